@@ -273,7 +273,12 @@ HEADERS += \
     src/comm/LinkConfiguration.h \
     src/comm/LinkInterface.h \
     src/comm/LinkManager.h \
+    src/comm/MAVLinkDecoderPool.h \
+    src/comm/MAVLinkFrameDecoder.h \
     src/comm/MAVLinkProtocol.h \
+    src/comm/MAVLinkRequestWindow.h \
+    src/comm/MAVLinkTlogIndex.h \
+    src/comm/MAVLinkTlogWriter.h \
     src/comm/ProtocolInterface.h \
     src/comm/QGCMAVLink.h \
     src/comm/TCPLink.h \
@@ -341,7 +346,10 @@ HEADERS += \
     src/QmlControls/QGCImageProvider.h \
     src/QtLocationPlugin/QMLControl/QGCMapEngineManager.h \
     src/PositionManager/PositionManager.h \
-    src/AnalyzeView/ExifParser.h
+    src/AnalyzeView/ExifParser.h \
+    src/AnalyzeView/LogFileView.h \
+    src/AnalyzeView/PX4LogParser.h \
+    src/AnalyzeView/ULogParser.h
 
 AndroidBuild {
 HEADERS += \
@@ -444,7 +452,12 @@ SOURCES += \
     src/CmdLineOptParser.cc \
     src/comm/LinkConfiguration.cc \
     src/comm/LinkManager.cc \
+    src/comm/MAVLinkDecoderPool.cc \
+    src/comm/MAVLinkFrameDecoder.cc \
     src/comm/MAVLinkProtocol.cc \
+    src/comm/MAVLinkRequestWindow.cc \
+    src/comm/MAVLinkTlogIndex.cc \
+    src/comm/MAVLinkTlogWriter.cc \
     src/comm/QGCMAVLink.cc \
     src/comm/TCPLink.cc \
     src/comm/UDPLink.cc \
@@ -508,7 +521,10 @@ SOURCES += \
     src/QtLocationPlugin/QMLControl/QGCMapEngineManager.cc \
     src/PositionManager/SimulatedPosition.cc \
     src/PositionManager/PositionManager.cpp \
-    src/AnalyzeView/ExifParser.cc
+    src/AnalyzeView/ExifParser.cc \
+    src/AnalyzeView/LogFileView.cc \
+    src/AnalyzeView/PX4LogParser.cc \
+    src/AnalyzeView/ULogParser.cc
 
 DebugBuild {
 SOURCES += \
@@ -593,7 +609,10 @@ INCLUDEPATH += \
     src/qgcunittest
 
 HEADERS += \
+    src/AnalyzeView/ExifParserTest.h \
+    src/AnalyzeView/GeoTagControllerTest.h \
     src/AnalyzeView/LogDownloadTest.h \
+    src/AnalyzeView/LogParserTest.h \
     src/FactSystem/FactSystemTestBase.h \
     src/FactSystem/FactSystemTestGeneric.h \
     src/FactSystem/FactSystemTestPX4.h \
@@ -611,8 +630,16 @@ HEADERS += \
     src/qgcunittest/FlightGearTest.h \
     src/qgcunittest/LinkManagerTest.h \
     src/qgcunittest/MainWindowTest.h \
+    src/qgcunittest/MAVLinkFrameDecoderTest.h \
+    src/qgcunittest/MAVLinkRequestWindowTest.h \
+    src/qgcunittest/MAVLinkTlogIndexTest.h \
+    src/qgcunittest/MAVLinkLogProcessorTest.h \
+    src/qgcunittest/TileCacheWorkerTest.h \
+    src/qgcunittest/TileDownloaderTest.h \
+    src/qgcunittest/MockLinkSwarmTest.h \
     src/qgcunittest/MavlinkLogTest.h \
     src/qgcunittest/MessageBoxTest.h \
+    src/qgcunittest/MockTileServer.h \
     src/qgcunittest/MultiSignalSpy.h \
     src/qgcunittest/RadioConfigTest.h \
     src/qgcunittest/TCPLinkTest.h \
@@ -620,7 +647,10 @@ HEADERS += \
     src/qgcunittest/UnitTest.h \
 
 SOURCES += \
+    src/AnalyzeView/ExifParserTest.cc \
+    src/AnalyzeView/GeoTagControllerTest.cc \
     src/AnalyzeView/LogDownloadTest.cc \
+    src/AnalyzeView/LogParserTest.cc \
     src/FactSystem/FactSystemTestBase.cc \
     src/FactSystem/FactSystemTestGeneric.cc \
     src/FactSystem/FactSystemTestPX4.cc \
@@ -638,8 +668,16 @@ SOURCES += \
     src/qgcunittest/FlightGearTest.cc \
     src/qgcunittest/LinkManagerTest.cc \
     src/qgcunittest/MainWindowTest.cc \
+    src/qgcunittest/MAVLinkFrameDecoderTest.cc \
+    src/qgcunittest/MAVLinkRequestWindowTest.cc \
+    src/qgcunittest/MAVLinkTlogIndexTest.cc \
+    src/qgcunittest/MAVLinkLogProcessorTest.cc \
+    src/qgcunittest/TileCacheWorkerTest.cc \
+    src/qgcunittest/TileDownloaderTest.cc \
+    src/qgcunittest/MockLinkSwarmTest.cc \
     src/qgcunittest/MavlinkLogTest.cc \
     src/qgcunittest/MessageBoxTest.cc \
+    src/qgcunittest/MockTileServer.cc \
     src/qgcunittest/MultiSignalSpy.cc \
     src/qgcunittest/RadioConfigTest.cc \
     src/qgcunittest/TCPLinkTest.cc \
@@ -805,7 +843,9 @@ HEADERS += \
     src/FactSystem/FactMetaData.h \
     src/FactSystem/FactSystem.h \
     src/FactSystem/FactValidator.h \
+    src/FactSystem/ParameterCacheSnapshot.h \
     src/FactSystem/ParameterManager.h \
+    src/FactSystem/ParameterStore.h \
     src/FactSystem/SettingsFact.h \
 
 SOURCES += \
@@ -815,7 +855,9 @@ SOURCES += \
     src/FactSystem/FactMetaData.cc \
     src/FactSystem/FactSystem.cc \
     src/FactSystem/FactValidator.cc \
+    src/FactSystem/ParameterCacheSnapshot.cc \
     src/FactSystem/ParameterManager.cc \
+    src/FactSystem/ParameterStore.cc \
     src/FactSystem/SettingsFact.cc \
 
 #-------------------------------------------------------------------------------------
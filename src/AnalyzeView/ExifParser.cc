@@ -3,6 +3,8 @@
 #include <QtEndian>
 #include <QDateTime>
 
+static const int kMaxExifHeaderSize = 1024 * 1024;
+
 ExifParser::ExifParser()
 {
 
@@ -56,6 +58,41 @@ double ExifParser::readTime(QByteArray& buf)
     return tagTime.toMSecsSinceEpoch()/1000.0;
 }
 
+bool ExifParser::readExifHeader(QIODevice& device, QByteArray& header)
+{
+    header = device.read(2);
+    if (header != QByteArray("\xff\xd8", 2)) {
+        return false;
+    }
+
+    // Walk the segments ahead of the image data, each one is at most 64k
+    while (header.size() < kMaxExifHeaderSize) {
+        QByteArray marker = device.read(4);
+        if (marker.size() != 4 || (uchar)marker[0] != 0xff) {
+            return false;
+        }
+        uchar type = marker[1];
+        if (type == 0xda || type == 0xd9) {
+            // Start of scan or end of image, there is no Exif data
+            return false;
+        }
+        int length = qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(marker.constData() + 2));
+        if (length < 2) {
+            return false;
+        }
+        QByteArray segment = device.read(length - 2);
+        if (segment.size() != length - 2) {
+            return false;
+        }
+        header.append(marker);
+        header.append(segment);
+        if (type == 0xe1 && segment.startsWith(QByteArray("Exif\0\0", 6))) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool ExifParser::write(QByteArray &buf, QGeoCoordinate coordinate)
 {
     QByteArray app1Header("\xff\xe1", 2);
@@ -2,6 +2,7 @@
 #define EXIFPARSER_H
 
 #include <QGeoCoordinate>
+#include <QIODevice>
 #include <QDebug>
 
 class ExifParser
@@ -11,6 +12,12 @@ public:
     ~ExifParser();
     double readTime(QByteArray& buf);
     bool write(QByteArray& data, QGeoCoordinate coordinate);
+
+    /// Reads a JPEG from the start through the end of the Exif APP1 segment. readTime and write only need this part
+    /// of the file, the image data after it can be streamed.
+    ///     @param header Returns the bytes read
+    ///     @return false: not a JPEG, or no Exif segment ahead of the image data
+    bool readExifHeader(QIODevice& device, QByteArray& header);
 };
 
 #endif // EXIFPARSER_H
@@ -0,0 +1,197 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "ExifParserTest.h"
+#include "ExifParser.h"
+#include "GeoTagController.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+static const char* _captureTime = "2016:09:01 12:34:56";
+
+template<typename T>
+static void _append(QByteArray& bytes, T value)
+{
+    uchar buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    bytes.append((const char*)buffer, sizeof(T));
+}
+
+/// Appends a JPEG marker segment, the length includes the two length bytes
+static void _appendSegment(QByteArray& jpeg, uchar type, const QByteArray& payload)
+{
+    uchar length[2];
+    qToBigEndian<quint16>(payload.length() + 2, length);
+    jpeg.append((char)0xff);
+    jpeg.append((char)type);
+    jpeg.append((const char*)length, 2);
+    jpeg.append(payload);
+}
+
+/// Appends a TIFF IFD entry whose value is stored at offset
+static void _appendEntry(QByteArray& tiff, quint16 tag, quint16 type, quint32 count, quint32 offset)
+{
+    _append<quint16>(tiff, tag);
+    _append<quint16>(tiff, type);
+    _append<quint32>(tiff, count);
+    _append<quint32>(tiff, offset);
+}
+
+ExifParserTest::ExifParserTest(void)
+{
+
+}
+
+/// Exif segment laid out the way ExifParser::write expects: an IFD0 with the image description and capture time,
+/// twelve spaces of image description straight after the next IFD offset, and an empty IFD1 where the GPS IFD goes.
+QByteArray ExifParserTest::_exifPayload(void)
+{
+    QByteArray tiff("II\x2a\x00", 4);
+    _append<quint32>(tiff, 8);
+
+    _append<quint16>(tiff, 2);
+    _appendEntry(tiff, 0x010e, 2, 13, 38);      // ImageDescription
+    _appendEntry(tiff, 0x9004, 2, 20, 51);      // DateTimeOriginal
+    _append<quint32>(tiff, 71);                 // IFD1
+
+    tiff.append("            ", 12);
+    tiff.append('\0');
+    tiff.append(_captureTime, qstrlen(_captureTime) + 1);
+
+    _append<quint16>(tiff, 0);
+    _append<quint32>(tiff, 0);
+
+    return QByteArray("Exif\0\0", 6) + tiff;
+}
+
+/// Builds a JPEG with optional APP0/APP2 segments ahead of its APP1 segment. Without Exif the APP1 segment holds XMP.
+///     @param[out] exifStart Offset of the APP1 segment
+///     @param[out] exifEnd Offset just past the APP1 segment
+QByteArray ExifParserTest::_jpeg(bool appSegments, bool exif, int& exifStart, int& exifEnd)
+{
+    QByteArray jpeg("\xff\xd8", 2);
+
+    if (appSegments) {
+        _appendSegment(jpeg, 0xe0, QByteArray("JFIF\0\x01\x01\x00\x00\x01\x00\x01\x00\x00", 14));
+        QByteArray icc("ICC_PROFILE\0\x01\x01", 14);
+        for (int i=0; i<32; i++) {
+            icc.append((char)i);
+        }
+        _appendSegment(jpeg, 0xe2, icc);
+    }
+
+    exifStart = jpeg.length();
+    if (exif) {
+        _appendSegment(jpeg, 0xe1, _exifPayload());
+    } else {
+        _appendSegment(jpeg, 0xe1, QByteArray("http://ns.adobe.com/xap/1.0/\0<x:xmpmeta/>", 41));
+    }
+    exifEnd = jpeg.length();
+
+    // Start of scan then the image data. The data has stray markers in it, which must be copied untouched.
+    _appendSegment(jpeg, 0xda, QByteArray("\x01\x01\x00\x00\x3f\x00", 6));
+    for (int i=0; i<_imageDataSize; i++) {
+        jpeg.append((char)(i * 31));
+    }
+    jpeg.append("\xff\xe1\xff\xd9", 4);
+
+    return jpeg;
+}
+
+void ExifParserTest::_readExifHeader_test(void)
+{
+    double captureTime = QDateTime(QDate(2016, 9, 1), QTime(12, 34, 56)).toMSecsSinceEpoch() / 1000.0;
+
+    // Exif straight after the start of image, and after APP0/APP2 segments
+    for (int appSegments=0; appSegments<2; appSegments++) {
+        int exifStart, exifEnd;
+        QByteArray jpeg = _jpeg(appSegments, true /* exif */, exifStart, exifEnd);
+        QBuffer buffer(&jpeg);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+        ExifParser exifParser;
+        QByteArray header;
+        QVERIFY(exifParser.readExifHeader(buffer, header));
+        QCOMPARE(header, jpeg.left(exifEnd));
+        QCOMPARE(buffer.pos(), (qint64)exifEnd);
+        QCOMPARE(exifParser.readTime(header), captureTime);
+    }
+}
+
+void ExifParserTest::_noExif_test(void)
+{
+    int exifStart, exifEnd;
+    QByteArray header;
+    ExifParser exifParser;
+
+    // Other APP1 data is walked over, up to the start of scan
+    QByteArray jpeg = _jpeg(true /* appSegments */, false /* exif */, exifStart, exifEnd);
+    QBuffer buffer(&jpeg);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QVERIFY(!exifParser.readExifHeader(buffer, header));
+
+    // Not a JPEG
+    QByteArray gif("GIF89a\x01\x00\x01\x00", 10);
+    QBuffer gifBuffer(&gif);
+    QVERIFY(gifBuffer.open(QIODevice::ReadOnly));
+    QVERIFY(!exifParser.readExifHeader(gifBuffer, header));
+
+    // Cut off part way through a segment ahead of the Exif data
+    QByteArray truncated = _jpeg(true /* appSegments */, true /* exif */, exifStart, exifEnd).left(exifStart - 10);
+    QBuffer truncatedBuffer(&truncated);
+    QVERIFY(truncatedBuffer.open(QIODevice::ReadOnly));
+    QVERIFY(!exifParser.readExifHeader(truncatedBuffer, header));
+}
+
+void ExifParserTest::_tagImage_test(void)
+{
+    QTemporaryDir tempDir;
+    QString sourceFileName = tempDir.path() + QStringLiteral("/source.jpg");
+    QString saveFileName = tempDir.path() + QStringLiteral("/tagged.jpg");
+
+    int exifStart, exifEnd;
+    QByteArray source = _jpeg(true /* appSegments */, true /* exif */, exifStart, exifEnd);
+    QFile sourceFile(sourceFileName);
+    QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+    QCOMPARE(sourceFile.write(source), (qint64)source.length());
+    sourceFile.close();
+
+    QCOMPARE(GeoTagWorker::_tagImage(sourceFileName, saveFileName, QGeoCoordinate(47.3977, 8.5456, 488.0)), GeoTagWorker::ImageOk);
+
+    QFile savedFile(saveFileName);
+    QVERIFY(savedFile.open(QIODevice::ReadOnly));
+    QByteArray tagged = savedFile.readAll();
+
+    // Only the APP1 segment changes, everything ahead of it and all of the image data is copied as is
+    QCOMPARE(tagged.length(), source.length() + _gpsDataSize);
+    QCOMPARE(tagged.left(exifStart), source.left(exifStart));
+    QCOMPARE(tagged.mid(exifEnd + _gpsDataSize), source.mid(exifEnd));
+    quint16 app1Length = qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(tagged.constData() + exifStart + 2));
+    QCOMPARE((int)app1Length, exifEnd - exifStart - 2 + _gpsDataSize);
+
+    // The tagged copy is still a readable JPEG
+    QBuffer buffer(&tagged);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    ExifParser exifParser;
+    QByteArray header;
+    QVERIFY(exifParser.readExifHeader(buffer, header));
+    QCOMPARE(header.length(), exifEnd + _gpsDataSize);
+
+    // Images without Exif data, or which can't be opened, are not tagged
+    QByteArray noExif = _jpeg(true /* appSegments */, false /* exif */, exifStart, exifEnd);
+    QVERIFY(sourceFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(sourceFile.write(noExif), (qint64)noExif.length());
+    sourceFile.close();
+    QCOMPARE(GeoTagWorker::_tagImage(sourceFileName, saveFileName, QGeoCoordinate(47.3977, 8.5456, 488.0)), GeoTagWorker::ImageWriteFailed);
+    QCOMPARE(GeoTagWorker::_tagImage(tempDir.path() + QStringLiteral("/missing.jpg"), saveFileName, QGeoCoordinate(47.3977, 8.5456, 488.0)), GeoTagWorker::ImageReadFailed);
+}
@@ -0,0 +1,36 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef ExifParserTest_H
+#define ExifParserTest_H
+
+#include "UnitTest.h"
+
+/// Unit test for ExifParser and the streamed image tagging in GeoTagWorker, run against small generated JPEGs
+class ExifParserTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    ExifParserTest(void);
+
+private slots:
+    void _readExifHeader_test(void);
+    void _noExif_test(void);
+    void _tagImage_test(void);
+
+private:
+    QByteArray _jpeg(bool appSegments, bool exif, int& exifStart, int& exifEnd);
+    QByteArray _exifPayload(void);
+
+    static const int _imageDataSize =   600 * 1024; ///< More than one copy block, so tagging streams the image data
+    static const int _gpsDataSize =     0xa5;       ///< Bytes ExifParser::write adds to the Exif segment
+};
+
+#endif
@@ -9,13 +9,24 @@
 
 #include "GeoTagController.h"
 #include "ExifParser.h"
+#include "LogFileView.h"
+#include "PX4LogParser.h"
+#include "ULogParser.h"
 #include "QGCFileDialog.h"
 #include "QGCLoggingCategory.h"
 #include <math.h>
 #include <QtEndian>
 #include <QMessageBox>
 #include <QDebug>
+#include <QtConcurrent>
 #include <cfloat>
+#include <algorithm>
+
+static const qint64 kImageCopyBlockSize = 256 * 1024;
+static const int    kImageProgressMSecs = 50;
+static const double kMatchToleranceSecs = 1.0;     // Exif times only have a resolution of one second
+static const int    kOffsetSearchWindow = 5;
+static const int    kOffsetSearchWindowMax = 200;
 
 GeoTagController::GeoTagController(void)
     : _progress(0)
@@ -34,7 +45,7 @@ GeoTagController::~GeoTagController()
 
 void GeoTagController::pickLogFile(void)
 {
-    QString filename = QGCFileDialog::getOpenFileName(NULL, "Select log file load", QString(), "PX4 log file (*.px4log);;All Files (*.*)");
+    QString filename = QGCFileDialog::getOpenFileName(NULL, "Select log file load", QString(), "PX4 log file (*.px4log *.ulg);;All Files (*.*)");
     if (!filename.isEmpty()) {
         _worker.setLogFile(filename);
         emit logFileChanged(filename);
@@ -170,27 +181,41 @@ void GeoTagWorker::run(void)
     }
     emit progressChanged((100/nSteps));
 
-    // Parse EXIF
-    ExifParser exifParser;
-    _tagTime.clear();
+    // Parse EXIF, only the header of each image is read
+    QVector<ImageTime_t> imageTimes(_imageList.size());
     for (int i = 0; i < _imageList.size(); ++i) {
-        QFile file(_imageList.at(i).absoluteFilePath());
+        imageTimes[i].fileName = _imageList.at(i).absoluteFilePath();
+        imageTimes[i].time = -1.0;
+        imageTimes[i].result = ImageOk;
+    }
+    _imageFailed = 0;
+    QFuture<void> timeFuture = QtConcurrent::map(imageTimes, [this](ImageTime_t& image) {
+        QFile file(image.fileName);
         if (!file.open(QIODevice::ReadOnly)) {
-            emit error(tr("Geotagging failed. Couldn't open an image."));
+            image.result = ImageReadFailed;
+            _imageFailed = 1;
             return;
         }
-        QByteArray imageBuffer = file.readAll();
-        file.close();
-
-        _tagTime.append(exifParser.readTime(imageBuffer));
-
-        emit progressChanged((100/nSteps) + ((100/nSteps) / _imageList.size())*i);
-
-        if (_cancel) {
-            qCDebug(GeotaggingLog) << "Tagging cancelled";
-            emit error(tr("Tagging cancelled"));
+        ExifParser exifParser;
+        QByteArray header;
+        if (exifParser.readExifHeader(file, header)) {
+            image.time = exifParser.readTime(header);
+        } else {
+            qCDebug(GeotaggingLog) << "No Exif data in" << image.fileName;
+        }
+    });
+    if (!_waitForImages(timeFuture, 100/nSteps, 100/nSteps)) {
+        qCDebug(GeotaggingLog) << "Tagging cancelled";
+        emit error(tr("Tagging cancelled"));
+        return;
+    }
+    _tagTime.clear();
+    foreach (const ImageTime_t& image, imageTimes) {
+        if (image.result != ImageOk) {
+            emit error(tr("Geotagging failed. Couldn't open an image."));
             return;
         }
+        _tagTime.append(image.time);
     }
 
     // Load PX4 log
@@ -234,37 +259,36 @@ void GeoTagWorker::run(void)
     // Tag images
     int maxIndex = std::min(_imageIndices.count(), _triggerIndices.count());
     maxIndex = std::min(maxIndex, _imageList.count());
+    QVector<ImageTag_t> imageTags(maxIndex);
     for(int i = 0; i < maxIndex; i++) {
-        QFile fileRead(_imageList.at(_imageIndices[i]).absoluteFilePath());
-        if (!fileRead.open(QIODevice::ReadOnly)) {
-            emit error(tr("Geotagging failed. Couldn't open an image."));
-            return;
-        }
-        QByteArray imageBuffer = fileRead.readAll();
-        fileRead.close();
-
-        if (!exifParser.write(imageBuffer, _geoRef[_triggerIndices[i]])) {
-            emit error(tr("Geotagging failed. Couldn't write to image."));
-            return;
+        const QFileInfo& imageInfo = _imageList.at(_imageIndices[i]);
+        imageTags[i].sourceFileName = imageInfo.absoluteFilePath();
+        if(_saveDirectory == "") {
+            imageTags[i].saveFileName = _imageDirectory + "/TAGGED/" + imageInfo.fileName();
         } else {
-            QFile fileWrite;
-            if(_saveDirectory == "") {
-                fileWrite.setFileName(_imageDirectory + "/TAGGED/" + _imageList.at(_imageIndices[i]).fileName());
-            } else {
-                fileWrite.setFileName(_saveDirectory + "/" + _imageList.at(_imageIndices[i]).fileName());
-            }
-            if (!fileWrite.open(QFile::WriteOnly)) {
-                emit error(tr("Geotagging failed. Couldn't write to an image."));
-                return;
-            }
-            fileWrite.write(imageBuffer);
-            fileWrite.close();
+            imageTags[i].saveFileName = _saveDirectory + "/" + imageInfo.fileName();
         }
-        emit progressChanged(4*(100/nSteps) + ((100/nSteps) / maxIndex)*i);
-
-        if (_cancel) {
-            qCDebug(GeotaggingLog) << "Tagging cancelled";
-            emit error(tr("Tagging cancelled"));
+        imageTags[i].coordinate = _geoRef[_triggerIndices[i]];
+        imageTags[i].result = ImageOk;
+    }
+    _imageFailed = 0;
+    QFuture<void> tagFuture = QtConcurrent::map(imageTags, [this](ImageTag_t& image) {
+        image.result = _tagImage(image.sourceFileName, image.saveFileName, image.coordinate);
+        if (image.result != ImageOk) {
+            _imageFailed = 1;
+        }
+    });
+    if (!_waitForImages(tagFuture, 4*(100/nSteps), 100/nSteps)) {
+        qCDebug(GeotaggingLog) << "Tagging cancelled";
+        emit error(tr("Tagging cancelled"));
+        return;
+    }
+    foreach (const ImageTag_t& image, imageTags) {
+        if (image.result == ImageReadFailed) {
+            emit error(tr("Geotagging failed. Couldn't open an image."));
+            return;
+        } else if (image.result == ImageWriteFailed) {
+            emit error(tr("Geotagging failed. Couldn't write to an image."));
             return;
         }
     }
@@ -278,111 +302,256 @@ void GeoTagWorker::run(void)
     emit progressChanged(100);
 }
 
+/// Waits for images to be processed on the thread pool, reporting progress and handling cancellation
+///     @return false: tagging was cancelled
+bool GeoTagWorker::_waitForImages(QFuture<void>& future, double progressStart, double progressSpan)
+{
+    while (!future.isFinished()) {
+        if (_cancel || _imageFailed.load()) {
+            // Images already being processed are finished off
+            future.cancel();
+            future.waitForFinished();
+            break;
+        }
+        if (future.progressMaximum() > 0) {
+            emit progressChanged(progressStart + (progressSpan * future.progressValue()) / future.progressMaximum());
+        }
+        QThread::msleep(kImageProgressMSecs);
+    }
+    return !_cancel;
+}
+
+/// Writes a tagged copy of an image. Only the Exif header is read into memory and rewritten, the image data is copied
+/// across in blocks.
+GeoTagWorker::ImageResult_t GeoTagWorker::_tagImage(const QString& sourceFileName, const QString& saveFileName, const QGeoCoordinate& coordinate)
+{
+    QFile fileRead(sourceFileName);
+    if (!fileRead.open(QIODevice::ReadOnly)) {
+        return ImageReadFailed;
+    }
+
+    ExifParser exifParser;
+    QByteArray header;
+    if (!exifParser.readExifHeader(fileRead, header) || !exifParser.write(header, coordinate)) {
+        return ImageWriteFailed;
+    }
+
+    QFile fileWrite(saveFileName);
+    if (!fileWrite.open(QFile::WriteOnly)) {
+        return ImageWriteFailed;
+    }
+    if (fileWrite.write(header) != header.size()) {
+        return ImageWriteFailed;
+    }
+    while (!fileRead.atEnd()) {
+        QByteArray block = fileRead.read(kImageCopyBlockSize);
+        if (block.isEmpty() || fileWrite.write(block) != block.size()) {
+            return ImageWriteFailed;
+        }
+    }
+
+    return ImageOk;
+}
+
+/// Loads the trigger times and positions from a PX4 log or a ULog. The log is streamed through a mapped view, so
+/// its size is not limited by memory.
 bool GeoTagWorker::parsePX4Log()
 {
-    // general message header
-    char header[] = {(char)0xA3, (char)0x95, (char)0x00};
-    // header for GPOS message header
-    char gposHeaderHeader[] = {(char)0xA3, (char)0x95, (char)0x80, (char)0x10, (char)0x00};
-    int gposHeaderOffset;
-    // header for GPOS message
-    char gposHeader[] = {(char)0xA3, (char)0x95, (char)0x10, (char)0x00};
-    int gposOffsets[3] = {3, 7, 11};
-    int gposLengths[3] = {4, 4, 4};
-    // header for trigger message header
-    char triggerHeaderHeader[] = {(char)0xA3, (char)0x95, (char)0x80, (char)0x37, (char)0x00};
-    int triggerHeaderOffset;
-    // header for trigger message
-    char triggerHeader[] = {(char)0xA3, (char)0x95, (char)0x37, (char)0x00};
-    int triggerOffsets[2] = {3, 11};
-    int triggerLengths[2] = {8, 4};
-
-    // load log
-    QFile file(_logFile);
-    if (!file.open(QIODevice::ReadOnly)) {
+    LogFileView log;
+    if (!log.open(_logFile)) {
         qCDebug(GeotaggingLog) << "Could not open log file " << _logFile;
         return false;
     }
-    QByteArray log = file.readAll();
-    file.close();
 
-    // extract header information: message lengths
-    uint8_t* iptr = reinterpret_cast<uint8_t*>(log.mid(log.indexOf(gposHeaderHeader) + 4, 1).data());
-    gposHeaderOffset = static_cast<int>(qFromLittleEndian(*iptr));
-    iptr = reinterpret_cast<uint8_t*>(log.mid(log.indexOf(triggerHeaderHeader) + 4, 1).data());
-    triggerHeaderOffset = static_cast<int>(qFromLittleEndian(*iptr));
+    if (ULogParser::isULog(log)) {
+        ULogParser parser;
+        return parser.getTagsFromLog(log, _cancel, _triggerTime, _geoRef);
+    } else {
+        PX4LogParser parser;
+        return parser.getTagsFromLog(log, _cancel, _triggerTime, _geoRef);
+    }
+}
 
-    // extract trigger data
-    int index = 1;
-    int sequence = -1;
-    QGeoCoordinate lastCoordinate;
-    while(index < log.count() - 1) {
+/// Matches images to trigger events by time. The camera and the vehicle clocks are lined up with an estimated offset,
+/// then images and triggers are paired up in time order. Missed triggers and missing images only leave the items
+/// concerned unmatched, rather than shifting every later image onto the wrong position.
+bool GeoTagWorker::triggerFiltering()
+{
+    _imageIndices.clear();
+    _triggerIndices.clear();
 
-        if (_cancel) {
-            return false;
+    // Images and triggers by time, images without a capture time can't be matched
+    QList<int> images;
+    for(int i = 0; i < _tagTime.count(); i++) {
+        if(_tagTime[i] >= 0) {
+            images.append(i);
         }
+    }
+    std::stable_sort(images.begin(), images.end(), [this](int a, int b) { return _tagTime[a] < _tagTime[b]; });
+    QList<int> triggers;
+    for(int i = 0; i < _triggerTime.count() && i < _geoRef.count(); i++) {
+        triggers.append(i);
+    }
+    std::stable_sort(triggers.begin(), triggers.end(), [this](int a, int b) { return _triggerTime[a] < _triggerTime[b]; });
 
-        // first extract trigger
-        index = log.indexOf(triggerHeader, index + 1);
-        // check for whether last entry has been passed
-        if (index < 0) {
-            break;
+    double offset;
+    if(_estimateClockOffset(images, triggers, offset)) {
+        qCDebug(GeotaggingLog) << "Camera to log clock offset:" << offset;
+        _alignTriggers(images, triggers, offset);
+    } else {
+        // Not enough to go on, fall back to pairing images and triggers in order
+        qCWarning(GeotaggingLog) << "Could not line up image times with trigger times, matching images to triggers in order";
+        for(int i = 0; i < _tagTime.count() && i < _triggerTime.count(); i++) {
+            _imageIndices.append(i);
+            _triggerIndices.append(i);
         }
+    }
+    int unmatchedImages, unmatchedTriggers;
+    _reportUnmatched(unmatchedImages, unmatchedTriggers);
+
+    return !_imageIndices.isEmpty();
+}
 
-        if (log.indexOf(header, index + 1) != index + triggerHeaderOffset) {
-            continue;
+/// Estimates the offset from camera time to log time. Each image is paired with the triggers around the one at the same
+/// relative position in the sequence, and the offset is taken from the densest cluster of pair offsets. Dropped
+/// triggers or images only add to the scattered pairs.
+///     @return false: no offset is supported by enough pairs
+bool GeoTagWorker::_estimateClockOffset(const QList<int>& images, const QList<int>& triggers, double& offset)
+{
+    const int imageCount = images.count();
+    const int triggerCount = triggers.count();
+    if(imageCount < 2 || triggerCount < 2) {
+        return false;
+    }
+
+    const int window = std::min(kOffsetSearchWindow + std::abs(imageCount - triggerCount), kOffsetSearchWindowMax);
+    QVector<double> offsets;
+    offsets.reserve(imageCount * (2 * window + 1));
+    for(int i = 0; i < imageCount; i++) {
+        int center = qRound((double)i * (triggerCount - 1) / (imageCount - 1));
+        int first = std::max(0, center - window);
+        int last = std::min(triggerCount - 1, center + window);
+        for(int j = first; j <= last; j++) {
+            offsets.append(_triggerTime[triggers[j]] - _tagTime[images[i]]);
+        }
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    // Densest window of offsets
+    int bestStart = 0;
+    int bestCount = 0;
+    int end = 0;
+    for(int start = 0; start < offsets.count(); start++) {
+        while(end < offsets.count() && offsets[end] - offsets[start] <= kMatchToleranceSecs) {
+            end++;
         }
-        uint64_t* time = reinterpret_cast<uint64_t*>(log.mid(index + triggerOffsets[0], triggerLengths[0]).data());
-        double timeDouble = static_cast<double>(qFromLittleEndian(*time)) / 1.0e6;
-        uint32_t* seq = reinterpret_cast<uint32_t*>(log.mid(index + triggerOffsets[1], triggerLengths[1]).data());
-        int seqInt = static_cast<int>(qFromLittleEndian(*seq));
-        if (sequence >= seqInt || sequence + 20 < seqInt) { // assume that logging has not skipped more than 20 triggers. this prevents wrong header detection
-            continue;
+        if(end - start > bestCount) {
+            bestStart = start;
+            bestCount = end - start;
         }
-        _triggerTime.append(timeDouble);
-        sequence = seqInt;
+    }
 
-        // second extract position
-        bool lookForGpos = true;
-        while (lookForGpos) {
+    // Most images need to back the offset up
+    if(bestCount < std::max(3, std::min(imageCount, triggerCount) / 4)) {
+        return false;
+    }
+    offset = offsets[bestStart + (bestCount / 2)];
+    return true;
+}
 
-            if (_cancel) {
-                return false;
-            }
+/// Pairs up images and triggers which are within the match tolerance once the clock offset is applied. Of all the
+/// candidate pairs, the largest set which keeps both images and triggers in time order is picked, with the smallest
+/// total time error breaking ties. This is a longest increasing subsequence over the candidate pairs, O(n log n).
+void GeoTagWorker::_alignTriggers(const QList<int>& images, const QList<int>& triggers, double offset)
+{
+    typedef struct {
+        int     image;      // Position in images
+        int     trigger;    // Position in triggers
+        double  error;
+        int     count;      // Length of the best chain ending with this pair
+        double  chainError;
+        int     previous;   // Previous pair in that chain, -1 for none
+    } Pair_t;
+
+    QVector<double> triggerTimes;
+    triggerTimes.reserve(triggers.count());
+    foreach(int trigger, triggers) {
+        triggerTimes.append(_triggerTime[trigger]);
+    }
+
+    // Candidate pairs by image, with the later trigger first for each image so an image is never used twice
+    QVector<Pair_t> pairs;
+    for(int i = 0; i < images.count(); i++) {
+        double time = _tagTime[images[i]] + offset;
+        int first = std::lower_bound(triggerTimes.begin(), triggerTimes.end(), time - kMatchToleranceSecs) - triggerTimes.begin();
+        int last = std::upper_bound(triggerTimes.begin(), triggerTimes.end(), time + kMatchToleranceSecs) - triggerTimes.begin();
+        for(int j = last - 1; j >= first; j--) {
+            Pair_t pair = { i, j, fabs(triggerTimes[j] - time), 0, 0, -1 };
+            pairs.append(pair);
+        }
+    }
 
-            int gposIndex = log.indexOf(gposHeader, index + 1);
-            if (gposIndex < 0) {
-                _geoRef.append(lastCoordinate);
-                break;
+    // Fenwick tree over trigger positions holding the best chain ending at or before each position
+    auto better = [&pairs](int a, int b) {
+        if(b < 0) return a >= 0;
+        if(a < 0) return false;
+        return pairs[a].count > pairs[b].count || (pairs[a].count == pairs[b].count && pairs[a].chainError < pairs[b].chainError);
+    };
+    QVector<int> tree(triggers.count() + 1, -1);
+    int best = -1;
+    for(int p = 0; p < pairs.count(); p++) {
+        // Best chain using triggers before this one
+        int previous = -1;
+        for(int k = pairs[p].trigger; k > 0; k -= k & -k) {
+            if(better(tree[k], previous)) {
+                previous = tree[k];
             }
-            index = gposIndex;
-            // verify that at an offset of gposHeaderOffset the next log message starts
-            if (gposIndex + gposHeaderOffset == log.indexOf(header, gposIndex + 1)) {
-                int32_t* lat = reinterpret_cast<int32_t*>(log.mid(gposIndex + gposOffsets[0], gposLengths[0]).data());
-                double latitude = static_cast<double>(qFromLittleEndian(*lat))/1.0e7;
-                lastCoordinate.setLatitude(latitude);
-                int32_t* lon = reinterpret_cast<int32_t*>(log.mid(gposIndex + gposOffsets[1], gposLengths[1]).data());
-                double longitude = static_cast<double>(qFromLittleEndian(*lon))/1.0e7;
-                longitude = fmod(180.0 + longitude, 360.0) - 180.0;
-                lastCoordinate.setLongitude(longitude);
-                float* alt = reinterpret_cast<float*>(log.mid(gposIndex + gposOffsets[2], gposLengths[2]).data());
-                lastCoordinate.setAltitude(qFromLittleEndian(*alt));
-                _geoRef.append(lastCoordinate);
-                break;
+        }
+        pairs[p].previous   = previous;
+        pairs[p].count      = (previous < 0 ? 0 : pairs[previous].count) + 1;
+        pairs[p].chainError = (previous < 0 ? 0 : pairs[previous].chainError) + pairs[p].error;
+        for(int k = pairs[p].trigger + 1; k < tree.count(); k += k & -k) {
+            if(better(p, tree[k])) {
+                tree[k] = p;
             }
         }
+        if(better(p, best)) {
+            best = p;
+        }
+    }
+
+    for(int p = best; p >= 0; p = pairs[p].previous) {
+        _imageIndices.prepend(images[pairs[p].image]);
+        _triggerIndices.prepend(triggers[pairs[p].trigger]);
     }
-    return true;
 }
 
-bool GeoTagWorker::triggerFiltering()
+/// Logs the images and triggers which were left without a match
+///     @param[out] unmatchedImages Number of images without a trigger
+///     @param[out] unmatchedTriggers Number of triggers without an image
+void GeoTagWorker::_reportUnmatched(int& unmatchedImages, int& unmatchedTriggers)
 {
-    _imageIndices.clear();
-    _triggerIndices.clear();
-    for(int i = 0; i < _tagTime.count() && i < _triggerTime.count(); i++) {
-        _imageIndices.append(i);
-        _triggerIndices.append(i);
+    QVector<bool> imageMatched(_imageList.count(), false);
+    foreach(int image, _imageIndices) {
+        imageMatched[image] = true;
     }
-
-    return true;
+    unmatchedImages = 0;
+    for(int i = 0; i < imageMatched.count(); i++) {
+        if(!imageMatched[i]) {
+            unmatchedImages++;
+            qCWarning(GeotaggingLog) << "No trigger for image" << _imageList.at(i).fileName();
+        }
+    }
+    QVector<bool> triggerMatched(_triggerTime.count(), false);
+    foreach(int trigger, _triggerIndices) {
+        triggerMatched[trigger] = true;
+    }
+    unmatchedTriggers = 0;
+    for(int i = 0; i < triggerMatched.count(); i++) {
+        if(!triggerMatched[i]) {
+            unmatchedTriggers++;
+            qCDebug(GeotaggingLog) << "No image for trigger at" << _triggerTime[i];
+        }
+    }
+    qCDebug(GeotaggingLog) << "Matched" << _imageIndices.count() << "images, unmatched images:" << unmatchedImages << "unmatched triggers:" << unmatchedTriggers;
 }
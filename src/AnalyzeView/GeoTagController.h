@@ -20,11 +20,16 @@
 #include <QElapsedTimer>
 #include <QDebug>
 #include <QGeoCoordinate>
+#include <QFuture>
+#include <QAtomicInt>
 
 class GeoTagWorker : public QThread
 {
     Q_OBJECT
 
+    friend class GeoTagControllerTest; ///< This allows our unit test to access internal information needed.
+    friend class ExifParserTest;       ///< This allows our unit test to access internal information needed.
+
 public:
     GeoTagWorker(void);
 
@@ -49,8 +54,36 @@ signals:
 private:
     bool parsePX4Log();
     bool triggerFiltering();
+    bool _estimateClockOffset(const QList<int>& images, const QList<int>& triggers, double& offset);
+    void _alignTriggers(const QList<int>& images, const QList<int>& triggers, double offset);
+    void _reportUnmatched(int& unmatchedImages, int& unmatchedTriggers);
+
+    typedef enum {
+        ImageOk,
+        ImageReadFailed,
+        ImageWriteFailed
+    } ImageResult_t;
+
+    /// Capture time for an image, filled in on the thread pool
+    typedef struct {
+        QString         fileName;
+        double          time;
+        ImageResult_t   result;
+    } ImageTime_t;
+
+    /// Tagged copy of an image, written on the thread pool
+    typedef struct {
+        QString         sourceFileName;
+        QString         saveFileName;
+        QGeoCoordinate  coordinate;
+        ImageResult_t   result;
+    } ImageTag_t;
+
+    static ImageResult_t _tagImage(const QString& sourceFileName, const QString& saveFileName, const QGeoCoordinate& coordinate);
+    bool _waitForImages(QFuture<void>& future, double progressStart, double progressSpan);
 
     bool                    _cancel;
+    QAtomicInt              _imageFailed;   ///< Set by the thread pool to stop processing after the first failure
     QString                 _logFile;
     QString                 _imageDirectory;
     QString                 _saveDirectory;
@@ -0,0 +1,134 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "GeoTagControllerTest.h"
+#include "GeoTagController.h"
+
+static const double _clockOffsetSecs =  600.0;  ///< Log time minus camera time
+static const double _captureSpacing =   3.0;    ///< Seconds between captures
+static const double _logStartSecs =     1000.0;
+
+GeoTagControllerTest::GeoTagControllerTest(void)
+{
+
+}
+
+/// Fills in the image and trigger times of a flight with a dropped trigger, an extra image and a stray trigger at the
+/// end. Image times are whole seconds like Exif times, trigger times are a little late by varying amounts.
+///     @param[out] images Image indices in time order
+///     @param[out] triggers Trigger indices in time order
+void GeoTagControllerTest::_setupTimes(GeoTagWorker& worker, QList<int>& images, QList<int>& triggers)
+{
+    worker._imageList.clear();
+    worker._tagTime.clear();
+    worker._triggerTime.clear();
+    worker._imageIndices.clear();
+    worker._triggerIndices.clear();
+
+    for (int i=0; i<_captureCount; i++) {
+        double logTime = _logStartSecs + (i * _captureSpacing);
+
+        worker._tagTime.append(logTime - _clockOffsetSecs);
+        if (i == _extraImageAfter) {
+            // Half way between two captures, so out of tolerance of either trigger
+            worker._tagTime.append(logTime + (_captureSpacing / 2) - _clockOffsetSecs);
+        }
+        if (i != _droppedTrigger) {
+            worker._triggerTime.append(logTime + (0.1 * (i % 3)));
+        }
+    }
+    worker._triggerTime.append(_logStartSecs + (_captureCount * _captureSpacing) + 1.5);
+
+    images.clear();
+    for (int i=0; i<worker._tagTime.count(); i++) {
+        worker._imageList.append(QFileInfo(QString("IMG_%1.JPG").arg(i, 4, 10, QChar('0'))));
+        images.append(i);
+    }
+    triggers.clear();
+    for (int i=0; i<worker._triggerTime.count(); i++) {
+        triggers.append(i);
+    }
+}
+
+void GeoTagControllerTest::_clockOffset_test(void)
+{
+    GeoTagWorker    worker;
+    QList<int>      images;
+    QList<int>      triggers;
+    double          offset = 0;
+
+    _setupTimes(worker, images, triggers);
+    QVERIFY(images.count() != triggers.count());
+    QVERIFY(worker._estimateClockOffset(images, triggers, offset));
+    QVERIFY(offset >= _clockOffsetSecs && offset <= _clockOffsetSecs + 0.2);
+
+    // A constant offset a whole number of captures away still wins over pairing each image with a neighbouring trigger
+    for (int i=0; i<worker._triggerTime.count(); i++) {
+        worker._triggerTime[i] += _captureSpacing * 2;
+    }
+    QVERIFY(worker._estimateClockOffset(images, triggers, offset));
+    QVERIFY(offset >= _clockOffsetSecs + (_captureSpacing * 2) && offset <= _clockOffsetSecs + (_captureSpacing * 2) + 0.2);
+
+    // Too few images to back an offset up
+    QVERIFY(!worker._estimateClockOffset(images.mid(0, 1), triggers, offset));
+    QVERIFY(!worker._estimateClockOffset(images.mid(0, 2), triggers.mid(0, 2), offset));
+}
+
+void GeoTagControllerTest::_alignTriggers_test(void)
+{
+    GeoTagWorker    worker;
+    QList<int>      images;
+    QList<int>      triggers;
+
+    _setupTimes(worker, images, triggers);
+    worker._alignTriggers(images, triggers, _clockOffsetSecs);
+
+    // The image without a trigger and the extra image are skipped, all the others keep their own trigger
+    QList<int> expectedImages;
+    QList<int> expectedTriggers;
+    int image = 0;
+    int trigger = 0;
+    for (int i=0; i<_captureCount; i++) {
+        if (i != _droppedTrigger) {
+            expectedImages.append(image);
+            expectedTriggers.append(trigger++);
+        }
+        image += i == _extraImageAfter ? 2 : 1;
+    }
+    QCOMPARE(worker._imageIndices, expectedImages);
+    QCOMPARE(worker._triggerIndices, expectedTriggers);
+    for (int i=0; i<worker._imageIndices.count(); i++) {
+        double error = worker._triggerTime[worker._triggerIndices[i]] - worker._tagTime[worker._imageIndices[i]] - _clockOffsetSecs;
+        QVERIFY(qAbs(error) < 1.0);
+    }
+}
+
+void GeoTagControllerTest::_reportUnmatched_test(void)
+{
+    GeoTagWorker    worker;
+    QList<int>      images;
+    QList<int>      triggers;
+    int             unmatchedImages = -1;
+    int             unmatchedTriggers = -1;
+
+    _setupTimes(worker, images, triggers);
+    worker._alignTriggers(images, triggers, _clockOffsetSecs);
+    worker._reportUnmatched(unmatchedImages, unmatchedTriggers);
+
+    // Image without a trigger, extra image and stray trigger at the end
+    QCOMPARE(unmatchedImages, 2);
+    QCOMPARE(unmatchedTriggers, 1);
+
+    // Nothing matched
+    worker._imageIndices.clear();
+    worker._triggerIndices.clear();
+    worker._reportUnmatched(unmatchedImages, unmatchedTriggers);
+    QCOMPARE(unmatchedImages, worker._imageList.count());
+    QCOMPARE(unmatchedTriggers, worker._triggerTime.count());
+}
@@ -0,0 +1,38 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef GeoTagControllerTest_H
+#define GeoTagControllerTest_H
+
+#include "UnitTest.h"
+
+class GeoTagWorker;
+
+/// Unit test for matching images to trigger events in GeoTagWorker, run against synthetic capture and trigger times
+class GeoTagControllerTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    GeoTagControllerTest(void);
+
+private slots:
+    void _clockOffset_test(void);
+    void _alignTriggers_test(void);
+    void _reportUnmatched_test(void);
+
+private:
+    void _setupTimes(GeoTagWorker& worker, QList<int>& images, QList<int>& triggers);
+
+    static const int _captureCount =    10;     ///< Captures in the flight, each one fires a trigger
+    static const int _droppedTrigger =  4;      ///< Capture whose trigger is missing from the log
+    static const int _extraImageAfter = 7;      ///< Capture followed by an image which has no trigger
+};
+
+#endif
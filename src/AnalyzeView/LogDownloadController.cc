@@ -23,21 +23,39 @@
 #include <QSettings>
 #include <QUrl>
 #include <QBitArray>
+#include <QDataStream>
+#include <QFileInfo>
 #include <QtCore/qmath.h>
 
 #define kTimeOutMilliseconds 500
+#define kMaxTimeOutMilliseconds 8000            // Cap on the timeout as it backs off while the vehicle doesn't answer
+#define kMaxDataRetries      10                 // Log data requests in a row without an answer before giving up
 #define kGUIRateMilliseconds 17
 #define kTableBins           512
-#define kChunkSize           (kTableBins * MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN)
+#define kMinRequestBins      16
+#define kMaxRequestBins      (64 * kTableBins)
+#define kCoalesceBins        16                 // Runs of received bins this short are requested again rather than splitting a request
+#define kResumeSaveBins      4096               // Bins received between saves of the resume bitmap
+#define kResumeMagic         0x4C504751         // "QGPL"
+#define kPartialExtension    ".part"
+#define kResumeExtension     ".bins"
 
 QGC_LOGGING_CATEGORY(LogDownloadLog, "LogDownloadLog")
 
 //-----------------------------------------------------------------------------
 struct LogDownloadData {
     LogDownloadData(QGCLogEntry* entry);
-    QBitArray     chunk_table;
-    uint32_t      current_chunk;
+    QBitArray     bins_received;        // One bit per MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN bin of the whole log
+    uint32_t      bins_received_count;
+    uint32_t      first_missing_bin;    // All bins before this one have been received
+    uint32_t      bins_since_save;
+    uint32_t      request_start;        // Bin range of the request the vehicle is working on
+    uint32_t      request_end;
+    uint32_t      request_missing;      // Bins in the range which were missing when it was requested, 0 for no request
+    uint32_t      request_received;     // Bins in the range which have been received since it was requested
+    uint32_t      request_bins;         // Request size, adapted to the loss seen on the link
     QFile         file;
+    uchar*        map;                  // Mapped log file, NULL if the file could not be mapped
     QString       filename;
     uint          ID;
     QGCLogEntry*  entry;
@@ -45,41 +63,82 @@ struct LogDownloadData {
     size_t        rate_bytes;
     qreal         rate_avg;
     QElapsedTimer elapsed;
+    QElapsedTimer total_elapsed;
+    qint64        session_bytes;        // Bytes received during this download attempt
 
-    void advanceChunk()
+    // The number of MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN bins in the file
+    uint32_t numBins() const
     {
-           current_chunk++;
-           chunk_table = QBitArray(chunkBins(), false);
+        return qCeil(entry->size() / static_cast<qreal>(MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN));
     }
 
-    // The number of MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN bins in the current chunk
-    uint32_t chunkBins() const
+    QString resumeFilename() const
     {
-        return qMin(qCeil((entry->size() - current_chunk*kChunkSize)/static_cast<qreal>(MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN)),
-                    kTableBins);
+        return file.fileName() + kResumeExtension;
     }
 
-    // The number of kChunkSize chunks in the file
-    uint32_t numChunks() const
+    // Picks up the bitmap left behind by an earlier attempt at downloading the same log
+    bool loadResumeBitmap()
     {
-        return qCeil(entry->size() / static_cast<qreal>(kChunkSize));
+        QFileInfo partialInfo(file.fileName());
+        if (!partialInfo.exists() || partialInfo.size() != entry->size()) {
+            return false;
+        }
+        QFile resumeFile(resumeFilename());
+        if (!resumeFile.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        quint32   magic;
+        quint32   size;
+        QBitArray bins;
+        QDataStream stream(&resumeFile);
+        stream >> magic >> size >> bins;
+        if (stream.status() != QDataStream::Ok || magic != kResumeMagic || size != entry->size() || (uint32_t)bins.size() != numBins()) {
+            return false;
+        }
+        bins_received = bins;
+        bins_received_count = bins.count(true);
+        written = bins_received_count * MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN;
+        return true;
     }
 
-    // True if all bins in the chunk have been set to val
-    bool chunkEquals(const bool val) const
+    void saveResumeBitmap()
     {
-        return chunk_table == QBitArray(chunk_table.size(), val);
+        bins_since_save = 0;
+        // Never claim bins which haven't made it to disk
+        if (map) {
+            file.unmap(map);
+            map = file.map(0, file.size());
+        } else {
+            file.flush();
+        }
+        QFile resumeFile(resumeFilename());
+        if (!resumeFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Failed to save log download resume file:" << resumeFile.fileName();
+            return;
+        }
+        QDataStream stream(&resumeFile);
+        stream << (quint32)kResumeMagic << (quint32)entry->size() << bins_received;
     }
-
 };
 
 //----------------------------------------------------------------------------------------
 LogDownloadData::LogDownloadData(QGCLogEntry* entry_)
-    : ID(entry_->id())
+    : bins_received_count(0)
+    , first_missing_bin(0)
+    , bins_since_save(0)
+    , request_start(0)
+    , request_end(0)
+    , request_missing(0)
+    , request_received(0)
+    , request_bins(kTableBins)
+    , map(NULL)
+    , ID(entry_->id())
     , entry(entry_)
     , written(0)
     , rate_bytes(0)
     , rate_avg(0)
+    , session_bytes(0)
 {
 
 }
@@ -110,6 +169,7 @@ LogDownloadController::LogDownloadController(void)
     , _requestingLogEntries(false)
     , _downloadingLogs(false)
     , _retries(0)
+    , _maxDataRetries(kMaxDataRetries)
     , _apmOneBased(0)
 {
     MultiVehicleManager *manager = qgcApp()->toolbox()->multiVehicleManager();
@@ -134,6 +194,13 @@ void
 LogDownloadController::_setActiveVehicle(Vehicle* vehicle)
 {
     if(_uas) {
+        //-- The partial log stays on disk so the download can resume after reconnecting
+        if(_downloadData) {
+            _timer.stop();
+            _closeLogDownload();
+            _downloadingLogs = false;
+            emit downloadingLogsChanged();
+        }
         _logEntriesModel.clear();
         disconnect(_uas, &UASInterface::logEntry, this, &LogDownloadController::_logEntry);
         disconnect(_uas, &UASInterface::logData,  this, &LogDownloadController::_logData);
@@ -312,87 +379,93 @@ LogDownloadController::_logData(UASInterface* uas, uint32_t ofs, uint16_t id, ui
         return;
     }
 
-    bool result = false;
-    uint32_t timeout_time = kTimeOutMilliseconds;
-    if(ofs <= _downloadData->entry->size()) {
-        const uint32_t chunk = ofs / kChunkSize;
-        if (chunk != _downloadData->current_chunk) {
-            qWarning() << "Ignored packet for out of order chunk" << chunk;
-            return;
-        }
-        const uint16_t bin = (ofs - chunk*kChunkSize) / MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN;
-        if (bin >= _downloadData->chunk_table.size()) {
-            qWarning() << "Out of range bin received";
-        } else
-            _downloadData->chunk_table.setBit(bin);
-        if (_downloadData->file.pos() != ofs) {
-            // Seek to correct position
-            if (!_downloadData->file.seek(ofs)) {
-                qWarning() << "Error while seeking log file offset";
-                return;
-            }
-        }
+    if(count == 0) {
+        //-- End of log marker, we know the size from the log entry
+        return;
+    }
+
+    const uint32_t bin = ofs / MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN;
+    if(ofs + count > _downloadData->entry->size()) {
+        qWarning() << "Received log offset greater than expected";
+        _downloadData->entry->setStatus(QString("Error"));
+        return;
+    }
+
+    //-- reset retries
+    _retries = 0;
+    //-- Reset timer
+    _timer.start(kTimeOutMilliseconds);
 
+    //-- Data from an older request is kept as long as we still need it
+    if(!_downloadData->bins_received.testBit(bin)) {
         //-- Write chunk to file
-        if(_downloadData->file.write((const char*)data, count)) {
-            _downloadData->written += count;
-            _downloadData->rate_bytes += count;
-            if (_downloadData->elapsed.elapsed() >= kGUIRateMilliseconds) {
-                //-- Update download rate
-                qreal rrate = _downloadData->rate_bytes/(_downloadData->elapsed.elapsed()/1000.0);
-                _downloadData->rate_avg = _downloadData->rate_avg*0.95 + rrate*0.05;
-                _downloadData->rate_bytes = 0;
-
-                //-- Update status
-                const QString status = QString("%1 (%2/s)").arg(QGCMapEngine::bigSizeToString(_downloadData->written),
-                                                                QGCMapEngine::bigSizeToString(_downloadData->rate_avg));
-
-                _downloadData->entry->setStatus(status);
-                _downloadData->elapsed.start();
-            }
-            result = true;
-            //-- reset retries
-            _retries = 0;
-            //-- Reset timer
-            _timer.start(timeout_time);
-            //-- Do we have it all?
-            if(_logComplete()) {
-                _downloadData->entry->setStatus(QString("Downloaded"));
-                //-- Check for more
-                _receivedAllData();
-            } else if (_chunkComplete()) {
-                _downloadData->advanceChunk();
-                _requestLogData(_downloadData->ID,
-                                _downloadData->current_chunk*kChunkSize,
-                                _downloadData->chunk_table.size()*MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN);
-            } else if (bin < _downloadData->chunk_table.size() - 1 && _downloadData->chunk_table.at(bin+1)) {
-                // Likely to be grabbing fragments and got to the end of a gap
-                _findMissingData();
-            }
+        bool written = true;
+        if(_downloadData->map) {
+            memcpy(_downloadData->map + ofs, data, count);
         } else {
+            written = _downloadData->file.seek(ofs) && _downloadData->file.write((const char*)data, count) == count;
+        }
+        if(!written) {
             qWarning() << "Error while writing log file chunk";
+            _downloadData->entry->setStatus(QString("Error"));
+            return;
+        }
+        _downloadData->bins_received.setBit(bin);
+        _downloadData->bins_received_count++;
+        if(bin >= _downloadData->request_start && bin < _downloadData->request_end) {
+            _downloadData->request_received++;
+        }
+        while(_downloadData->first_missing_bin < _downloadData->numBins() && _downloadData->bins_received.testBit(_downloadData->first_missing_bin)) {
+            _downloadData->first_missing_bin++;
+        }
+        _downloadData->written += count;
+        _downloadData->rate_bytes += count;
+        _downloadData->session_bytes += count;
+        if(++_downloadData->bins_since_save >= kResumeSaveBins) {
+            _downloadData->saveResumeBitmap();
+        }
+        if (_downloadData->elapsed.elapsed() >= kGUIRateMilliseconds) {
+            //-- Update download rate
+            qreal rrate = _downloadData->rate_bytes/(_downloadData->elapsed.elapsed()/1000.0);
+            _downloadData->rate_avg = _downloadData->rate_avg*0.95 + rrate*0.05;
+            _downloadData->rate_bytes = 0;
+
+            //-- Update status
+            const QString status = QString("%1 (%2/s)").arg(QGCMapEngine::bigSizeToString(_downloadData->written),
+                                                            QGCMapEngine::bigSizeToString(_downloadData->rate_avg));
+
+            _downloadData->entry->setStatus(status);
+            _downloadData->elapsed.start();
         }
-    } else {
-        qWarning() << "Received log offset greater than expected";
     }
-    if(!result) {
-        _downloadData->entry->setStatus(QString("Error"));
+
+    //-- Do we have it all?
+    if(_logComplete()) {
+        const qreal rate = _sustainedRate();
+        qCDebug(LogDownloadLog) << "Log download complete (bytes/sec:" << rate << "link bits/sec:" << _vehicle->priorityLink()->getConnectionSpeed() << ")";
+        _downloadData->entry->setStatus(QString("Downloaded (%1/s)").arg(QGCMapEngine::bigSizeToString(rate)));
+        //-- Check for more
+        _receivedAllData();
+    } else if(bin + 1 == _downloadData->request_end) {
+        //-- The vehicle has sent the whole range, ask for the next one right away
+        _requestRangeComplete();
+        _requestNextRange();
     }
 }
 
-
 //----------------------------------------------------------------------------------------
 bool
-LogDownloadController::_chunkComplete() const
+LogDownloadController::_logComplete() const
 {
-    return _downloadData->chunkEquals(true);
+    return _downloadData->bins_received_count == _downloadData->numBins();
 }
 
 //----------------------------------------------------------------------------------------
-bool
-LogDownloadController::_logComplete() const
+qreal
+LogDownloadController::_sustainedRate() const
 {
-    return _chunkComplete() && (_downloadData->current_chunk+1) == _downloadData->numChunks();
+    qint64 msecs = _downloadData->total_elapsed.elapsed();
+    return msecs ? _downloadData->session_bytes / (msecs / 1000.0) : 0;
 }
 
 //----------------------------------------------------------------------------------------
@@ -403,7 +476,7 @@ LogDownloadController::_receivedAllData()
     //-- Anything queued up for download?
     if(_prepareLogDownload()) {
         //-- Request Log
-        _requestLogData(_downloadData->ID, 0, _downloadData->chunk_table.size()*MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN);
+        _requestNextRange();
     } else {
         _resetSelection();
         _setDownloading(false);
@@ -417,11 +490,16 @@ LogDownloadController::_findMissingData()
     if (_logComplete()) {
          _receivedAllData();
          return;
-    } else if (_chunkComplete()) {
-        _downloadData->advanceChunk();
     }
 
-    if(_retries++ > 2) {
+    //-- Nothing will answer while the link is down, wait for it to come back rather than using up the retries
+    if(_vehicle && _vehicle->connectionLost()) {
+        _downloadData->entry->setStatus(QString("Waiting for vehicle"));
+        _timer.start(kMaxTimeOutMilliseconds);
+        return;
+    }
+
+    if(_retries++ >= _maxDataRetries) {
         _downloadData->entry->setStatus(QString("Timed Out"));
         //-- Give up
         qWarning() << "Too many errors retreiving log data. Giving up.";
@@ -429,23 +507,73 @@ LogDownloadController::_findMissingData()
         return;
     }
 
-    uint16_t start = 0, end = 0;
-    const int size = _downloadData->chunk_table.size();
-    for (; start < size; start++) {
-        if (!_downloadData->chunk_table.testBit(start)) {
-            break;
-        }
+    //-- The vehicle went quiet before finishing the range
+    qCDebug(LogDownloadLog) << "Log data timeout, requesting missing data again (retry:" << _retries << ")";
+    _requestRangeComplete();
+    _requestNextRange();
+}
+
+//----------------------------------------------------------------------------------------
+int
+LogDownloadController::_retryTimeOutMilliseconds() const
+{
+    //-- Back off each time a request goes unanswered, so a busy link isn't flooded with requests
+    return qMin(kTimeOutMilliseconds << qMin(_retries, 8), kMaxTimeOutMilliseconds);
+}
+
+//----------------------------------------------------------------------------------------
+void
+LogDownloadController::_requestRangeComplete()
+{
+    if(_downloadData->request_missing == 0) {
+        return;
     }
+    //-- Grow requests while the link is clean, shrink them when it drops data so less is sent again
+    const qreal loss = 1.0 - (_downloadData->request_received / static_cast<qreal>(_downloadData->request_missing));
+    if(loss <= 0.01) {
+        _downloadData->request_bins = qMin(_downloadData->request_bins * 2, (uint32_t)kMaxRequestBins);
+    } else if(loss > 0.05) {
+        _downloadData->request_bins = qMax(_downloadData->request_bins / 2, (uint32_t)kMinRequestBins);
+    }
+    qCDebug(LogDownloadLog) << "Log data range complete (loss:" << loss << "next request bins:" << _downloadData->request_bins << ")";
+    _downloadData->request_missing = 0;
+}
 
-    for (end = start; end < size; end++) {
-        if (_downloadData->chunk_table.testBit(end)) {
+//----------------------------------------------------------------------------------------
+void
+LogDownloadController::_requestNextRange()
+{
+    //-- The vehicle works on a single request at a time, a new request replaces the one in progress. So rather than
+    //   asking for one gap at a time, gaps separated by short runs of received bins go out as a single request.
+    const uint32_t numBins  = _downloadData->numBins();
+    const uint32_t start    = _downloadData->first_missing_bin;
+    const uint32_t limit    = qMin(start + _downloadData->request_bins, numBins);
+    uint32_t end            = start;
+    uint32_t missing        = 0;
+    uint32_t bin            = start;
+    while(bin < limit) {
+        if(!_downloadData->bins_received.testBit(bin)) {
+            missing++;
+            end = ++bin;
+            continue;
+        }
+        uint32_t runEnd = bin;
+        while(runEnd < limit && _downloadData->bins_received.testBit(runEnd)) {
+            runEnd++;
+        }
+        if(runEnd == limit || runEnd - bin > kCoalesceBins) {
             break;
         }
+        bin = runEnd;
     }
-
-    const uint32_t pos = _downloadData->current_chunk*kChunkSize + start*MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN,
-                   len = (end - start)*MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN;
-    _requestLogData(_downloadData->ID, pos, len);
+    _downloadData->request_start    = start;
+    _downloadData->request_end      = end;
+    _downloadData->request_missing  = missing;
+    _downloadData->request_received = 0;
+    _requestLogData(_downloadData->ID,
+                    start * MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN,
+                    (end - start) * MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN);
+    _timer.start(_retryTimeOutMilliseconds());
 }
 
 //----------------------------------------------------------------------------------------
@@ -517,10 +645,7 @@ void LogDownloadController::downloadToDirectory(const QString& dir)
     //-- Stop listing just in case
     _receivedAllEntries();
     //-- Reset downloads, again just in case
-    if(_downloadData) {
-        delete _downloadData;
-        _downloadData = 0;
-    }
+    _closeLogDownload();
     _downloadPath = dir;
     if(!_downloadPath.isEmpty()) {
         if(!_downloadPath.endsWith(QDir::separator()))
@@ -563,10 +688,7 @@ LogDownloadController::_getNextSelected()
 bool
 LogDownloadController::_prepareLogDownload()
 {
-    if(_downloadData) {
-        delete _downloadData;
-        _downloadData = NULL;
-    }
+    _closeLogDownload();
     QGCLogEntry* entry = _getNextSelected();
     if(!entry) {
         return false;
@@ -588,34 +710,37 @@ LogDownloadController::_prepareLogDownload()
     } else {
         _downloadData->filename += ".bin";
     }
-    _downloadData->file.setFileName(_downloadPath + _downloadData->filename);
-    //-- Append a number to the end if the filename already exists
-    if (_downloadData->file.exists()){
-        uint num_dups = 0;
-        QStringList filename_spl = _downloadData->filename.split('.');
-        do {
-            num_dups +=1;
-            _downloadData->file.setFileName(filename_spl[0] + '_' + QString::number(num_dups) + '.' + filename_spl[1]);
-        } while( _downloadData->file.exists());
+    //-- Download into a partial file which is renamed once complete
+    _downloadData->file.setFileName(_downloadPath + _downloadData->filename + kPartialExtension);
+    _downloadData->bins_received = QBitArray(_downloadData->numBins(), false);
+    QIODevice::OpenMode openMode = QIODevice::ReadWrite;
+    if(_downloadData->loadResumeBitmap()) {
+        qCDebug(LogDownloadLog) << "Resuming log download (have:" << _downloadData->bins_received_count << "of" << _downloadData->numBins() << "bins)";
+    } else {
+        openMode |= QIODevice::Truncate;
     }
     //-- Create file
-    if (!_downloadData->file.open(QIODevice::WriteOnly)) {
+    if (!_downloadData->file.open(openMode)) {
         qWarning() << "Failed to create log file:" <<  _downloadData->filename;
     } else {
         //-- Preallocate file
         if(!_downloadData->file.resize(entry->size())) {
             qWarning() << "Failed to allocate space for log file:" <<  _downloadData->filename;
         } else {
-            _downloadData->current_chunk = 0;
-            _downloadData->chunk_table = QBitArray(_downloadData->chunkBins(), false);
+            if(entry->size()) {
+                //-- Falls back to seek and write if the file can't be mapped
+                _downloadData->map = _downloadData->file.map(0, entry->size());
+            }
+            while(_downloadData->first_missing_bin < _downloadData->numBins() && _downloadData->bins_received.testBit(_downloadData->first_missing_bin)) {
+                _downloadData->first_missing_bin++;
+            }
             _downloadData->elapsed.start();
+            _downloadData->total_elapsed.start();
             result = true;
         }
     }
     if(!result) {
-        if (_downloadData->file.exists()) {
-            _downloadData->file.remove();
-        }
+        _removeLogFiles();
         _downloadData->entry->setStatus(QString("Error"));
         delete _downloadData;
         _downloadData = NULL;
@@ -623,6 +748,49 @@ LogDownloadController::_prepareLogDownload()
     return result;
 }
 
+//----------------------------------------------------------------------------------------
+void
+LogDownloadController::_closeLogDownload()
+{
+    if(!_downloadData) {
+        return;
+    }
+    if(_logComplete()) {
+        _downloadData->file.close();
+        QFile::remove(_downloadData->resumeFilename());
+        QString filename = _downloadPath + _downloadData->filename;
+        //-- Append a number to the end if the filename already exists
+        if (QFile::exists(filename)) {
+            uint num_dups = 0;
+            QStringList filename_spl = _downloadData->filename.split('.');
+            do {
+                num_dups +=1;
+                filename = _downloadPath + filename_spl[0] + '_' + QString::number(num_dups) + '.' + filename_spl[1];
+            } while(QFile::exists(filename));
+        }
+        if(!_downloadData->file.rename(filename)) {
+            qWarning() << "Failed to rename log file:" << filename;
+        }
+    } else if(_downloadData->file.isOpen()) {
+        //-- Keep what we have so the next attempt picks up from here
+        _downloadData->saveResumeBitmap();
+        _downloadData->file.close();
+    }
+    delete _downloadData;
+    _downloadData = NULL;
+}
+
+//----------------------------------------------------------------------------------------
+void
+LogDownloadController::_removeLogFiles()
+{
+    _downloadData->file.close();
+    if (_downloadData->file.exists()) {
+        _downloadData->file.remove();
+    }
+    QFile::remove(_downloadData->resumeFilename());
+}
+
 //----------------------------------------------------------------------------------------
 void
 LogDownloadController::_setDownloading(bool active)
@@ -671,9 +839,7 @@ LogDownloadController::cancel(void)
     }
     if(_downloadData) {
         _downloadData->entry->setStatus(QString("Canceled"));
-        if (_downloadData->file.exists()) {
-            _downloadData->file.remove();
-        }
+        _removeLogFiles();
         delete _downloadData;
         _downloadData = 0;
     }
@@ -131,6 +131,9 @@ public:
 
     void downloadToDirectory(const QString& dir);
 
+    /// Sets the number of times in a row missing log data is requested again before a download is given up on
+    void setMaxDataRetries(int maxDataRetries) { _maxDataRetries = maxDataRetries; }
+
 signals:
     void requestingListChanged  ();
     void downloadingLogsChanged ();
@@ -146,16 +149,21 @@ private slots:
 private:
 
     bool _entriesComplete   ();
-    bool _chunkComplete     () const;
     bool _logComplete       () const;
+    qreal _sustainedRate    () const;
+    int  _retryTimeOutMilliseconds() const;
     void _findMissingEntries();
     void _receivedAllEntries();
     void _receivedAllData   ();
     void _resetSelection    (bool canceled = false);
     void _findMissingData   ();
+    void _requestRangeComplete();
+    void _requestNextRange  ();
     void _requestLogList    (uint32_t start, uint32_t end);
     void _requestLogData    (uint8_t id, uint32_t offset = 0, uint32_t count = 0xFFFFFFFF);
     bool _prepareLogDownload();
+    void _closeLogDownload  ();
+    void _removeLogFiles    ();
     void _setDownloading    (bool active);
     void _setListing        (bool active);
 
@@ -169,6 +177,7 @@ private:
     bool                _requestingLogEntries;
     bool                _downloadingLogs;
     int                 _retries;
+    int                 _maxDataRetries;
     int                 _apmOneBased;
     QString             _downloadPath;
 };
@@ -12,17 +12,16 @@
 #include "MockLink.h"
 
 #include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
 
 LogDownloadTest::LogDownloadTest(void)
 {
 
 }
 
-void LogDownloadTest::downloadTest(void)
+LogDownloadController* LogDownloadTest::_createController(void)
 {
-
-    _connectMockLink(MAV_AUTOPILOT_PX4);
-
     LogDownloadController* controller = new LogDownloadController();
 
     _rgLogDownloadControllerSignals[requestingListChangedSignalIndex] =     SIGNAL(requestingListChanged());
@@ -30,8 +29,15 @@ void LogDownloadTest::downloadTest(void)
     _rgLogDownloadControllerSignals[modelChangedSignalIndex] =              SIGNAL(modelChanged());
 
     _multiSpyLogDownloadController = new MultiSignalSpy();
-    QVERIFY(_multiSpyLogDownloadController->init(controller, _rgLogDownloadControllerSignals, _cLogDownloadControllerSignals));
+    if (!_multiSpyLogDownloadController->init(controller, _rgLogDownloadControllerSignals, _cLogDownloadControllerSignals)) {
+        QTest::qFail("MultiSignalSpy init failed", __FILE__, __LINE__);
+    }
+
+    return controller;
+}
 
+void LogDownloadTest::_listLogs(LogDownloadController* controller)
+{
     controller->refresh();
     QVERIFY(_multiSpyLogDownloadController->waitForSignalByIndex(requestingListChangedSignalIndex, 10000));
     _multiSpyLogDownloadController->clearAllSignals();
@@ -41,26 +47,111 @@ void LogDownloadTest::downloadTest(void)
     }
     _multiSpyLogDownloadController->clearAllSignals();
 
-    QGCLogModel* model = controller->model();
-    QVERIFY(model);
-    qDebug() << model->count();
-    (*model)[0]->setSelected(true);
+    QVERIFY(controller->model());
+    QVERIFY(controller->model()->count() > 0);
+}
 
-    QString downloadTo = QDir::currentPath();
-    qDebug() << "download to:" << downloadTo;
-    controller->downloadToDirectory(downloadTo);
+void LogDownloadTest::_waitForDownload(LogDownloadController* controller)
+{
     QVERIFY(_multiSpyLogDownloadController->waitForSignalByIndex(downloadingLogsChangedSignalIndex, 10000));
     _multiSpyLogDownloadController->clearAllSignals();
     if (controller->downloadingLogs()) {
-        QVERIFY(_multiSpyLogDownloadController->waitForSignalByIndex(downloadingLogsChangedSignalIndex, 10000));
+        QVERIFY(_multiSpyLogDownloadController->waitForSignalByIndex(downloadingLogsChangedSignalIndex, 30000));
         QCOMPARE(controller->downloadingLogs(), false);
     }
     _multiSpyLogDownloadController->clearAllSignals();
+}
+
+void LogDownloadTest::downloadTest(void)
+{
+    _connectMockLink(MAV_AUTOPILOT_PX4);
+
+    LogDownloadController* controller = _createController();
+    _listLogs(controller);
+
+    QGCLogModel* model = controller->model();
+    qDebug() << model->count();
+    (*model)[0]->setSelected(true);
+
+    QString downloadTo = QDir::currentPath();
+    qDebug() << "download to:" << downloadTo;
+    controller->downloadToDirectory(downloadTo);
+    _waitForDownload(controller);
 
     QString downloadFile = QDir(downloadTo).filePath("log_0_UnknownDate.px4log");
     QVERIFY(UnitTest::fileCompare(downloadFile, _mockLink->logDownloadFile()));
 
+    // Nothing is sent twice on a clean link
+    QCOMPARE(_mockLink->logDownloadBytesSent(), _mockLink->logDownloadFileSize());
+
     QFile::remove(downloadFile);
 
     delete controller;
 }
+
+/// Gaps left by dropped LOG_DATA messages must be filled in without restarting the download
+void LogDownloadTest::lossyDownloadTest(void)
+{
+    _connectMockLink(MAV_AUTOPILOT_PX4);
+
+    LogDownloadController* controller = _createController();
+    _listLogs(controller);
+
+    QTemporaryDir downloadDir;
+    QVERIFY(downloadDir.isValid());
+
+    _mockLink->setLogDownloadLossPercent(10);
+    (*controller->model())[0]->setSelected(true);
+    controller->downloadToDirectory(downloadDir.path());
+    _waitForDownload(controller);
+
+    QString downloadFile = QDir(downloadDir.path()).filePath("log_0_UnknownDate.px4log");
+    QVERIFY(UnitTest::fileCompare(downloadFile, _mockLink->logDownloadFile()));
+
+    delete controller;
+}
+
+/// A download which times out part way through must pick up where it left off the next time
+void LogDownloadTest::resumeDownloadTest(void)
+{
+    _connectMockLink(MAV_AUTOPILOT_PX4);
+
+    LogDownloadController* controller = _createController();
+    _listLogs(controller);
+
+    QTemporaryDir downloadDir;
+    QVERIFY(downloadDir.isValid());
+    QString downloadFile = QDir(downloadDir.path()).filePath("log_0_UnknownDate.px4log");
+
+    // Vehicle goes quiet half way through the log, give up after a couple of retries to keep the test short
+    controller->setMaxDataRetries(2);
+    (*controller->model())[0]->setSelected(true);
+    controller->downloadToDirectory(downloadDir.path());
+    const uint32_t fileSize = _mockLink->logDownloadFileSize();
+    QElapsedTimer timer;
+    timer.start();
+    while (_mockLink->logDownloadBytesSent() < fileSize / 2 && timer.elapsed() < 10000) {
+        QTest::qWait(5);
+    }
+    QVERIFY(_mockLink->logDownloadBytesSent() >= fileSize / 2);
+    _mockLink->setLogDownloadLossPercent(100);
+    _waitForDownload(controller);
+
+    QCOMPARE((*controller->model())[0]->status(), QString("Timed Out"));
+    QVERIFY(!QFile::exists(downloadFile));
+    QVERIFY(QFile::exists(downloadFile + ".part"));
+
+    // Download again, only the missing part should be sent
+    _mockLink->setLogDownloadLossPercent(0);
+    const uint32_t firstAttemptBytesSent = _mockLink->logDownloadBytesSent();
+    (*controller->model())[0]->setSelected(true);
+    controller->downloadToDirectory(downloadDir.path());
+    _waitForDownload(controller);
+
+    QVERIFY(UnitTest::fileCompare(downloadFile, _mockLink->logDownloadFile()));
+    QVERIFY(_mockLink->logDownloadBytesSent() - firstAttemptBytesSent < fileSize);
+    QVERIFY(!QFile::exists(downloadFile + ".part"));
+    QVERIFY(!QFile::exists(downloadFile + ".part.bins"));
+
+    delete controller;
+}
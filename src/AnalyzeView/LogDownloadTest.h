@@ -13,6 +13,8 @@
 #include "UnitTest.h"
 #include "MultiSignalSpy.h"
 
+class LogDownloadController;
+
 class LogDownloadTest : public UnitTest
 {
     Q_OBJECT
@@ -25,8 +27,14 @@ private slots:
     //void cleanup(void) { _cleanup(); }
 
     void downloadTest(void);
+    void lossyDownloadTest(void);
+    void resumeDownloadTest(void);
 
 private:
+    LogDownloadController* _createController(void);
+    void _listLogs(LogDownloadController* controller);
+    void _waitForDownload(LogDownloadController* controller);
+
     // LogDownloadController signals
 
     enum {
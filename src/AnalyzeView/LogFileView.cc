@@ -0,0 +1,66 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "LogFileView.h"
+
+LogFileView::LogFileView()
+    : _size(0)
+    , _window(NULL)
+    , _windowOffset(0)
+    , _windowLength(0)
+    , _windowSize(defaultWindowSize)
+{
+
+}
+
+LogFileView::~LogFileView()
+{
+    close();
+}
+
+bool LogFileView::open(const QString& fileName)
+{
+    close();
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    _size = _file.size();
+    return true;
+}
+
+void LogFileView::close()
+{
+    // Closing the file also unmaps it
+    _file.close();
+    _size = 0;
+    _window = NULL;
+    _windowOffset = 0;
+    _windowLength = 0;
+}
+
+const uchar* LogFileView::data(qint64 offset, int length)
+{
+    if (offset < 0 || length < 0 || offset + length > _size) {
+        return NULL;
+    }
+    if (!_window || offset < _windowOffset || offset + length > _windowOffset + _windowLength) {
+        if (_window) {
+            _file.unmap(_window);
+            _window = NULL;
+        }
+        _windowOffset = offset;
+        _windowLength = qMin(qMax(_windowSize, (qint64)length), _size - offset);
+        _window = _file.map(_windowOffset, _windowLength);
+        if (!_window) {
+            return NULL;
+        }
+    }
+    return _window + (offset - _windowOffset);
+}
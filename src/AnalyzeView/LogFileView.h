@@ -0,0 +1,48 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef LogFileView_H
+#define LogFileView_H
+
+#include <QFile>
+#include <QString>
+
+/// Read only view of a log file. The file is mapped a window at a time, so logs larger than the available address
+/// space can still be parsed in place. Access is fastest front to back.
+class LogFileView
+{
+public:
+    LogFileView();
+    ~LogFileView();
+
+    bool    open        (const QString& fileName);
+    void    close       ();
+    bool    isOpen      () const { return _file.isOpen(); }
+    qint64  size        () const { return _size; }
+    QString errorString () const { return _file.errorString(); }
+
+    /// @return Pointer to length bytes at offset, NULL if they run past the end of the file. Only valid until the
+    ///         next call.
+    const uchar* data(qint64 offset, int length);
+
+    /// Sets the most mapped at once, the window still grows to fit a longer request. Defaults to defaultWindowSize.
+    void setWindowSize(qint64 size) { _windowSize = size; }
+
+    static const qint64 defaultWindowSize = 64 * 1024 * 1024;
+
+private:
+    QFile   _file;
+    qint64  _size;
+    uchar*  _window;
+    qint64  _windowOffset;
+    qint64  _windowLength;
+    qint64  _windowSize;
+};
+
+#endif
@@ -0,0 +1,277 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "LogParserTest.h"
+#include "LogFileView.h"
+#include "PX4LogParser.h"
+#include "ULogParser.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+template<typename T>
+static void _append(QByteArray& bytes, T value)
+{
+    uchar buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    bytes.append((const char*)buffer, sizeof(T));
+}
+
+static void _appendFloat(QByteArray& bytes, float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    _append<quint32>(bytes, bits);
+}
+
+static void _appendDouble(QByteArray& bytes, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    _append<quint64>(bytes, bits);
+}
+
+/// Appends a zero padded string
+static void _appendString(QByteArray& bytes, const char* str, int length)
+{
+    QByteArray padded(str);
+    padded.resize(length);
+    for (int i=qstrlen(str); i<length; i++) {
+        padded[i] = 0;
+    }
+    bytes.append(padded);
+}
+
+LogParserTest::LogParserTest(void)
+{
+
+}
+
+/// @return Vehicle position of the specified GPOS message, trigger n comes just before position n
+QGeoCoordinate LogParserTest::_position(int index)
+{
+    return QGeoCoordinate(47.0 + index * 0.001, 8.0 + index * 0.002, 500.0 + index);
+}
+
+bool LogParserTest::_writeLog(const QString& fileName, const QByteArray& bytes)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.length();
+}
+
+/// Triggers 1..n each have their own position. Every third trigger is logged twice with the same sequence number and
+/// the last ones come after the last position.
+QByteArray LogParserTest::_px4Log(void)
+{
+    const uchar gposType = 10;
+    const uchar camtType = 20;
+    const uchar header[] = { 0xA3, 0x95 };
+
+    QByteArray log;
+    // Garbage the parser must step over
+    log.append("\x00\x00", 2);
+
+    // FMT: type, length, name[4], format[16], labels[64]
+    struct {
+        uchar       type;
+        const char* name;
+        const char* format;
+        const char* labels;
+    } formats[] = {
+        { gposType, "GPOS", "LLf", "Lat,Lon,Alt" },
+        { camtType, "CAMT", "QI",  "T,seq" },
+    };
+    for (size_t i=0; i<sizeof(formats)/sizeof(formats[0]); i++) {
+        log.append((const char*)header, 2);
+        log.append((char)0x80);
+        log.append((char)formats[i].type);
+        log.append((char)15);
+        _appendString(log, formats[i].name, 4);
+        _appendString(log, formats[i].format, 16);
+        _appendString(log, formats[i].labels, 64);
+    }
+
+    int seq = 0;
+    for (int i=0; i<_positionCount + _trailingCount; i++) {
+        if (i > 0) {
+            int repeats = i % 3 == 0 ? 2 : 1;
+            for (int j=0; j<repeats; j++) {
+                log.append((const char*)header, 2);
+                log.append((char)camtType);
+                _append<quint64>(log, (quint64)i * 1000000 + 500000);
+                _append<quint32>(log, seq);
+            }
+            seq++;
+        }
+        if (i < _positionCount) {
+            QGeoCoordinate coord = _position(i);
+            log.append((const char*)header, 2);
+            log.append((char)gposType);
+            _append<qint32>(log, (qint32)qRound(coord.latitude() * 1.0e7));
+            _append<qint32>(log, (qint32)qRound(coord.longitude() * 1.0e7));
+            _appendFloat(log, coord.altitude());
+        }
+    }
+
+    return log;
+}
+
+/// Same triggers and positions as _px4Log, without the repeats
+QByteArray LogParserTest::_ulog(void)
+{
+    const quint16 gposId = 1;
+    const quint16 triggerId = 2;
+
+    QByteArray log;
+    log.append("ULog\x01\x12\x35", 7);
+    log.append((char)1);
+    _append<quint64>(log, 0);
+
+    QList<QByteArray> definitions;
+    definitions << "vehicle_global_position:uint64_t timestamp;double lat;double lon;float alt;";
+    definitions << "camera_trigger:uint64_t timestamp;uint32_t seq;";
+    foreach (const QByteArray& definition, definitions) {
+        _append<quint16>(log, definition.length());
+        log.append('F');
+        log.append(definition);
+    }
+
+    QList<QPair<quint16, QByteArray> > subscriptions;
+    subscriptions << qMakePair(gposId, QByteArray("vehicle_global_position"));
+    subscriptions << qMakePair(triggerId, QByteArray("camera_trigger"));
+    for (int i=0; i<subscriptions.count(); i++) {
+        _append<quint16>(log, 3 + subscriptions[i].second.length());
+        log.append('A');
+        log.append((char)0);
+        _append<quint16>(log, subscriptions[i].first);
+        log.append(subscriptions[i].second);
+    }
+
+    for (int i=0; i<_positionCount + _trailingCount; i++) {
+        if (i > 0) {
+            _append<quint16>(log, 2 + 8 + 4);
+            log.append('D');
+            _append<quint16>(log, triggerId);
+            _append<quint64>(log, (quint64)i * 1000000 + 500000);
+            _append<quint32>(log, i - 1);
+        }
+        if (i < _positionCount) {
+            QGeoCoordinate coord = _position(i);
+            _append<quint16>(log, 2 + 8 + 8 + 8 + 4);
+            log.append('D');
+            _append<quint16>(log, gposId);
+            _append<quint64>(log, (quint64)i * 1000000);
+            _appendDouble(log, coord.latitude());
+            _appendDouble(log, coord.longitude());
+            _appendFloat(log, coord.altitude());
+        }
+    }
+
+    return log;
+}
+
+/// Each trigger gets the first position after it, the trailing ones the last position
+void LogParserTest::_checkTags(const QList<double>& triggerTime, const QList<QGeoCoordinate>& geoRef)
+{
+    const int triggerCount = _positionCount - 1 + _trailingCount;
+    QCOMPARE(triggerTime.count(), triggerCount);
+    QCOMPARE(geoRef.count(), triggerCount);
+    for (int i=0; i<triggerCount; i++) {
+        QGeoCoordinate expected = _position(qMin(i + 1, _positionCount - 1));
+        QCOMPARE(triggerTime[i], i + 1.5);
+        QVERIFY(qAbs(geoRef[i].latitude() - expected.latitude()) < 1.0e-7);
+        QVERIFY(qAbs(geoRef[i].longitude() - expected.longitude()) < 1.0e-7);
+        QVERIFY(qAbs(geoRef[i].altitude() - expected.altitude()) < 1.0e-3);
+    }
+}
+
+void LogParserTest::_logFileView_test(void)
+{
+    QTemporaryDir tempDir;
+    QString fileName = tempDir.path() + QStringLiteral("/view.bin");
+    QByteArray bytes;
+    for (int i=0; i<1000; i++) {
+        bytes.append((char)(i * 7));
+    }
+    QVERIFY(_writeLog(fileName, bytes));
+
+    LogFileView view;
+    view.setWindowSize(64);
+    QVERIFY(view.open(fileName));
+    QCOMPARE(view.size(), (qint64)bytes.length());
+
+    // Forward, backward, straddling the window and longer than it
+    int reads[][2] = { { 0, 10 }, { 60, 10 }, { 5, 3 }, { 120, 200 }, { 990, 10 }, { 0, 1000 } };
+    for (size_t i=0; i<sizeof(reads)/sizeof(reads[0]); i++) {
+        const uchar* data = view.data(reads[i][0], reads[i][1]);
+        QVERIFY(data);
+        QCOMPARE(QByteArray((const char*)data, reads[i][1]), bytes.mid(reads[i][0], reads[i][1]));
+    }
+    QVERIFY(!view.data(995, 10));
+    QVERIFY(!view.data(-1, 2));
+}
+
+void LogParserTest::_px4Log_test(void)
+{
+    QTemporaryDir tempDir;
+    QString fileName = tempDir.path() + QStringLiteral("/triggers.px4log");
+    QVERIFY(_writeLog(fileName, _px4Log()));
+
+    qint64 windowSizes[] = { _smallWindowSize, LogFileView::defaultWindowSize };
+    for (size_t i=0; i<sizeof(windowSizes)/sizeof(windowSizes[0]); i++) {
+        LogFileView log;
+        log.setWindowSize(windowSizes[i]);
+        QVERIFY(log.open(fileName));
+        QVERIFY(!ULogParser::isULog(log));
+
+        bool cancel = false;
+        QList<double> triggerTime;
+        QList<QGeoCoordinate> geoRef;
+        PX4LogParser parser;
+        QVERIFY(parser.getTagsFromLog(log, cancel, triggerTime, geoRef));
+        _checkTags(triggerTime, geoRef);
+    }
+}
+
+void LogParserTest::_ulog_test(void)
+{
+    QTemporaryDir tempDir;
+    QString fileName = tempDir.path() + QStringLiteral("/triggers.ulg");
+    QVERIFY(_writeLog(fileName, _ulog()));
+
+    qint64 windowSizes[] = { _smallWindowSize, LogFileView::defaultWindowSize };
+    for (size_t i=0; i<sizeof(windowSizes)/sizeof(windowSizes[0]); i++) {
+        LogFileView log;
+        log.setWindowSize(windowSizes[i]);
+        QVERIFY(log.open(fileName));
+        QVERIFY(ULogParser::isULog(log));
+
+        bool cancel = false;
+        QList<double> triggerTime;
+        QList<QGeoCoordinate> geoRef;
+        ULogParser parser;
+        QVERIFY(parser.getTagsFromLog(log, cancel, triggerTime, geoRef));
+        _checkTags(triggerTime, geoRef);
+    }
+
+    // A log cut off part way through a message still gives the triggers before it
+    QByteArray truncated = _ulog();
+    truncated.chop(5);
+    QVERIFY(_writeLog(fileName, truncated));
+    LogFileView log;
+    log.setWindowSize(_smallWindowSize);
+    QVERIFY(log.open(fileName));
+    bool cancel = false;
+    QList<double> triggerTime;
+    QList<QGeoCoordinate> geoRef;
+    ULogParser parser;
+    QVERIFY(parser.getTagsFromLog(log, cancel, triggerTime, geoRef));
+    QCOMPARE(triggerTime.count(), _positionCount - 1 + _trailingCount - 1);
+}
@@ -0,0 +1,42 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef LogParserTest_H
+#define LogParserTest_H
+
+#include "UnitTest.h"
+
+#include <QGeoCoordinate>
+
+/// Unit test for LogFileView, PX4LogParser and ULogParser, run against small generated logs
+class LogParserTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    LogParserTest(void);
+
+private slots:
+    void _logFileView_test(void);
+    void _px4Log_test(void);
+    void _ulog_test(void);
+
+private:
+    bool            _writeLog       (const QString& fileName, const QByteArray& bytes);
+    QByteArray      _px4Log         (void);
+    QByteArray      _ulog           (void);
+    void            _checkTags      (const QList<double>& triggerTime, const QList<QGeoCoordinate>& geoRef);
+    static QGeoCoordinate _position (int index);
+
+    static const int _positionCount =   20;     ///< Positions in each log, a trigger comes before each but the first
+    static const int _trailingCount =   2;      ///< Triggers after the last position
+    static const int _smallWindowSize = 50;     ///< Not a multiple of any message length, so messages straddle windows
+};
+
+#endif
@@ -0,0 +1,239 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "PX4LogParser.h"
+#include "LogFileView.h"
+#include "QGCLoggingCategory.h"
+
+#include <math.h>
+#include <QtEndian>
+
+static const uchar  kHeader[2]          = { 0xA3, 0x95 };
+static const int    kHeaderLength       = 3;
+static const uchar  kFormatType         = 0x80;
+static const int    kFormatLength       = 89;
+static const int    kCancelCheckCount   = 10000;    // Messages between checks for cancellation
+
+PX4LogParser::PX4LogParser()
+{
+
+}
+
+PX4LogParser::~PX4LogParser()
+{
+
+}
+
+bool PX4LogParser::getTagsFromLog(LogFileView& log, const bool& cancel, QList<double>& triggerTime, QList<QGeoCoordinate>& geoRef)
+{
+    QVector<Format_t> formats(256);
+    for (int i=0; i<formats.count(); i++) {
+        formats[i].length = 0;
+    }
+    formats[kFormatType].length = kFormatLength;
+
+    int     gposType = -1;
+    Field_t gposLat, gposLon, gposAlt;
+    int     camtType = -1;
+    Field_t camtTime, camtSeq;
+
+    QGeoCoordinate  lastCoordinate;
+    int             pendingTriggers = 0;    // Triggers waiting for the next position
+    int             sequence = -1;
+    int             messageCount = 0;
+
+    qint64 offset = 0;
+    while (offset + kHeaderLength <= log.size()) {
+        if (++messageCount % kCancelCheckCount == 0 && cancel) {
+            return false;
+        }
+
+        const uchar* header = log.data(offset, kHeaderLength);
+        if (!header) {
+            break;
+        }
+        // The header is only valid until the next data() call, which may move the window
+        uchar type = header[2];
+        const Format_t& format = formats[type];
+        if (header[0] != kHeader[0] || header[1] != kHeader[1] || format.length == 0) {
+            // Not a message we know the length of, step forward until we find one
+            offset++;
+            continue;
+        }
+        const uchar* message = log.data(offset, format.length);
+        if (!message) {
+            // Truncated message at the end of the log
+            break;
+        }
+        offset += format.length;
+
+        if (type == kFormatType) {
+            Format_t& newFormat = formats[message[3]];
+            newFormat.length = message[4];
+            newFormat.name   = QString::fromLatin1((const char*)&message[5], qstrnlen((const char*)&message[5], 4));
+            newFormat.format = QByteArray((const char*)&message[9], qstrnlen((const char*)&message[9], 16));
+            newFormat.labels = QString::fromLatin1((const char*)&message[25], qstrnlen((const char*)&message[25], 64)).split(',');
+            if (newFormat.length < kHeaderLength) {
+                newFormat.length = 0;
+            } else if (newFormat.name == "GPOS") {
+                gposType = message[3];
+                gposLat = _field(newFormat, "Lat", 0);
+                gposLon = _field(newFormat, "Lon", 1);
+                gposAlt = _field(newFormat, "Alt", 2);
+            } else if (newFormat.name == "CAMT") {
+                camtType = message[3];
+                camtTime = _field(newFormat, "T", 0);
+                camtSeq  = _field(newFormat, "seq", 1);
+            }
+        } else if (type == camtType) {
+            if (camtSeq.offset >= 0) {
+                int seq = (int)_value(message, camtSeq);
+                if (seq <= sequence) {
+                    // Repeated trigger
+                    continue;
+                }
+                sequence = seq;
+            }
+            triggerTime.append(_value(message, camtTime) / 1.0e6);
+            pendingTriggers++;
+        } else if (type == gposType) {
+            double latitude  = _value(message, gposLat);
+            double longitude = _value(message, gposLon);
+            if (gposLat.type == 'L' || gposLat.type == 'i') {
+                latitude  /= 1.0e7;
+                longitude /= 1.0e7;
+            }
+            longitude = fmod(180.0 + longitude, 360.0) - 180.0;
+            lastCoordinate.setLatitude(latitude);
+            lastCoordinate.setLongitude(longitude);
+            lastCoordinate.setAltitude(_value(message, gposAlt));
+            for (; pendingTriggers > 0; pendingTriggers--) {
+                geoRef.append(lastCoordinate);
+            }
+        }
+    }
+
+    // Triggers after the last position get the last known position
+    for (; pendingTriggers > 0; pendingTriggers--) {
+        geoRef.append(lastCoordinate);
+    }
+
+    if (camtType == -1 || gposType == -1) {
+        qCDebug(GeotaggingLog) << "Log has no camera trigger or position messages";
+        return false;
+    }
+
+    return true;
+}
+
+/// @return Offset and type of the labelled field, falling back to the field at defaultIndex for logs without labels
+PX4LogParser::Field_t PX4LogParser::_field(const Format_t& format, const QString& label, int defaultIndex)
+{
+    int index = format.labels.indexOf(label);
+    if (index == -1) {
+        index = defaultIndex;
+    }
+
+    Field_t field;
+    field.offset = -1;
+    field.type = 0;
+
+    int offset = kHeaderLength;
+    for (int i=0; i<format.format.length(); i++) {
+        if (i == index) {
+            field.offset = offset;
+            field.type = format.format[i];
+            if (offset + _typeSize(field.type) > format.length) {
+                field.offset = -1;
+            }
+            break;
+        }
+        offset += _typeSize(format.format[i]);
+    }
+
+    return field;
+}
+
+int PX4LogParser::_typeSize(char type)
+{
+    switch (type) {
+    case 'b':
+    case 'B':
+    case 'M':
+        return 1;
+    case 'h':
+    case 'H':
+    case 'c':
+    case 'C':
+        return 2;
+    case 'i':
+    case 'I':
+    case 'f':
+    case 'n':
+    case 'e':
+    case 'E':
+    case 'L':
+        return 4;
+    case 'q':
+    case 'Q':
+        return 8;
+    case 'N':
+        return 16;
+    case 'Z':
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+double PX4LogParser::_value(const uchar* message, const Field_t& field)
+{
+    if (field.offset < 0) {
+        return 0;
+    }
+
+    const uchar* ptr = message + field.offset;
+    switch (field.type) {
+    case 'b':
+        return (qint8)*ptr;
+    case 'B':
+    case 'M':
+        return *ptr;
+    case 'h':
+        return qFromLittleEndian<qint16>(ptr);
+    case 'H':
+        return qFromLittleEndian<quint16>(ptr);
+    case 'c':
+        return qFromLittleEndian<qint16>(ptr) / 100.0;
+    case 'C':
+        return qFromLittleEndian<quint16>(ptr) / 100.0;
+    case 'i':
+    case 'L':
+        return qFromLittleEndian<qint32>(ptr);
+    case 'I':
+        return qFromLittleEndian<quint32>(ptr);
+    case 'e':
+        return qFromLittleEndian<qint32>(ptr) / 100.0;
+    case 'E':
+        return qFromLittleEndian<quint32>(ptr) / 100.0;
+    case 'f':
+    {
+        quint32 bits = qFromLittleEndian<quint32>(ptr);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case 'q':
+        return (double)qFromLittleEndian<qint64>(ptr);
+    case 'Q':
+        return (double)qFromLittleEndian<quint64>(ptr);
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,52 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef PX4LogParser_H
+#define PX4LogParser_H
+
+#include <QGeoCoordinate>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+class LogFileView;
+
+/// Extracts camera trigger events from a PX4 (sdlog2) .px4log file in a single pass. Messages are located from the
+/// format (FMT) table in the log, only GPOS and CAMT messages are decoded.
+class PX4LogParser
+{
+public:
+    PX4LogParser();
+    ~PX4LogParser();
+
+    /// @param cancel Checked as the log is parsed, parsing stops when set
+    /// @param triggerTime Returns the time of each trigger in seconds
+    /// @param geoRef Returns the position of the vehicle at each trigger
+    /// @return false: log could not be parsed or parsing was cancelled
+    bool getTagsFromLog(LogFileView& log, const bool& cancel, QList<double>& triggerTime, QList<QGeoCoordinate>& geoRef);
+
+private:
+    typedef struct {
+        int         length;     ///< Message length including the header, 0 for an unknown message type
+        QString     name;
+        QByteArray  format;
+        QStringList labels;
+    } Format_t;
+
+    typedef struct {
+        int     offset;         ///< Offset from the start of the message, -1 if the field is missing
+        char    type;
+    } Field_t;
+
+    static Field_t  _field      (const Format_t& format, const QString& label, int defaultIndex);
+    static int      _typeSize   (char type);
+    static double   _value      (const uchar* message, const Field_t& field);
+};
+
+#endif
@@ -0,0 +1,258 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#include "ULogParser.h"
+#include "LogFileView.h"
+#include "QGCLoggingCategory.h"
+
+#include <math.h>
+#include <QtEndian>
+#include <QStringList>
+
+static const char   kMagic[]            = { 'U', 'L', 'o', 'g', 0x01, 0x12, 0x35 };
+static const int    kFileHeaderLength   = 16;
+static const int    kMessageHeaderLength= 3;    // uint16_t size, uint8_t type
+static const int    kCancelCheckCount   = 10000;
+static const char*  kGposTopic          = "vehicle_global_position";
+static const char*  kTriggerTopic       = "camera_trigger";
+
+ULogParser::ULogParser()
+{
+
+}
+
+ULogParser::~ULogParser()
+{
+
+}
+
+bool ULogParser::isULog(LogFileView& log)
+{
+    const uchar* magic = log.data(0, sizeof(kMagic));
+    return magic && memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool ULogParser::getTagsFromLog(LogFileView& log, const bool& cancel, QList<double>& triggerTime, QList<QGeoCoordinate>& geoRef)
+{
+    if (!isULog(log)) {
+        return false;
+    }
+
+    Field_t gposLat, gposLon, gposAlt;
+    Field_t triggerTimestamp;
+
+    QGeoCoordinate  lastCoordinate;
+    int             pendingTriggers = 0;    // Triggers waiting for the next position
+    int             messageCount = 0;
+
+    qint64 offset = kFileHeaderLength;
+    while (offset + kMessageHeaderLength <= log.size()) {
+        if (++messageCount % kCancelCheckCount == 0 && cancel) {
+            return false;
+        }
+
+        const uchar* header = log.data(offset, kMessageHeaderLength);
+        if (!header) {
+            break;
+        }
+        int size = qFromLittleEndian<quint16>(header);
+        char type = header[2];
+        const uchar* message = log.data(offset, kMessageHeaderLength + size);
+        if (!message) {
+            // Truncated message at the end of the log
+            break;
+        }
+        const uchar* payload = message + kMessageHeaderLength;
+        offset += kMessageHeaderLength + size;
+
+        switch (type) {
+        case 'F':
+        {
+            // Format definition "name:type field;type field;..."
+            QString definition = QString::fromLatin1((const char*)payload, size);
+            int separator = definition.indexOf(':');
+            if (separator > 0) {
+                _formats[definition.left(separator)] = definition.mid(separator + 1);
+            }
+            break;
+        }
+        case 'A':
+        {
+            // Subscription: uint8_t multi_id, uint16_t msg_id, char name[]
+            if (size < 3) {
+                break;
+            }
+            int msgId = qFromLittleEndian<quint16>(payload + 1);
+            QString name = QString::fromLatin1((const char*)payload + 3, size - 3);
+            if (name == kGposTopic) {
+                _gposIds.insert(msgId);
+                gposLat = _field(name, "lat");
+                gposLon = _field(name, "lon");
+                gposAlt = _field(name, "alt");
+            } else if (name == kTriggerTopic) {
+                _triggerIds.insert(msgId);
+                triggerTimestamp = _field(name, "timestamp");
+            }
+            break;
+        }
+        case 'D':
+        {
+            // Data: uint16_t msg_id, topic data
+            if (size < 2) {
+                break;
+            }
+            int msgId = qFromLittleEndian<quint16>(payload);
+            const uchar* data = payload + 2;
+            int dataLength = size - 2;
+            if (_triggerIds.contains(msgId)) {
+                triggerTime.append(_value(data, dataLength, triggerTimestamp) / 1.0e6);
+                pendingTriggers++;
+            } else if (_gposIds.contains(msgId)) {
+                double latitude  = _value(data, dataLength, gposLat);
+                double longitude = _value(data, dataLength, gposLon);
+                if (gposLat.type == "int32_t") {
+                    latitude  /= 1.0e7;
+                    longitude /= 1.0e7;
+                }
+                longitude = fmod(180.0 + longitude, 360.0) - 180.0;
+                lastCoordinate.setLatitude(latitude);
+                lastCoordinate.setLongitude(longitude);
+                lastCoordinate.setAltitude(_value(data, dataLength, gposAlt));
+                for (; pendingTriggers > 0; pendingTriggers--) {
+                    geoRef.append(lastCoordinate);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Triggers after the last position get the last known position
+    for (; pendingTriggers > 0; pendingTriggers--) {
+        geoRef.append(lastCoordinate);
+    }
+
+    if (_triggerIds.isEmpty() || _gposIds.isEmpty()) {
+        qCDebug(GeotaggingLog) << "Log has no camera trigger or position topics";
+        return false;
+    }
+
+    return true;
+}
+
+/// @return Offset and type of the named field within the topic data
+ULogParser::Field_t ULogParser::_field(const QString& topic, const QString& name)
+{
+    Field_t field;
+    field.offset = -1;
+
+    int offset = 0;
+    foreach (const QString& definition, _formats.value(topic).split(';', QString::SkipEmptyParts)) {
+        // "type name" or "type[count] name"
+        QStringList parts = definition.split(' ', QString::SkipEmptyParts);
+        if (parts.count() != 2) {
+            break;
+        }
+        QString type = parts[0];
+        int count = 1;
+        int bracket = type.indexOf('[');
+        if (bracket > 0) {
+            count = type.mid(bracket + 1, type.indexOf(']') - bracket - 1).toInt();
+            type = type.left(bracket);
+        }
+        if (parts[1] == name) {
+            field.offset = offset;
+            field.type = type;
+            break;
+        }
+        int size = _typeSize(type);
+        if (size <= 0) {
+            break;
+        }
+        offset += size * count;
+    }
+
+    return field;
+}
+
+/// @return Size of a basic type or a nested topic, -1 if unknown
+int ULogParser::_typeSize(const QString& type)
+{
+    if (type == "int8_t" || type == "uint8_t" || type == "bool" || type == "char") {
+        return 1;
+    } else if (type == "int16_t" || type == "uint16_t") {
+        return 2;
+    } else if (type == "int32_t" || type == "uint32_t" || type == "float") {
+        return 4;
+    } else if (type == "int64_t" || type == "uint64_t" || type == "double") {
+        return 8;
+    }
+
+    if (_formatSizes.contains(type)) {
+        return _formatSizes[type];
+    }
+    if (!_formats.contains(type)) {
+        return -1;
+    }
+    // Guards against a nested type which refers back to itself
+    _formatSizes[type] = -1;
+    int size = 0;
+    foreach (const QString& definition, _formats.value(type).split(';', QString::SkipEmptyParts)) {
+        QStringList parts = definition.split(' ', QString::SkipEmptyParts);
+        if (parts.count() != 2) {
+            return -1;
+        }
+        QString fieldType = parts[0];
+        int count = 1;
+        int bracket = fieldType.indexOf('[');
+        if (bracket > 0) {
+            count = fieldType.mid(bracket + 1, fieldType.indexOf(']') - bracket - 1).toInt();
+            fieldType = fieldType.left(bracket);
+        }
+        int fieldSize = _typeSize(fieldType);
+        if (fieldSize <= 0) {
+            return -1;
+        }
+        size += fieldSize * count;
+    }
+    _formatSizes[type] = size;
+    return size;
+}
+
+double ULogParser::_value(const uchar* data, int dataLength, const Field_t& field)
+{
+    if (field.offset < 0) {
+        return 0;
+    }
+
+    const uchar* ptr = data + field.offset;
+    const QString& type = field.type;
+    if (type == "double" && field.offset + 8 <= dataLength) {
+        quint64 bits = qFromLittleEndian<quint64>(ptr);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    } else if (type == "float" && field.offset + 4 <= dataLength) {
+        quint32 bits = qFromLittleEndian<quint32>(ptr);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    } else if (type == "uint64_t" && field.offset + 8 <= dataLength) {
+        return (double)qFromLittleEndian<quint64>(ptr);
+    } else if (type == "int64_t" && field.offset + 8 <= dataLength) {
+        return (double)qFromLittleEndian<qint64>(ptr);
+    } else if (type == "int32_t" && field.offset + 4 <= dataLength) {
+        return qFromLittleEndian<qint32>(ptr);
+    } else if (type == "uint32_t" && field.offset + 4 <= dataLength) {
+        return qFromLittleEndian<quint32>(ptr);
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+#ifndef ULogParser_H
+#define ULogParser_H
+
+#include <QGeoCoordinate>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+class LogFileView;
+
+/// Extracts camera trigger events from a PX4 ULog (.ulg) file in a single pass. Topic layouts come from the format
+/// definitions in the log, only camera_trigger and vehicle_global_position data is decoded.
+class ULogParser
+{
+public:
+    ULogParser();
+    ~ULogParser();
+
+    /// @return true: log starts with the ULog file magic
+    static bool isULog(LogFileView& log);
+
+    /// @param cancel Checked as the log is parsed, parsing stops when set
+    /// @param triggerTime Returns the time of each trigger in seconds
+    /// @param geoRef Returns the position of the vehicle at each trigger
+    /// @return false: log could not be parsed or parsing was cancelled
+    bool getTagsFromLog(LogFileView& log, const bool& cancel, QList<double>& triggerTime, QList<QGeoCoordinate>& geoRef);
+
+private:
+    typedef struct {
+        int     offset;     ///< Offset from the start of the topic data, -1 if the field is missing
+        QString type;
+    } Field_t;
+
+    Field_t _field      (const QString& topic, const QString& name);
+    int     _typeSize   (const QString& type);
+
+    static double _value(const uchar* data, int dataLength, const Field_t& field);
+
+    QHash<QString, QString> _formats;       ///< Field list by topic name, from the format definitions
+    QHash<QString, int>     _formatSizes;   ///< Size of each topic which has been worked out
+    QSet<int>               _gposIds;       ///< Message ids of vehicle_global_position instances
+    QSet<int>               _triggerIds;    ///< Message ids of camera_trigger instances
+};
+
+#endif
@@ -0,0 +1,246 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "ParameterCacheSnapshot.h"
+#include "QGC.h"
+
+#include <QtEndian>
+
+ParameterCacheSnapshot::ParameterCacheSnapshot(void)
+    : _records(NULL)
+    , _count(0)
+    , _hash(0)
+{
+    Q_STATIC_ASSERT(sizeof(Header_t) == 32);
+    Q_STATIC_ASSERT(sizeof(Record_t) == 32);
+}
+
+ParameterCacheSnapshot::~ParameterCacheSnapshot()
+{
+    clear();
+}
+
+void ParameterCacheSnapshot::clear(void)
+{
+    if (_file.isOpen()) {
+        // Closing the file also unmaps it
+        _file.close();
+    }
+    _buildRecords.clear();
+    _records = NULL;
+    _count = 0;
+    _hash = 0;
+}
+
+void ParameterCacheSnapshot::append(const QString& name, MAV_PARAM_TYPE mavType, const QVariant& value)
+{
+    if (_file.isOpen()) {
+        clear();
+    }
+
+    Record_t record;
+    memset(&record, 0, sizeof(record));
+
+    QByteArray nameBytes = name.toLocal8Bit();
+    memcpy(record.name, nameBytes.constData(), qMin(nameBytes.length(), (int)sizeof(record.name)));
+    record.mavType = mavType;
+    _valueToBytes(mavType, value, record.value);
+
+    // Same hash the PX4 firmware computes for _HASH_CHECK
+    _hash = QGC::crc32((const quint8*)nameBytes.constData(), nameBytes.length(), _hash);
+    _hash = QGC::crc32(record.value, _mavTypeSize(mavType), _hash);
+
+    _buildRecords.append((const char*)&record, sizeof(record));
+    _records = (const Record_t*)_buildRecords.constData();
+    _count++;
+}
+
+bool ParameterCacheSnapshot::save(const QString& fileName, QString& errorString)
+{
+    Header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic =      qToLittleEndian(fileMagic);
+    header.version =    qToLittleEndian(fileVersion);
+    header.recordSize = qToLittleEndian((quint16)sizeof(Record_t));
+    header.count =      qToLittleEndian((quint32)_count);
+    header.hash =       qToLittleEndian(_hash);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorString = file.errorString();
+        return false;
+    }
+    if (file.write((const char*)&header, sizeof(header)) != sizeof(header) ||
+            file.write(_buildRecords) != _buildRecords.length()) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool ParameterCacheSnapshot::load(const QString& fileName)
+{
+    clear();
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 fileSize = _file.size();
+    if (fileSize < (qint64)sizeof(Header_t)) {
+        clear();
+        return false;
+    }
+
+    const uchar* data = _file.map(0, fileSize);
+    if (!data) {
+        clear();
+        return false;
+    }
+
+    Header_t header;
+    memcpy(&header, data, sizeof(header));
+    quint32 count = qFromLittleEndian(header.count);
+    if (qFromLittleEndian(header.magic) != fileMagic ||
+            qFromLittleEndian(header.version) != fileVersion ||
+            qFromLittleEndian(header.recordSize) != sizeof(Record_t) ||
+            fileSize != (qint64)(sizeof(Header_t) + ((qint64)count * sizeof(Record_t)))) {
+        // Older cache format, or a truncated file
+        clear();
+        return false;
+    }
+
+    _records = (const Record_t*)(data + sizeof(Header_t));
+    _count = count;
+    _hash = qFromLittleEndian(header.hash);
+
+    return true;
+}
+
+QString ParameterCacheSnapshot::name(int index) const
+{
+    const char* name = _records[index].name;
+    return QString::fromLocal8Bit(name, strnlen(name, sizeof(_records[index].name)));
+}
+
+QVariant ParameterCacheSnapshot::value(int index) const
+{
+    const quint8* bytes = _records[index].value;
+
+    // Same variant types as UAS::processParamValueMsg produces
+    switch (_records[index].mavType) {
+    case MAV_PARAM_TYPE_UINT8:
+        return QVariant((int)*bytes);
+    case MAV_PARAM_TYPE_INT8:
+        return QVariant((int)*(const qint8*)bytes);
+    case MAV_PARAM_TYPE_UINT16:
+        return QVariant((int)qFromLittleEndian<quint16>(bytes));
+    case MAV_PARAM_TYPE_INT16:
+        return QVariant((int)qFromLittleEndian<qint16>(bytes));
+    case MAV_PARAM_TYPE_UINT32:
+        return QVariant(qFromLittleEndian<quint32>(bytes));
+    case MAV_PARAM_TYPE_UINT64:
+        return QVariant(qFromLittleEndian<quint64>(bytes));
+    case MAV_PARAM_TYPE_INT64:
+        return QVariant(qFromLittleEndian<qint64>(bytes));
+    case MAV_PARAM_TYPE_REAL32:
+    {
+        float value;
+        memcpy(&value, bytes, sizeof(value));
+        return QVariant(value);
+    }
+    case MAV_PARAM_TYPE_REAL64:
+    {
+        double value;
+        memcpy(&value, bytes, sizeof(value));
+        return QVariant(value);
+    }
+    case MAV_PARAM_TYPE_INT32:
+    default:
+        return QVariant(qFromLittleEndian<qint32>(bytes));
+    }
+}
+
+bool ParameterCacheSnapshot::valueMatches(int index, MAV_PARAM_TYPE mavType, const QVariant& value) const
+{
+    if (_records[index].mavType != mavType) {
+        return false;
+    }
+
+    // Compare the raw bytes so floats which went through the wire unchanged always match
+    quint8 bytes[sizeof(_records[index].value)];
+    memset(bytes, 0, sizeof(bytes));
+    _valueToBytes(mavType, value, bytes);
+
+    return memcmp(bytes, _records[index].value, sizeof(bytes)) == 0;
+}
+
+int ParameterCacheSnapshot::_mavTypeSize(MAV_PARAM_TYPE mavType)
+{
+    switch (mavType) {
+    case MAV_PARAM_TYPE_UINT8:
+    case MAV_PARAM_TYPE_INT8:
+        return 1;
+    case MAV_PARAM_TYPE_UINT16:
+    case MAV_PARAM_TYPE_INT16:
+        return 2;
+    case MAV_PARAM_TYPE_UINT64:
+    case MAV_PARAM_TYPE_INT64:
+    case MAV_PARAM_TYPE_REAL64:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+void ParameterCacheSnapshot::_valueToBytes(MAV_PARAM_TYPE mavType, const QVariant& value, quint8* bytes)
+{
+    switch (mavType) {
+    case MAV_PARAM_TYPE_UINT8:
+        *bytes = (quint8)value.toUInt();
+        break;
+    case MAV_PARAM_TYPE_INT8:
+        *(qint8*)bytes = (qint8)value.toInt();
+        break;
+    case MAV_PARAM_TYPE_UINT16:
+        qToLittleEndian<quint16>((quint16)value.toUInt(), bytes);
+        break;
+    case MAV_PARAM_TYPE_INT16:
+        qToLittleEndian<qint16>((qint16)value.toInt(), bytes);
+        break;
+    case MAV_PARAM_TYPE_UINT32:
+        qToLittleEndian<quint32>(value.toUInt(), bytes);
+        break;
+    case MAV_PARAM_TYPE_UINT64:
+        qToLittleEndian<quint64>(value.toULongLong(), bytes);
+        break;
+    case MAV_PARAM_TYPE_INT64:
+        qToLittleEndian<qint64>(value.toLongLong(), bytes);
+        break;
+    case MAV_PARAM_TYPE_REAL32:
+    {
+        float floatValue = value.toFloat();
+        memcpy(bytes, &floatValue, sizeof(floatValue));
+        break;
+    }
+    case MAV_PARAM_TYPE_REAL64:
+    {
+        double doubleValue = value.toDouble();
+        memcpy(bytes, &doubleValue, sizeof(doubleValue));
+        break;
+    }
+    case MAV_PARAM_TYPE_INT32:
+    default:
+        qToLittleEndian<qint32>(value.toInt(), bytes);
+        break;
+    }
+}
@@ -0,0 +1,88 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef ParameterCacheSnapshot_H
+#define ParameterCacheSnapshot_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVariant>
+
+#include "QGCMAVLink.h"
+
+/// Binary snapshot of the full parameter set for a single component, used as the on disk parameter cache.
+///
+/// The file is a 32 byte header followed by one 32 byte record per parameter, stored in parameter index order so
+/// record i is the parameter with index i. Records hold the name, MAV_PARAM_TYPE and the value in its native little
+/// endian representation. Snapshots are loaded by mapping the file, records are read in place.
+///
+/// The header holds the PX4 style parameter hash (crc32 over each name followed by the value bytes) so a PX4 _HASH_CHECK
+/// can be compared without touching the records.
+class ParameterCacheSnapshot
+{
+public:
+    ParameterCacheSnapshot(void);
+    ~ParameterCacheSnapshot();
+
+    /// Clears the snapshot, unmapping any loaded file
+    void clear(void);
+
+    /// Adds the next parameter to a snapshot which is being built. Parameters must be added in index order.
+    void append(const QString& name, MAV_PARAM_TYPE mavType, const QVariant& value);
+
+    /// Saves the snapshot which was built with append
+    ///     @return false: write failed, see errorString
+    bool save(const QString& fileName, QString& errorString);
+
+    /// Maps the specified snapshot file
+    ///     @return false: no file, or file is not a valid snapshot
+    bool load(const QString& fileName);
+
+    int             count       (void) const { return _count; }
+    quint32         hash        (void) const { return _hash; }
+    QString         name        (int index) const;
+    MAV_PARAM_TYPE  mavType     (int index) const { return (MAV_PARAM_TYPE)_records[index].mavType; }
+    QVariant        value       (int index) const;
+
+    /// @return true: value is the same as the parameter value stored at the specified index
+    bool valueMatches(int index, MAV_PARAM_TYPE mavType, const QVariant& value) const;
+
+    static const quint32 fileMagic =    0x43504751;     ///< "QGPC"
+    static const quint16 fileVersion =  1;
+
+private:
+    typedef struct {
+        quint32 magic;
+        quint16 version;
+        quint16 recordSize;
+        quint32 count;
+        quint32 hash;
+        quint8  reserved[16];
+    } Header_t;
+
+    typedef struct {
+        char    name[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];   ///< Not null terminated if the name fills the field
+        quint8  mavType;
+        quint8  reserved[7];
+        quint8  value[8];                                           ///< Value in native representation, zero padded
+    } Record_t;
+
+    static int  _mavTypeSize    (MAV_PARAM_TYPE mavType);
+    static void _valueToBytes   (MAV_PARAM_TYPE mavType, const QVariant& value, quint8* bytes);
+
+    QFile           _file;
+    QByteArray      _buildRecords;  ///< Records added with append
+    const Record_t* _records;       ///< Either the mapped file or _buildRecords
+    int             _count;
+    quint32         _hash;
+};
+
+#endif
@@ -26,11 +26,7 @@
 #include <QDebug>
 #include <QVariantAnimation>
 #include <QJsonArray>
-
-/* types for local parameter cache */
-typedef QPair<int, QVariant> ParamTypeVal;
-typedef QPair<QString, ParamTypeVal> NamedParam;
-typedef QMap<int, NamedParam> MapID2NamedParam;
+#include <QVector>
 
 QGC_LOGGING_CATEGORY(ParameterManagerVerboseLog, "ParameterManagerVerboseLog")
 
@@ -59,8 +55,15 @@ ParameterManager::ParameterManager(Vehicle* vehicle)
     , _prevWaitingWriteParamNameCount(0)
     , _initialRequestRetryCount(0)
     , _totalParamCount(0)
+    , _indexReadsInFlightCount(0)
+    , _readWindow(_defaultMaxReadWindowSize)
+    , _readRequestCount(0)
+    , _loadRate(0)
+    , _cacheValidationRetryCount(0)
 {
     _versionParam = vehicle->firmwarePlugin()->getVersionParam();
+    _volatileParamPrefixes = vehicle->firmwarePlugin()->volatileParameterPrefixes();
+    _cacheIdentityParams = vehicle->firmwarePlugin()->cacheIdentityParameters();
 
     if (_vehicle->isOfflineEditingVehicle()) {
         _loadOfflineEditingParams();
@@ -80,6 +83,14 @@ ParameterManager::ParameterManager(Vehicle* vehicle)
     _waitingParamTimeoutTimer.setInterval(1000);
     connect(&_waitingParamTimeoutTimer, &QTimer::timeout, this, &ParameterManager::_waitingParamTimeout);
 
+    _readWindowTimer.setSingleShot(false);
+    _readWindowTimer.setInterval(20);
+    connect(&_readWindowTimer, &QTimer::timeout, this, &ParameterManager::_readWindowTimeout);
+
+    _cacheValidationTimer.setSingleShot(true);
+    _cacheValidationTimer.setInterval(1000);
+    connect(&_cacheValidationTimer, &QTimer::timeout, this, &ParameterManager::_cacheValidationTimeout);
+
     connect(_vehicle->uas(), &UASInterface::parameterUpdate, this, &ParameterManager::_parameterUpdate);
 
     _defaultComponentIdParam = vehicle->firmwarePlugin()->getDefaultComponentIdParam();
@@ -87,14 +98,25 @@ ParameterManager::ParameterManager(Vehicle* vehicle)
 
     // Ensure the cache directory exists
     QFileInfo(QSettings().fileName()).dir().mkdir("ParamCache");
-    refreshAllParameters();
+    if (_vehicle->apmFirmware()) {
+        // ArduPilot has no parameter hash, the cache is validated against a sample of parameters instead
+        _tryCacheLookup();
+    } else {
+        refreshAllParameters();
+    }
 }
 
 ParameterManager::~ParameterManager()
 {
+    qDeleteAll(_cacheSnapshots);
     delete _parameterMetaData;
 }
 
+void ParameterManager::setMaxReadWindowSize(int maxReadWindowSize)
+{
+    _readWindow.setMaxSize(maxReadWindowSize);
+}
+
 /// Called whenever a parameter is updated or first seen.
 void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString parameterName, int parameterCount, int parameterId, int mavType, QVariant value)
 {
@@ -103,6 +125,11 @@ void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString
         return;
     }
 
+    if (!_cacheSnapshots.isEmpty()) {
+        _cacheValidationUpdate(componentId, parameterName, parameterCount, parameterId, mavType, value);
+        return;
+    }
+
     _initialRequestTimeoutTimer.stop();
 
     if (_initialLoadComplete) {
@@ -149,28 +176,14 @@ void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString
     }
     _dataMutex.lock();
 
-    // Update our total parameter counts
-    if (!_paramCountMap.contains(componentId)) {
-        _paramCountMap[componentId] = parameterCount;
+    // If we've never seen this component id before, setup the store. Every index starts out waiting for a read.
+    if (!_parameterStores.contains(componentId)) {
+        _parameterStores[componentId].setParamCount(parameterCount);
         _totalParamCount += parameterCount;
-    }
-
-    _mapParameterId2Name[componentId][parameterId] = parameterName;
-
-    // If we've never seen this component id before, setup the wait lists.
-    if (!_waitingReadParamIndexMap.contains(componentId)) {
-        // Add all indices to the wait list, parameter index is 0-based
-        for (int waitingIndex=0; waitingIndex<parameterCount; waitingIndex++) {
-            // This will add the new component id, as well as the the new waiting index and set the retry count for that index to 0
-            _waitingReadParamIndexMap[componentId][waitingIndex] = 0;
-        }
-
-        // The read and write waiting lists for this component are initialized the empty
-        _waitingReadParamNameMap[componentId] = QMap<QString, int>();
-        _waitingWriteParamNameMap[componentId] = QMap<QString, int>();
 
         qCDebug(ParameterManagerLog) << "Seeing component for first time, id:" << componentId << "parameter count:" << parameterCount;
     }
+    ParameterStore& store = _parameterStores[componentId];
 
     // Determine default component id
     if (!_defaultComponentIdParam.isEmpty() && _defaultComponentIdParam == parameterName) {
@@ -178,60 +191,47 @@ void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString
         _defaultComponentId = componentId;
     }
 
+    int     slot = store.slotFor(parameterId, parameterName);
+    bool    indexValid = parameterId >= 0 && parameterId < store.paramCount();
+
     bool componentParamsComplete = false;
-    if (_waitingReadParamIndexMap[componentId].count() == 1) {
+    if (store.pendingCount(ParameterStore::PendingIndexRead) == 1) {
         // We need to know when we get the last param from a component in order to complete setup
         componentParamsComplete = true;
     }
 
-    if (_waitingReadParamIndexMap[componentId].contains(parameterId) ||
-        _waitingReadParamNameMap[componentId].contains(parameterName) ||
-        _waitingWriteParamNameMap[componentId].contains(parameterName)) {
+    bool writeAcked = store.isPending(ParameterStore::PendingWrite, slot);
+    if ((indexValid && store.isPending(ParameterStore::PendingIndexRead, parameterId)) ||
+        store.isPending(ParameterStore::PendingNameRead, slot) ||
+        store.isPending(ParameterStore::PendingWrite, slot)) {
         // We were waiting for this parameter, restart wait timer. Otherwise it is a spurious parameter update which
         // means we should not reset the wait timer.
         _waitingParamTimeoutTimer.start();
     }
 
-    // Remove this parameter from the waiting lists
-    _waitingReadParamIndexMap[componentId].remove(parameterId);
-    _waitingReadParamNameMap[componentId].remove(parameterName);
-    _waitingWriteParamNameMap[componentId].remove(parameterName);
-    qCDebug(ParameterManagerVerboseLog) << "_waitingReadParamIndexMap:" << _waitingReadParamIndexMap[componentId];
-    qCDebug(ParameterManagerLog) << "_waitingReadParamNameMap" << _waitingReadParamNameMap[componentId];
-    qCDebug(ParameterManagerLog) << "_waitingWriteParamNameMap" << _waitingWriteParamNameMap[componentId];
-
-    // Track how many parameters we are still waiting for
-
-    int waitingReadParamIndexCount = 0;
-    int waitingReadParamNameCount = 0;
-    int waitingWriteParamNameCount = 0;
-
-    foreach(int waitingComponentId, _waitingReadParamIndexMap.keys()) {
-        waitingReadParamIndexCount += _waitingReadParamIndexMap[waitingComponentId].count();
-    }
-    if (waitingReadParamIndexCount) {
-        qCDebug(ParameterManagerLog) << "waitingReadParamIndexCount:" << waitingReadParamIndexCount;
+    bool indexReadComplete = false;
+    if (indexValid && _indexReadsInFlight.contains(componentId) && _indexReadsInFlight[componentId].contains(parameterId)) {
+        _indexReadComplete(componentId, parameterId);
+        indexReadComplete = true;
     }
 
-
-    foreach(int waitingComponentId, _waitingReadParamNameMap.keys()) {
-        waitingReadParamNameCount += _waitingReadParamNameMap[waitingComponentId].count();
-    }
-    if (waitingReadParamNameCount) {
-        qCDebug(ParameterManagerLog) << "waitingReadParamNameCount:" << waitingReadParamNameCount;
+    // Remove this parameter from the waiting lists
+    if (indexValid) {
+        store.clearPending(ParameterStore::PendingIndexRead, parameterId);
     }
+    store.clearPending(ParameterStore::PendingNameRead, slot);
+    store.clearPending(ParameterStore::PendingWrite, slot);
 
-    foreach(int waitingComponentId, _waitingWriteParamNameMap.keys()) {
-        waitingWriteParamNameCount += _waitingWriteParamNameMap[waitingComponentId].count();
-    }
-    if (waitingWriteParamNameCount) {
-        qCDebug(ParameterManagerLog) << "waitingWriteParamNameCount:" << waitingWriteParamNameCount;
-    }
+    // Track how many parameters we are still waiting for
+
+    int waitingReadParamIndexCount = _pendingCount(ParameterStore::PendingIndexRead);
+    int waitingReadParamNameCount = _pendingCount(ParameterStore::PendingNameRead);
+    int waitingWriteParamNameCount = _pendingCount(ParameterStore::PendingWrite);
 
     int readWaitingParamCount = waitingReadParamIndexCount + waitingReadParamNameCount;
     int totalWaitingParamCount = readWaitingParamCount + waitingWriteParamNameCount;
     if (totalWaitingParamCount) {
-        qCDebug(ParameterManagerLog) << "totalWaitingParamCount:" << totalWaitingParamCount;
+        qCDebug(ParameterManagerVerboseLog) << "waiting readIndex:readName:write" << waitingReadParamIndexCount << waitingReadParamNameCount << waitingWriteParamNameCount;
     } else if (_defaultComponentId != MAV_COMP_ID_ALL) {
         // No more parameters to wait for, stop the timeout. Be careful to not stop timer if we don't have the default
         // component yet.
@@ -254,55 +254,22 @@ void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString
         _parameterSetMajorVersion = value.toInt();
     }
 
-    if (!_mapParameterName2Variant.contains(componentId) || !_mapParameterName2Variant[componentId].contains(parameterName)) {
+    Fact* fact = store.fact(slot);
+    if (!fact) {
         qCDebug(ParameterManagerLog) << "Adding new fact";
-
-        FactMetaData::ValueType_t factType;
-        switch (mavType) {
-            case MAV_PARAM_TYPE_UINT8:
-                factType = FactMetaData::valueTypeUint8;
-                break;
-            case MAV_PARAM_TYPE_INT8:
-                factType = FactMetaData::valueTypeInt8;
-                break;
-            case MAV_PARAM_TYPE_UINT16:
-                factType = FactMetaData::valueTypeUint16;
-                break;
-            case MAV_PARAM_TYPE_INT16:
-                factType = FactMetaData::valueTypeInt16;
-                break;
-            case MAV_PARAM_TYPE_UINT32:
-                factType = FactMetaData::valueTypeUint32;
-                break;
-            case MAV_PARAM_TYPE_INT32:
-                factType = FactMetaData::valueTypeInt32;
-                break;
-            case MAV_PARAM_TYPE_REAL32:
-                factType = FactMetaData::valueTypeFloat;
-                break;
-            case MAV_PARAM_TYPE_REAL64:
-                factType = FactMetaData::valueTypeDouble;
-                break;
-            default:
-                factType = FactMetaData::valueTypeInt32;
-                qCritical() << "Unsupported fact type" << mavType;
-                break;
-        }
-
-        Fact* fact = new Fact(componentId, parameterName, factType, this);
-
-        _mapParameterName2Variant[componentId][parameterName] = QVariant::fromValue(fact);
-
-        // We need to know when the fact changes from QML so that we can send the new value to the parameter manager
-        connect(fact, &Fact::_containerRawValueChanged, this, &ParameterManager::_valueUpdated);
+        fact = _createFact(componentId, slot, (MAV_PARAM_TYPE)mavType);
     }
 
     _dataMutex.unlock();
 
-    Q_ASSERT(_mapParameterName2Variant[componentId].contains(parameterName));
+    if (indexReadComplete) {
+        // Keep the read window full
+        _fillReadWindow();
+    }
+
+    // A value we did not ask for which differs from ours was changed on the vehicle, by autotune or another GCS for example
+    bool unsolicitedChange = !writeAcked && fact->rawValue() != value;
 
-    Fact* fact = _mapParameterName2Variant[componentId][parameterName].value<Fact*>();
-    Q_ASSERT(fact);
     fact->_containerSetRawValue(value);
 
     if (componentParamsComplete) {
@@ -323,12 +290,15 @@ void ParameterManager::_parameterUpdate(int vehicleId, int componentId, QString
         _saveToEEPROM();
     }
 
-    // Update param cache. The param cache is only used on PX4 Firmware since ArduPilot and Solo have volatile params
-    // which invalidate the cache. The Solo also streams param updates in flight for things like gimbal values
-    // which in turn causes a perf problem with all the param cache updates.
-    if (_vehicle->px4Firmware()) {
-        if (_prevWaitingReadParamIndexCount + _prevWaitingReadParamNameCount != 0 && readWaitingParamCount == 0) {
-            // All reads just finished, update the cache
+    // Update param cache. PX4 Firmware validates the cache with a hash of all params. ArduPilot validates it against
+    // a sample of params which leaves out the volatile ones. The cache is written when reads we were waiting for
+    // complete, when our writes have all been acked and when a value is changed on the vehicle. Volatile params streamed
+    // in flight (Solo gimbal values for example) don't cause cache updates.
+    if (_vehicle->px4Firmware() || _vehicle->apmFirmware()) {
+        bool readsComplete = _prevWaitingReadParamIndexCount + _prevWaitingReadParamNameCount != 0 && readWaitingParamCount == 0;
+        bool writesComplete = _prevWaitingWriteParamNameCount != 0 && waitingWriteParamNameCount == 0;
+        bool valueChanged = _initialLoadComplete && unsolicitedChange && !_isVolatileParameter(parameterName);
+        if (readsComplete || ((writesComplete || valueChanged) && readWaitingParamCount == 0)) {
             _writeLocalParamCache(vehicleId, componentId);
         }
     }
@@ -354,9 +324,11 @@ void ParameterManager::_valueUpdated(const QVariant& value)
 
     _dataMutex.lock();
 
-    Q_ASSERT(_waitingWriteParamNameMap.contains(componentId));
-    _waitingWriteParamNameMap[componentId].remove(name);    // Remove any old entry
-    _waitingWriteParamNameMap[componentId][name] = 0;       // Add new entry and set retry count
+    Q_ASSERT(_parameterStores.contains(componentId));
+    ParameterStore& store = _parameterStores[componentId];
+    int slot = store.indexOf(name);
+    Q_ASSERT(slot != -1);
+    store.setPending(ParameterStore::PendingWrite, slot);   // Add new entry and reset retry count
     _waitingParamTimeoutTimer.start();
     _saveRequired = true;
 
@@ -376,17 +348,16 @@ void ParameterManager::refreshAllParameters(uint8_t componentID)
 
     if (!_initialLoadComplete) {
         _initialRequestTimeoutTimer.start();
+        _loadTimer.start();
     }
 
     // Reset index wait lists
-    foreach (int cid, _paramCountMap.keys()) {
+    foreach (int cid, _parameterStores.keys()) {
         // Add/Update all indices to the wait list, parameter index is 0-based
         if(componentID != MAV_COMP_ID_ALL && componentID != cid)
             continue;
-        for (int waitingIndex = 0; waitingIndex < _paramCountMap[cid]; waitingIndex++) {
-            // This will add a new waiting index if needed and set the retry count for that index to 0
-            _waitingReadParamIndexMap[cid][waitingIndex] = 0;
-        }
+        // Sets the retry count for each index to 0
+        _parameterStores[cid].setAllIndexReadsPending();
     }
 
     _dataMutex.unlock();
@@ -415,8 +386,8 @@ void ParameterManager::_determineDefaultComponentId(void)
         // the set of parameters. Better than nothing!
 
         int largestCompParamCount = 0;
-        foreach(int componentId, _mapParameterName2Variant.keys()) {
-            int compParamCount = _mapParameterName2Variant[componentId].count();
+        foreach(int componentId, _parameterStores.keys()) {
+            int compParamCount = _parameterStores[componentId].factCount();
             if (compParamCount > largestCompParamCount) {
                 largestCompParamCount = compParamCount;
                 _defaultComponentId = componentId;
@@ -449,13 +420,15 @@ void ParameterManager::refreshParameter(int componentId, const QString& name)
 
     _dataMutex.lock();
 
-    Q_ASSERT(_waitingReadParamNameMap.contains(componentId));
+    Q_ASSERT(_parameterStores.contains(componentId));
 
-    if (_waitingReadParamNameMap.contains(componentId)) {
+    if (_parameterStores.contains(componentId)) {
+        ParameterStore& store = _parameterStores[componentId];
         QString mappedParamName = _remapParamNameToVersion(name);
 
-        _waitingReadParamNameMap[componentId].remove(mappedParamName);  // Remove old wait entry if there
-        _waitingReadParamNameMap[componentId][mappedParamName] = 0;     // Add new wait entry and update retry count
+        // Parameters we don't know about yet get a slot so the reply can be matched up
+        int slot = store.slotFor(-1, mappedParamName);
+        store.setPending(ParameterStore::PendingNameRead, slot);    // Add new wait entry and reset retry count
         emit restartWaitingParamTimer();
     }
 
@@ -469,7 +442,7 @@ void ParameterManager::refreshParametersPrefix(int componentId, const QString& n
     componentId = _actualComponentId(componentId);
     qCDebug(ParameterManagerLog) << "refreshParametersPrefix (component id:" << componentId << "name:" << namePrefix << ")";
 
-    foreach(const QString &name, _mapParameterName2Variant[componentId].keys()) {
+    foreach(const QString &name, parameterNames(componentId)) {
         if (name.startsWith(namePrefix)) {
             refreshParameter(componentId, name);
         }
@@ -481,8 +454,9 @@ bool ParameterManager::parameterExists(int componentId, const QString&  name)
     bool ret = false;
 
     componentId = _actualComponentId(componentId);
-    if (_mapParameterName2Variant.contains(componentId)) {
-        ret = _mapParameterName2Variant[componentId].contains(_remapParamNameToVersion(name));
+    QMap<int, ParameterStore>::const_iterator store = _parameterStores.constFind(componentId);
+    if (store != _parameterStores.constEnd()) {
+        ret = store->fact(_remapParamNameToVersion(name)) != NULL;
     }
 
     return ret;
@@ -493,23 +467,24 @@ Fact* ParameterManager::getParameter(int componentId, const QString& name)
     componentId = _actualComponentId(componentId);
 
     QString mappedParamName = _remapParamNameToVersion(name);
-    if (!_mapParameterName2Variant.contains(componentId) || !_mapParameterName2Variant[componentId].contains(mappedParamName)) {
+    QMap<int, ParameterStore>::const_iterator store = _parameterStores.constFind(componentId);
+    Fact* fact = store == _parameterStores.constEnd() ? NULL : store->fact(mappedParamName);
+    if (!fact) {
         qgcApp()->reportMissingParameter(componentId, mappedParamName);
         return &_defaultFact;
     }
 
-    return _mapParameterName2Variant[componentId][mappedParamName].value<Fact*>();
+    return fact;
 }
 
 QStringList ParameterManager::parameterNames(int componentId)
 {
-    QStringList names;
-
-    foreach(const QString &paramName, _mapParameterName2Variant[_actualComponentId(componentId)].keys()) {
-        names << paramName;
+    QMap<int, ParameterStore>::const_iterator store = _parameterStores.constFind(_actualComponentId(componentId));
+    if (store == _parameterStores.constEnd()) {
+        return QStringList();
     }
 
-    return names;
+    return store->names();
 }
 
 void ParameterManager::_setupGroupMap(void)
@@ -517,10 +492,10 @@ void ParameterManager::_setupGroupMap(void)
     // Must be able to handle being called multiple times
     _mapGroup2ParameterName.clear();
 
-    foreach (int componentId, _mapParameterName2Variant.keys()) {
-        foreach (const QString &name, _mapParameterName2Variant[componentId].keys()) {
-            Fact* fact = _mapParameterName2Variant[componentId][name].value<Fact*>();
-            _mapGroup2ParameterName[componentId][fact->group()] += name;
+    foreach (int componentId, _parameterStores.keys()) {
+        const ParameterStore& store = _parameterStores[componentId];
+        foreach (const QString &name, store.names()) {
+            _mapGroup2ParameterName[componentId][store.fact(name)->group()] += name;
         }
     }
 }
@@ -532,32 +507,11 @@ const QMap<int, QMap<QString, QStringList> >& ParameterManager::getGroupMap(void
 
 void ParameterManager::_waitingParamTimeout(void)
 {
-    bool paramsRequested = false;
     const int maxBatchSize = 10;
     int batchCount = 0;
 
-    // First check for any missing parameters from the initial index based load
-    batchCount = 0;
-    foreach(int componentId, _waitingReadParamIndexMap.keys()) {
-        foreach(int paramIndex, _waitingReadParamIndexMap[componentId].keys()) {
-            _waitingReadParamIndexMap[componentId][paramIndex]++;   // Bump retry count
-            if (_waitingReadParamIndexMap[componentId][paramIndex] > _maxInitialLoadRetrySingleParam) {
-                // Give up on this index
-                _failedReadParamIndexMap[componentId] << paramIndex;
-                qCDebug(ParameterManagerLog) << "Giving up on (componentId:" << componentId << "paramIndex:" << paramIndex << "retryCount:" << _waitingReadParamIndexMap[componentId][paramIndex] << ")";
-                _waitingReadParamIndexMap[componentId].remove(paramIndex);
-            } else {
-                // Retry again
-                paramsRequested = true;
-                _readParameterRaw(componentId, "", paramIndex);
-                qCDebug(ParameterManagerLog) << "Read re-request for (componentId:" << componentId << "paramIndex:" << paramIndex << "retryCount:" << _waitingReadParamIndexMap[componentId][paramIndex] << ")";
-
-                if (++batchCount > maxBatchSize) {
-                    goto Out;
-                }
-            }
-        }
-    }
+    // First check for any missing parameters from the initial index based load. These are pipelined through the read window.
+    bool paramsRequested = _fillReadWindow();
 
     if (!paramsRequested && _defaultComponentId == MAV_COMP_ID_ALL && !_waitingForDefaultComponent) {
         // Initial load is complete but we still don't have default component params. Wait one more cycle to see if the
@@ -572,19 +526,21 @@ void ParameterManager::_waitingParamTimeout(void)
     _checkInitialLoadComplete(true /* failIfNoDefaultComponent */);
 
     if (!paramsRequested) {
-        foreach(int componentId, _waitingWriteParamNameMap.keys()) {
-            foreach(const QString &paramName, _waitingWriteParamNameMap[componentId].keys()) {
+        foreach(int componentId, _parameterStores.keys()) {
+            ParameterStore& store = _parameterStores[componentId];
+            for (int slot=store.nextPending(ParameterStore::PendingWrite, 0); slot!=-1; slot=store.nextPending(ParameterStore::PendingWrite, slot + 1)) {
+                QString paramName = store.name(slot);
                 paramsRequested = true;
-                _waitingWriteParamNameMap[componentId][paramName]++;   // Bump retry count
-                if (_waitingWriteParamNameMap[componentId][paramName] <= _maxReadWriteRetry) {
-                    _writeParameterRaw(componentId, paramName, getParameter(componentId, paramName)->rawValue());
-                    qCDebug(ParameterManagerLog) << "Write resend for (componentId:" << componentId << "paramName:" << paramName << "retryCount:" << _waitingWriteParamNameMap[componentId][paramName] << ")";
+                int retryCount = store.bumpRetryCount(ParameterStore::PendingWrite, slot);
+                if (retryCount <= _maxReadWriteRetry) {
+                    _writeParameterRaw(componentId, paramName, store.fact(slot)->rawValue());
+                    qCDebug(ParameterManagerLog) << "Write resend for (componentId:" << componentId << "paramName:" << paramName << "retryCount:" << retryCount << ")";
                     if (++batchCount > maxBatchSize) {
                         goto Out;
                     }
                 } else {
                     // Exceeded max retry count, notify user
-                    _waitingWriteParamNameMap[componentId].remove(paramName);
+                    store.clearPending(ParameterStore::PendingWrite, slot);
                     qgcApp()->showMessage(tr("Parameter write failed: comp:%1 param:%2").arg(componentId).arg(paramName));
                 }
             }
@@ -592,19 +548,21 @@ void ParameterManager::_waitingParamTimeout(void)
     }
 
     if (!paramsRequested) {
-        foreach(int componentId, _waitingReadParamNameMap.keys()) {
-            foreach(const QString &paramName, _waitingReadParamNameMap[componentId].keys()) {
+        foreach(int componentId, _parameterStores.keys()) {
+            ParameterStore& store = _parameterStores[componentId];
+            for (int slot=store.nextPending(ParameterStore::PendingNameRead, 0); slot!=-1; slot=store.nextPending(ParameterStore::PendingNameRead, slot + 1)) {
+                QString paramName = store.name(slot);
                 paramsRequested = true;
-                _waitingReadParamNameMap[componentId][paramName]++;   // Bump retry count
-                if (_waitingReadParamNameMap[componentId][paramName] <= _maxReadWriteRetry) {
+                int retryCount = store.bumpRetryCount(ParameterStore::PendingNameRead, slot);
+                if (retryCount <= _maxReadWriteRetry) {
                     _readParameterRaw(componentId, paramName, -1);
-                    qCDebug(ParameterManagerLog) << "Read re-request for (componentId:" << componentId << "paramName:" << paramName << "retryCount:" << _waitingReadParamNameMap[componentId][paramName] << ")";
+                    qCDebug(ParameterManagerLog) << "Read re-request for (componentId:" << componentId << "paramName:" << paramName << "retryCount:" << retryCount << ")";
                     if (++batchCount > maxBatchSize) {
                         goto Out;
                     }
                 } else {
                     // Exceeded max retry count, notify user
-                    _waitingReadParamNameMap[componentId].remove(paramName);
+                    store.clearPending(ParameterStore::PendingNameRead, slot);
                     qgcApp()->showMessage(tr("Parameter read failed: comp:%1 param:%2").arg(componentId).arg(paramName));
                 }
             }
@@ -617,6 +575,98 @@ Out:
     }
 }
 
+/// Sends index based read requests for parameters missing from the initial load until the read window is full.
+///     @return true: there are still missing parameters from the initial load
+bool ParameterManager::_fillReadWindow(void)
+{
+    bool paramsWaiting = false;
+
+    foreach(int componentId, _parameterStores.keys()) {
+        ParameterStore&     store = _parameterStores[componentId];
+        QMap<int, qint64>&  inFlight = _indexReadsInFlight[componentId];
+
+        for (int paramIndex=store.nextPending(ParameterStore::PendingIndexRead, 0); paramIndex!=-1; paramIndex=store.nextPending(ParameterStore::PendingIndexRead, paramIndex + 1)) {
+            if (inFlight.contains(paramIndex)) {
+                paramsWaiting = true;
+                continue;
+            }
+            if (store.retryCount(ParameterStore::PendingIndexRead, paramIndex) >= _maxInitialLoadRetrySingleParam) {
+                // Give up on this index
+                _failedReadParamIndexMap[componentId] << paramIndex;
+                qCDebug(ParameterManagerLog) << "Giving up on (componentId:" << componentId << "paramIndex:" << paramIndex << "retryCount:" << store.retryCount(ParameterStore::PendingIndexRead, paramIndex) << ")";
+                store.clearPending(ParameterStore::PendingIndexRead, paramIndex);
+                continue;
+            }
+
+            paramsWaiting = true;
+            if (!_readWindow.canSend(_indexReadsInFlightCount)) {
+                // Window is full, more requests go out as replies come back
+                return true;
+            }
+
+            int retryCount = store.bumpRetryCount(ParameterStore::PendingIndexRead, paramIndex);
+            inFlight[paramIndex] = _loadTimer.elapsed();
+            _indexReadsInFlightCount++;
+            _readRequestCount++;
+            _readParameterRaw(componentId, "", paramIndex);
+            qCDebug(ParameterManagerVerboseLog) << "Read re-request for (componentId:" << componentId << "paramIndex:" << paramIndex << "retryCount:" << retryCount << "window:" << _readWindow.size() << ")";
+        }
+    }
+
+    if (_indexReadsInFlightCount && !_readWindowTimer.isActive()) {
+        _readWindowTimer.start();
+    }
+
+    return paramsWaiting;
+}
+
+/// Called when a PARAM_VALUE arrives for an index based read which is in flight
+void ParameterManager::_indexReadComplete(int componentId, int paramIndex)
+{
+    qint64 sentMSecs = _indexReadsInFlight[componentId].take(paramIndex);
+    _indexReadsInFlightCount--;
+
+    // Only sample the round trip time from requests which were sent once. A reply to a resent request can't be matched
+    // to the send which caused it.
+    double rttMSecs = -1;
+    if (_parameterStores[componentId].retryCount(ParameterStore::PendingIndexRead, paramIndex) == 1) {
+        rttMSecs = _loadTimer.elapsed() - sentMSecs;
+    }
+    _readWindow.replyReceived(rttMSecs);
+}
+
+void ParameterManager::_readWindowTimeout(void)
+{
+    qint64  nowMSecs = _loadTimer.elapsed();
+    int     timeoutMSecs = _readWindow.timeoutMSecs();
+    int     timeoutCount = 0;
+
+    foreach(int componentId, _indexReadsInFlight.keys()) {
+        QMap<int, qint64>& inFlight = _indexReadsInFlight[componentId];
+
+        foreach(int paramIndex, inFlight.keys()) {
+            if (nowMSecs - inFlight[paramIndex] >= timeoutMSecs) {
+                // Request or reply was lost. The index stays on the wait list and is resent as the window refills.
+                inFlight.remove(paramIndex);
+                _indexReadsInFlightCount--;
+                timeoutCount++;
+            }
+        }
+    }
+
+    if (timeoutCount) {
+        _readWindow.requestsTimedOut(timeoutCount);
+        qCDebug(ParameterManagerLog) << "Read window timeout window:rtt:timeout" << _readWindow.size() << _readWindow.smoothedRttMSecs() << timeoutMSecs;
+    }
+
+    _fillReadWindow();
+
+    if (_indexReadsInFlightCount == 0) {
+        _readWindowTimer.stop();
+        _checkInitialLoadComplete(false /* failIfNoDefaultComponent */);
+    }
+}
+
 void ParameterManager::_readParameterRaw(int componentId, const QString& paramName, int paramIndex)
 {
     mavlink_message_t msg;
@@ -693,19 +743,25 @@ void ParameterManager::_writeParameterRaw(int componentId, const QString& paramN
 
 void ParameterManager::_writeLocalParamCache(int vehicleId, int componentId)
 {
-    MapID2NamedParam cache_map;
-
-    foreach(int id, _mapParameterId2Name[componentId].keys()) {
-        const QString name(_mapParameterId2Name[componentId][id]);
-        const Fact *fact = _mapParameterName2Variant[componentId][name].value<Fact*>();
-        cache_map[id] = NamedParam(name, ParamTypeVal(fact->type(), fact->rawValue()));
+    QMap<int, ParameterStore>::const_iterator store = _parameterStores.constFind(componentId);
+    if (store == _parameterStores.constEnd() || store->paramCount() == 0) {
+        return;
     }
 
-    QFile cache_file(parameterCacheFile(vehicleId, componentId));
-    cache_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    // Snapshot records are looked up by index, so only a complete parameter set can be cached
+    ParameterCacheSnapshot snapshot;
+    for (int index=0; index<store->paramCount(); index++) {
+        const Fact* fact = store->fact(index);
+        if (!fact) {
+            return;
+        }
+        snapshot.append(store->name(index), _factTypeToMavType(fact->type()), fact->rawValue());
+    }
 
-    QDataStream ds(&cache_file);
-    ds << cache_map;
+    QString errorString;
+    if (!snapshot.save(parameterCacheFile(vehicleId, componentId), errorString)) {
+        qCWarning(ParameterManagerLog) << "Unable to write parameter cache" << errorString;
+    }
 }
 
 QDir ParameterManager::parameterCacheDir()
@@ -721,41 +777,19 @@ QString ParameterManager::parameterCacheFile(int vehicleId, int componentId)
 
 void ParameterManager::_tryCacheHashLoad(int vehicleId, int componentId, QVariant hash_value)
 {
-    uint32_t crc32_value = 0;
-    /* The datastructure of the cache table */
-    MapID2NamedParam cache_map;
-    QFile cache_file(parameterCacheFile(vehicleId, componentId));
-    if (!cache_file.exists()) {
+    ParameterCacheSnapshot snapshot;
+    if (!snapshot.load(parameterCacheFile(vehicleId, componentId))) {
         /* no local cache, just wait for them to come in*/
         return;
     }
-    cache_file.open(QIODevice::ReadOnly);
-
-    /* Deserialize the parameter cache table */
-    QDataStream ds(&cache_file);
-    ds >> cache_map;
-
-    /* compute the crc of the local cache to check against the remote */
-
-    foreach(int id, cache_map.keys()) {
-        const QString name(cache_map[id].first);
-        const void *vdat = cache_map[id].second.second.constData();
-        const FactMetaData::ValueType_t fact_type = static_cast<FactMetaData::ValueType_t>(cache_map[id].second.first);
-        crc32_value = QGC::crc32((const uint8_t *)qPrintable(name), name.length(),  crc32_value);
-        crc32_value = QGC::crc32((const uint8_t *)vdat, FactMetaData::typeToSize(fact_type), crc32_value);
-    }
 
+    /* the hash of the local cache is stored with it, check it against the remote */
+    quint32 crc32_value = snapshot.hash();
     if (crc32_value == hash_value.toUInt()) {
-        qCInfo(ParameterManagerLog) << "Parameters loaded from cache" << qPrintable(QFileInfo(cache_file).absoluteFilePath());
+        qCInfo(ParameterManagerLog) << "Parameters loaded from cache" << qPrintable(parameterCacheFile(vehicleId, componentId));
         /* if the two param set hashes match, just load from the disk */
-        int count = cache_map.count();
-        foreach(int id, cache_map.keys()) {
-            const QString &name = cache_map[id].first;
-            const QVariant &value = cache_map[id].second.second;
-            const FactMetaData::ValueType_t fact_type = static_cast<FactMetaData::ValueType_t>(cache_map[id].second.first);
-            const int mavType = _factTypeToMavType(fact_type);
-            _parameterUpdate(vehicleId, componentId, name, count, id, mavType, value);
-        }
+        _loadSnapshot(componentId, snapshot);
+
         // Return the hash value to notify we don't want any more updates
         mavlink_param_set_t     p;
         mavlink_param_union_t   union_value;
@@ -795,6 +829,202 @@ void ParameterManager::_tryCacheHashLoad(int vehicleId, int componentId, QVarian
     }
 }
 
+/// Loads the full parameter set for a component from the cache in a single pass
+void ParameterManager::_loadSnapshot(int componentId, const ParameterCacheSnapshot& snapshot)
+{
+    int count = snapshot.count();
+    QVector<Fact*> facts(count);
+
+    _dataMutex.lock();
+
+    if (!_parameterStores.contains(componentId)) {
+        _parameterStores[componentId].setParamCount(count);
+        _totalParamCount += count;
+    }
+    ParameterStore& store = _parameterStores[componentId];
+
+    // Everything arrives at once, so there is nothing left to wait for by index
+    store.clearAllPending(ParameterStore::PendingIndexRead);
+
+    for (int index=0; index<count; index++) {
+        QString name = snapshot.name(index);
+
+        int slot = store.slotFor(index, name);
+        Fact* fact = store.fact(slot);
+        if (!fact) {
+            fact = _createFact(componentId, slot, snapshot.mavType(index));
+        }
+        facts[index] = fact;
+
+        if (!_defaultComponentIdParam.isEmpty() && _defaultComponentIdParam == name) {
+            qCDebug(ParameterManagerLog) << "Default component id determined" << componentId;
+            _defaultComponentId = componentId;
+        }
+        if (!_versionParam.isEmpty() && _versionParam == name) {
+            _parameterSetMajorVersion = snapshot.value(index).toInt();
+        }
+    }
+
+    _prevWaitingReadParamIndexCount = _pendingCount(ParameterStore::PendingIndexRead);
+
+    _dataMutex.unlock();
+
+    for (int index=0; index<count; index++) {
+        facts[index]->_containerSetRawValue(snapshot.value(index));
+    }
+
+    if (componentId == _defaultComponentId) {
+        _addMetaDataToDefaultComponent();
+    }
+    _setupGroupMap();
+
+    _checkInitialLoadComplete(false /* failIfNoDefaultComponent */);
+}
+
+/// Starts validating the cached parameters for this vehicle by reading a sample of them by index. If there is no cache
+/// the full parameter list is requested.
+void ParameterManager::_tryCacheLookup(void)
+{
+    QDir    cacheDir = parameterCacheDir();
+    QString vehiclePrefix = QString("%1_").arg(_vehicle->id());
+
+    foreach (const QString& cacheFileName, cacheDir.entryList(QStringList(vehiclePrefix + "*"), QDir::Files)) {
+        bool ok;
+        int componentId = cacheFileName.mid(vehiclePrefix.length()).toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+
+        ParameterCacheSnapshot* snapshot = new ParameterCacheSnapshot();
+        if (snapshot->load(cacheDir.filePath(cacheFileName)) && snapshot->count()) {
+            _cacheSnapshots[componentId] = snapshot;
+        } else {
+            delete snapshot;
+        }
+    }
+
+    if (_cacheSnapshots.isEmpty()) {
+        refreshAllParameters();
+        return;
+    }
+
+    // Spread the samples across the parameter set. Every reply also carries the parameter count, which catches
+    // parameters being added or removed by a firmware update. Spread out samples mostly land on default values, so the
+    // identity and calibration params are sampled as well to tell apart airframes which share a system id.
+    foreach (int componentId, _cacheSnapshots.keys()) {
+        const ParameterCacheSnapshot* snapshot = _cacheSnapshots[componentId];
+        int count = snapshot->count();
+
+        for (int index=0; index<count; index++) {
+            if (_cacheIdentityParams.contains(snapshot->name(index))) {
+                _cacheSampleIndexMap[componentId].append(index);
+            }
+        }
+
+        for (int i=0; i<_cacheSampleCount; i++) {
+            int index = (i * (count - 1)) / (_cacheSampleCount - 1);
+            while (index < count - 1 && _isVolatileParameter(snapshot->name(index))) {
+                index++;
+            }
+            if (!_cacheSampleIndexMap[componentId].contains(index)) {
+                _cacheSampleIndexMap[componentId].append(index);
+            }
+        }
+        qCDebug(ParameterManagerLog) << "Validating parameter cache (componentId:" << componentId << "count:" << count << "samples:" << _cacheSampleIndexMap[componentId] << ")";
+    }
+
+    _loadTimer.start();
+    _cacheValidationRetryCount = 0;
+    _sendCacheSamples();
+}
+
+void ParameterManager::_sendCacheSamples(void)
+{
+    foreach (int componentId, _cacheSampleIndexMap.keys()) {
+        foreach (int paramIndex, _cacheSampleIndexMap[componentId]) {
+            _readParameterRaw(componentId, "", paramIndex);
+        }
+    }
+    _cacheValidationTimer.start();
+}
+
+void ParameterManager::_cacheValidationTimeout(void)
+{
+    if (++_cacheValidationRetryCount > _maxCacheValidationRetry) {
+        _cacheValidationFailed(QStringLiteral("no response to samples"));
+    } else {
+        _sendCacheSamples();
+    }
+}
+
+/// Called for each PARAM_VALUE while the cache is being validated
+void ParameterManager::_cacheValidationUpdate(int componentId, const QString& parameterName, int parameterCount, int parameterId, int mavType, const QVariant& value)
+{
+    if (!_cacheSampleIndexMap.contains(componentId) || !_cacheSampleIndexMap[componentId].contains(parameterId)) {
+        // Not one of the samples
+        return;
+    }
+
+    const ParameterCacheSnapshot* snapshot = _cacheSnapshots[componentId];
+    if (parameterCount != snapshot->count() ||
+            parameterName != snapshot->name(parameterId) ||
+            !snapshot->valueMatches(parameterId, (MAV_PARAM_TYPE)mavType, value)) {
+        _cacheValidationFailed(QString("sample mismatch componentId:%1 index:%2 name:%3").arg(componentId).arg(parameterId).arg(parameterName));
+        return;
+    }
+
+    _cacheSampleIndexMap[componentId].removeOne(parameterId);
+    foreach (int sampleComponentId, _cacheSampleIndexMap.keys()) {
+        if (_cacheSampleIndexMap[sampleComponentId].count()) {
+            return;
+        }
+    }
+
+    // All samples match
+    _cacheValidationTimer.stop();
+    _cacheSampleIndexMap.clear();
+    QMap<int, ParameterCacheSnapshot*> snapshots = _cacheSnapshots;
+    _cacheSnapshots.clear();
+
+    foreach (int snapshotComponentId, snapshots.keys()) {
+        qCInfo(ParameterManagerLog) << "Parameters loaded from cache" << qPrintable(parameterCacheFile(_vehicle->id(), snapshotComponentId));
+        _loadSnapshot(snapshotComponentId, *snapshots[snapshotComponentId]);
+    }
+    qDeleteAll(snapshots);
+
+    // Fail the load if the cache did not have the default component
+    _checkInitialLoadComplete(true /* failIfNoDefaultComponent */);
+
+    // Cached values for volatile parameters may be out of date
+    foreach (int snapshotComponentId, snapshots.keys()) {
+        foreach (const QString& prefix, _volatileParamPrefixes) {
+            refreshParametersPrefix(snapshotComponentId, prefix);
+        }
+    }
+}
+
+void ParameterManager::_cacheValidationFailed(const QString& reason)
+{
+    qCDebug(ParameterManagerLog) << "Parameter cache not used:" << reason;
+
+    _cacheValidationTimer.stop();
+    _cacheSampleIndexMap.clear();
+    qDeleteAll(_cacheSnapshots);
+    _cacheSnapshots.clear();
+
+    refreshAllParameters();
+}
+
+bool ParameterManager::_isVolatileParameter(const QString& name)
+{
+    foreach (const QString& prefix, _volatileParamPrefixes) {
+        if (name.startsWith(prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void ParameterManager::_saveToEEPROM(void)
 {
     if (_saveRequired) {
@@ -867,9 +1097,10 @@ void ParameterManager::writeParametersToStream(QTextStream &stream)
     stream << "#\n";
     stream << "# MAV ID  COMPONENT ID  PARAM NAME  VALUE (FLOAT)\n";
 
-    foreach (int componentId, _mapParameterName2Variant.keys()) {
-        foreach (const QString &paramName, _mapParameterName2Variant[componentId].keys()) {
-            Fact* fact = _mapParameterName2Variant[componentId][paramName].value<Fact*>();
+    foreach (int componentId, _parameterStores.keys()) {
+        const ParameterStore& store = _parameterStores[componentId];
+        foreach (const QString &paramName, store.names()) {
+            Fact* fact = store.fact(paramName);
             if (fact) {
                 stream << _vehicle->id() << "\t" << componentId << "\t" << paramName << "\t" << fact->rawValueStringFullPrecision() << "\t" << QString("%1").arg(_factTypeToMavType(fact->type())) << "\n";
             } else {
@@ -932,6 +1163,9 @@ FactMetaData::ValueType_t ParameterManager::_mavTypeToFactType(MAV_PARAM_TYPE ma
         case MAV_PARAM_TYPE_REAL32:
             return FactMetaData::valueTypeFloat;
 
+        case MAV_PARAM_TYPE_REAL64:
+            return FactMetaData::valueTypeDouble;
+
         default:
             qWarning() << "Unsupported mav param type" << mavType;
             // fall through
@@ -941,6 +1175,30 @@ FactMetaData::ValueType_t ParameterManager::_mavTypeToFactType(MAV_PARAM_TYPE ma
     }
 }
 
+/// Creates the Fact for a new parameter and adds it to the component store
+Fact* ParameterManager::_createFact(int componentId, int slot, MAV_PARAM_TYPE mavType)
+{
+    ParameterStore& store = _parameterStores[componentId];
+
+    Fact* fact = new Fact(componentId, store.name(slot), _mavTypeToFactType(mavType), this);
+    store.setFact(slot, fact);
+
+    // We need to know when the fact changes from QML so that we can send the new value to the parameter manager
+    connect(fact, &Fact::_containerRawValueChanged, this, &ParameterManager::_valueUpdated);
+
+    return fact;
+}
+
+/// @return Number of parameters waiting across all components
+int ParameterManager::_pendingCount(ParameterStore::PendingType_t type)
+{
+    int count = 0;
+    foreach (const ParameterStore& store, _parameterStores) {
+        count += store.pendingCount(type);
+    }
+    return count;
+}
+
 void ParameterManager::_restartWaitingParamTimer(void)
 {
     _waitingParamTimeoutTimer.start();
@@ -973,9 +1231,11 @@ void ParameterManager::_addMetaDataToDefaultComponent(void)
      _parameterMetaData = _vehicle->firmwarePlugin()->loadParameterMetaData(metaDataFile);
 
     // Loop over all parameters in default component adding meta data
-    QVariantMap& factMap = _mapParameterName2Variant[_defaultComponentId];
-    foreach (const QString& key, factMap.keys()) {
-        _vehicle->firmwarePlugin()->addMetaDataToFact(_parameterMetaData, factMap[key].value<Fact*>(), _vehicle->vehicleType());
+    const ParameterStore& store = _parameterStores[_defaultComponentId];
+    for (int slot=0; slot<store.slotCount(); slot++) {
+        if (store.fact(slot)) {
+            _vehicle->firmwarePlugin()->addMetaDataToFact(_parameterMetaData, store.fact(slot), _vehicle->vehicleType());
+        }
     }
 }
 
@@ -987,11 +1247,9 @@ void ParameterManager::_checkInitialLoadComplete(bool failIfNoDefaultComponent)
         return;
     }
 
-    foreach (int componentId, _waitingReadParamIndexMap.keys()) {
-        if (_waitingReadParamIndexMap[componentId].count()) {
-            // We are still waiting on some parameters, not done yet
-            return;
-        }
+    if (_pendingCount(ParameterStore::PendingIndexRead)) {
+        // We are still waiting on some parameters, not done yet
+        return;
     }
 
     if (!failIfNoDefaultComponent && _defaultComponentId == MAV_COMP_ID_ALL) {
@@ -1002,6 +1260,12 @@ void ParameterManager::_checkInitialLoadComplete(bool failIfNoDefaultComponent)
     // We aren't waiting for any more initial parameter updates, initial parameter loading is complete
     _initialLoadComplete = true;
 
+    qint64 loadMSecs = _loadTimer.elapsed();
+    _loadRate = (_totalParamCount * 1000.0) / qMax((qint64)1, loadMSecs);
+    qCDebug(ParameterManagerLog) << "Initial load complete params:msecs:params/sec" << _totalParamCount << loadMSecs << _loadRate
+                                 << "read requests:timeouts" << _readRequestCount << _readWindow.timeoutCount()
+                                 << "window:rtt" << _readWindow.size() << _readWindow.smoothedRttMSecs();
+
     // Check for index based load failures
     QString indexList;
     bool initialLoadFailures = false;
@@ -1309,8 +1573,8 @@ void ParameterManager::_loadOfflineEditingParams(void)
             _parameterSetMajorVersion = paramValue.toInt();
         }
 
-        Fact* fact = new Fact(_defaultComponentId, paramName, _mavTypeToFactType(paramType), this);
-        _mapParameterName2Variant[_defaultComponentId][paramName] = QVariant::fromValue(fact);
+        ParameterStore& store = _parameterStores[_defaultComponentId];
+        store.setFact(store.slotFor(-1, paramName), new Fact(_defaultComponentId, paramName, _mavTypeToFactType(paramType), this));
     }
 
     _addMetaDataToDefaultComponent();
@@ -1325,7 +1589,7 @@ void ParameterManager::saveToJson(int componentId, const QStringList& paramsToSa
     QStringList rgParamNames;
 
     if (componentId == MAV_COMP_ID_ALL) {
-        rgCompIds = _mapParameterName2Variant.keys();
+        rgCompIds = _parameterStores.keys();
     } else {
         rgCompIds.append(_actualComponentId(componentId));
     }
@@ -1336,7 +1600,7 @@ void ParameterManager::saveToJson(int componentId, const QStringList& paramsToSa
     for (int i=0; i<rgCompIds.count(); i++) {
         int compId = rgCompIds[i];
 
-        if (!_mapParameterName2Variant.contains(compId)) {
+        if (!_parameterStores.contains(compId)) {
             qCDebug(ParameterManagerLog) << "ParameterManager::saveToJson no params for compId" << compId;
             continue;
         }
@@ -18,9 +18,13 @@
 #include <QMutex>
 #include <QDir>
 #include <QJsonObject>
+#include <QElapsedTimer>
 
 #include "FactSystem.h"
+#include "ParameterCacheSnapshot.h"
+#include "ParameterStore.h"
 #include "MAVLinkProtocol.h"
+#include "MAVLinkRequestWindow.h"
 #include "AutoPilotPlugin.h"
 #include "QGCMAVLink.h"
 #include "Vehicle.h"
@@ -117,6 +121,13 @@ public:
 
     Vehicle* vehicle(void) { return _vehicle; }
 
+    /// Sets the maximum number of index based PARAM_REQUEST_READ requests which can be in flight at once while filling
+    /// in parameters missing from the initial load. The window adapts to loss up to this size.
+    void setMaxReadWindowSize(int maxReadWindowSize);
+
+    /// @return Throughput for the initial parameter load in params/sec, 0 if the load has not completed
+    double loadRate(void) { return _loadRate; }
+
 signals:
     void parametersReadyChanged(bool parametersReady);
     void missingParametersChanged(bool missingParameters);
@@ -137,6 +148,8 @@ protected:
     void _waitingParamTimeout(void);
     void _tryCacheLookup(void);
     void _initialRequestTimeout(void);
+    void _readWindowTimeout(void);
+    void _cacheValidationTimeout(void);
 
 private:
     static QVariant _stringToTypedVariant(const QString& string, FactMetaData::ValueType_t type, bool failOk = false);
@@ -147,6 +160,11 @@ private:
     void _writeParameterRaw(int componentId, const QString& paramName, const QVariant& value);
     void _writeLocalParamCache(int vehicleId, int componentId);
     void _tryCacheHashLoad(int vehicleId, int componentId, QVariant hash_value);
+    void _loadSnapshot(int componentId, const ParameterCacheSnapshot& snapshot);
+    void _sendCacheSamples(void);
+    void _cacheValidationUpdate(int componentId, const QString& parameterName, int parameterCount, int parameterId, int mavType, const QVariant& value);
+    void _cacheValidationFailed(const QString& reason);
+    bool _isVolatileParameter(const QString& name);
     void _addMetaDataToDefaultComponent(void);
     QString _remapParamNameToVersion(const QString& paramName);
     void _loadOfflineEditingParams(void);
@@ -155,12 +173,12 @@ private:
     FactMetaData::ValueType_t _mavTypeToFactType(MAV_PARAM_TYPE mavType);
     void _saveToEEPROM(void);
     void _checkInitialLoadComplete(bool failIfNoDefaultComponent);
+    bool _fillReadWindow(void);
+    void _indexReadComplete(int componentId, int paramIndex);
+    Fact* _createFact(int componentId, int slot, MAV_PARAM_TYPE mavType);
+    int  _pendingCount(ParameterStore::PendingType_t type);
 
-    /// First mapping is by component id
-    /// Second mapping is parameter name, to Fact* in QVariant
-    QMap<int, QVariantMap>            _mapParameterName2Variant;
-
-    QMap<int, QMap<int, QString> >    _mapParameterId2Name;
+    QMap<int, ParameterStore> _parameterStores;     ///< Key: Component id, Value: Parameters for component
     
     /// First mapping is by component id
     /// Second mapping is group name, to Fact
@@ -188,14 +206,35 @@ private:
     static const int _maxInitialLoadRetrySingleParam = 10;  ///< Maximum retries for initial index based load of a single param
     static const int _maxReadWriteRetry = 5;                ///< Maximum retries read/write
 
-    QMap<int, int>                  _paramCountMap;             ///< Key: Component id, Value: count of parameters in this component
-    QMap<int, QMap<int, int> >      _waitingReadParamIndexMap;  ///< Key: Component id, Value: Map { Key: parameter index still waiting for, Value: retry count }
-    QMap<int, QMap<QString, int> >  _waitingReadParamNameMap;   ///< Key: Component id, Value: Map { Key: parameter name still waiting for, Value: retry count }
-    QMap<int, QMap<QString, int> >  _waitingWriteParamNameMap;  ///< Key: Component id, Value: Map { Key: parameter name still waiting for, Value: retry count }
     QMap<int, QList<int> >          _failedReadParamIndexMap;   ///< Key: Component id, Value: failed parameter index
 
     int _totalParamCount;   ///< Number of parameters across all components
     
+    // Missing parameters from the initial load are re-requested by index through a window of requests which are in flight
+    // at the same time. The window grows as replies come back and halves when requests time out. The timeout tracks the
+    // measured round trip time.
+    QMap<int, QMap<int, qint64> >   _indexReadsInFlight;        ///< Key: Component id, Value: Map { Key: parameter index, Value: time request was sent }
+    int                             _indexReadsInFlightCount;
+    MAVLinkRequestWindow            _readWindow;                ///< Number of requests allowed in flight and their timeout
+    int                             _readRequestCount;          ///< Index based requests sent
+    double                          _loadRate;                  ///< Initial load params/sec
+    QElapsedTimer                   _loadTimer;
+    QTimer                          _readWindowTimer;
+
+    static const int _defaultMaxReadWindowSize = 32;
+
+    // Vehicles without a parameter hash (ArduPilot) validate the cache by reading a sample of parameters by index. If every
+    // sample matches the cached name, value and parameter count the cache is loaded instead of requesting the full list.
+    QMap<int, ParameterCacheSnapshot*>  _cacheSnapshots;            ///< Key: Component id, Value: cached parameters being validated
+    QMap<int, QList<int> >              _cacheSampleIndexMap;       ///< Key: Component id, Value: sampled indices still waiting for
+    QStringList                         _volatileParamPrefixes;     ///< Parameters which change by themselves, never used as samples
+    QStringList                         _cacheIdentityParams;       ///< Parameters which are always used as samples
+    QTimer                              _cacheValidationTimer;
+    int                                 _cacheValidationRetryCount;
+
+    static const int _cacheSampleCount =        8;
+    static const int _maxCacheValidationRetry = 2;
+    
     QTimer _initialRequestTimeoutTimer;
     QTimer _waitingParamTimeoutTimer;
     
@@ -12,6 +12,13 @@
 #include "MultiVehicleManager.h"
 #include "QGCApplication.h"
 #include "ParameterManager.h"
+#include "ParameterCacheSnapshot.h"
+#include "QGC.h"
+#include "UAS.h"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
 
 /// Test failure modes which should still lead to param load success
 void ParameterManagerTest::_noFailureWorker(MockConfiguration::FailureMode_t failureMode)
@@ -135,3 +142,260 @@ void ParameterManagerTest::_requestListMissingParamFail(void)
     // User should have been notified
     checkExpectedMessageBox();
 }
+
+/// Loads parameters from a vehicle on a link which drops and delays messages
+///     @param maxReadWindowSize Maximum number of re-requests in flight, 0 for default
+///     @param[out] loadRate Throughput for the load in params/sec
+void ParameterManagerTest::_lossyLoadWorker(int maxReadWindowSize, double& loadRate)
+{
+    Q_ASSERT(!_mockLink);
+    _mockLink = MockLink::startLossyPX4MockLink(_lossyLinkLossPercent, _lossyLinkJitterMSecs);
+
+    MultiVehicleManager* vehicleMgr = qgcApp()->toolbox()->multiVehicleManager();
+    QVERIFY(vehicleMgr);
+
+    // Wait for the Vehicle to get created
+    QSignalSpy spyVehicle(vehicleMgr, SIGNAL(activeVehicleAvailableChanged(bool)));
+    QCOMPARE(spyVehicle.wait(5000), true);
+
+    Vehicle* vehicle = vehicleMgr->activeVehicle();
+    QVERIFY(vehicle);
+
+    // Missing parameters aren't re-requested until the initial list stalls, so this is still in time
+    if (maxReadWindowSize) {
+        vehicle->parameterManager()->setMaxReadWindowSize(maxReadWindowSize);
+    }
+
+    QSignalSpy spyParamsReady(vehicleMgr, SIGNAL(parameterReadyVehicleAvailableChanged(bool)));
+    QCOMPARE(spyParamsReady.wait(60000), true);
+    QCOMPARE(vehicle->parameterManager()->missingParameters(), false);
+
+    loadRate = vehicle->parameterManager()->loadRate();
+    QVERIFY(loadRate > 0);
+
+    _disconnectMockLink();
+
+    // Wait for the Vehicle to go away so the next load starts clean
+    timer.start();
+    while (vehicleMgr->vehicles()->count() && timer.elapsed() < 5000) {
+        QTest::qWait(100);
+    }
+    QCOMPARE(vehicleMgr->vehicles()->count(), 0);
+}
+
+/// Compares loading over a lossy link with one re-request in flight at a time against the pipelined read window
+void ParameterManagerTest::_lossyLinkPipelinedLoad(void)
+{
+    UT_BENCHMARK_OPT_IN();
+
+    double stopAndWaitRate = 0;
+    double pipelinedRate = 0;
+
+    _lossyLoadWorker(1, stopAndWaitRate);
+    _lossyLoadWorker(0, pipelinedRate);
+
+    qCDebug(UnitTestBenchmarkLog) << "Lossy link load params/sec stop and wait:pipelined:speedup" << stopAndWaitRate << pipelinedRate << pipelinedRate / stopAndWaitRate;
+    QVERIFY(pipelinedRate > stopAndWaitRate);
+}
+
+void ParameterManagerTest::_cacheSnapshot(void)
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QString fileName = tempDir.path() + "/snapshot";
+
+    const int paramCount = 1000;
+
+    // Build a snapshot with a mix of types, keeping track of the PX4 style hash as we go
+    ParameterCacheSnapshot snapshot;
+    quint32 expectedHash = 0;
+    for (int i=0; i<paramCount; i++) {
+        QString name = QString("PARAM_%1").arg(i);
+        QByteArray nameBytes = name.toLocal8Bit();
+        expectedHash = QGC::crc32((const quint8*)nameBytes.constData(), nameBytes.length(), expectedHash);
+        if (i % 2) {
+            float value = i * 0.5f;
+            snapshot.append(name, MAV_PARAM_TYPE_REAL32, QVariant(value));
+            expectedHash = QGC::crc32((const quint8*)&value, sizeof(value), expectedHash);
+        } else {
+            qint32 value = -i;
+            snapshot.append(name, MAV_PARAM_TYPE_INT32, QVariant(value));
+            expectedHash = QGC::crc32((const quint8*)&value, sizeof(value), expectedHash);
+        }
+    }
+    QCOMPARE(snapshot.hash(), expectedHash);
+
+    QString errorString;
+    QVERIFY(snapshot.save(fileName, errorString));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ParameterCacheSnapshot loaded;
+    QVERIFY(loaded.load(fileName));
+    QCOMPARE(loaded.count(), paramCount);
+    QCOMPARE(loaded.hash(), expectedHash);
+    for (int i=0; i<paramCount; i++) {
+        QCOMPARE(loaded.name(i), QString("PARAM_%1").arg(i));
+        if (i % 2) {
+            QCOMPARE(loaded.mavType(i), MAV_PARAM_TYPE_REAL32);
+            QCOMPARE(loaded.value(i).toFloat(), i * 0.5f);
+            QVERIFY(loaded.valueMatches(i, MAV_PARAM_TYPE_REAL32, QVariant(i * 0.5f)));
+        } else {
+            QCOMPARE(loaded.mavType(i), MAV_PARAM_TYPE_INT32);
+            QCOMPARE(loaded.value(i).toInt(), -i);
+            QVERIFY(!loaded.valueMatches(i, MAV_PARAM_TYPE_INT32, QVariant(i + 1)));
+        }
+    }
+    qCDebug(UnitTestBenchmarkLog) << "Snapshot load and read msecs" << timer.elapsed() << "params" << paramCount;
+    loaded.clear();
+
+    // Truncated files are rejected
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 1));
+    file.close();
+    QCOMPARE(loaded.load(fileName), false);
+
+    // As are caches in the old QDataStream format
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QDataStream stream(&file);
+    stream << QMap<int, QString>();
+    file.close();
+    QCOMPARE(loaded.load(fileName), false);
+}
+
+/// Reconnecting to a known ArduPilot vehicle should validate the cache with a few samples rather than downloading
+/// every parameter again.
+void ParameterManagerTest::_apmCachedLoad(void)
+{
+    MultiVehicleManager* vehicleMgr = qgcApp()->toolbox()->multiVehicleManager();
+    QVERIFY(vehicleMgr);
+
+    // Count the PARAM_VALUE messages for each load
+    int paramValueCount = 0;
+    QMetaObject::Connection countConnection = connect(qgcApp()->toolbox()->mavlinkProtocol(), &MAVLinkProtocol::messageReceived, this, [&paramValueCount](LinkInterface*, mavlink_message_t message) {
+        if (message.msgid == MAVLINK_MSG_ID_PARAM_VALUE) {
+            paramValueCount++;
+        }
+    });
+
+    // First load downloads everything and writes the cache
+    Q_ASSERT(!_mockLink);
+    _mockLink = MockLink::startAPMArduCopterMockLink(false);
+
+    QSignalSpy spyParamsReady(vehicleMgr, SIGNAL(parameterReadyVehicleAvailableChanged(bool)));
+    QCOMPARE(spyParamsReady.wait(30000), true);
+
+    Vehicle* vehicle = vehicleMgr->activeVehicle();
+    QVERIFY(vehicle);
+    int vehicleId = vehicle->id();
+    int componentId = vehicle->defaultComponentId();
+    int fullLoadParamValueCount = paramValueCount;
+
+    QVERIFY(QFile::exists(ParameterManager::parameterCacheFile(vehicleId, componentId)));
+
+    // Writes are patched into the cache once the vehicle acks them
+    const char* writeParamName = "WPNAV_SPEED";
+    const float writeParamValue = 750;
+    Fact* writeFact = vehicle->parameterManager()->getParameter(componentId, writeParamName);
+    QVERIFY(writeFact);
+    QVERIFY(writeFact->rawValue().toFloat() != writeParamValue);
+    writeFact->setRawValue(writeParamValue);
+    bool cacheUpdated = false;
+    QElapsedTimer timer;
+    timer.start();
+    while (!cacheUpdated && timer.elapsed() < 5000) {
+        QTest::qWait(100);
+        ParameterCacheSnapshot snapshot;
+        QVERIFY(snapshot.load(ParameterManager::parameterCacheFile(vehicleId, componentId)));
+        for (int index=0; index<snapshot.count(); index++) {
+            if (snapshot.name(index) == writeParamName) {
+                cacheUpdated = snapshot.value(index).toFloat() == writeParamValue;
+            }
+        }
+    }
+    QVERIFY(cacheUpdated);
+
+    _disconnectMockLink();
+    QElapsedTimer timer;
+    timer.start();
+    while (vehicleMgr->vehicles()->count() && timer.elapsed() < 5000) {
+        QTest::qWait(100);
+    }
+    QCOMPARE(vehicleMgr->vehicles()->count(), 0);
+
+    // MockLink gives each new link the next system id, so move the cache over to make the next link look like the
+    // same vehicle reconnecting.
+    QVERIFY(QFile::copy(ParameterManager::parameterCacheFile(vehicleId, componentId), ParameterManager::parameterCacheFile(vehicleId + 1, componentId)));
+
+    paramValueCount = 0;
+    _mockLink = MockLink::startAPMArduCopterMockLink(false);
+
+    // The vehicle kept the written value over the reconnect. Nothing is requested until the vehicle is created on
+    // this thread, so it is safe to change the MockLink parameters here.
+    _mockLink->setParamValue(componentId, writeParamName, writeParamValue);
+
+    spyParamsReady.clear();
+    QCOMPARE(spyParamsReady.wait(10000), true);
+
+    vehicle = vehicleMgr->activeVehicle();
+    QVERIFY(vehicle);
+    QCOMPARE(vehicle->id(), vehicleId + 1);
+    QCOMPARE(vehicle->parameterManager()->missingParameters(), false);
+    QVERIFY(vehicle->parameterManager()->parameterExists(FactSystem::defaultComponentId, vehicle->firmwarePlugin()->getDefaultComponentIdParam()));
+
+    // Loaded from the cache with the written value, not the value from the first load
+    QCOMPARE(vehicle->parameterManager()->getParameter(componentId, writeParamName)->rawValue().toFloat(), writeParamValue);
+
+    // Only the samples and the re-reads of volatile parameters should have come over the link
+    qCDebug(UnitTestBenchmarkLog) << "PARAM_VALUE messages full load:cached load" << fullLoadParamValueCount << paramValueCount;
+    QVERIFY(paramValueCount < fullLoadParamValueCount / 4);
+
+    disconnect(countConnection);
+}
+
+/// Feeds a synthetic component with a large parameter set straight into the parameter manager, then times the lookups
+void ParameterManagerTest::_syntheticParamValueBenchmark(void)
+{
+    Q_ASSERT(!_mockLink);
+    _mockLink = MockLink::startPX4MockLink(false);
+
+    MultiVehicleManager* vehicleMgr = qgcApp()->toolbox()->multiVehicleManager();
+    QVERIFY(vehicleMgr);
+
+    QSignalSpy spyParamsReady(vehicleMgr, SIGNAL(parameterReadyVehicleAvailableChanged(bool)));
+    QCOMPARE(spyParamsReady.wait(60000), true);
+
+    Vehicle* vehicle = vehicleMgr->activeVehicle();
+    QVERIFY(vehicle);
+    ParameterManager* paramMgr = vehicle->parameterManager();
+
+    const int paramCount = 5000;
+    const int componentId = 100;
+
+    QStringList names;
+    for (int i=0; i<paramCount; i++) {
+        names << QStringLiteral("BENCH_%1").arg(i);
+    }
+
+    // Same path as PARAM_VALUE messages coming off the link, in reverse index order so nothing is appended in order
+    QElapsedTimer timer;
+    timer.start();
+    for (int i=paramCount-1; i>=0; i--) {
+        emit vehicle->uas()->parameterUpdate(vehicle->id(), componentId, names[i], paramCount, i, MAV_PARAM_TYPE_INT32, QVariant(i));
+    }
+    qint64 updateMSecs = timer.elapsed();
+
+    timer.restart();
+    for (int i=0; i<paramCount; i++) {
+        QVERIFY(paramMgr->parameterExists(componentId, names[i]));
+        QCOMPARE(paramMgr->getParameter(componentId, names[i])->rawValue().toInt(), i);
+    }
+    qint64 lookupMSecs = timer.elapsed();
+
+    QCOMPARE(paramMgr->parameterNames(componentId).count(), paramCount);
+    QCOMPARE(paramMgr->parameterExists(componentId, QStringLiteral("BENCH_%1").arg(paramCount)), false);
+
+    qCDebug(UnitTestBenchmarkLog) << "Synthetic PARAM_VALUE msecs update:lookup" << updateMSecs << lookupMSecs << "params" << paramCount;
+}
@@ -25,9 +25,17 @@ private slots:
     void _requestListNoResponse(void);
     void _requestListMissingParamSuccess(void);
     void _requestListMissingParamFail(void);
+    void _lossyLinkPipelinedLoad(void);
+    void _cacheSnapshot(void);
+    void _apmCachedLoad(void);
+    void _syntheticParamValueBenchmark(void);
 
 private:
     void _noFailureWorker(MockConfiguration::FailureMode_t failureMode);
+    void _lossyLoadWorker(int maxReadWindowSize, double& loadRate);
+
+    static const int _lossyLinkLossPercent =    10;
+    static const int _lossyLinkJitterMSecs =    100;
 };
 
 #endif
@@ -0,0 +1,212 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "ParameterStore.h"
+#include "Fact.h"
+
+#include <QHash>
+
+ParameterStore::ParameterStore(void)
+    : _paramCount(0)
+    , _factCount(0)
+{
+    for (int i=0; i<PendingTypeCount; i++) {
+        _pendingCount[i] = 0;
+    }
+}
+
+void ParameterStore::setParamCount(int paramCount)
+{
+    if (!_facts.isEmpty()) {
+        // Only sized once, when the component is first seen
+        return;
+    }
+
+    _paramCount = paramCount;
+    _facts.fill(NULL, paramCount);
+    _names.resize(paramCount);
+    for (int i=0; i<PendingTypeCount; i++) {
+        _pending[i].resize(paramCount);
+        _retryCounts[i].fill(0, paramCount);
+    }
+    _nameIndex.fill(0, _nameIndexSize(paramCount));
+
+    setAllIndexReadsPending();
+}
+
+int ParameterStore::slotFor(int index, const QString& name)
+{
+    if (index >= 0 && index < _paramCount) {
+        if (_names[index] == name) {
+            return index;
+        }
+        if (_names[index].isEmpty()) {
+            int slot = indexOf(name);
+            if (slot != -1) {
+                // Already seen without an index, keep using that slot
+                return slot;
+            }
+            _names[index] = name;
+            _insertName(index);
+            return index;
+        }
+        // Some other parameter has this index, fall back to finding it by name
+    }
+
+    int slot = indexOf(name);
+    if (slot == -1) {
+        slot = _addSlot(name);
+    }
+    return slot;
+}
+
+void ParameterStore::setFact(int slot, Fact* fact)
+{
+    if (!_facts[slot]) {
+        _factCount++;
+    }
+    _facts[slot] = fact;
+}
+
+int ParameterStore::indexOf(const QString& name) const
+{
+    if (_nameIndex.isEmpty()) {
+        return -1;
+    }
+
+    int mask = _nameIndex.count() - 1;
+    int bucket = qHash(name) & mask;
+    int entry;
+    while ((entry = _nameIndex[bucket]) != 0) {
+        if (_names[entry - 1] == name) {
+            return entry - 1;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    return -1;
+}
+
+Fact* ParameterStore::fact(const QString& name) const
+{
+    int slot = indexOf(name);
+    return slot == -1 ? NULL : _facts[slot];
+}
+
+QStringList ParameterStore::names(void) const
+{
+    QStringList names;
+
+    names.reserve(_factCount);
+    for (int slot=0; slot<_facts.count(); slot++) {
+        if (_facts[slot]) {
+            names.append(_names[slot]);
+        }
+    }
+    names.sort();
+
+    return names;
+}
+
+void ParameterStore::setPending(PendingType_t type, int slot)
+{
+    if (!_pending[type].testBit(slot)) {
+        _pending[type].setBit(slot);
+        _pendingCount[type]++;
+    }
+    _retryCounts[type][slot] = 0;
+}
+
+void ParameterStore::clearPending(PendingType_t type, int slot)
+{
+    if (_pending[type].testBit(slot)) {
+        _pending[type].clearBit(slot);
+        _pendingCount[type]--;
+    }
+}
+
+void ParameterStore::clearAllPending(PendingType_t type)
+{
+    _pending[type].fill(false);
+    _pendingCount[type] = 0;
+}
+
+void ParameterStore::setAllIndexReadsPending(void)
+{
+    for (int index=0; index<_paramCount; index++) {
+        setPending(PendingIndexRead, index);
+    }
+}
+
+int ParameterStore::nextPending(PendingType_t type, int slot) const
+{
+    if (_pendingCount[type] == 0) {
+        return -1;
+    }
+
+    const QBitArray& pending = _pending[type];
+    for (; slot<pending.count(); slot++) {
+        if (pending.testBit(slot)) {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+int ParameterStore::_addSlot(const QString& name)
+{
+    int slot = _facts.count();
+
+    _facts.append(NULL);
+    _names.append(name);
+    for (int i=0; i<PendingTypeCount; i++) {
+        _pending[i].resize(slot + 1);
+        _retryCounts[i].append(0);
+    }
+
+    if (_nameIndexSize(slot + 1) > _nameIndex.count()) {
+        _rebuildNameIndex(slot + 1);
+    } else {
+        _insertName(slot);
+    }
+
+    return slot;
+}
+
+void ParameterStore::_insertName(int slot)
+{
+    int mask = _nameIndex.count() - 1;
+    int bucket = qHash(_names[slot]) & mask;
+    while (_nameIndex[bucket] != 0) {
+        bucket = (bucket + 1) & mask;
+    }
+    _nameIndex[bucket] = slot + 1;
+}
+
+void ParameterStore::_rebuildNameIndex(int minimumSlotCount)
+{
+    _nameIndex.fill(0, _nameIndexSize(minimumSlotCount));
+    for (int slot=0; slot<_names.count(); slot++) {
+        if (!_names[slot].isEmpty()) {
+            _insertName(slot);
+        }
+    }
+}
+
+/// @return Size of the hash table for the specified number of slots. Kept at most half full so probes stay short.
+int ParameterStore::_nameIndexSize(int slotCount)
+{
+    int size = 16;
+    while (size < slotCount * 2) {
+        size <<= 1;
+    }
+    return size;
+}
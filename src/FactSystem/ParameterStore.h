@@ -0,0 +1,106 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef ParameterStore_H
+#define ParameterStore_H
+
+#include <QBitArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class Fact;
+
+/// Parameters for a single component.
+///
+/// Facts are held in a vector indexed by parameter index, with an open addressing hash table for lookups by name.
+/// Parameters the vehicle reports without a usable index (ArduPilot replies to a write or a read by name with index -1)
+/// are given slots past the end of the index range. The parameters still waiting for a read by index, a read by name or
+/// a write are tracked with bit arrays plus a retry count per slot. Everything is sized from the parameter count when the
+/// component is first seen, so filling the store allocates nothing per parameter.
+class ParameterStore
+{
+public:
+    ParameterStore(void);
+
+    typedef enum {
+        PendingIndexRead,   ///< Waiting for the initial load of the parameter by index
+        PendingNameRead,    ///< Waiting for the reply to a read by name
+        PendingWrite,       ///< Waiting for the vehicle to acknowledge a write
+        PendingTypeCount
+    } PendingType_t;
+
+    /// Sizes the store for the parameter count reported by the vehicle. Every index starts out waiting for a read.
+    void setParamCount(int paramCount);
+
+    /// @return Number of parameters reported by the vehicle
+    int paramCount(void) const { return _paramCount; }
+
+    /// @return Number of slots, which are the parameter indices followed by any parameters without an index
+    int slotCount(void) const { return _facts.count(); }
+
+    /// @return Number of slots which hold a Fact
+    int factCount(void) const { return _factCount; }
+
+    /// Finds the slot for a parameter reported by the vehicle, making one if needed
+    ///     @param index Parameter index as reported by the vehicle, -1 or out of range for none
+    ///     @return Slot for the parameter, which may not have a Fact yet
+    int slotFor(int index, const QString& name);
+
+    /// Adds the Fact for a slot returned by slotFor
+    void setFact(int slot, Fact* fact);
+
+    Fact*           fact    (int slot) const { return _facts[slot]; }
+    const QString&  name    (int slot) const { return _names[slot]; }
+
+    /// @return Slot for the named parameter, -1 if not known
+    int indexOf(const QString& name) const;
+
+    /// @return Fact for the named parameter, NULL if not known
+    Fact* fact(const QString& name) const;
+
+    bool contains(const QString& name) const { return indexOf(name) != -1; }
+
+    /// @return Names of all the parameters which have a Fact, sorted
+    QStringList names(void) const;
+
+    bool    isPending       (PendingType_t type, int slot) const { return _pending[type].testBit(slot); }
+    int     pendingCount    (PendingType_t type) const { return _pendingCount[type]; }
+    void    setPending      (PendingType_t type, int slot);     ///< Also resets the retry count
+    void    clearPending    (PendingType_t type, int slot);
+    void    clearAllPending (PendingType_t type);
+
+    /// Marks every parameter index as waiting for a read by index
+    void setAllIndexReadsPending(void);
+
+    /// @return Next pending slot at or after the specified slot, -1 if none
+    int nextPending(PendingType_t type, int slot) const;
+
+    int retryCount      (PendingType_t type, int slot) const { return _retryCounts[type][slot]; }
+    int bumpRetryCount  (PendingType_t type, int slot) { return ++_retryCounts[type][slot]; }
+
+private:
+    int     _addSlot        (const QString& name);
+    void    _insertName     (int slot);
+    void    _rebuildNameIndex(int minimumSlotCount);
+
+    static int _nameIndexSize(int slotCount);
+
+    int                 _paramCount;
+    int                 _factCount;
+    QVector<Fact*>      _facts;                             ///< By slot
+    QVector<QString>    _names;                             ///< By slot, empty until the parameter is seen
+    QVector<int>        _nameIndex;                         ///< Open addressing hash table, holds slot + 1, 0 for empty
+    QBitArray           _pending[PendingTypeCount];         ///< By slot
+    int                 _pendingCount[PendingTypeCount];
+    QVector<quint8>     _retryCounts[PendingTypeCount];     ///< By slot
+};
+
+#endif
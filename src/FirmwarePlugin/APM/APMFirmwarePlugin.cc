@@ -697,6 +697,23 @@ QObject* APMFirmwarePlugin::loadParameterMetaData(const QString& metaDataFile)
     return metaData;
 }
 
+QStringList APMFirmwarePlugin::volatileParameterPrefixes(void) const
+{
+    // Flight statistics, plus ground pressure/temperature which are calibrated and saved on each boot
+    return QStringList() << QStringLiteral("STAT_") << QStringLiteral("GND_ABS_PRESS") << QStringLiteral("GND_TEMP") << QStringLiteral("BARO");
+}
+
+QStringList APMFirmwarePlugin::cacheIdentityParameters(void) const
+{
+    // Sensor device ids and the saved accel/compass calibration differ between airframes even when every other
+    // parameter is left at its default. Gyro offsets are left out since they are re-calibrated on boot.
+    return QStringList() << QStringLiteral("COMPASS_DEV_ID") << QStringLiteral("COMPASS_DEV_ID2") << QStringLiteral("COMPASS_DEV_ID3")
+                         << QStringLiteral("COMPASS_OFS_X") << QStringLiteral("COMPASS_OFS_Y") << QStringLiteral("COMPASS_OFS_Z")
+                         << QStringLiteral("INS_ACC_ID") << QStringLiteral("INS_GYR_ID")
+                         << QStringLiteral("INS_ACCOFFS_X") << QStringLiteral("INS_ACCOFFS_Y") << QStringLiteral("INS_ACCOFFS_Z")
+                         << QStringLiteral("FRAME") << QStringLiteral("FRAME_CLASS") << QStringLiteral("FRAME_TYPE");
+}
+
 bool APMFirmwarePlugin::isGuidedMode(const Vehicle* vehicle) const
 {
     return vehicle->flightMode() == "Guided";
@@ -90,6 +90,8 @@ public:
     QString             getDefaultComponentIdParam      (void) const final { return QString("SYSID_SW_TYPE"); }
     QString             missionCommandOverrides         (MAV_TYPE vehicleType) const;
     QString             getVersionParam                 (void) final { return QStringLiteral("SYSID_SW_MREV"); }
+    QStringList         volatileParameterPrefixes       (void) const final;
+    QStringList         cacheIdentityParameters         (void) const final;
     QString             internalParameterMetaDataFile   (void) final { return QString(":/FirmwarePlugin/APM/APMParameterFactMetaData.xml"); }
     void                getParameterMetaDataVersionInfo (const QString& metaDataFile, int& majorVersion, int& minorVersion) final { APMParameterMetaData::getParameterMetaDataVersionInfo(metaDataFile, majorVersion, minorVersion); }
     QObject*            loadParameterMetaData           (const QString& metaDataFile);
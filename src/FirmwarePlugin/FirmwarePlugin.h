@@ -177,6 +177,14 @@ public:
     /// Returns the parameter which is used to identify the version number of parameter set
     virtual QString getVersionParam(void) { return QString(); }
 
+    /// Returns the prefixes for parameters which the firmware changes by itself, such as statistics or values
+    /// calibrated at boot. These are not used to validate the parameter cache and are re-read after a cached load.
+    virtual QStringList volatileParameterPrefixes(void) const { return QStringList(); }
+
+    /// Returns parameters which tell one airframe apart from another, such as sensor device ids and calibration
+    /// values. These are always part of the sample used to validate the parameter cache.
+    virtual QStringList cacheIdentityParameters(void) const { return QStringList(); }
+
     /// Returns the parameter set version info pulled from inside the meta data file. -1 if not found.
     virtual void getParameterMetaDataVersionInfo(const QString& metaDataFile, int& majorVersion, int& minorVersion);
 
@@ -571,10 +571,17 @@ void QGCApplication::saveTempFlightDataLogOnMainThread(QString tempLogfile)
                 // if file could not be copied, prompt user and ask new path
                 saveError = true;
                 QGCMessageBox::warning("File Error","Could not create file.\nPlease provide a different file name to save to.");
+            } else {
+                // Bring the time index along with the log so replay doesn't need to rebuild it. If this fails the
+                // index is simply rebuilt on first replay.
+                QString saveIndexFilename = MAVLinkTlogIndex::indexFileName(saveFilename);
+                QFile::remove(saveIndexFilename);
+                QFile::copy(MAVLinkTlogIndex::indexFileName(tempLogfile), saveIndexFilename);
             }
         }
     } while(saveError); // if the file could not be overwritten, ask for new file
     QFile::remove(tempLogfile);
+    QFile::remove(MAVLinkTlogIndex::indexFileName(tempLogfile));
 }
 #endif
 
@@ -75,6 +75,15 @@ void QGroundControlQmlGlobal::setToolbox(QGCToolbox* toolbox)
     _mavlinkLogManager      = toolbox->mavlinkLogManager();
 }
 
+MAVLinkTlogWriter* QGroundControlQmlGlobal::tlogWriter(void)
+{
+#ifndef __mobile__
+    return _toolbox->mavlinkProtocol()->tlogWriter();
+#else
+    return NULL;
+#endif
+}
+
 void QGroundControlQmlGlobal::saveGlobalSetting (const QString& key, const QString& value)
 {
     QSettings settings;
@@ -15,7 +15,10 @@ HEADERS += \
     $$PWD/QGCMapEngineData.h \
     $$PWD/QGCMapTileSet.h \
     $$PWD/QGCMapUrlEngine.h \
+    $$PWD/QGCTileCacheReader.h \
     $$PWD/QGCTileCacheWorker.h \
+    $$PWD/QGCTileDownloader.h \
+    $$PWD/QGCTileMemCache.h \
     $$PWD/QGeoCodeReplyQGC.h \
     $$PWD/QGeoCodingManagerEngineQGC.h \
     $$PWD/QGeoMapReplyQGC.h \
@@ -27,7 +30,10 @@ SOURCES += \
     $$PWD/QGCMapEngine.cpp \
     $$PWD/QGCMapTileSet.cpp \
     $$PWD/QGCMapUrlEngine.cpp \
+    $$PWD/QGCTileCacheReader.cpp \
     $$PWD/QGCTileCacheWorker.cpp \
+    $$PWD/QGCTileDownloader.cpp \
+    $$PWD/QGCTileMemCache.cpp \
     $$PWD/QGeoCodeReplyQGC.cpp \
     $$PWD/QGeoCodingManagerEngineQGC.cpp \
     $$PWD/QGeoMapReplyQGC.cpp \
@@ -17,6 +17,7 @@
  */
 
 #include <math.h>
+#include <algorithm>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QDir>
@@ -34,6 +35,16 @@ static QLocale kLocale;
 
 #define CACHE_PATH_VERSION  "300"
 
+//-- Tile keys pack (type, z, x, y) into the low 63 bits so they sort by map type, then zoom, then position
+//   and stay positive as SQLite integers. 22 bits of x and y cover zoom levels up to 22.
+
+#define TILE_KEY_TYPE_SHIFT 49
+#define TILE_KEY_Z_SHIFT    44
+#define TILE_KEY_X_SHIFT    22
+#define TILE_KEY_TYPE_MASK  0x3FFF
+#define TILE_KEY_Z_MASK     0x1F
+#define TILE_KEY_XY_MASK    0x3FFFFF
+
 struct stQGeoTileCacheQGCMapTypes {
     const char* name;
     UrlFactory::MapType type;
@@ -83,6 +94,10 @@ stQGeoTileCacheQGCMapTypes kMapBoxTypes[] = {
 static const char* kMapBoxTokenKey  = "MapBoxToken";
 static const char* kMaxDiskCacheKey = "MaxDiskCache";
 static const char* kMaxMemCacheKey  = "MaxMemoryCache";
+static const char* kCacheSyncKey    = "CacheSynchronous";
+
+//-- Both memory caches hold encoded tile images, so neither gets the whole budget
+#define HOT_MEM_CACHE_PERCENT   50
 
 //-----------------------------------------------------------------------------
 // Singleton
@@ -135,6 +150,7 @@ QGCMapEngine::QGCMapEngine()
     qRegisterMetaType<QGCTile>();
     qRegisterMetaType<QList<QGCTile*>>();
     connect(&_worker, &QGCCacheWorker::updateTotals, this, &QGCMapEngine::_updateTotals);
+    _worker.setMemCache(&_memCache);
 }
 
 //-----------------------------------------------------------------------------
@@ -200,10 +216,12 @@ QGCMapEngine::init()
     if(!_cachePath.isEmpty()) {
         _cacheFile = kDbFileName;
         _worker.setDatabaseFile(_cachePath + "/" + _cacheFile);
+        _worker.setSynchronous(getCacheSynchronous());
         qDebug() << "Map Cache in:" << _cachePath << "/" << _cacheFile;
     } else {
         qCritical() << "Could not find suitable map cache directory.";
     }
+    _memCache.setMaxBytes(hotMemCacheBytes(getMaxMemCache()));
     QGCMapTask* task = new QGCMapTask(QGCMapTask::taskInit);
     _worker.enqueueTask(task);
 }
@@ -241,42 +259,92 @@ QGCMapEngine::addTask(QGCMapTask* task)
 void
 QGCMapEngine::cacheTile(UrlFactory::MapType type, int x, int y, int z, const QByteArray& image, const QString &format, qulonglong set)
 {
-    QString hash = getTileHash(type, x, y, z);
-    cacheTile(type, hash, image, format, set);
+    cacheTile(type, getTileKey(type, x, y, z), image, format, set);
 }
 
 //-----------------------------------------------------------------------------
 void
-QGCMapEngine::cacheTile(UrlFactory::MapType type, const QString& hash, const QByteArray& image, const QString& format, qulonglong set)
+QGCMapEngine::cacheTile(UrlFactory::MapType type, quint64 key, const QByteArray& image, const QString& format, qulonglong set)
 {
-    QGCSaveTileTask* task = new QGCSaveTileTask(new QGCCacheTile(hash, image, format, type, set));
+    QGCSaveTileTask* task = new QGCSaveTileTask(new QGCCacheTile(key, image, format, type, set));
     _worker.enqueueTask(task);
 }
 
 //-----------------------------------------------------------------------------
-QString
-QGCMapEngine::getTileHash(UrlFactory::MapType type, int x, int y, int z)
+quint64
+QGCMapEngine::getTileKey(UrlFactory::MapType type, int x, int y, int z)
 {
-    return QString().sprintf("%04d%08d%08d%03d", (int)type, x, y, z);
+    return ((quint64)((int)type & TILE_KEY_TYPE_MASK) << TILE_KEY_TYPE_SHIFT) |
+           ((quint64)(z & TILE_KEY_Z_MASK)            << TILE_KEY_Z_SHIFT)    |
+           ((quint64)(x & TILE_KEY_XY_MASK)           << TILE_KEY_X_SHIFT)    |
+            (quint64)(y & TILE_KEY_XY_MASK);
 }
 
 //-----------------------------------------------------------------------------
 UrlFactory::MapType
-QGCMapEngine::hashToType(const QString& hash)
+QGCMapEngine::tileKeyToType(quint64 key)
+{
+    return (UrlFactory::MapType)((key >> TILE_KEY_TYPE_SHIFT) & TILE_KEY_TYPE_MASK);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngine::tileKeyToXYZ(quint64 key, int& x, int& y, int& z)
+{
+    x = (int)((key >> TILE_KEY_X_SHIFT) & TILE_KEY_XY_MASK);
+    y = (int)(key & TILE_KEY_XY_MASK);
+    z = (int)((key >> TILE_KEY_Z_SHIFT) & TILE_KEY_Z_MASK);
+}
+
+//-----------------------------------------------------------------------------
+//-- SQL expression computing the tile key from the given (integer) column expressions
+QString
+QGCMapEngine::getTileKeySql(const QString& type, const QString& x, const QString& y, const QString& z)
 {
-    QString type = hash.mid(0,4);
-    return (UrlFactory::MapType)type.toInt();
+    return QString("((((%1) & %5) << %6) | (((%4) & %7) << %8) | (((%2) & %9) << %10) | ((%3) & %9))")
+        .arg(type).arg(x).arg(y).arg(z)
+        .arg(TILE_KEY_TYPE_MASK).arg(TILE_KEY_TYPE_SHIFT)
+        .arg(TILE_KEY_Z_MASK).arg(TILE_KEY_Z_SHIFT)
+        .arg(TILE_KEY_XY_MASK).arg(TILE_KEY_X_SHIFT);
+}
+
+//-----------------------------------------------------------------------------
+//-- SQL expressions extracting x, y and z from the given (integer) key expression
+void
+QGCMapEngine::getTileXYZSql(const QString& key, QString& x, QString& y, QString& z)
+{
+    x = QString("(((%1) >> %2) & %3)").arg(key).arg(TILE_KEY_X_SHIFT).arg(TILE_KEY_XY_MASK);
+    y = QString("((%1) & %2)").arg(key).arg(TILE_KEY_XY_MASK);
+    z = QString("(((%1) >> %2) & %3)").arg(key).arg(TILE_KEY_Z_SHIFT).arg(TILE_KEY_Z_MASK);
 }
 
 //-----------------------------------------------------------------------------
 QGCFetchTileTask*
-QGCMapEngine::createFetchTileTask(UrlFactory::MapType type, int x, int y, int z)
+QGCMapEngine::createFetchTileTask(quint64 key)
 {
-    QString hash = getTileHash(type, x, y, z);
-    QGCFetchTileTask* task = new QGCFetchTileTask(hash);
+    QGCFetchTileTask* task = new QGCFetchTileTask(key);
     return task;
 }
 
+//-----------------------------------------------------------------------------
+bool
+QGCMapEngine::fetchMemTile(quint64 key, QByteArray& image, QString& format)
+{
+    if(_memCache.find(key, image, format)) {
+        //-- Keep the tile fresh on disk too so it isn't pruned while in use
+        _worker.touchTile(key);
+        return true;
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngine::cacheMemTile(quint64 key, const QByteArray& image, const QString& format)
+{
+    _memCache.insert(key, image, format);
+}
+
 //-----------------------------------------------------------------------------
 QGCTileSet
 QGCMapEngine::getTileCount(int zoom, double topleftLon, double topleftLat, double bottomRightLon, double bottomRightLat, UrlFactory::MapType mapType)
@@ -293,6 +361,115 @@ QGCMapEngine::getTileCount(int zoom, double topleftLon, double topleftLat, doubl
     return set;
 }
 
+//-----------------------------------------------------------------------------
+QGCTileSet
+QGCMapEngine::getTileCount(int zoom, const QList<QGeoCoordinate>& polygon, UrlFactory::MapType mapType)
+{
+    QGCTileSet set;
+    QVector<QGCTileRun> runs = getTileRuns(zoom, polygon);
+    for(int i = 0; i < runs.count(); i++) {
+        if(!i || runs[i].y0 < set.tileY0) set.tileY0 = runs[i].y0;
+        if(!i || runs[i].y1 > set.tileY1) set.tileY1 = runs[i].y1;
+        set.tileCount += (quint64)(runs[i].y1 - runs[i].y0 + 1);
+    }
+    if(!runs.isEmpty()) {
+        set.tileX0 = runs.first().x;
+        set.tileX1 = runs.last().x;
+    }
+    set.tileSize = UrlFactory::averageSizeForType(mapType) * set.tileCount;
+    return set;
+}
+
+//-----------------------------------------------------------------------------
+static bool
+_runStartsAbove(const QGCTileRun& a, const QGCTileRun& b)
+{
+    return a.y0 < b.y0;
+}
+
+//-----------------------------------------------------------------------------
+QVector<QGCTileRun>
+QGCMapEngine::getTileRuns(int zoom, const QList<QGeoCoordinate>& polygon)
+{
+    //-- Tiles the polygon covers, as runs down each column ordered by x then y (tile key order).
+    //   Scanline rasterization in tile space: within one column the polygon covers the rows spanned by
+    //   the pieces of its edges inside the column plus the spans inside the polygon along the column's
+    //   center line (even-odd rule). Together those are exactly the rows the polygon reaches.
+    QVector<QGCTileRun> runs;
+    if(polygon.count() < 3) {
+        return runs;
+    }
+    if(zoom <  1) zoom = 1;
+    if(zoom > MAX_MAP_ZOOM) zoom = MAX_MAP_ZOOM;
+    double n = pow(2.0, zoom);
+    int tileMax = (int)n - 1;
+    QVector<double> px(polygon.count());
+    QVector<double> py(polygon.count());
+    double minX = n;
+    double maxX = 0.0;
+    for(int i = 0; i < polygon.count(); i++) {
+        //-- Web Mercator stops at about 85.0511 degrees
+        double lat = qBound(-85.0511, polygon[i].latitude(), 85.0511) * M_PI / 180.0;
+        px[i] = qBound(0.0, (polygon[i].longitude() + 180.0) / 360.0 * n, n);
+        py[i] = qBound(0.0, (1.0 - log(tan(lat) + 1.0 / cos(lat)) / M_PI) / 2.0 * n, n);
+        minX = qMin(minX, px[i]);
+        maxX = qMax(maxX, px[i]);
+    }
+    int x0 = qBound(0, (int)floor(minX), tileMax);
+    int x1 = qBound(x0, (int)ceil(maxX) - 1, tileMax);
+    QVector<double> spans;      //-- Pairs of y (top, bottom)
+    QVector<double> crossings;
+    QVector<QGCTileRun> rows;
+    for(int x = x0; x <= x1; x++) {
+        double left  = x;
+        double right = x + 1.0;
+        double mid   = x + 0.5;
+        spans.clear();
+        crossings.clear();
+        for(int i = 0; i < px.count(); i++) {
+            int j = (i + 1) % px.count();
+            double ax = px[i], ay = py[i], bx = px[j], by = py[j];
+            if(ax == bx) {
+                //-- Vertical edges on a column boundary belong to neither column
+                if(ax > left && ax < right) {
+                    spans << qMin(ay, by) << qMax(ay, by);
+                }
+                continue;
+            }
+            double lo = qMax(qMin(ax, bx), left);
+            double hi = qMin(qMax(ax, bx), right);
+            if(lo < hi) {
+                double ylo = ay + (lo - ax) * (by - ay) / (bx - ax);
+                double yhi = ay + (hi - ax) * (by - ay) / (bx - ax);
+                spans << qMin(ylo, yhi) << qMax(ylo, yhi);
+            }
+            if((ax <= mid) != (bx <= mid)) {
+                crossings << ay + (mid - ax) * (by - ay) / (bx - ax);
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for(int i = 0; i + 1 < crossings.count(); i += 2) {
+            spans << crossings[i] << crossings[i + 1];
+        }
+        //-- Rows the spans touch, merged into runs. A span ending exactly on a row boundary stops at the row above.
+        rows.clear();
+        for(int i = 0; i + 1 < spans.count(); i += 2) {
+            int y0 = qBound(0, (int)floor(spans[i]), tileMax);
+            int y1 = qBound(y0, (int)ceil(spans[i + 1]) - 1, tileMax);
+            rows.append(QGCTileRun(x, y0, y1));
+        }
+        std::sort(rows.begin(), rows.end(), _runStartsAbove);
+        for(int i = 0; i < rows.count(); i++) {
+            if(i && rows[i].y0 <= runs.last().y1 + 1) {
+                runs.last().y1 = qMax(runs.last().y1, rows[i].y1);
+            } else {
+                runs.append(rows[i]);
+            }
+        }
+    }
+    return runs;
+}
+
 //-----------------------------------------------------------------------------
 int
 QGCMapEngine::long2tileX(double lon, int z)
@@ -307,6 +484,23 @@ QGCMapEngine::lat2tileY(double lat, int z)
     return (int)(floor((1.0 - log( tan(lat * M_PI/180.0) + 1.0 / cos(lat * M_PI/180.0)) / M_PI) / 2.0 * pow(2.0, z)));
 }
 
+//-----------------------------------------------------------------------------
+//-- Longitude of the west edge of the tile column
+double
+QGCMapEngine::tileX2long(int x, int z)
+{
+    return x / pow(2.0, z) * 360.0 - 180.0;
+}
+
+//-----------------------------------------------------------------------------
+//-- Latitude of the north edge of the tile row
+double
+QGCMapEngine::tileY2lat(int y, int z)
+{
+    double n = M_PI - 2.0 * M_PI * y / pow(2.0, z);
+    return 180.0 / M_PI * atan(0.5 * (exp(n) - exp(-n)));
+}
+
 //-----------------------------------------------------------------------------
 UrlFactory::MapType
 QGCMapEngine::getTypeFromName(const QString& name)
@@ -323,6 +517,22 @@ QGCMapEngine::getTypeFromName(const QString& name)
     return UrlFactory::Invalid;
 }
 
+//-----------------------------------------------------------------------------
+QString
+QGCMapEngine::getMapName(UrlFactory::MapType type)
+{
+    size_t i;
+    for(i = 0; i < NUM_MAPS; i++) {
+        if(kMapTypes[i].type == type)
+            return kMapTypes[i].name;
+    }
+    for(i = 0; i < NUM_MAPBOXMAPS; i++) {
+        if(kMapBoxTypes[i].type == type)
+            return kMapBoxTypes[i].name;
+    }
+    return QString();
+}
+
 //-----------------------------------------------------------------------------
 QStringList
 QGCMapEngine::getMapNameList()
@@ -407,6 +617,39 @@ QGCMapEngine::setMaxMemCache(quint32 size)
     QSettings settings;
     settings.setValue(kMaxMemCacheKey, size);
     _maxMemCache = size;
+    _memCache.setMaxBytes(hotMemCacheBytes(size));
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCMapEngine::hotMemCacheBytes(quint32 maxMemCache)
+{
+    return (quint64)maxMemCache * 1024 * 1024 * HOT_MEM_CACHE_PERCENT / 100;
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCMapEngine::qtMemCacheBytes(quint32 maxMemCache)
+{
+    return (quint64)maxMemCache * 1024 * 1024 - hotMemCacheBytes(maxMemCache);
+}
+
+//-----------------------------------------------------------------------------
+int
+QGCMapEngine::getCacheSynchronous()
+{
+    QSettings settings;
+    return settings.value(kCacheSyncKey, (int)QGCCacheWorker::SyncNormal).toInt();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngine::setCacheSynchronous(int synchronous)
+{
+    //-- Takes effect the next time the cache database is opened
+    QSettings settings;
+    settings.setValue(kCacheSyncKey, synchronous);
+    _worker.setSynchronous(synchronous);
 }
 
 //-----------------------------------------------------------------------------
@@ -483,5 +726,13 @@ QGCCreateTileSetTask::~QGCCreateTileSetTask()
         delete _tileSet;
 }
 
+//-----------------------------------------------------------------------------
+QGCImportTileTask::~QGCImportTileTask()
+{
+    //-- If not sent out, delete it
+    if(!_imported && _tileSet)
+        delete _tileSet;
+}
+
 // Resolution math: https://wiki.openstreetmap.org/wiki/Slippy_map_tilenames#Resolution_and_Scale
 
@@ -20,10 +20,13 @@
 #define QGC_MAP_ENGINE_H
 
 #include <QString>
+#include <QVector>
+#include <QGeoCoordinate>
 
 #include "QGCMapUrlEngine.h"
 #include "QGCMapEngineData.h"
 #include "QGCTileCacheWorker.h"
+#include "QGCTileMemCache.h"
 
 //-----------------------------------------------------------------------------
 class QGCTileSet
@@ -72,18 +75,25 @@ public:
     void                        init                ();
     void                        addTask             (QGCMapTask *task);
     void                        cacheTile           (UrlFactory::MapType type, int x, int y, int z, const QByteArray& image, const QString& format, qulonglong set = UINT64_MAX);
-    void                        cacheTile           (UrlFactory::MapType type, const QString& hash, const QByteArray& image, const QString& format, qulonglong set = UINT64_MAX);
-    QGCFetchTileTask*           createFetchTileTask (UrlFactory::MapType type, int x, int y, int z);
+    void                        cacheTile           (UrlFactory::MapType type, quint64 key, const QByteArray& image, const QString& format, qulonglong set = UINT64_MAX);
+    QGCFetchTileTask*           createFetchTileTask (quint64 key);
+    bool                        fetchMemTile        (quint64 key, QByteArray& image, QString& format);
+    void                        cacheMemTile        (quint64 key, const QByteArray& image, const QString& format);
+    QGCTileMemCache*            memCache            () { return &_memCache; }
     QStringList                 getMapNameList      ();
     const QString               userAgent           () { return _userAgent; }
     void                        setUserAgent        (const QString& ua) { _userAgent = ua; }
-    UrlFactory::MapType         hashToType          (const QString& hash);
     QString                     getMapBoxToken      ();
     void                        setMapBoxToken      (const QString& token);
     quint32                     getMaxDiskCache     ();
     void                        setMaxDiskCache     (quint32 size);
     quint32                     getMaxMemCache      ();
     void                        setMaxMemCache      (quint32 size);
+    //-- The memory cache setting (MB) is split between the hot tile cache and QtLocation's own tile cache
+    static quint64              hotMemCacheBytes    (quint32 maxMemCache);
+    static quint64              qtMemCacheBytes     (quint32 maxMemCache);
+    int                         getCacheSynchronous ();
+    void                        setCacheSynchronous (int synchronous);
     const QString               getCachePath        () { return _cachePath; }
     const QString               getCacheFilename    () { return _cacheFile; }
     bool                        wasCacheReset       () { return _cacheWasReset; }
@@ -92,10 +102,19 @@ public:
 
     //-- Tile Math
     static QGCTileSet           getTileCount        (int zoom, double topleftLon, double topleftLat, double bottomRightLon, double bottomRightLat, UrlFactory::MapType mapType);
+    static QGCTileSet           getTileCount        (int zoom, const QList<QGeoCoordinate>& polygon, UrlFactory::MapType mapType);
+    static QVector<QGCTileRun>  getTileRuns         (int zoom, const QList<QGeoCoordinate>& polygon);
     static int                  long2tileX          (double lon, int z);
     static int                  lat2tileY           (double lat, int z);
-    static QString              getTileHash         (UrlFactory::MapType type, int x, int y, int z);
+    static double               tileX2long          (int x, int z);
+    static double               tileY2lat           (int y, int z);
+    static quint64              getTileKey          (UrlFactory::MapType type, int x, int y, int z);
+    static UrlFactory::MapType  tileKeyToType       (quint64 key);
+    static void                 tileKeyToXYZ        (quint64 key, int& x, int& y, int& z);
+    static QString              getTileKeySql       (const QString& type, const QString& x, const QString& y, const QString& z);
+    static void                 getTileXYZSql       (const QString& key, QString& x, QString& y, QString& z);
     static UrlFactory::MapType  getTypeFromName     (const QString &name);
+    static QString              getMapName          (UrlFactory::MapType type);
     static QString              bigSizeToString     (quint64 size);
     static QString              numberToString      (quint64 number);
     static int                  concurrentDownloads (UrlFactory::MapType type);
@@ -114,6 +133,7 @@ private:
 
 private:
     QGCCacheWorker          _worker;
+    QGCTileMemCache         _memCache;
     QString                 _cachePath;
     QString                 _cacheFile;
     QString                 _mapBoxToken;
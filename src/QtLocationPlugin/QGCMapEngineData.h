@@ -37,6 +37,7 @@ public:
         , _y(0)
         , _z(0)
         , _set(UINT64_MAX)
+        , _key(0)
         , _type(UrlFactory::Invalid)
     {
     }
@@ -52,14 +53,14 @@ public:
     int                 y           () const { return _y; }
     int                 z           () const { return _z; }
     qulonglong          set         () const { return _set;  }
-    const QString       hash        () const { return _hash; }
+    quint64             key         () const { return _key; }
     UrlFactory::MapType type        () const { return _type; }
 
     void                setX        (int x) { _x = x; }
     void                setY        (int y) { _y = y; }
     void                setZ        (int z) { _z = z; }
     void                setTileSet  (qulonglong set) { _set = set;  }
-    void                setHash     (const QString& hash) { _hash = hash; }
+    void                setKey      (quint64 key) { _key = key; }
     void                setType     (UrlFactory::MapType type) { _type = type; }
 
 private:
@@ -67,36 +68,53 @@ private:
     int         _y;
     int         _z;
     qulonglong  _set;
-    QString     _hash;
+    quint64     _key;
     UrlFactory::MapType _type;
 };
 
+//-----------------------------------------------------------------------------
+//-- Tiles y0 through y1 of tile column x
+class QGCTileRun
+{
+public:
+    QGCTileRun(int x_ = 0, int y0_ = 0, int y1_ = 0)
+        : x(x_)
+        , y0(y0_)
+        , y1(y1_)
+    {
+    }
+
+    int         x;
+    int         y0;
+    int         y1;
+};
+
 //-----------------------------------------------------------------------------
 class QGCCacheTile : public QObject
 {
     Q_OBJECT
 public:
-    QGCCacheTile    (const QString hash, const QByteArray img, const QString format, UrlFactory::MapType type, qulonglong set = UINT64_MAX)
+    QGCCacheTile    (quint64 key, const QByteArray img, const QString format, UrlFactory::MapType type, qulonglong set = UINT64_MAX)
         : _set(set)
-        , _hash(hash)
+        , _key(key)
         , _img(img)
         , _format(format)
         , _type(type)
     {
     }
-    QGCCacheTile    (const QString hash, qulonglong set)
+    QGCCacheTile    (quint64 key, qulonglong set)
         : _set(set)
-        , _hash(hash)
+        , _key(key)
     {
     }
     qulonglong          set     () { return _set;   }
-    QString             hash    () { return _hash;  }
+    quint64             key     () { return _key;   }
     QByteArray          img     () { return _img;   }
     QString             format  () { return _format;}
     UrlFactory::MapType type    () { return _type; }
 private:
     qulonglong  _set;
-    QString     _hash;
+    quint64     _key;
     QByteArray  _img;
     QString     _format;
     UrlFactory::MapType _type;
@@ -118,7 +136,9 @@ public:
         taskUpdateTileDownloadState,
         taskDeleteTileSet,
         taskPruneCache,
-        taskReset
+        taskReset,
+        taskExportTileSet,
+        taskImportTileSet
     };
 
     QGCMapTask(TaskType type)
@@ -194,9 +214,9 @@ class QGCFetchTileTask : public QGCMapTask
 {
     Q_OBJECT
 public:
-    QGCFetchTileTask(const QString hash)
+    QGCFetchTileTask(quint64 key)
         : QGCMapTask(QGCMapTask::taskFetchTile)
-        , _hash(hash)
+        , _key(key)
     {}
 
     ~QGCFetchTileTask()
@@ -208,13 +228,13 @@ public:
         emit tileFetched(tile);
     }
 
-    QString         hash() { return _hash; }
+    quint64         key() { return _key; }
 
 signals:
     void            tileFetched     (QGCCacheTile* tile);
 
 private:
-    QString         _hash;
+    quint64         _key;
 };
 
 //-----------------------------------------------------------------------------
@@ -253,13 +273,14 @@ public:
     qulonglong  setID() { return _setID; }
     int         count() { return _count; }
 
-    void setTileListFetched(QList<QGCTile*> tiles)
+    //-- Also reports the tiles which joined the set because they were already cached
+    void setTileListFetched(QList<QGCTile*> tiles, quint32 cachedCount, quint64 cachedSize)
     {
-        emit tileListFetched(tiles);
+        emit tileListFetched(tiles, cachedCount, cachedSize);
     }
 
 signals:
-    void            tileListFetched  (QList<QGCTile*> tiles);
+    void            tileListFetched  (QList<QGCTile*> tiles, quint32 cachedCount, quint64 cachedSize);
 
 private:
     qulonglong  _setID;
@@ -271,21 +292,22 @@ class QGCUpdateTileDownloadStateTask : public QGCMapTask
 {
     Q_OBJECT
 public:
-    QGCUpdateTileDownloadStateTask(qulonglong setID, QGCTile::TyleState state, const QString& hash)
+    //-- A key of UINT64_MAX updates every tile in the set
+    QGCUpdateTileDownloadStateTask(qulonglong setID, QGCTile::TyleState state, quint64 key)
         : QGCMapTask(QGCMapTask::taskUpdateTileDownloadState)
         , _setID(setID)
         , _state(state)
-        , _hash(hash)
+        , _key(key)
     {}
 
-    QString             hash    () { return _hash; }
+    quint64             key     () { return _key; }
     qulonglong          setID   () { return _setID; }
     QGCTile::TyleState  state   () { return _state; }
 
 private:
     qulonglong          _setID;
     QGCTile::TyleState  _state;
-    QString             _hash;
+    quint64             _key;
 };
 
 //-----------------------------------------------------------------------------
@@ -354,5 +376,73 @@ signals:
     void resetCompleted();
 };
 
+//-----------------------------------------------------------------------------
+//-- Writes the tiles of a map type to an MBTiles file, either those of one set or all cached ones (setID UINT64_MAX)
+class QGCExportTileTask : public QGCMapTask
+{
+    Q_OBJECT
+public:
+    QGCExportTileTask(qulonglong setID, UrlFactory::MapType mapType, const QString& name, const QString& path)
+        : QGCMapTask(QGCMapTask::taskExportTileSet)
+        , _setID(setID)
+        , _mapType(mapType)
+        , _name(name)
+        , _path(path)
+    {}
+
+    qulonglong          setID   () { return _setID; }
+    UrlFactory::MapType mapType () { return _mapType; }
+    const QString&      name    () { return _name; }
+    const QString&      path    () { return _path; }
+
+    void setExported(quint32 count)
+    {
+        emit exported(count);
+    }
+
+signals:
+    void exported(quint32 count);
+
+private:
+    qulonglong          _setID;
+    UrlFactory::MapType _mapType;
+    QString             _name;
+    QString             _path;
+};
+
+//-----------------------------------------------------------------------------
+//-- Creates a tile set holding the tiles of an MBTiles file
+class QGCImportTileTask : public QGCMapTask
+{
+    Q_OBJECT
+public:
+    QGCImportTileTask(QGCCachedTileSet* tileSet, const QString& path)
+        : QGCMapTask(QGCMapTask::taskImportTileSet)
+        , _tileSet(tileSet)
+        , _path(path)
+        , _imported(false)
+    {}
+
+    ~QGCImportTileTask();
+
+    QGCCachedTileSet*   tileSet () { return _tileSet; }
+    const QString&      path    () { return _path; }
+
+    void setTileSetImported()
+    {
+        //-- Flag as imported. Signalee wll maintain it.
+        _imported = true;
+        emit tileSetImported(_tileSet);
+    }
+
+signals:
+    void tileSetImported(QGCCachedTileSet* tileSet);
+
+private:
+    QGCCachedTileSet*   _tileSet;
+    QString             _path;
+    bool                _imported;
+};
+
 
 #endif // QGC_MAP_ENGINE_DATA_H
@@ -48,6 +48,7 @@ QGCCachedTileSet::QGCCachedTileSet(const QString& name)
     , _id(0)
     , _type(UrlFactory::Invalid)
     , _networkManager(NULL)
+    , _downloader(NULL)
     , _errorCount(0)
     , _noMoreTiles(false)
     , _batchRequested(false)
@@ -59,6 +60,9 @@ QGCCachedTileSet::QGCCachedTileSet(const QString& name)
 //-----------------------------------------------------------------------------
 QGCCachedTileSet::~QGCCachedTileSet()
 {
+    if(_downloader) {
+        delete _downloader;
+    }
     if(_networkManager) {
         delete _networkManager;
     }
@@ -71,6 +75,13 @@ QGCCachedTileSet::errorCountStr()
     return QGCMapEngine::numberToString(_errorCount);
 }
 
+//-----------------------------------------------------------------------------
+QString
+QGCCachedTileSet::downloadRateStr()
+{
+    return QString("%1 tiles/s, %2/s").arg(tilesPerSecond(), 0, 'f', 1).arg(QGCMapEngine::bigSizeToString((quint64)bytesPerSecond()));
+}
+
 //-----------------------------------------------------------------------------
 QString
 QGCCachedTileSet::totalTileCountStr()
@@ -153,7 +164,7 @@ void
 QGCCachedTileSet::resumeDownloadTask()
 {
     //-- Reset and download error flag (for all tiles)
-    QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StatePending, "*");
+    QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StatePending, UINT64_MAX);
     getQGCMapEngine()->addTask(task);
     //-- Start download
     createDownloadTask();
@@ -167,28 +178,53 @@ QGCCachedTileSet::cancelDownloadTask()
         _downloading = false;
         emit downloadingChanged();
     }
+    //-- Tiles already handed out stay marked as downloading until the download is resumed
+    if(_downloader) {
+        _downloader->cancel();
+        emit downloadRateChanged();
+    }
 }
 
 //-----------------------------------------------------------------------------
 void
-QGCCachedTileSet::_tileListFetched(QList<QGCTile *> tiles)
+QGCCachedTileSet::_tileListFetched(QList<QGCTile *> tiles, quint32 cachedCount, quint64 cachedSize)
 {
     _batchRequested = false;
+    //-- Tiles already in the cache were added to the set without being downloaded
+    if(cachedCount) {
+        _savedTileCount += cachedCount;
+        _savedTileSize  += cachedSize;
+        emit savedTileCountChanged();
+        emit savedTileSizeChanged();
+    }
+    //-- Canceled while the batch was being fetched
+    if(!_downloading) {
+        qDeleteAll(tiles);
+        return;
+    }
     //-- Done?
     if(tiles.size() < TILE_BATCH_SIZE) {
         _noMoreTiles = true;
     }
-    if(!tiles.size()) {
-        _doneWithDownload();
-        return;
-    }
-    //-- If this is the first time, create Network Manager
+    //-- If this is the first time, create Network Manager and downloader
     if (!_networkManager) {
         _networkManager = new QNetworkAccessManager(this);
     }
-    //-- Add tiles to the list
-    _tilesToDownload += tiles;
-    //-- Kick downloads
+    if (!_downloader) {
+        _downloader = new QGCTileDownloader(_networkManager);
+        _downloader->setInitialConcurrency(QGCMapEngine::concurrentDownloads(_type));
+        _downloader->setMaxConcurrency(QGCMapEngine::concurrentDownloads(_type) * 2);
+        connect(_downloader, &QGCTileDownloader::tileDownloaded, this, &QGCCachedTileSet::_tileDownloaded);
+        connect(_downloader, &QGCTileDownloader::tileFailed, this, &QGCCachedTileSet::_tileFailed);
+        connect(_downloader, &QGCTileDownloader::rateChanged, this, &QGCCachedTileSet::downloadRateChanged);
+    }
+    //-- Hand the tiles to the downloader, it requests the lowest zoom levels first
+    for(int i = 0; i < tiles.size(); i++) {
+        QGCTile* tile = tiles[i];
+        QNetworkRequest request = getQGCMapEngine()->urlFactory()->getTileURL(tile->type(), tile->x(), tile->y(), tile->z(), _networkManager);
+        _downloader->addTile(tile->key(), request);
+        delete tile;
+    }
     _prepareDownload();
 }
 
@@ -215,7 +251,7 @@ void QGCCachedTileSet::_doneWithDownload()
 //-----------------------------------------------------------------------------
 void QGCCachedTileSet::_prepareDownload()
 {
-    if(!_tilesToDownload.count()) {
+    if(!_downloader || (!_downloader->queuedCount() && !_downloader->inFlightCount())) {
         //-- Are we done?
         if(_noMoreTiles) {
             _doneWithDownload();
@@ -225,113 +261,57 @@ void QGCCachedTileSet::_prepareDownload()
         }
         return;
     }
-    //-- Prepare queue (QNetworkAccessManager has a limit for concurrent downloads)
-    for(int i = _replies.count(); i < QGCMapEngine::concurrentDownloads(_type); i++) {
-        if(_tilesToDownload.count()) {
-            QGCTile* tile = _tilesToDownload.first();
-            _tilesToDownload.removeFirst();
-            QNetworkRequest request = getQGCMapEngine()->urlFactory()->getTileURL(tile->type(), tile->x(), tile->y(), tile->z(), _networkManager);
-            request.setAttribute(QNetworkRequest::User, tile->hash());
-            QNetworkReply* reply = _networkManager->get(request);
-            reply->setParent(0);
-            connect(reply, &QNetworkReply::finished, this, &QGCCachedTileSet::_networkReplyFinished);
-            connect(reply, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this, &QGCCachedTileSet::_networkReplyError);
-            _replies.insert(tile->hash(), reply);
-            delete tile;
-            //-- Refill queue if running low
-            if(!_batchRequested && !_noMoreTiles && _tilesToDownload.count() < (QGCMapEngine::concurrentDownloads(_type) * 10)) {
-                //-- Request new batch of tiles
-                createDownloadTask();
-            }
-        }
+    //-- Refill queue if running low
+    if(!_batchRequested && !_noMoreTiles && _downloader->queuedCount() < (QGCMapEngine::concurrentDownloads(_type) * 10)) {
+        //-- Request new batch of tiles
+        createDownloadTask();
     }
 }
 
 //-----------------------------------------------------------------------------
 void
-QGCCachedTileSet::_networkReplyFinished()
+QGCCachedTileSet::_tileDownloaded(quint64 key, QByteArray image)
 {
-    //-- Figure out which reply this is
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(QObject::sender());
-    if(!reply) {
-        qWarning() << "QGCMapEngineManager::networkReplyFinished() NULL Reply";
+    qCDebug(QGCCachedTileSetLog) << "Tile fetched" << key;
+    UrlFactory::MapType type = QGCMapEngine::tileKeyToType(key);
+    QString format = getQGCMapEngine()->urlFactory()->getImageFormat(type, image);
+    if(format.isEmpty()) {
+        _tileFailed(key, "Not an image");
         return;
     }
-    //-- Get tile hash
-    const QString hash = reply->request().attribute(QNetworkRequest::User).toString();
-    if(!hash.isEmpty()) {
-        if(_replies.contains(hash)) {
-            _replies.remove(hash);
-        } else {
-            qWarning() << "QGCMapEngineManager::networkReplyFinished() Reply not in list: " << hash;
-        }
-        if (reply->error() != QNetworkReply::NoError) {
-            qWarning() << "QGCMapEngineManager::networkReplyFinished() Error:" << reply->errorString();
-            return;
-        }
-        qCDebug(QGCCachedTileSetLog) << "Tile fetched" << hash;
-        QByteArray image = reply->readAll();
-        UrlFactory::MapType type = getQGCMapEngine()->hashToType(hash);
-        QString format = getQGCMapEngine()->urlFactory()->getImageFormat(type, image);
-        if(!format.isEmpty()) {
-            //-- Cache tile
-            getQGCMapEngine()->cacheTile(type, hash, image, format, _id);
-            QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StateComplete, hash);
-            getQGCMapEngine()->addTask(task);
-            //-- Updated cached (downloaded) data
-            _savedTileSize += image.size();
-            _savedTileCount++;
-            emit savedTileSizeChanged();
-            emit savedTileCountChanged();
-            //-- Update estimate
-            if(_savedTileCount % 10 == 0) {
-                quint32 avg = _savedTileSize / _savedTileCount;
-                _totalTileSize  = avg * _totalTileCount;
-                _uniqueTileSize = avg * _uniqueTileCount;
-                emit totalTilesSizeChanged();
-                emit uniqueTileSizeChanged();
-            }
-        }
-        //-- Setup a new download
-        _prepareDownload();
-    } else {
-        qWarning() << "QGCMapEngineManager::networkReplyFinished() Empty Hash";
+    //-- Cache tile
+    getQGCMapEngine()->cacheTile(type, key, image, format, _id);
+    QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StateComplete, key);
+    getQGCMapEngine()->addTask(task);
+    //-- Updated cached (downloaded) data
+    _savedTileSize += image.size();
+    _savedTileCount++;
+    emit savedTileSizeChanged();
+    emit savedTileCountChanged();
+    //-- Update estimate
+    if(_savedTileCount % 10 == 0) {
+        quint32 avg = _savedTileSize / _savedTileCount;
+        _totalTileSize  = avg * _totalTileCount;
+        _uniqueTileSize = avg * _uniqueTileCount;
+        emit totalTilesSizeChanged();
+        emit uniqueTileSizeChanged();
     }
-    reply->deleteLater();
+    //-- Setup a new download
+    _prepareDownload();
 }
 
 //-----------------------------------------------------------------------------
 void
-QGCCachedTileSet::_networkReplyError(QNetworkReply::NetworkError error)
+QGCCachedTileSet::_tileFailed(quint64 key, QString errorString)
 {
-    //-- Figure out which reply this is
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(QObject::sender());
-    if (!reply) {
-        return;
-    }
-    //-- Upodate error count
+    //-- The downloader has given up on it (retries included)
+    qWarning() << "QGCCachedTileSet::_tileFailed() Error:" << key << errorString;
     _errorCount++;
     emit errorCountChanged();
-    //-- Get tile hash
-    QString hash = reply->request().attribute(QNetworkRequest::User).toString();
-    qCDebug(QGCCachedTileSetLog) << "Error fetching tile" << reply->errorString();
-    if(!hash.isEmpty()) {
-        if(_replies.contains(hash)) {
-            _replies.remove(hash);
-        } else {
-            qWarning() << "QGCMapEngineManager::networkReplyError() Reply not in list: " << hash;
-        }
-        if (error != QNetworkReply::OperationCanceledError) {
-            qWarning() << "QGCMapEngineManager::networkReplyError() Error:" << reply->errorString();
-        }
-        QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StateError, hash);
-        getQGCMapEngine()->addTask(task);
-    } else {
-        qWarning() << "QGCMapEngineManager::networkReplyError() Empty Hash";
-    }
+    QGCUpdateTileDownloadStateTask* task = new QGCUpdateTileDownloadStateTask(_id, QGCTile::StateError, key);
+    getQGCMapEngine()->addTask(task);
     //-- Setup a new download
     _prepareDownload();
-    reply->deleteLater();
 }
 
 //-----------------------------------------------------------------------------
@@ -24,10 +24,12 @@
 #include <QHash>
 #include <QDateTime>
 #include <QImage>
+#include <QGeoCoordinate>
 
 #include "QGCLoggingCategory.h"
 #include "QGCMapEngineData.h"
 #include "QGCMapUrlEngine.h"
+#include "QGCTileDownloader.h"
 
 Q_DECLARE_LOGGING_CATEGORY(QGCCachedTileSetLog)
 
@@ -71,6 +73,9 @@ public:
     Q_PROPERTY(bool         downloading         READ    downloading         NOTIFY downloadingChanged)
     Q_PROPERTY(quint32      errorCount          READ    errorCount          NOTIFY errorCountChanged)
     Q_PROPERTY(QString      errorCountStr       READ    errorCountStr       NOTIFY errorCountChanged)
+    Q_PROPERTY(double       tilesPerSecond      READ    tilesPerSecond      NOTIFY downloadRateChanged)
+    Q_PROPERTY(double       bytesPerSecond      READ    bytesPerSecond      NOTIFY downloadRateChanged)
+    Q_PROPERTY(QString      downloadRateStr     READ    downloadRateStr     NOTIFY downloadRateChanged)
 
     Q_INVOKABLE void createDownloadTask ();
     Q_INVOKABLE void resumeDownloadTask ();
@@ -84,6 +89,8 @@ public:
     double      topleftLon              () { return _topleftLon; }
     double      bottomRightLat          () { return _bottomRightLat; }
     double      bottomRightLon          () { return _bottomRightLon; }
+    //-- Area the set covers when it is not the whole of the bounds (empty for a plain rectangle)
+    QList<QGeoCoordinate> polygon       () { return _polygon; }
     quint32     totalTileCount          () { return (quint32)_totalTileCount; }
     QString     totalTileCountStr       ();
     quint64     totalTilesSize          () { return (quint64)_totalTileSize; }
@@ -109,6 +116,9 @@ public:
     bool        downloading             () { return _downloading; }
     quint32     errorCount              () { return _errorCount; }
     QString     errorCountStr           ();
+    double      tilesPerSecond          () { return _downloader ? _downloader->tilesPerSecond() : 0.0; }
+    double      bytesPerSecond          () { return _downloader ? _downloader->bytesPerSecond() : 0.0; }
+    QString     downloadRateStr         ();
 
     void        setName                 (QString name)              { _name = name; }
     void        setMapTypeStr           (QString typeStr)           { _mapTypeStr = typeStr; }
@@ -116,6 +126,7 @@ public:
     void        setTopleftLon           (double lon)                { _topleftLon = lon; }
     void        setBottomRightLat       (double lat)                { _bottomRightLat = lat; }
     void        setBottomRightLon       (double lon)                { _bottomRightLon = lon; }
+    void        setPolygon              (const QList<QGeoCoordinate>& polygon) { _polygon = polygon; }
     void        setTotalTileCount       (quint32 num)               { _totalTileCount = num; emit totalTileCountChanged(); }
     void        setUniqueTileCount      (quint32 num)               { _uniqueTileCount = num; }
     void        setUniqueTileSize       (quint64 size)              { _uniqueTileSize  = size; }
@@ -142,11 +153,12 @@ signals:
     void        savedTileSizeChanged    ();
     void        completeChanged         ();
     void        errorCountChanged       ();
+    void        downloadRateChanged     ();
 
 private slots:
-    void _tileListFetched               (QList<QGCTile*> tiles);
-    void _networkReplyFinished          ();
-    void _networkReplyError             (QNetworkReply::NetworkError error);
+    void _tileListFetched               (QList<QGCTile*> tiles, quint32 cachedCount, quint64 cachedSize);
+    void _tileDownloaded                (quint64 key, QByteArray image);
+    void _tileFailed                    (quint64 key, QString errorString);
 
 private:
     void        _prepareDownload        ();
@@ -159,6 +171,7 @@ private:
     double      _topleftLon;
     double      _bottomRightLat;
     double      _bottomRightLon;
+    QList<QGeoCoordinate> _polygon;
     quint32     _totalTileCount;
     quint64     _totalTileSize;
     quint32     _uniqueTileCount;
@@ -174,10 +187,9 @@ private:
     quint64     _id;
     UrlFactory::MapType _type;
     QNetworkAccessManager*  _networkManager;
-    QHash<QString, QNetworkReply*> _replies;
+    QGCTileDownloader*      _downloader;
     quint32     _errorCount;
     //-- Tile download
-    QList<QGCTile *> _tilesToDownload;
     bool        _noMoreTiles;
     bool        _batchRequested;
     QGCMapEngineManager* _manager;
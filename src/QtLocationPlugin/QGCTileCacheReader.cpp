@@ -0,0 +1,143 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief Map Tile Cache Reader Threads
+ *
+ */
+
+#include "QGCMapEngine.h"
+#include "QGCTileCacheReader.h"
+
+#include <QtSql/QSqlDatabase>
+#include <QSqlError>
+#include <QMutexLocker>
+#include <QDebug>
+
+//-----------------------------------------------------------------------------
+QGCCacheReader::QGCCacheReader(QGCCacheReaderPool* pool, const QString& session)
+    : _pool(pool)
+    , _session(session)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheReader::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", _session);
+        db.setDatabaseName(_pool->_databasePath);
+        //-- No shared cache here. Shared cache connections use table level locks which
+        //   would make readers wait for the writer again.
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        bool valid = db.open();
+        if(!valid) {
+            qWarning() << "Map Cache SQL error (reader open db):" << db.lastError();
+        }
+        QGCMapTask* task;
+        while((task = _pool->_dequeueTask()) != NULL) {
+            if(valid) {
+                QGCCacheWorker::fetchTile(db, task);
+            } else {
+                task->setError("No Cache Database");
+            }
+            task->deleteLater();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(_session);
+}
+
+//-----------------------------------------------------------------------------
+QGCCacheReaderPool::QGCCacheReaderPool(const QString& session)
+    : _session(session)
+    , _readerCount(0)
+    , _stopping(false)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+QGCCacheReaderPool::~QGCCacheReaderPool()
+{
+    quit();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheReaderPool::setReaderCount(int count)
+{
+    if(_readers.count()) {
+        qWarning() << "QGCCacheReaderPool::setReaderCount() Readers already running";
+        return;
+    }
+    _readerCount = qMax(count, 0);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheReaderPool::_startReaders()
+{
+    for(int i = 0; i < _readerCount; i++) {
+        QGCCacheReader* reader = new QGCCacheReader(this, QString("%1_reader%2").arg(_session).arg(i));
+        _readers.append(reader);
+        reader->start(QThread::NormalPriority);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheReaderPool::enqueueTask(QGCMapTask* task)
+{
+    QMutexLocker lock(&_mutex);
+    if(!_readers.count()) {
+        _stopping = false;
+        _startReaders();
+    }
+    _taskQueue.enqueue(task);
+    _waitc.wakeOne();
+}
+
+//-----------------------------------------------------------------------------
+QGCMapTask*
+QGCCacheReaderPool::_dequeueTask()
+{
+    QMutexLocker lock(&_mutex);
+    while(!_stopping && !_taskQueue.count()) {
+        _waitc.wait(&_mutex);
+    }
+    if(_stopping) {
+        return NULL;
+    }
+    return _taskQueue.dequeue();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheReaderPool::quit()
+{
+    QList<QGCCacheReader*> readers;
+    {
+        QMutexLocker lock(&_mutex);
+        while(_taskQueue.count()) {
+            delete _taskQueue.dequeue();
+        }
+        _stopping = true;
+        _waitc.wakeAll();
+        readers.swap(_readers);
+    }
+    for(int i = 0; i < readers.count(); i++) {
+        readers[i]->wait();
+        delete readers[i];
+    }
+}
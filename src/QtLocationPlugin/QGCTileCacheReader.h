@@ -0,0 +1,83 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief Map Tile Cache Reader Threads
+ *
+ *   Tile fetches are served by a small pool of reader threads, each with
+ *   its own read only database connection. With the database in WAL mode
+ *   they don't wait on the cache worker, which owns the only writer
+ *   connection and does everything else (saves, tile sets, prune, totals).
+ *
+ */
+
+#ifndef QGC_TILE_CACHE_READER_H
+#define QGC_TILE_CACHE_READER_H
+
+#include <QString>
+#include <QThread>
+#include <QQueue>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+class QGCMapTask;
+class QGCCacheReaderPool;
+
+//-----------------------------------------------------------------------------
+class QGCCacheReader : public QThread
+{
+    Q_OBJECT
+public:
+    QGCCacheReader  (QGCCacheReaderPool* pool, const QString& session);
+
+protected:
+    void    run     ();
+
+private:
+    QGCCacheReaderPool* _pool;
+    QString             _session;
+};
+
+//-----------------------------------------------------------------------------
+class QGCCacheReaderPool
+{
+public:
+    QGCCacheReaderPool  (const QString& session);
+    ~QGCCacheReaderPool ();
+
+    //-- Must be called before the first task is queued
+    void    setDatabaseFile (const QString& path)   { _databasePath = path; }
+    void    setReaderCount  (int count);
+    int     readerCount     () { return _readerCount; }
+
+    void    enqueueTask     (QGCMapTask* task);
+    //-- Drops queued tasks and stops all reader threads
+    void    quit            ();
+
+private:
+    friend class QGCCacheReader;
+
+    //-- Blocks until there is a task or the pool is stopping (returns NULL)
+    QGCMapTask* _dequeueTask    ();
+    void        _startReaders   ();
+
+    QString                 _session;
+    QString                 _databasePath;
+    int                     _readerCount;
+    QList<QGCCacheReader*>  _readers;
+    QQueue<QGCMapTask*>     _taskQueue;
+    QMutex                  _mutex;
+    QWaitCondition          _waitc;
+    bool                    _stopping;
+};
+
+#endif // QGC_TILE_CACHE_READER_H
@@ -26,12 +26,32 @@
 #include <QDateTime>
 #include <QApplication>
 #include <QFile>
+#include <QStringList>
+#include <algorithm>
 
 #include "time.h"
 
 const char* kDefaultSet = "Default Tile Set";
+//-- TileTotals row holding the totals for the whole cache (set IDs start at 1)
+const quint64 kTotalsSetID = 0;
 const QString kSession  = QLatin1String("QGeoTileWorkerSession");
 
+//-- Tiles are keyed by their packed (type, z, x, y) key (see QGCMapEngine::getTileKey()), which is
+//   also the rowid. There is no separate index for tile lookups.
+const char* kCreateTiles =
+    "CREATE TABLE IF NOT EXISTS Tiles ("
+    "tileID INTEGER PRIMARY KEY NOT NULL, "
+    "format TEXT NOT NULL, "
+    "tile BLOB NULL, "
+    "size INTEGER, "
+    "date INTEGER DEFAULT 0)";
+const char* kCreateTilesDownload =
+    "CREATE TABLE IF NOT EXISTS TilesDownload ("
+    "setID INTEGER NOT NULL, "
+    "tileID INTEGER NOT NULL, "
+    "state INTEGER DEFAULT 0, "
+    "PRIMARY KEY(setID, tileID)) WITHOUT ROWID";
+
 QGC_LOGGING_CATEGORY(QGCTileCacheLog, "QGCTileCacheLog")
 
 //-- Update intervals
@@ -39,6 +59,58 @@ QGC_LOGGING_CATEGORY(QGCTileCacheLog, "QGCTileCacheLog")
 #define LONG_TIMEOUT        5
 #define SHORT_TIMEOUT       2
 
+//-- Max number of queued tiles saved in a single transaction
+
+#define SAVE_BATCH_SIZE     1000
+
+//-- Max number of candidate tiles looked at per query when enumerating a tile set
+
+#define ENUMERATE_BATCH_SIZE 4096
+
+//-- Number of read only connections for tile fetches
+
+#define READER_COUNT        2
+
+//-- Tile access times are written in batches, once enough tiles were used or after a while
+
+#define ACCESS_BATCH_SIZE   500
+#define ACCESS_TIMEOUT      30
+
+//-----------------------------------------------------------------------------
+//-- Tile set polygons are stored as "lat,lon;lat,lon;..."
+static QString
+_polygonToString(const QList<QGeoCoordinate>& polygon)
+{
+    QStringList vertices;
+    for(int i = 0; i < polygon.count(); i++) {
+        vertices << QString("%1,%2").arg(polygon[i].latitude(), 0, 'g', 12).arg(polygon[i].longitude(), 0, 'g', 12);
+    }
+    return vertices.join(';');
+}
+
+//-----------------------------------------------------------------------------
+static QList<QGeoCoordinate>
+_polygonFromString(const QString& str)
+{
+    QList<QGeoCoordinate> polygon;
+    QStringList vertices = str.split(';', QString::SkipEmptyParts);
+    for(int i = 0; i < vertices.count(); i++) {
+        QStringList latLon = vertices[i].split(',');
+        if(latLon.count() == 2) {
+            polygon.append(QGeoCoordinate(latLon[0].toDouble(), latLon[1].toDouble()));
+        }
+    }
+    return polygon;
+}
+
+//-----------------------------------------------------------------------------
+//-- Orders runs by where they end, so the first run not before a tile is the one holding it or the next one
+static bool
+_runEndsBefore(const QGCTileRun& run, const QGCTileRun& tile)
+{
+    return run.x < tile.x || (run.x == tile.x && run.y1 < tile.y0);
+}
+
 //-----------------------------------------------------------------------------
 QGCCacheWorker::QGCCacheWorker()
     : _db(NULL)
@@ -51,14 +123,26 @@ QGCCacheWorker::QGCCacheWorker()
     , _defaultCount(0)
     , _lastUpdate(0)
     , _updateTimeout(SHORT_TIMEOUT)
+    , _synchronous(SyncNormal)
+    , _walMode(true)
+    , _saveBatchSize(SAVE_BATCH_SIZE)
+    , _memCache(NULL)
+    , _lastAccessUpdate(0)
+    , _runsSetID(UINT64_MAX)
+    , _runsZoom(0)
 {
-
+    //-- Each worker needs its own connection name or they would share (and close) each other's connection
+    _session = QString("%1_%2").arg(kSession).arg((quintptr)this, 0, 16);
+    _readerPool = new QGCCacheReaderPool(_session);
+    _readerPool->setReaderCount(READER_COUNT);
 }
 
 //-----------------------------------------------------------------------------
 QGCCacheWorker::~QGCCacheWorker()
 {
-
+    //-- Stops (and waits for) the reader threads before the pool goes away
+    _readerPool->quit();
+    delete _readerPool;
 }
 
 //-----------------------------------------------------------------------------
@@ -66,12 +150,14 @@ void
 QGCCacheWorker::setDatabaseFile(const QString& path)
 {
     _databasePath = path;
+    _readerPool->setDatabaseFile(path);
 }
 
 //-----------------------------------------------------------------------------
 void
 QGCCacheWorker::quit()
 {
+    _readerPool->quit();
     _mutex.lock();
     while(_taskQueue.count()) {
         QGCMapTask* task = _taskQueue.dequeue();
@@ -93,6 +179,14 @@ QGCCacheWorker::enqueueTask(QGCMapTask* task)
         task->deleteLater();
         return false;
     }
+    if(task->type() == QGCMapTask::taskFetchTile) {
+        touchTile(static_cast<QGCFetchTileTask*>(task)->key());
+        //-- Tile fetches go to the readers so they don't wait behind saves, prune and totals
+        if(_readerPool->readerCount()) {
+            _readerPool->enqueueTask(task);
+            return true;
+        }
+    }
     if(!_taskQueue.contains(task))
     {
         _mutex.lock();
@@ -117,22 +211,41 @@ QGCCacheWorker::run()
         _init();
     }
     if(_valid) {
-        _db = new QSqlDatabase(QSqlDatabase::addDatabase("QSQLITE", kSession));
+        _db = new QSqlDatabase(QSqlDatabase::addDatabase("QSQLITE", _session));
         _db->setDatabaseName(_databasePath);
         _db->setConnectOptions("QSQLITE_ENABLE_SHARED_CACHE");
         _valid = _db->open();
+        if(_valid) {
+            _configureDatabase();
+        }
     }
     while(true) {
         QGCMapTask* task;
         if(_taskQueue.count()) {
             _mutex.lock();
             task = _taskQueue.dequeue();
+            //-- Drain consecutive tile saves so they go into a single transaction. Only
+            //   consecutive ones are taken so they stay ordered with respect to other tasks.
+            QList<QGCMapTask*> saveTasks;
+            if(task->type() == QGCMapTask::taskCacheTile) {
+                saveTasks.append(task);
+                while(saveTasks.count() < _saveBatchSize && _taskQueue.count() && _taskQueue.head()->type() == QGCMapTask::taskCacheTile) {
+                    saveTasks.append(_taskQueue.dequeue());
+                }
+            }
             _mutex.unlock();
             switch(task->type()) {
                 case QGCMapTask::taskInit:
+                    if(!_valid) {
+                        task->setError("Map cache database could not be opened");
+                    }
                     break;
                 case QGCMapTask::taskCacheTile:
-                    _saveTile(task);
+                    _saveTiles(saveTasks);
+                    //-- The first one is deleted below along with all other task types
+                    for(int i = 1; i < saveTasks.count(); i++) {
+                        saveTasks[i]->deleteLater();
+                    }
                     break;
                 case QGCMapTask::taskFetchTile:
                     _getTile(task);
@@ -158,6 +271,12 @@ QGCCacheWorker::run()
                 case QGCMapTask::taskReset:
                     _resetCacheDatabase(task);
                     break;
+                case QGCMapTask::taskExportTileSet:
+                    _exportTileSet(task);
+                    break;
+                case QGCMapTask::taskImportTileSet:
+                    _importTileSet(task);
+                    break;
             }
             task->deleteLater();
             //-- Check for update timeout
@@ -172,6 +291,9 @@ QGCCacheWorker::run()
                     _updateTotals();
                 }
             }
+            if(_valid) {
+                _updateAccessTimes(false);
+            }
         } else {
             //-- Wait a bit before shutting things down
             _waitmutex.lock();
@@ -191,9 +313,12 @@ QGCCacheWorker::run()
         }
     }
     if(_db) {
+        if(_valid) {
+            _updateAccessTimes(true);
+        }
         delete _db;
         _db = NULL;
-        QSqlDatabase::removeDatabase(kSession);
+        QSqlDatabase::removeDatabase(_session);
     }
 }
 //-----------------------------------------------------------------------------
@@ -230,34 +355,53 @@ QGCCacheWorker::_getDefaultTileSet()
 
 //-----------------------------------------------------------------------------
 void
-QGCCacheWorker::_saveTile(QGCMapTask *mtask)
+QGCCacheWorker::_saveTiles(QList<QGCMapTask*>& tasks)
 {
-    if(_valid) {
-        QGCSaveTileTask* task = static_cast<QGCSaveTileTask*>(mtask);
-        QSqlQuery query(*_db);
-        query.prepare("INSERT INTO Tiles(hash, format, tile, size, type, date) VALUES(?, ?, ?, ?, ?, ?)");
-        query.addBindValue(task->tile()->hash());
-        query.addBindValue(task->tile()->format());
-        query.addBindValue(task->tile()->img());
-        query.addBindValue(task->tile()->img().size());
-        query.addBindValue(task->tile()->type());
-        query.addBindValue(QDateTime::currentDateTime().toTime_t());
-        if(query.exec()) {
-            quint64 tileID = query.lastInsertId().toULongLong();
-            quint64 setID = task->tile()->set() == UINT64_MAX ? _getDefaultTileSet() : task->tile()->set();
-            QString s = QString("INSERT INTO SetTiles(tileID, setID) VALUES(%1, %2)").arg(tileID).arg(setID);
-            query.prepare(s);
-            if(!query.exec()) {
-                qWarning() << "Map Cache SQL error (add tile into SetTiles):" << query.lastError().text();
+    if(!_valid) {
+        qWarning() << "Map Cache SQL error (saveTile() open db):" << _db->lastError();
+        return;
+    }
+    //-- One transaction for the whole batch. Otherwise each INSERT is its own (synced) transaction.
+    bool transaction = _db->transaction();
+    if(!transaction) {
+        qWarning() << "Map Cache SQL error (saveTile() begin transaction):" << _db->lastError().text();
+    }
+    QSqlQuery tileQuery(*_db);
+    QSqlQuery setQuery(*_db);
+    tileQuery.prepare("INSERT INTO Tiles(tileID, format, tile, size, date) VALUES(?, ?, ?, ?, ?)");
+    setQuery.prepare("INSERT INTO SetTiles(tileID, setID) VALUES(?, ?)");
+    quint64 defaultSet = _getDefaultTileSet();
+    uint    now        = QDateTime::currentDateTime().toTime_t();
+    int     saved      = 0;
+    for(int i = 0; i < tasks.count(); i++) {
+        QGCSaveTileTask* task = static_cast<QGCSaveTileTask*>(tasks[i]);
+        //-- Keys are bound as signed, the Qt SQLite driver binds unsigned 64 bit values as text
+        qint64 key = (qint64)task->tile()->key();
+        tileQuery.bindValue(0, key);
+        tileQuery.bindValue(1, task->tile()->format());
+        tileQuery.bindValue(2, task->tile()->img());
+        tileQuery.bindValue(3, task->tile()->img().size());
+        tileQuery.bindValue(4, now);
+        if(tileQuery.exec()) {
+            quint64 setID = task->tile()->set() == UINT64_MAX ? defaultSet : task->tile()->set();
+            setQuery.bindValue(0, key);
+            setQuery.bindValue(1, setID);
+            if(!setQuery.exec()) {
+                qWarning() << "Map Cache SQL error (add tile into SetTiles):" << setQuery.lastError().text();
             }
-            qCDebug(QGCTileCacheLog) << "_saveTile() HASH:" << task->tile()->hash();
+            saved++;
+            qCDebug(QGCTileCacheLog) << "_saveTile() KEY:" << task->tile()->key();
         } else {
             //-- Tile was already there.
             //   QtLocation some times requests the same tile twice in a row. The first is saved, the second is already there.
         }
-    } else {
-        qWarning() << "Map Cache SQL error (saveTile() open db):" << _db->lastError();
     }
+    if(transaction && !_db->commit()) {
+        qWarning() << "Map Cache SQL error (saveTile() commit):" << _db->lastError().text();
+        _db->rollback();
+        return;
+    }
+    qCDebug(QGCTileCacheLog) << "_saveTiles() Saved" << saved << "of" << tasks.count();
 }
 
 //-----------------------------------------------------------------------------
@@ -268,23 +412,30 @@ QGCCacheWorker::_getTile(QGCMapTask* mtask)
         mtask->setError("No Cache Database");
         return;
     }
+    fetchTile(*_db, mtask);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::fetchTile(QSqlDatabase& db, QGCMapTask* mtask)
+{
     bool found = false;
     QGCFetchTileTask* task = static_cast<QGCFetchTileTask*>(mtask);
-    QSqlQuery query(*_db);
-    QString s = QString("SELECT tile, format, type FROM Tiles WHERE hash = \"%1\"").arg(task->hash());
+    QSqlQuery query(db);
+    QString s = QString("SELECT tile, format FROM Tiles WHERE tileID = %1").arg(task->key());
     if(query.exec(s)) {
         if(query.next()) {
             QByteArray ar   = query.value(0).toByteArray();
             QString format  = query.value(1).toString();
-            UrlFactory::MapType type = (UrlFactory::MapType)query.value(2).toInt();
-            qCDebug(QGCTileCacheLog) << "_getTile() (Found in DB) HASH:" << task->hash();
-            QGCCacheTile* tile = new QGCCacheTile(task->hash(), ar, format, type);
+            UrlFactory::MapType type = QGCMapEngine::tileKeyToType(task->key());
+            qCDebug(QGCTileCacheLog) << "_getTile() (Found in DB) KEY:" << task->key();
+            QGCCacheTile* tile = new QGCCacheTile(task->key(), ar, format, type);
             task->setTileFetched(tile);
             found = true;
         }
     }
     if(!found) {
-        qCDebug(QGCTileCacheLog) << "_getTile() (NOT in DB) HASH:" << task->hash();
+        qCDebug(QGCTileCacheLog) << "_getTile() (NOT in DB) KEY:" << task->key();
         task->setError("Tile not in cache database");
     }
 }
@@ -311,6 +462,7 @@ QGCCacheWorker::_getTileSets(QGCMapTask* mtask)
             set->setTopleftLon(query.value("topleftLon").toDouble());
             set->setBottomRightLat(query.value("bottomRightLat").toDouble());
             set->setBottomRightLon(query.value("bottomRightLon").toDouble());
+            set->setPolygon(_polygonFromString(query.value("polygon").toString()));
             set->setMinZoom(query.value("minZoom").toInt());
             set->setMaxZoom(query.value("maxZoom").toInt());
             set->setType((UrlFactory::MapType)query.value("type").toInt());
@@ -340,7 +492,7 @@ QGCCacheWorker::_updateSetTotals(QGCCachedTileSet* set)
         return;
     }
     QSqlQuery subquery(*_db);
-    QString sq = QString("SELECT COUNT(size), SUM(size) FROM Tiles A INNER JOIN SetTiles B on A.tileID = B.tileID WHERE B.setID = %1").arg(set->id());
+    QString sq = QString("SELECT tileCount, tileSize, uniqueCount, uniqueSize FROM TileTotals WHERE setID = %1").arg(set->id());
     qCDebug(QGCTileCacheLog) << "_updateSetTotals(): " << sq;
     if(subquery.exec(sq)) {
         if(subquery.next()) {
@@ -360,16 +512,9 @@ QGCCacheWorker::_updateSetTotals(QGCCachedTileSet* set)
                 set->setTotalTileSize(avg * set->totalTileCount());
             }
             //-- Now figure out the count for tiles unique to this set
-            quint32 ucount = 0;
-            quint64 usize  = 0;
-            sq = QString("SELECT COUNT(size), SUM(size) FROM Tiles WHERE tileID IN (SELECT A.tileID FROM SetTiles A join SetTiles B on A.tileID = B.tileID WHERE B.setID = %1 GROUP by A.tileID HAVING COUNT(A.tileID) = 1)").arg(set->id());
-            if(subquery.exec(sq)) {
-                if(subquery.next()) {
-                    //-- This is only accurate when all tiles are downloaded
-                    ucount = subquery.value(0).toUInt();
-                    usize  = subquery.value(1).toULongLong();
-                }
-            }
+            //   This is only accurate when all tiles are downloaded
+            quint32 ucount = subquery.value(2).toUInt();
+            quint64 usize  = subquery.value(3).toULongLong();
             //-- If we haven't downloaded it all, estimate size of unique tiles
             quint32 expectedUcount = set->totalTileCount() - set->savedTileCount();
             if(!ucount) {
@@ -387,54 +532,38 @@ QGCCacheWorker::_updateSetTotals(QGCCachedTileSet* set)
 void
 QGCCacheWorker::_updateTotals()
 {
+    //-- Totals are maintained by triggers (see _createTotals()) so this is a single indexed lookup
     QSqlQuery query(*_db);
-    QString s;
-    s = QString("SELECT COUNT(size), SUM(size) FROM Tiles");
-    qCDebug(QGCTileCacheLog) << "_updateTotals(): " << s;
-    if(query.exec(s)) {
-        if(query.next()) {
-            _totalCount = query.value(0).toUInt();
-            _totalSize  = query.value(1).toULongLong();
-        }
-    }
-    s = QString("SELECT COUNT(size), SUM(size) FROM Tiles WHERE tileID IN (SELECT A.tileID FROM SetTiles A join SetTiles B on A.tileID = B.tileID WHERE B.setID = %1 GROUP by A.tileID HAVING COUNT(A.tileID) = 1)").arg(_getDefaultTileSet());
-    qCDebug(QGCTileCacheLog) << "_updateTotals(): " << s;
+    QString s = QString("SELECT setID, tileCount, tileSize, uniqueCount, uniqueSize FROM TileTotals WHERE setID = %1 OR setID = %2").arg(kTotalsSetID).arg(_getDefaultTileSet());
     if(query.exec(s)) {
-        if(query.next()) {
-            _defaultCount = query.value(0).toUInt();
-            _defaultSize  = query.value(1).toULongLong();
+        while(query.next()) {
+            if(query.value(0).toULongLong() == kTotalsSetID) {
+                _totalCount = query.value(1).toUInt();
+                _totalSize  = query.value(2).toULongLong();
+            } else {
+                _defaultCount = query.value(3).toUInt();
+                _defaultSize  = query.value(4).toULongLong();
+            }
         }
+    } else {
+        qWarning() << "Map Cache SQL error (read totals):" << query.lastError().text();
     }
     emit updateTotals(_totalCount, _totalSize, _defaultCount, _defaultSize);
     _lastUpdate = time(0);
 }
 
-//-----------------------------------------------------------------------------
-quint64 QGCCacheWorker::_findTile(const QString hash)
-{
-    quint64 tileID = 0;
-    QSqlQuery query(*_db);
-    QString s = QString("SELECT tileID FROM Tiles WHERE hash = \"%1\"").arg(hash);
-    if(query.exec(s)) {
-        if(query.next()) {
-            tileID = query.value(0).toULongLong();
-        }
-    }
-    return tileID;
-}
-
 //-----------------------------------------------------------------------------
 void
 QGCCacheWorker::_createTileSet(QGCMapTask *mtask)
 {
     if(_valid) {
-        //-- Create Tile Set
-        quint32 actual_count = 0;
+        //-- Create Tile Set. Its tiles are enumerated from the bounds (or polygon) and zoom range as it downloads.
         QGCCreateTileSetTask* task = static_cast<QGCCreateTileSetTask*>(mtask);
+        quint64 cursor = QGCMapEngine::getTileKey(task->tileSet()->type(), 0, 0, qMax(task->tileSet()->minZoom(), 1));
         QSqlQuery query(*_db);
         query.prepare("INSERT INTO TileSets("
-            "name, typeStr, topleftLat, topleftLon, bottomRightLat, bottomRightLon, minZoom, maxZoom, type, numTiles, date"
-            ") VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+            "name, typeStr, topleftLat, topleftLon, bottomRightLat, bottomRightLon, minZoom, maxZoom, type, numTiles, date, enumCursor, polygon"
+            ") VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
         query.addBindValue(task->tileSet()->name());
         query.addBindValue(task->tileSet()->mapTypeStr());
         query.addBindValue(task->tileSet()->topleftLat());
@@ -446,53 +575,20 @@ QGCCacheWorker::_createTileSet(QGCMapTask *mtask)
         query.addBindValue(task->tileSet()->type());
         query.addBindValue(task->tileSet()->totalTileCount());
         query.addBindValue(QDateTime::currentDateTime().toTime_t());
+        query.addBindValue((qint64)cursor);
+        if(task->tileSet()->polygon().isEmpty()) {
+            query.addBindValue(QVariant(QVariant::String));
+        } else {
+            query.addBindValue(_polygonToString(task->tileSet()->polygon()));
+        }
         if(!query.exec()) {
             qWarning() << "Map Cache SQL error (add tileSet into TileSets):" << query.lastError().text();
         } else {
             //-- Get just created (auto-incremented) setID
             quint64 setID = query.lastInsertId().toULongLong();
             task->tileSet()->setId(setID);
-            //-- Prepare Download List
-            quint64 tileCount = 0;
-            for(int z = task->tileSet()->minZoom(); z <= task->tileSet()->maxZoom(); z++) {
-                QGCTileSet set = QGCMapEngine::getTileCount(z,
-                    task->tileSet()->topleftLon(), task->tileSet()->topleftLat(),
-                    task->tileSet()->bottomRightLon(), task->tileSet()->bottomRightLat(), task->tileSet()->type());
-                tileCount += set.tileCount;
-                UrlFactory::MapType type = task->tileSet()->type();
-                for(int x = set.tileX0; x <= set.tileX1; x++) {
-                    for(int y = set.tileY0; y <= set.tileY1; y++) {
-                        //-- See if tile is already downloaded
-                        QString hash = QGCMapEngine::getTileHash(type, x, y, z);
-                        quint64 tileID = _findTile(hash);
-                        if(!tileID) {
-                            //-- Set to download
-                            query.prepare("INSERT OR IGNORE INTO TilesDownload(setID, hash, type, x, y, z, state) VALUES(?, ?, ?, ?, ? ,? ,?)");
-                            query.addBindValue(setID);
-                            query.addBindValue(hash);
-                            query.addBindValue(type);
-                            query.addBindValue(x);
-                            query.addBindValue(y);
-                            query.addBindValue(z);
-                            query.addBindValue(0);
-                            if(!query.exec()) {
-                                qWarning() << "Map Cache SQL error (add tile into TilesDownload):" << query.lastError().text();
-                                mtask->setError("Error creating tile set download list");
-                                return;
-                            } else
-                                actual_count++;
-                        } else {
-                            //-- Tile already in the database. No need to dowload.
-                            QString s = QString("INSERT OR IGNORE INTO SetTiles(tileID, setID) VALUES(%1, %2)").arg(tileID).arg(setID);
-                            query.prepare(s);
-                            if(!query.exec()) {
-                                qWarning() << "Map Cache SQL error (add tile into SetTiles):" << query.lastError().text();
-                            }
-                            qCDebug(QGCTileCacheLog) << "_createTileSet() Already Cached HASH:" << hash;
-                        }
-                    }
-                }
-            }
+            //-- The ID may be one a deleted set had
+            _runsSetID = UINT64_MAX;
             //-- Done
             _updateSetTotals(task->tileSet());
             task->setTileSetSaved();
@@ -502,6 +598,102 @@ QGCCacheWorker::_createTileSet(QGCMapTask *mtask)
     mtask->setError("Error saving tile set");
 }
 
+//-----------------------------------------------------------------------------
+QVector<QGCTileRun>
+QGCCacheWorker::_zoomRuns(int z, double topleftLon, double topleftLat, double bottomRightLon, double bottomRightLat, const QList<QGeoCoordinate>& polygon)
+{
+    if(!polygon.isEmpty()) {
+        return QGCMapEngine::getTileRuns(z, polygon);
+    }
+    QVector<QGCTileRun> runs;
+    QGCTileSet set = QGCMapEngine::getTileCount(z, topleftLon, topleftLat, bottomRightLon, bottomRightLat, UrlFactory::Invalid);
+    for(int x = set.tileX0; x <= set.tileX1; x++) {
+        runs.append(QGCTileRun(x, set.tileY0, set.tileY1));
+    }
+    return runs;
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCCacheWorker::_enumerateTiles(quint64 setID, int count, quint32& cachedCount, quint64& cachedSize)
+{
+    //-- Where the enumeration is at and the area it covers
+    QSqlQuery query(*_db);
+    QString s = QString("SELECT enumCursor, type, maxZoom, topleftLat, topleftLon, bottomRightLat, bottomRightLon, polygon FROM TileSets WHERE setID = %1").arg(setID);
+    if(!query.exec(s) || !query.next()) {
+        qWarning() << "Map Cache SQL error (read tile set cursor):" << query.lastError().text();
+        return false;
+    }
+    qint64              cursor          = query.value(0).toLongLong();
+    UrlFactory::MapType type            = (UrlFactory::MapType)query.value(1).toInt();
+    int                 maxZoom         = qMin(query.value(2).toInt(), (int)MAX_MAP_ZOOM);
+    double              topleftLat      = query.value(3).toDouble();
+    double              topleftLon      = query.value(4).toDouble();
+    double              bottomRightLat  = query.value(5).toDouble();
+    double              bottomRightLon  = query.value(6).toDouble();
+    QList<QGeoCoordinate> polygon       = _polygonFromString(query.value(7).toString());
+    query.finish();
+    if(cursor < 0) {
+        return true;
+    }
+    //-- Tiles already in the cache join the set, the others (the anti-join against Tiles) are queued for download
+    QSqlQuery cachedQuery(*_db);
+    QSqlQuery linkQuery(*_db);
+    QSqlQuery missingQuery(*_db);
+    cachedQuery.prepare("SELECT COUNT(size), IFNULL(SUM(size), 0) FROM Tiles WHERE tileID BETWEEN ? AND ?");
+    linkQuery.prepare(QString("INSERT INTO SetTiles(tileID, setID) SELECT tileID, %1 FROM Tiles WHERE tileID BETWEEN ? AND ?").arg(setID));
+    missingQuery.prepare(QString(
+        "WITH RECURSIVE Candidates(tileID) AS (SELECT ? UNION ALL SELECT tileID + 1 FROM Candidates WHERE tileID < ?) "
+        "INSERT OR IGNORE INTO TilesDownload(setID, tileID, state) "
+        "SELECT %1, Candidates.tileID, %2 FROM Candidates LEFT JOIN Tiles ON Tiles.tileID = Candidates.tileID WHERE Tiles.tileID IS NULL")
+        .arg(setID).arg((int)QGCTile::StatePending));
+    int found = 0;
+    while(found < count && cursor >= 0) {
+        int x, y, z;
+        QGCMapEngine::tileKeyToXYZ(cursor, x, y, z);
+        if(_runsSetID != setID || _runsZoom != z) {
+            _runs       = _zoomRuns(z, topleftLon, topleftLat, bottomRightLon, bottomRightLat, polygon);
+            _runsSetID  = setID;
+            _runsZoom   = z;
+        }
+        //-- The run holding the cursor, or the next one
+        QVector<QGCTileRun>::const_iterator run = std::lower_bound(_runs.constBegin(), _runs.constEnd(), QGCTileRun(x, y, y), _runEndsBefore);
+        if(run == _runs.constEnd()) {
+            //-- Done with this zoom level. The first run of the next one is found the same way.
+            cursor = z < maxZoom ? (qint64)QGCMapEngine::getTileKey(type, 0, 0, z + 1) : -1;
+            continue;
+        }
+        //-- Keys are ordered by (type, z, x, y), so a run down a column is a single key range
+        int     y0          = run->x == x ? qMax(y, run->y0) : run->y0;
+        int     y1          = qMin(run->y1, y0 + ENUMERATE_BATCH_SIZE - 1);
+        qint64  firstKey    = (qint64)QGCMapEngine::getTileKey(type, run->x, y0, z);
+        qint64  lastKey     = (qint64)QGCMapEngine::getTileKey(type, run->x, y1, z);
+        cachedQuery.bindValue(0, firstKey);
+        cachedQuery.bindValue(1, lastKey);
+        linkQuery.bindValue(0, firstKey);
+        linkQuery.bindValue(1, lastKey);
+        missingQuery.bindValue(0, firstKey);
+        missingQuery.bindValue(1, lastKey);
+        if(!cachedQuery.exec() || !cachedQuery.next() || !linkQuery.exec() || !missingQuery.exec()) {
+            qWarning() << "Map Cache SQL error (enumerate tile set):" << cachedQuery.lastError().text() << linkQuery.lastError().text() << missingQuery.lastError().text();
+            return false;
+        }
+        cachedCount += cachedQuery.value(0).toUInt();
+        cachedSize  += cachedQuery.value(1).toULongLong();
+        cachedQuery.finish();
+        found += missingQuery.numRowsAffected();
+        //-- Move past what was just looked at
+        cursor = (qint64)QGCMapEngine::getTileKey(type, run->x, y1 + 1, z);
+    }
+    s = QString("UPDATE TileSets SET enumCursor = %1 WHERE setID = %2").arg(cursor).arg(setID);
+    if(!query.exec(s)) {
+        qWarning() << "Map Cache SQL error (update tile set cursor):" << query.lastError().text();
+        return false;
+    }
+    qCDebug(QGCTileCacheLog) << "_enumerateTiles() Set" << setID << "Queued" << found << "Already cached" << cachedCount << "Cursor" << cursor;
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 void
 QGCCacheWorker::_getTileDownloadList(QGCMapTask* mtask)
@@ -511,27 +703,49 @@ QGCCacheWorker::_getTileDownloadList(QGCMapTask* mtask)
         return;
     }
     QList<QGCTile*> tiles;
+    quint32 cachedCount = 0;
+    quint64 cachedSize  = 0;
     QGCGetTileDownloadListTask* task = static_cast<QGCGetTileDownloadListTask*>(mtask);
+    _db->transaction();
     QSqlQuery query(*_db);
-    QString s = QString("SELECT hash, type, x, y, z FROM TilesDownload WHERE setID = %1 AND state = 0 LIMIT %2").arg(task->setID()).arg(task->count());
+    //-- Only enumerate more of the set once what is pending runs low
+    int pending = 0;
+    QString s = QString("SELECT COUNT(*) FROM TilesDownload WHERE setID = %1 AND state = %2").arg(task->setID()).arg((int)QGCTile::StatePending);
+    if(query.exec(s) && query.next()) {
+        pending = query.value(0).toInt();
+    }
+    query.finish();
+    if(pending < task->count() && !_enumerateTiles(task->setID(), task->count() - pending, cachedCount, cachedSize)) {
+        _db->rollback();
+        task->setError("Error enumerating tile set");
+        return;
+    }
+    s = QString("SELECT tileID FROM TilesDownload WHERE setID = %1 AND state = %2 LIMIT %3").arg(task->setID()).arg((int)QGCTile::StatePending).arg(task->count());
     if(query.exec(s)) {
         while(query.next()) {
+            //-- Everything needed to download the tile is in its key
+            quint64 key = query.value(0).toULongLong();
+            int x, y, z;
+            QGCMapEngine::tileKeyToXYZ(key, x, y, z);
             QGCTile* tile = new QGCTile;
-            tile->setHash(query.value("hash").toString());
-            tile->setType((UrlFactory::MapType)query.value("type").toInt());
-            tile->setX(query.value("x").toInt());
-            tile->setY(query.value("y").toInt());
-            tile->setZ(query.value("z").toInt());
+            tile->setKey(key);
+            tile->setType(QGCMapEngine::tileKeyToType(key));
+            tile->setX(x);
+            tile->setY(y);
+            tile->setZ(z);
             tiles.append(tile);
         }
+        query.finish();
+        query.prepare(QString("UPDATE TilesDownload SET state = %1 WHERE setID = %2 AND tileID = ?").arg((int)QGCTile::StateDownloading).arg(task->setID()));
         for(int i = 0; i < tiles.size(); i++) {
-            s = QString("UPDATE TilesDownload SET state = %1 WHERE setID = %2 and hash = \"%3\"").arg((int)QGCTile::StateDownloading).arg(task->setID()).arg(tiles[i]->hash());
-            if(!query.exec(s)) {
+            query.bindValue(0, (qint64)tiles[i]->key());
+            if(!query.exec()) {
                 qWarning() << "Map Cache SQL error (set TilesDownload state):" << query.lastError().text();
             }
         }
     }
-    task->setTileListFetched(tiles);
+    _db->commit();
+    task->setTileListFetched(tiles, cachedCount, cachedSize);
 }
 
 //-----------------------------------------------------------------------------
@@ -546,12 +760,12 @@ QGCCacheWorker::_updateTileDownloadState(QGCMapTask* mtask)
     QSqlQuery query(*_db);
     QString s;
     if(task->state() == QGCTile::StateComplete) {
-        s = QString("DELETE FROM TilesDownload WHERE setID = %1 AND hash = \"%2\"").arg(task->setID()).arg(task->hash());
+        s = QString("DELETE FROM TilesDownload WHERE setID = %1 AND tileID = %2").arg(task->setID()).arg(task->key());
     } else {
-        if(task->hash() == "*") {
+        if(task->key() == UINT64_MAX) {
             s = QString("UPDATE TilesDownload SET state = %1 WHERE setID = %2").arg((int)task->state()).arg(task->setID());
         } else {
-            s = QString("UPDATE TilesDownload SET state = %1 WHERE setID = %2 AND hash = \"%3\"").arg((int)task->state()).arg(task->setID()).arg(task->hash());
+            s = QString("UPDATE TilesDownload SET state = %1 WHERE setID = %2 AND tileID = %3").arg((int)task->state()).arg(task->setID()).arg(task->key());
         }
     }
     if(!query.exec(s)) {
@@ -568,26 +782,82 @@ QGCCacheWorker::_pruneCache(QGCMapTask* mtask)
         return;
     }
     QGCPruneCacheTask* task = static_cast<QGCPruneCacheTask*>(mtask);
+    //-- Pending access times decide what is least recently used
+    _updateAccessTimes(true);
+    //-- Only tiles in the default set (and no other) are pruned
+    QString prunable = QString("tileID IN (SELECT tileID FROM SetTiles WHERE setID = %1) AND tileID NOT IN (SELECT tileID FROM SetTiles WHERE setID != %1)").arg(_getDefaultTileSet());
+    //-- Walk the date index from the least recently used tile until enough has been found
     QSqlQuery query(*_db);
-    QString s;
-    //-- Select tiles in default set only, sorted by oldest.
-    s = QString("SELECT tileID, size, hash FROM Tiles WHERE tileID IN (SELECT A.tileID FROM SetTiles A join SetTiles B on A.tileID = B.tileID WHERE B.setID = %1 GROUP by A.tileID HAVING COUNT(A.tileID) = 1) ORDER BY DATE ASC LIMIT 128").arg(_getDefaultTileSet());
-    qint64 amount = (qint64)task->amount();
-    QList<quint64> tlist;
-    if(query.exec(s)) {
-        while(query.next() && amount >= 0) {
-            tlist << query.value(0).toULongLong();
-            amount -= query.value(1).toULongLong();
-            qCDebug(QGCTileCacheLog) << "_pruneCache() HASH:" << query.value(2).toString();
+    QString s = QString("SELECT tileID, size, date FROM Tiles WHERE %1 ORDER BY date ASC, tileID ASC").arg(prunable);
+    qint64  amount = (qint64)task->amount();
+    quint32 count  = 0;
+    quint64 lastID = 0;
+    quint64 lastDate = 0;
+    if(!query.exec(s)) {
+        qWarning() << "Map Cache SQL error (select tiles to prune):" << query.lastError().text();
+        return;
+    }
+    while(amount > 0 && query.next()) {
+        lastID   = query.value(0).toULongLong();
+        amount  -= query.value(1).toLongLong();
+        lastDate = query.value(2).toULongLong();
+        count++;
+    }
+    query.finish();
+    if(count) {
+        //-- Then delete everything up to that point in one statement
+        _db->transaction();
+        s = QString("DELETE FROM Tiles WHERE (date < %1 OR (date = %1 AND tileID <= %2)) AND %3").arg(lastDate).arg(lastID).arg(prunable);
+        if(query.exec(s)) {
+            _db->commit();
+            qCDebug(QGCTileCacheLog) << "_pruneCache() Pruned" << count << "tiles";
+        } else {
+            qWarning() << "Map Cache SQL error (prune tiles):" << query.lastError().text();
+            _db->rollback();
         }
-        while(tlist.count()) {
-            s = QString("DELETE FROM Tiles WHERE tileID = %1").arg(tlist[0]);
-            tlist.removeFirst();
-            if(!query.exec(s))
-                break;
+    }
+    task->setPruned();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::touchTile(quint64 key)
+{
+    QMutexLocker lock(&_accessMutex);
+    _accessedTiles.insert(key);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::_updateAccessTimes(bool force)
+{
+    QSet<quint64> keys;
+    {
+        QMutexLocker lock(&_accessMutex);
+        if(_accessedTiles.isEmpty()) {
+            return;
         }
-        task->setPruned();
+        if(!force && _accessedTiles.count() < ACCESS_BATCH_SIZE && time(0) - _lastAccessUpdate < ACCESS_TIMEOUT) {
+            return;
+        }
+        keys.swap(_accessedTiles);
     }
+    _lastAccessUpdate = time(0);
+    //-- The date column is the last access time. Tiles which are not in the cache are simply not updated.
+    _db->transaction();
+    QSqlQuery query(*_db);
+    query.prepare("UPDATE Tiles SET date = ? WHERE tileID = ?");
+    uint now = QDateTime::currentDateTime().toTime_t();
+    foreach(quint64 key, keys) {
+        query.bindValue(0, now);
+        query.bindValue(1, (qint64)key);
+        if(!query.exec()) {
+            qWarning() << "Map Cache SQL error (update access time):" << query.lastError().text();
+            break;
+        }
+    }
+    _db->commit();
+    qCDebug(QGCTileCacheLog) << "_updateAccessTimes()" << keys.count();
 }
 
 //-----------------------------------------------------------------------------
@@ -602,7 +872,18 @@ QGCCacheWorker::_deleteTileSet(QGCMapTask* mtask)
     QSqlQuery query(*_db);
     QString s;
     //-- Only delete tiles unique to this set
-    s = QString("DELETE FROM Tiles WHERE tileID IN (SELECT A.tileID FROM SetTiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = %1 GROUP BY A.tileID HAVING COUNT(A.tileID) = 1)").arg(task->setID());
+    QString uniqueTiles = QString("SELECT A.tileID FROM SetTiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = %1 GROUP BY A.tileID HAVING COUNT(A.tileID) = 1").arg(task->setID());
+    //-- Otherwise deleted tiles would still be served from memory
+    if(_memCache) {
+        if(query.exec(uniqueTiles)) {
+            while(query.next()) {
+                _memCache->remove(query.value(0).toULongLong());
+            }
+        } else {
+            qWarning() << "Map Cache SQL error (select deleted tiles):" << query.lastError().text();
+        }
+    }
+    s = QString("DELETE FROM Tiles WHERE tileID IN (%1)").arg(uniqueTiles);
     query.exec(s);
     s = QString("DELETE FROM TilesDownload WHERE setID = %1").arg(task->setID());
     query.exec(s);
@@ -632,10 +913,252 @@ QGCCacheWorker::_resetCacheDatabase(QGCMapTask* mtask)
     query.exec(s);
     s = QString("DROP TABLE TilesDownload");
     query.exec(s);
+    s = QString("DROP TABLE TileTotals");
+    query.exec(s);
     _createDB();
+    if(_memCache) {
+        _memCache->clear();
+    }
     task->setResetCompleted();
 }
 
+//-----------------------------------------------------------------------------
+//-- MBTiles files (https://github.com/mapbox/mbtiles-spec) are attached to the cache connection so tiles move
+//   between the two with INSERT ... SELECT, without going through Qt one row at a time. Rows are TMS (y up).
+bool
+QGCCacheWorker::_attachMBTiles(const QString& path)
+{
+    QSqlQuery query(*_db);
+    query.prepare("ATTACH DATABASE ? AS MBTiles");
+    query.addBindValue(path);
+    if(!query.exec()) {
+        qWarning() << "Map Cache SQL error (attach MBTiles):" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::_detachMBTiles()
+{
+    QSqlQuery query(*_db);
+    if(!query.exec("DETACH DATABASE MBTiles")) {
+        qWarning() << "Map Cache SQL error (detach MBTiles):" << query.lastError().text();
+    }
+}
+
+//-----------------------------------------------------------------------------
+//-- Tile count, zoom range and bounds of the attached MBTiles tiles. Bounds are those of the deepest zoom level.
+bool
+QGCCacheWorker::_getMBTilesExtent(QGCCachedTileSet* set)
+{
+    QSqlQuery query(*_db);
+    if(!query.exec("SELECT COUNT(*), MIN(zoom_level), MAX(zoom_level) FROM MBTiles.tiles") || !query.next() || !query.value(0).toUInt()) {
+        return false;
+    }
+    int maxZoom = query.value(2).toInt();
+    set->setTotalTileCount(query.value(0).toUInt());
+    set->setMinZoom(query.value(1).toInt());
+    set->setMaxZoom(maxZoom);
+    QString s = QString("SELECT MIN(tile_column), MAX(tile_column), MIN(tile_row), MAX(tile_row) FROM MBTiles.tiles WHERE zoom_level = %1").arg(maxZoom);
+    if(!query.exec(s) || !query.next()) {
+        return false;
+    }
+    int rows = 1 << maxZoom;
+    set->setTopleftLon(QGCMapEngine::tileX2long(query.value(0).toInt(), maxZoom));
+    set->setBottomRightLon(QGCMapEngine::tileX2long(query.value(1).toInt() + 1, maxZoom));
+    set->setTopleftLat(QGCMapEngine::tileY2lat(rows - 1 - query.value(3).toInt(), maxZoom));
+    set->setBottomRightLat(QGCMapEngine::tileY2lat(rows - query.value(2).toInt(), maxZoom));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::_exportTileSet(QGCMapTask* mtask)
+{
+    if(!_valid) {
+        mtask->setError("No Cache Database");
+        return;
+    }
+    QGCExportTileTask* task = static_cast<QGCExportTileTask*>(mtask);
+    if(task->mapType() == UrlFactory::Invalid) {
+        task->setError("An MBTiles file holds a single map type");
+        return;
+    }
+    //-- Tiles of one map type are a single key range
+    QString x, y, z;
+    QGCMapEngine::getTileXYZSql("tileID", x, y, z);
+    QString where = QString("tileID >= %1 AND tileID < %2 AND tile IS NOT NULL")
+        .arg((qint64)QGCMapEngine::getTileKey(task->mapType(), 0, 0, 0))
+        .arg((qint64)QGCMapEngine::getTileKey((UrlFactory::MapType)(task->mapType() + 1), 0, 0, 0));
+    if(task->setID() != UINT64_MAX) {
+        where += QString(" AND tileID IN (SELECT tileID FROM SetTiles WHERE setID = %1)").arg(task->setID());
+    }
+    //-- The file is replaced, not merged into
+    QFile::remove(task->path());
+    if(!_attachMBTiles(task->path())) {
+        task->setError("Error creating MBTiles file");
+        return;
+    }
+    QSqlQuery query(*_db);
+    //-- A single format is declared for the whole file. Use the one most tiles have.
+    QString format = "png";
+    QString s = QString("SELECT format FROM Tiles WHERE %1 GROUP BY format ORDER BY COUNT(*) DESC LIMIT 1").arg(where);
+    if(query.exec(s) && query.next()) {
+        format = query.value(0).toString();
+    }
+    QStringList statements;
+    statements << "CREATE TABLE MBTiles.metadata (name TEXT, value TEXT)";
+    statements << "CREATE TABLE MBTiles.tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)";
+    //-- Walks Tiles in key order, which is (z, x, y)
+    statements << QString("INSERT INTO MBTiles.tiles(zoom_level, tile_column, tile_row, tile_data) "
+        "SELECT %1, %2, (1 << %1) - 1 - %3, tile FROM Tiles WHERE %4 ORDER BY tileID").arg(z).arg(x).arg(y).arg(where);
+    //-- Indexing once filled is cheaper than keeping the index up to date row by row
+    statements << "CREATE UNIQUE INDEX MBTiles.tile_index ON tiles(zoom_level, tile_column, tile_row)";
+    _db->transaction();
+    for(int i = 0; i < statements.count(); i++) {
+        if(!query.exec(statements[i])) {
+            qWarning() << "Map Cache SQL error (export MBTiles):" << query.lastError().text();
+            query.finish();
+            _db->rollback();
+            _detachMBTiles();
+            task->setError("Error writing MBTiles file");
+            return;
+        }
+    }
+    QGCCachedTileSet extent(task->name());
+    if(!_getMBTilesExtent(&extent)) {
+        _db->rollback();
+        _detachMBTiles();
+        task->setError("No tiles to export");
+        return;
+    }
+    QList<QPair<QString, QString> > metadata;
+    metadata << qMakePair(QString("name"),      task->name());
+    metadata << qMakePair(QString("format"),    format);
+    metadata << qMakePair(QString("type"),      QString("baselayer"));
+    metadata << qMakePair(QString("version"),   QString("1.1"));
+    metadata << qMakePair(QString("minzoom"),   QString::number(extent.minZoom()));
+    metadata << qMakePair(QString("maxzoom"),   QString::number(extent.maxZoom()));
+    metadata << qMakePair(QString("bounds"),    QString("%1,%2,%3,%4")
+        .arg(extent.topleftLon(), 0, 'g', 12).arg(extent.bottomRightLat(), 0, 'g', 12)
+        .arg(extent.bottomRightLon(), 0, 'g', 12).arg(extent.topleftLat(), 0, 'g', 12));
+    //-- Not part of the spec. Lets an import file the tiles under the map type they came from.
+    metadata << qMakePair(QString("qgc_map_type"), QString::number((int)task->mapType()));
+    query.prepare("INSERT INTO MBTiles.metadata(name, value) VALUES(?, ?)");
+    for(int i = 0; i < metadata.count(); i++) {
+        query.bindValue(0, metadata[i].first);
+        query.bindValue(1, metadata[i].second);
+        query.exec();
+    }
+    //-- Nothing may be left running on the file for it to detach
+    query.finish();
+    bool committed = _db->commit();
+    _detachMBTiles();
+    if(!committed) {
+        qWarning() << "Map Cache SQL error (export MBTiles commit):" << _db->lastError().text();
+        task->setError("Error writing MBTiles file");
+        return;
+    }
+    qCDebug(QGCTileCacheLog) << "_exportTileSet()" << extent.totalTileCount() << "tiles to" << task->path();
+    task->setExported(extent.totalTileCount());
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::_importTileSet(QGCMapTask* mtask)
+{
+    if(!_valid) {
+        mtask->setError("No Cache Database");
+        return;
+    }
+    QGCImportTileTask* task = static_cast<QGCImportTileTask*>(mtask);
+    QGCCachedTileSet* set = task->tileSet();
+    if(!_attachMBTiles(task->path())) {
+        task->setError("Error opening MBTiles file");
+        return;
+    }
+    QSqlQuery query(*_db);
+    QHash<QString, QString> metadata;
+    if(query.exec("SELECT name, value FROM MBTiles.metadata")) {
+        while(query.next()) {
+            metadata[query.value(0).toString()] = query.value(1).toString();
+        }
+    }
+    //-- Files exported from here know their map type, anything else is filed under the one given
+    if(metadata.contains("qgc_map_type")) {
+        set->setType((UrlFactory::MapType)metadata["qgc_map_type"].toInt());
+        set->setMapTypeStr(QGCMapEngine::getMapName(set->type()));
+    }
+    if(set->type() == UrlFactory::Invalid) {
+        _detachMBTiles();
+        task->setError("Unknown map type for MBTiles file");
+        return;
+    }
+    if(!_getMBTilesExtent(set)) {
+        _detachMBTiles();
+        task->setError("No tiles in MBTiles file");
+        return;
+    }
+    QString format = metadata.value("format", "png");
+    uint    now    = QDateTime::currentDateTime().toTime_t();
+    //-- The rows are flipped to XYZ and keyed the same way as downloaded tiles
+    QString key = QGCMapEngine::getTileKeySql(QString::number((int)set->type()), "tile_column", "((1 << zoom_level) - 1 - tile_row)", "zoom_level");
+    //-- Everything goes in a single transaction. The set is complete, so there is nothing to enumerate (cursor -1).
+    _db->transaction();
+    query.prepare("INSERT INTO TileSets("
+        "name, typeStr, topleftLat, topleftLon, bottomRightLat, bottomRightLon, minZoom, maxZoom, type, numTiles, date, enumCursor"
+        ") VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, -1)");
+    query.addBindValue(set->name());
+    query.addBindValue(set->mapTypeStr());
+    query.addBindValue(set->topleftLat());
+    query.addBindValue(set->topleftLon());
+    query.addBindValue(set->bottomRightLat());
+    query.addBindValue(set->bottomRightLon());
+    query.addBindValue(set->minZoom());
+    query.addBindValue(set->maxZoom());
+    query.addBindValue(set->type());
+    query.addBindValue(set->totalTileCount());
+    query.addBindValue(now);
+    bool ok = query.exec();
+    if(ok) {
+        set->setId(query.lastInsertId().toULongLong());
+        //-- Descending rows are ascending keys, so tiles are appended to the table in order
+        query.prepare(QString("INSERT OR IGNORE INTO Tiles(tileID, format, tile, size, date) "
+            "SELECT %1, ?, tile_data, LENGTH(tile_data), ? FROM MBTiles.tiles ORDER BY zoom_level, tile_column, tile_row DESC").arg(key));
+        query.addBindValue(format);
+        query.addBindValue(now);
+        ok = query.exec();
+    }
+    if(ok) {
+        //-- Tiles already in the cache are shared with the new set
+        ok = query.exec(QString("INSERT INTO SetTiles(tileID, setID) SELECT %1, %2 FROM MBTiles.tiles").arg(key).arg(set->id()));
+    }
+    if(!ok) {
+        qWarning() << "Map Cache SQL error (import MBTiles):" << query.lastError().text();
+        query.finish();
+        _db->rollback();
+        _detachMBTiles();
+        task->setError("Error importing MBTiles file");
+        return;
+    }
+    //-- Nothing may be left running on the file for it to detach
+    query.finish();
+    bool committed = _db->commit();
+    _detachMBTiles();
+    if(!committed) {
+        qWarning() << "Map Cache SQL error (import MBTiles commit):" << _db->lastError().text();
+        task->setError("Error importing MBTiles file");
+        return;
+    }
+    //-- The ID may be one a deleted set had
+    _runsSetID = UINT64_MAX;
+    qCDebug(QGCTileCacheLog) << "_importTileSet()" << set->totalTileCount() << "tiles from" << task->path() << "into set" << set->id();
+    _updateSetTotals(set);
+    task->setTileSetImported();
+}
+
 //-----------------------------------------------------------------------------
 bool
 QGCCacheWorker::_init()
@@ -644,7 +1167,7 @@ QGCCacheWorker::_init()
     if(!_databasePath.isEmpty()) {
         qCDebug(QGCTileCacheLog) << "Mapping cache directory:" << _databasePath;
         //-- Initialize Database
-        _db = new QSqlDatabase(QSqlDatabase::addDatabase("QSQLITE", kSession));
+        _db = new QSqlDatabase(QSqlDatabase::addDatabase("QSQLITE", _session));
         _db->setDatabaseName(_databasePath);
         _db->setConnectOptions("QSQLITE_ENABLE_SHARED_CACHE");
         if (_db->open()) {
@@ -655,7 +1178,7 @@ QGCCacheWorker::_init()
         }
         delete _db;
         _db = NULL;
-        QSqlDatabase::removeDatabase(kSession);
+        QSqlDatabase::removeDatabase(_session);
     } else {
         qCritical() << "Could not find suitable cache directory.";
         _failed = true;
@@ -665,19 +1188,249 @@ QGCCacheWorker::_init()
 
 //-----------------------------------------------------------------------------
 void
-QGCCacheWorker::_createDB()
+QGCCacheWorker::_configureDatabase()
+{
+    QSqlQuery query(*_db);
+    //-- WAL lets readers proceed while tiles are being written and turns each commit into a sequential append
+    QString s = QString("PRAGMA journal_mode=%1").arg(_walMode ? "WAL" : "DELETE");
+    if(!query.exec(s)) {
+        qWarning() << "Map Cache SQL error (journal mode):" << query.lastError().text();
+    }
+    //-- With WAL, NORMAL only syncs at checkpoints. A crash may lose the last few tiles, which are simply downloaded again.
+    int synchronous = qBound((int)SyncOff, _synchronous, (int)SyncFull);
+    s = QString("PRAGMA synchronous=%1").arg(synchronous);
+    if(!query.exec(s)) {
+        qWarning() << "Map Cache SQL error (synchronous):" << query.lastError().text();
+    }
+    qCDebug(QGCTileCacheLog) << "_configureDatabase() WAL:" << _walMode << "Synchronous:" << synchronous;
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCCacheWorker::_createTotals()
 {
     QSqlQuery query(*_db);
+    //-- Used by the totals triggers to find the sets a tile belongs to
+    if(!query.exec("CREATE INDEX IF NOT EXISTS SetTilesTileIdx ON SetTiles(tileID)")) {
+        qWarning() << "Map Cache SQL error (create SetTiles index):" << query.lastError().text();
+        return false;
+    }
+    //-- Used by prune to find the tiles of a set and the least recently used tiles
+    if(!query.exec("CREATE INDEX IF NOT EXISTS SetTilesSetIdx ON SetTiles(setID)") ||
+       !query.exec("CREATE INDEX IF NOT EXISTS TilesDateIdx ON Tiles(date)")) {
+        qWarning() << "Map Cache SQL error (create prune indices):" << query.lastError().text();
+        return false;
+    }
+    bool exists = false;
+    if(query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'TileTotals'")) {
+        exists = query.next();
+    }
+    //-- One row per tile set plus one (kTotalsSetID) for the whole cache. "Unique" tiles are the ones which
+    //   belong to that set only, which is what would be freed if the set was deleted.
     if(!query.exec(
-        "CREATE TABLE IF NOT EXISTS Tiles ("
-        "tileID INTEGER PRIMARY KEY NOT NULL, "
-        "hash TEXT NOT NULL UNIQUE, "
-        "format TEXT NOT NULL, "
-        "tile BLOB NULL, "
-        "size INTEGER, "
-        "type INTEGER, "
-        "date INTEGER DEFAULT 0)"))
+        "CREATE TABLE IF NOT EXISTS TileTotals ("
+        "setID INTEGER PRIMARY KEY NOT NULL, "
+        "tileCount INTEGER DEFAULT 0, "
+        "tileSize INTEGER DEFAULT 0, "
+        "uniqueCount INTEGER DEFAULT 0, "
+        "uniqueSize INTEGER DEFAULT 0)"))
     {
+        qWarning() << "Map Cache SQL error (create TileTotals db):" << query.lastError().text();
+        return false;
+    }
+    if(!exists && !_populateTotals()) {
+        return false;
+    }
+    //-- Triggers keep the totals current in the same transaction as the change itself
+    QStringList triggers;
+    triggers <<
+        QString("CREATE TRIGGER IF NOT EXISTS TilesInsertTotals AFTER INSERT ON Tiles "
+        "BEGIN "
+        "UPDATE TileTotals SET tileCount = tileCount + 1, tileSize = tileSize + IFNULL(NEW.size, 0) WHERE setID = %1; "
+        "END").arg(kTotalsSetID);
+    //-- Set membership goes with the tile. This runs before the delete so the tile size is still there.
+    triggers <<
+        QString("CREATE TRIGGER IF NOT EXISTS TilesDeleteTotals BEFORE DELETE ON Tiles "
+        "BEGIN "
+        "UPDATE TileTotals SET tileCount = tileCount - 1, tileSize = tileSize - IFNULL(OLD.size, 0) WHERE setID = %1; "
+        "DELETE FROM SetTiles WHERE tileID = OLD.tileID; "
+        "END").arg(kTotalsSetID);
+    triggers <<
+        "CREATE TRIGGER IF NOT EXISTS SetTilesInsertTotals AFTER INSERT ON SetTiles "
+        "BEGIN "
+        "UPDATE TileTotals SET tileCount = tileCount + 1, tileSize = tileSize + IFNULL((SELECT size FROM Tiles WHERE tileID = NEW.tileID), 0) "
+        "WHERE setID = NEW.setID; "
+        //-- First set for this tile: it is unique to it
+        "UPDATE TileTotals SET uniqueCount = uniqueCount + 1, uniqueSize = uniqueSize + IFNULL((SELECT size FROM Tiles WHERE tileID = NEW.tileID), 0) "
+        "WHERE setID = NEW.setID AND (SELECT COUNT(*) FROM SetTiles WHERE tileID = NEW.tileID) = 1; "
+        //-- Second set for this tile: it is no longer unique to the first one
+        "UPDATE TileTotals SET uniqueCount = uniqueCount - 1, uniqueSize = uniqueSize - IFNULL((SELECT size FROM Tiles WHERE tileID = NEW.tileID), 0) "
+        "WHERE setID IN (SELECT setID FROM SetTiles WHERE tileID = NEW.tileID AND rowid != NEW.rowid) AND (SELECT COUNT(*) FROM SetTiles WHERE tileID = NEW.tileID) = 2; "
+        "END";
+    triggers <<
+        "CREATE TRIGGER IF NOT EXISTS SetTilesDeleteTotals AFTER DELETE ON SetTiles "
+        "BEGIN "
+        "UPDATE TileTotals SET tileCount = tileCount - 1, tileSize = tileSize - IFNULL((SELECT size FROM Tiles WHERE tileID = OLD.tileID), 0) "
+        "WHERE setID = OLD.setID; "
+        //-- Was only in this set
+        "UPDATE TileTotals SET uniqueCount = uniqueCount - 1, uniqueSize = uniqueSize - IFNULL((SELECT size FROM Tiles WHERE tileID = OLD.tileID), 0) "
+        "WHERE setID = OLD.setID AND (SELECT COUNT(*) FROM SetTiles WHERE tileID = OLD.tileID) = 0; "
+        //-- Now only in one other set, which makes it unique to that one
+        "UPDATE TileTotals SET uniqueCount = uniqueCount + 1, uniqueSize = uniqueSize + IFNULL((SELECT size FROM Tiles WHERE tileID = OLD.tileID), 0) "
+        "WHERE setID IN (SELECT setID FROM SetTiles WHERE tileID = OLD.tileID) AND (SELECT COUNT(*) FROM SetTiles WHERE tileID = OLD.tileID) = 1; "
+        "END";
+    triggers <<
+        "CREATE TRIGGER IF NOT EXISTS TileSetsInsertTotals AFTER INSERT ON TileSets "
+        "BEGIN "
+        "INSERT OR IGNORE INTO TileTotals(setID) VALUES(NEW.setID); "
+        "END";
+    triggers <<
+        "CREATE TRIGGER IF NOT EXISTS TileSetsDeleteTotals AFTER DELETE ON TileSets "
+        "BEGIN "
+        "DELETE FROM TileTotals WHERE setID = OLD.setID; "
+        "END";
+    for(int i = 0; i < triggers.count(); i++) {
+        if(!query.exec(triggers[i])) {
+            qWarning() << "Map Cache SQL error (create totals trigger):" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCCacheWorker::_populateTotals()
+{
+    //-- One time aggregation for caches created before totals were tracked
+    qCDebug(QGCTileCacheLog) << "_populateTotals()";
+    _db->transaction();
+    QSqlQuery query(*_db);
+    QStringList statements;
+    //-- Prune used to leave set entries behind for deleted tiles
+    statements << "DELETE FROM SetTiles WHERE tileID NOT IN (SELECT tileID FROM Tiles)";
+    statements << QString("INSERT INTO TileTotals(setID, tileCount, tileSize) SELECT %1, COUNT(size), IFNULL(SUM(size), 0) FROM Tiles").arg(kTotalsSetID);
+    statements << "INSERT INTO TileTotals(setID) SELECT setID FROM TileSets";
+    statements <<
+        QString("UPDATE TileTotals SET "
+        "tileCount = (SELECT COUNT(A.size) FROM Tiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = TileTotals.setID), "
+        "tileSize = (SELECT IFNULL(SUM(A.size), 0) FROM Tiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = TileTotals.setID) "
+        "WHERE setID != %1").arg(kTotalsSetID);
+    statements <<
+        QString("UPDATE TileTotals SET "
+        "uniqueCount = (SELECT COUNT(A.size) FROM Tiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = TileTotals.setID AND "
+            "A.tileID IN (SELECT tileID FROM SetTiles GROUP BY tileID HAVING COUNT(tileID) = 1)), "
+        "uniqueSize = (SELECT IFNULL(SUM(A.size), 0) FROM Tiles A JOIN SetTiles B ON A.tileID = B.tileID WHERE B.setID = TileTotals.setID AND "
+            "A.tileID IN (SELECT tileID FROM SetTiles GROUP BY tileID HAVING COUNT(tileID) = 1)) "
+        "WHERE setID != %1").arg(kTotalsSetID);
+    for(int i = 0; i < statements.count(); i++) {
+        if(!query.exec(statements[i])) {
+            qWarning() << "Map Cache SQL error (populate totals):" << query.lastError().text();
+            _db->rollback();
+            return false;
+        }
+    }
+    return _db->commit();
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCCacheWorker::_migrateTileKeys()
+{
+    //-- Caches created before tiles were keyed by integer use a "%04d%08d%08d%03d" (type, x, y, z) text hash
+    if(!_hasColumn("Tiles", "hash")) {
+        return true;
+    }
+    QSqlQuery query(*_db);
+    qCDebug(QGCTileCacheLog) << "_migrateTileKeys()";
+    QString hashKey = QGCMapEngine::getTileKeySql(
+        "CAST(substr(hash, 1, 4) AS INTEGER)", "CAST(substr(hash, 5, 8) AS INTEGER)",
+        "CAST(substr(hash, 13, 8) AS INTEGER)", "CAST(substr(hash, 21, 3) AS INTEGER)");
+    QString validHash = "length(hash) = 23 AND hash NOT LIKE '-%'";
+    QStringList statements;
+    //-- Totals, their triggers and indices are created again by _createTotals() once the tables have their new form
+    statements << "DROP TRIGGER IF EXISTS TilesInsertTotals";
+    statements << "DROP TRIGGER IF EXISTS TilesDeleteTotals";
+    statements << "DROP TRIGGER IF EXISTS SetTilesInsertTotals";
+    statements << "DROP TRIGGER IF EXISTS SetTilesDeleteTotals";
+    statements << "DROP TRIGGER IF EXISTS TileSetsInsertTotals";
+    statements << "DROP TRIGGER IF EXISTS TileSetsDeleteTotals";
+    statements << "DROP TABLE IF EXISTS TileTotals";
+    statements << "DROP INDEX IF EXISTS TilesDateIdx";
+    statements << "ALTER TABLE Tiles RENAME TO TilesV1";
+    statements << kCreateTiles;
+    statements << QString("INSERT OR IGNORE INTO Tiles(tileID, format, tile, size, date) SELECT %1, format, tile, size, date FROM TilesV1 WHERE %2").arg(hashKey).arg(validHash);
+    //-- Set membership follows the tile to its new key
+    statements << QString("UPDATE SetTiles SET tileID = (SELECT %1 FROM TilesV1 WHERE TilesV1.tileID = SetTiles.tileID AND %2)").arg(hashKey).arg(validHash);
+    statements << "DELETE FROM SetTiles WHERE tileID IS NULL";
+    statements << "DROP TABLE TilesV1";
+    //-- Pending downloads already have the parts of the key in their own columns
+    bool downloads = false;
+    if(query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'TilesDownload'")) {
+        downloads = query.next();
+    }
+    if(downloads) {
+        statements << "ALTER TABLE TilesDownload RENAME TO TilesDownloadV1";
+        statements << kCreateTilesDownload;
+        statements << QString("INSERT OR IGNORE INTO TilesDownload(setID, tileID, state) SELECT setID, %1, state FROM TilesDownloadV1 WHERE type >= 0")
+            .arg(QGCMapEngine::getTileKeySql("type", "x", "y", "z"));
+        statements << "DROP TABLE TilesDownloadV1";
+    }
+    query.finish();
+    //-- All or nothing. On failure the rollback leaves the cache exactly as it was.
+    if(!_db->transaction()) {
+        qWarning() << "Map Cache SQL error (migrate tile keys begin transaction):" << _db->lastError().text();
+        return false;
+    }
+    for(int i = 0; i < statements.count(); i++) {
+        if(!query.exec(statements[i])) {
+            qWarning() << "Map Cache SQL error (migrate tile keys):" << query.lastError().text();
+            query.finish();
+            _db->rollback();
+            return false;
+        }
+    }
+    if(!_db->commit()) {
+        qWarning() << "Map Cache SQL error (migrate tile keys commit):" << _db->lastError().text();
+        _db->rollback();
+        return false;
+    }
+    //-- Give the space used by the text keys and their index back
+    if(!query.exec("VACUUM")) {
+        qWarning() << "Map Cache SQL error (vacuum after migration):" << query.lastError().text();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCCacheWorker::_hasColumn(const QString& table, const QString& column)
+{
+    QSqlQuery query(*_db);
+    if(query.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+        while(query.next()) {
+            if(query.value("name").toString() == column) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCCacheWorker::_createDB()
+{
+    QSqlQuery query(*_db);
+    if(!_migrateTileKeys()) {
+        //-- The cache still holds the user's offline tile sets in the old form. Leave it alone, the migration
+        //   is tried again the next time around.
+        qCritical() << "Map Cache could not be upgraded, the cache is disabled:" << _databasePath;
+        _valid = false;
+        _failed = true;
+        return;
+    }
+    if(!query.exec(kCreateTiles)) {
         qWarning() << "Map Cache SQL error (create Tiles db):" << query.lastError().text();
     } else {
         if(!query.exec(
@@ -694,9 +1447,18 @@ QGCCacheWorker::_createDB()
             "type INTEGER DEFAULT -1, "
             "numTiles INTEGER DEFAULT 0, "
             "defaultSet INTEGER DEFAULT 0, "
-            "date INTEGER DEFAULT 0)"))
+            "date INTEGER DEFAULT 0, "
+            //-- Key of the next tile to look at when enumerating the set for download, -1 once done. Sets
+            //   from before sets were enumerated lazily get -1, their whole download list is in TilesDownload.
+            "enumCursor INTEGER DEFAULT -1, "
+            //-- Polygon the set is clipped to, NULL for the whole of the bounds
+            "polygon TEXT)"))
         {
             qWarning() << "Map Cache SQL error (create TileSets db):" << query.lastError().text();
+        } else if(!_hasColumn("TileSets", "enumCursor") && !query.exec("ALTER TABLE TileSets ADD COLUMN enumCursor INTEGER DEFAULT -1")) {
+            qWarning() << "Map Cache SQL error (add TileSets cursor):" << query.lastError().text();
+        } else if(!_hasColumn("TileSets", "polygon") && !query.exec("ALTER TABLE TileSets ADD COLUMN polygon TEXT")) {
+            qWarning() << "Map Cache SQL error (add TileSets polygon):" << query.lastError().text();
         } else {
             if(!query.exec(
                 "CREATE TABLE IF NOT EXISTS SetTiles ("
@@ -705,18 +1467,9 @@ QGCCacheWorker::_createDB()
             {
                 qWarning() << "Map Cache SQL error (create SetTiles db):" << query.lastError().text();
             } else {
-                if(!query.exec(
-                    "CREATE TABLE IF NOT EXISTS TilesDownload ("
-                    "setID INTEGER, "
-                    "hash TEXT NOT NULL UNIQUE, "
-                    "type INTEGER, "
-                    "x INTEGER, "
-                    "y INTEGER, "
-                    "z INTEGER, "
-                    "state INTEGER DEFAULT 0)"))
-                {
+                if(!query.exec(kCreateTilesDownload)) {
                     qWarning() << "Map Cache SQL error (create TilesDownload db):" << query.lastError().text();
-                } else {
+                } else if(_createTotals()) {
                     //-- Database it ready for use
                     _valid = true;
                 }
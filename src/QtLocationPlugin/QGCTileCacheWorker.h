@@ -22,17 +22,24 @@
 #include <QString>
 #include <QThread>
 #include <QQueue>
+#include <QSet>
+#include <QVector>
+#include <QGeoCoordinate>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QMutexLocker>
 #include <QtSql/QSqlDatabase>
 
 #include "QGCLoggingCategory.h"
+#include "QGCTileCacheReader.h"
+#include "QGCMapUrlEngine.h"
+#include "QGCMapEngineData.h"
 
 Q_DECLARE_LOGGING_CATEGORY(QGCTileCacheLog)
 
 class QGCMapTask;
 class QGCCachedTileSet;
+class QGCTileMemCache;
 
 //-----------------------------------------------------------------------------
 class QGCCacheWorker : public QThread
@@ -42,15 +49,38 @@ public:
     QGCCacheWorker  ();
     ~QGCCacheWorker ();
 
+    //-- SQLite synchronous levels (PRAGMA synchronous)
+    enum Synchronous {
+        SyncOff     = 0,
+        SyncNormal  = 1,
+        SyncFull    = 2
+    };
+
     void    quit            ();
     bool    enqueueTask     (QGCMapTask* task);
     void    setDatabaseFile (const QString& path);
+    //-- These take effect the next time the database is opened by the worker thread
+    void    setSynchronous  (int synchronous)   { _synchronous = synchronous; }
+    void    setWalMode      (bool walMode)      { _walMode = walMode; }
+    //-- Max number of queued tiles saved in a single transaction
+    void    setSaveBatchSize(int size)          { _saveBatchSize = size > 0 ? size : 1; }
+    //-- Number of read only connections serving tile fetches. With 0 tiles are fetched by the worker itself.
+    void    setReaderCount  (int count)         { _readerPool->setReaderCount(count); }
+
+    //-- Hot tile cache to keep in step with the database. Tiles deleted from the database are dropped from it.
+    void    setMemCache     (QGCTileMemCache* memCache) { _memCache = memCache; }
+
+    //-- Records a tile use. Access times are written to the database in batches.
+    void    touchTile       (quint64 key);
+
+    //-- Shared by the worker and the reader threads
+    static void fetchTile   (QSqlDatabase& db, QGCMapTask* mtask);
 
 protected:
     void    run             ();
 
 private:
-    void        _saveTile               (QGCMapTask* mtask);
+    void        _saveTiles              (QList<QGCMapTask*>& tasks);
     void        _getTile                (QGCMapTask* mtask);
     void        _getTileSets            (QGCMapTask* mtask);
     void        _createTileSet          (QGCMapTask* mtask);
@@ -59,15 +89,28 @@ private:
     void        _deleteTileSet          (QGCMapTask* mtask);
     void        _resetCacheDatabase     (QGCMapTask* mtask);
     void        _pruneCache             (QGCMapTask* mtask);
+    void        _exportTileSet          (QGCMapTask* mtask);
+    void        _importTileSet          (QGCMapTask* mtask);
 
-    quint64     _findTile               (const QString hash);
+    bool        _enumerateTiles         (quint64 setID, int count, quint32& cachedCount, quint64& cachedSize);
     bool        _findTileSetID          (const QString name, quint64& setID);
+    bool        _attachMBTiles          (const QString& path);
+    void        _detachMBTiles          ();
+    bool        _getMBTilesExtent       (QGCCachedTileSet* set);
     void        _updateSetTotals        (QGCCachedTileSet* set);
     bool        _init                   ();
+    void        _configureDatabase      ();
     void        _createDB               ();
+    bool        _migrateTileKeys        ();
+    bool        _hasColumn              (const QString& table, const QString& column);
+    bool        _createTotals           ();
+    void        _updateAccessTimes      (bool force);
+    bool        _populateTotals         ();
     quint64     _getDefaultTileSet      ();
     void        _updateTotals           ();
 
+    static QVector<QGCTileRun> _zoomRuns(int z, double topleftLon, double topleftLat, double bottomRightLon, double bottomRightLat, const QList<QGeoCoordinate>& polygon);
+
 signals:
     void        updateTotals            (quint32 totaltiles, quint64 totalsize, quint32 defaulttiles, quint64 defaultsize);
 
@@ -77,6 +120,7 @@ private:
     QMutex                  _waitmutex;
     QWaitCondition          _waitc;
     QString                 _databasePath;
+    QString                 _session;
     QSqlDatabase*           _db;
     bool                    _valid;
     bool                    _failed;
@@ -87,6 +131,18 @@ private:
     quint32                 _defaultCount;
     time_t                  _lastUpdate;
     int                     _updateTimeout;
+    int                     _synchronous;
+    bool                    _walMode;
+    int                     _saveBatchSize;
+    QGCCacheReaderPool*     _readerPool;
+    QGCTileMemCache*        _memCache;
+    QSet<quint64>           _accessedTiles;
+    QMutex                  _accessMutex;
+    time_t                  _lastAccessUpdate;
+    //-- Tile runs of the zoom level being enumerated
+    quint64                 _runsSetID;
+    int                     _runsZoom;
+    QVector<QGCTileRun>     _runs;
 };
 
 #endif // QGC_TILE_CACHE_WORKER_H
@@ -0,0 +1,346 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief Map Tile Downloader
+ *
+ */
+
+#include "QGCTileDownloader.h"
+
+#include <QtGlobal>
+
+QGC_LOGGING_CATEGORY(QGCTileDownloaderLog, "QGCTileDownloaderLog")
+
+//-- Weight of the latest reply in the moving averages
+
+#define AVERAGE_WEIGHT          0.2
+
+//-- The limit backs off once the average latency is this much over the best seen
+
+#define LATENCY_FACTOR          2.0
+#define LATENCY_SLACK_MSECS     50.0
+
+//-- The limit only grows while the average error rate is below this
+
+#define MAX_ERROR_RATE          0.05
+
+//-- Retry delays are capped
+
+#define MAX_RETRY_DELAY_MSECS   30000
+
+//-- Rates are measured over this window
+
+#define RATE_WINDOW_MSECS       5000
+
+//-----------------------------------------------------------------------------
+QGCTileDownloader::QGCTileDownloader(QNetworkAccessManager* networkManager, QObject* parent)
+    : QObject(parent)
+    , _networkManager(networkManager)
+    , _rateBytes(0)
+    , _dispatchQueued(false)
+    , _lastRateSignal(0)
+    , _initialConcurrency(6)
+    , _maxConcurrency(24)
+    , _maxRetries(4)
+    , _retryDelay(500)
+{
+    _clock.start();
+    _retryTimer.setSingleShot(true);
+    connect(&_retryTimer, &QTimer::timeout, this, &QGCTileDownloader::_retryTimeout);
+}
+
+//-----------------------------------------------------------------------------
+QGCTileDownloader::~QGCTileDownloader()
+{
+    cancel();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::addTile(quint64 key, const QNetworkRequest& request)
+{
+    Download download;
+    download.key        = key;
+    download.request    = request;
+    download.host       = _hostName(request.url());
+    download.attempts   = 0;
+    download.started    = 0;
+    download.sequence   = 0;
+    //-- Lets the network manager pipeline requests on the connections it keeps to the host
+    download.request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    _queue.insert(key, download);
+    //-- Tiles usually come in batches. Waiting for the event loop lets the whole batch be ordered.
+    _queueDispatch();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::cancel()
+{
+    foreach(QNetworkReply* reply, _replies.keys()) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+    _replies.clear();
+    _queue.clear();
+    _retries.clear();
+    _retryTimer.stop();
+    for(QHash<QString, Host>::iterator i = _hosts.begin(); i != _hosts.end(); ++i) {
+        i.value().inFlight = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+int
+QGCTileDownloader::concurrency(const QString& host)
+{
+    return _hosts.contains(host) ? _hosts[host].limit : _initialConcurrency;
+}
+
+//-----------------------------------------------------------------------------
+double
+QGCTileDownloader::tilesPerSecond()
+{
+    _pruneRate();
+    if(_rateSamples.isEmpty()) {
+        return 0.0;
+    }
+    double span = qMax((double)(_clock.elapsed() - _rateSamples.head().first), 1000.0);
+    return _rateSamples.count() * 1000.0 / span;
+}
+
+//-----------------------------------------------------------------------------
+double
+QGCTileDownloader::bytesPerSecond()
+{
+    _pruneRate();
+    if(_rateSamples.isEmpty()) {
+        return 0.0;
+    }
+    double span = qMax((double)(_clock.elapsed() - _rateSamples.head().first), 1000.0);
+    return _rateBytes * 1000.0 / span;
+}
+
+//-----------------------------------------------------------------------------
+QGCTileDownloader::Host&
+QGCTileDownloader::_host(const QString& name)
+{
+    if(!_hosts.contains(name)) {
+        Host host;
+        host.limit      = qMin(_initialConcurrency, _maxConcurrency);
+        host.inFlight   = 0;
+        host.latency    = -1.0;
+        host.minLatency = -1.0;
+        host.errorRate  = 0.0;
+        host.roundCount = 0;
+        host.sent       = 0;
+        host.cutAt      = 0;
+        _hosts.insert(name, host);
+    }
+    return _hosts[name];
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_queueDispatch()
+{
+    if(!_dispatchQueued) {
+        _dispatchQueued = true;
+        QTimer::singleShot(0, this, &QGCTileDownloader::_dispatch);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_dispatch()
+{
+    _dispatchQueued = false;
+    //-- Walk the queue in key order, starting whatever the tile's host has room for
+    QMap<quint64, Download>::iterator i = _queue.begin();
+    while(i != _queue.end()) {
+        Host& host = _host(i.value().host);
+        if(host.inFlight >= host.limit) {
+            ++i;
+            continue;
+        }
+        Download download = i.value();
+        i = _queue.erase(i);
+        download.attempts++;
+        download.started  = _clock.elapsed();
+        download.sequence = host.sent++;
+        host.inFlight++;
+        QNetworkReply* reply = _networkManager->get(download.request);
+        connect(reply, &QNetworkReply::finished, this, &QGCTileDownloader::_replyFinished);
+        _replies.insert(reply, download);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_replyFinished()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(QObject::sender());
+    if(!reply || !_replies.contains(reply)) {
+        return;
+    }
+    Download download = _replies.take(reply);
+    reply->deleteLater();
+    Host& host = _host(download.host);
+    host.inFlight--;
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(reply->error() == QNetworkReply::NoError) {
+        QByteArray image = reply->readAll();
+        _succeeded(host, (double)(_clock.elapsed() - download.started));
+        _recordRate(image.size());
+        emit tileDownloaded(download.key, image);
+    } else if(_isRetryable(reply, status)) {
+        _failed(host, download);
+        if(download.attempts <= _maxRetries) {
+            qCDebug(QGCTileDownloaderLog) << "Retrying tile" << download.key << "after" << reply->errorString();
+            _scheduleRetry(download, reply->rawHeader("Retry-After").toInt());
+        } else {
+            emit tileFailed(download.key, reply->errorString());
+        }
+    } else {
+        //-- The host answered, the tile just isn't there. Nothing to learn about the host from it.
+        emit tileFailed(download.key, reply->errorString());
+    }
+    _queueDispatch();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_retryTimeout()
+{
+    qint64 now = _clock.elapsed();
+    while(!_retries.isEmpty() && _retries.firstKey() <= now) {
+        Download download = _retries.first();
+        _retries.erase(_retries.begin());
+        _queue.insert(download.key, download);
+    }
+    _startRetryTimer();
+    _queueDispatch();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_succeeded(Host& host, double latency)
+{
+    host.latency    = host.latency < 0.0 ? latency : host.latency + AVERAGE_WEIGHT * (latency - host.latency);
+    host.minLatency = host.minLatency < 0.0 ? host.latency : qMin(host.minLatency, host.latency);
+    host.errorRate -= AVERAGE_WEIGHT * host.errorRate;
+    //-- One change per round of replies, so each change shows its effect before the next one
+    if(++host.roundCount >= host.limit) {
+        host.roundCount = 0;
+        if(host.latency > host.minLatency * LATENCY_FACTOR + LATENCY_SLACK_MSECS) {
+            if(host.limit > 1) {
+                host.limit--;
+                qCDebug(QGCTileDownloaderLog) << "Latency up, concurrency down to" << host.limit << "Latency" << host.latency << "Best" << host.minLatency;
+            }
+        } else if(host.errorRate < MAX_ERROR_RATE && host.limit < _maxConcurrency) {
+            host.limit++;
+            qCDebug(QGCTileDownloaderLog) << "Concurrency up to" << host.limit << "Latency" << host.latency;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_failed(Host& host, const Download& download)
+{
+    host.errorRate += AVERAGE_WEIGHT * (1.0 - host.errorRate);
+    //-- Requests sent before the last cut fail for the same reason, they don't cut again
+    if(download.sequence >= host.cutAt && host.limit > 1) {
+        host.limit      = qMax(host.limit / 2, 1);
+        host.roundCount = 0;
+        host.cutAt      = host.sent;
+        qCDebug(QGCTileDownloaderLog) << "Errors, concurrency down to" << host.limit << "Error rate" << host.errorRate;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_scheduleRetry(const Download& download, int retryAfter)
+{
+    //-- Exponential backoff, spread between half and one and a half times so a burst of failures doesn't retry in lockstep
+    qint64 delay = qMin((qint64)_retryDelay << qMin(download.attempts - 1, 16), (qint64)MAX_RETRY_DELAY_MSECS);
+    delay = delay / 2 + (qint64)(qrand() % (int)(delay + 1));
+    //-- A throttling server may say how long to wait
+    delay = qMax(delay, (qint64)retryAfter * 1000);
+    _retries.insert(_clock.elapsed() + delay, download);
+    _startRetryTimer();
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_startRetryTimer()
+{
+    if(_retries.isEmpty()) {
+        _retryTimer.stop();
+    } else {
+        _retryTimer.start((int)qMax(_retries.firstKey() - _clock.elapsed(), (qint64)0));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_recordRate(int bytes)
+{
+    qint64 now = _clock.elapsed();
+    _rateSamples.enqueue(qMakePair(now, bytes));
+    _rateBytes += bytes;
+    _pruneRate();
+    if(now - _lastRateSignal >= 1000) {
+        _lastRateSignal = now;
+        emit rateChanged();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileDownloader::_pruneRate()
+{
+    qint64 oldest = _clock.elapsed() - RATE_WINDOW_MSECS;
+    while(!_rateSamples.isEmpty() && _rateSamples.head().first < oldest) {
+        _rateBytes -= _rateSamples.dequeue().second;
+    }
+}
+
+//-----------------------------------------------------------------------------
+QString
+QGCTileDownloader::_hostName(const QUrl& url)
+{
+    return QString("%1:%2").arg(url.host()).arg(url.port(url.scheme() == "https" ? 443 : 80));
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCTileDownloader::_isRetryable(QNetworkReply* reply, int status)
+{
+    if(status) {
+        //-- Throttled or trouble on the server side. Other HTTP errors (not found, forbidden) won't go away.
+        return status == 429 || status >= 500;
+    }
+    switch(reply->error()) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,133 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief Map Tile Downloader
+ *
+ *   Downloads the tiles of an offline tile set. Queued tiles go out in key
+ *   order, so lower zoom levels are requested first. Each host gets its own
+ *   limit on requests in flight. The limit grows by one every round of
+ *   requests the host answers quickly and without errors, is halved when
+ *   requests fail and shrinks by one when latency climbs. Failed requests
+ *   are retried after an exponential backoff with random jitter.
+ *
+ */
+
+#ifndef QGC_TILE_DOWNLOADER_H
+#define QGC_TILE_DOWNLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QHash>
+#include <QQueue>
+#include <QPair>
+#include <QUrl>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+#include "QGCLoggingCategory.h"
+
+Q_DECLARE_LOGGING_CATEGORY(QGCTileDownloaderLog)
+
+//-----------------------------------------------------------------------------
+class QGCTileDownloader : public QObject
+{
+    Q_OBJECT
+public:
+    QGCTileDownloader   (QNetworkAccessManager* networkManager, QObject* parent = NULL);
+    ~QGCTileDownloader  ();
+
+    //-- Queues a tile. Requests go out on the next pass through the event loop.
+    void        addTile                 (quint64 key, const QNetworkRequest& request);
+    //-- Drops queued tiles and aborts the ones in flight. Nothing is reported for them.
+    void        cancel                  ();
+
+    //-- Tiles not done yet, including those waiting for a retry
+    int         queuedCount             () { return _queue.count() + _retries.count(); }
+    int         inFlightCount           () { return _replies.count(); }
+    //-- Current limit on requests in flight to a host ("host:port")
+    int         concurrency             (const QString& host);
+    //-- Download rate over the last few seconds
+    double      tilesPerSecond          ();
+    double      bytesPerSecond          ();
+
+    void        setInitialConcurrency   (int count)     { _initialConcurrency = qMax(count, 1); }
+    void        setMaxConcurrency       (int count)     { _maxConcurrency = qMax(count, 1); }
+    void        setMaxRetries           (int count)     { _maxRetries = count; }
+    void        setRetryDelay           (int msecs)     { _retryDelay = msecs; }
+
+signals:
+    void        tileDownloaded          (quint64 key, QByteArray image);
+    //-- The tile could not be downloaded, retries included
+    void        tileFailed              (quint64 key, QString errorString);
+    //-- At most once a second while tiles come in
+    void        rateChanged             ();
+
+private slots:
+    void        _dispatch               ();
+    void        _replyFinished          ();
+    void        _retryTimeout           ();
+
+private:
+    struct Download {
+        quint64         key;
+        QNetworkRequest request;
+        QString         host;
+        int             attempts;
+        qint64          started;        //-- When the current attempt went out, msecs
+        quint64         sequence;       //-- Requests sent to the host before this one
+    };
+
+    struct Host {
+        int     limit;
+        int     inFlight;
+        double  latency;        //-- Moving average, msecs, negative until the first reply
+        double  minLatency;     //-- Best moving average seen, the baseline for "latency climbs"
+        double  errorRate;      //-- Moving average of failures, 0 to 1
+        int     roundCount;     //-- Replies since the limit last changed
+        quint64 sent;           //-- Requests sent so far
+        quint64 cutAt;          //-- Value of sent when the limit was last halved
+    };
+
+    Host&       _host                   (const QString& name);
+    void        _queueDispatch          ();
+    void        _succeeded              (Host& host, double latency);
+    void        _failed                 (Host& host, const Download& download);
+    void        _scheduleRetry          (const Download& download, int retryAfter);
+    void        _startRetryTimer        ();
+    void        _recordRate             (int bytes);
+    void        _pruneRate              ();
+
+    static QString  _hostName           (const QUrl& url);
+    static bool     _isRetryable        (QNetworkReply* reply, int status);
+
+    QNetworkAccessManager*              _networkManager;
+    QMap<quint64, Download>             _queue;         //-- By tile key, lowest zoom first
+    QMultiMap<qint64, Download>         _retries;       //-- By the time they are retried
+    QHash<QNetworkReply*, Download>     _replies;
+    QHash<QString, Host>                _hosts;
+    QQueue<QPair<qint64, int> >         _rateSamples;   //-- Time and size of recent downloads
+    qint64                              _rateBytes;
+    QElapsedTimer                       _clock;
+    QTimer                              _retryTimer;
+    bool                                _dispatchQueued;
+    qint64                              _lastRateSignal;
+    int                                 _initialConcurrency;
+    int                                 _maxConcurrency;
+    int                                 _maxRetries;
+    int                                 _retryDelay;
+};
+
+#endif // QGC_TILE_DOWNLOADER_H
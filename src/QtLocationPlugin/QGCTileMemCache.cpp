@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief In memory (hot) tile cache
+ *
+ */
+
+#include "QGCTileMemCache.h"
+
+#include <QMutexLocker>
+#include <QHash>
+
+#include <limits.h>
+
+//-----------------------------------------------------------------------------
+QGCTileMemCache::QGCTileMemCache(quint64 maxBytes)
+    : _maxBytes(0)
+{
+    setMaxBytes(maxBytes);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileMemCache::setMaxBytes(quint64 maxBytes)
+{
+    _maxBytes = maxBytes;
+    //-- QCache cost is an int. Each shard gets an equal part of the budget.
+    int shardBytes = (int)qMin(maxBytes / kShardCount, (quint64)INT_MAX);
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        int count = _shards[i].cache.count();
+        _shards[i].cache.setMaxCost(shardBytes);
+        _shards[i].evictions += count - _shards[i].cache.count();
+    }
+}
+
+//-----------------------------------------------------------------------------
+QGCTileMemCache::Shard&
+QGCTileMemCache::_shard(quint64 key)
+{
+    return _shards[qHash(key) % kShardCount];
+}
+
+//-----------------------------------------------------------------------------
+bool
+QGCTileMemCache::find(quint64 key, QByteArray& image, QString& format)
+{
+    Shard& shard = _shard(key);
+    QMutexLocker lock(&shard.mutex);
+    Tile* tile = shard.cache.object(key);
+    if(!tile) {
+        shard.misses++;
+        return false;
+    }
+    //-- Implicitly shared, no copy of the image data
+    image  = tile->image;
+    format = tile->format;
+    shard.hits++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileMemCache::insert(quint64 key, const QByteArray& image, const QString& format)
+{
+    Shard& shard = _shard(key);
+    QMutexLocker lock(&shard.mutex);
+    //-- Replacing a tile is not an eviction
+    shard.cache.remove(key);
+    int count = shard.cache.count();
+    Tile* tile = new Tile;
+    tile->image  = image;
+    tile->format = format;
+    //-- If the tile is larger than the whole shard QCache deletes it right away
+    if(shard.cache.insert(key, tile, image.size())) {
+        shard.evictions += count + 1 - shard.cache.count();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileMemCache::remove(quint64 key)
+{
+    Shard& shard = _shard(key);
+    QMutexLocker lock(&shard.mutex);
+    shard.cache.remove(key);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCTileMemCache::clear()
+{
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        _shards[i].cache.clear();
+    }
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCTileMemCache::hits()
+{
+    quint64 total = 0;
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        total += _shards[i].hits;
+    }
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCTileMemCache::misses()
+{
+    quint64 total = 0;
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        total += _shards[i].misses;
+    }
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCTileMemCache::evictions()
+{
+    quint64 total = 0;
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        total += _shards[i].evictions;
+    }
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+quint64
+QGCTileMemCache::bytes()
+{
+    quint64 total = 0;
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        total += _shards[i].cache.totalCost();
+    }
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+quint32
+QGCTileMemCache::count()
+{
+    quint32 total = 0;
+    for(int i = 0; i < kShardCount; i++) {
+        QMutexLocker lock(&_shards[i].mutex);
+        total += _shards[i].cache.count();
+    }
+    return total;
+}
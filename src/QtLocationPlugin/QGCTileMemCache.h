@@ -0,0 +1,79 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file
+ *   @brief In memory (hot) tile cache
+ *
+ *   Keeps recently used tile images in memory so cache hits don't need a
+ *   round trip through the cache worker and SQLite. Tiles are spread across
+ *   shards, each with its own lock and LRU, so concurrent lookups don't
+ *   contend on a single mutex. The size limit is in bytes of tile data.
+ *
+ */
+
+#ifndef QGC_TILE_MEM_CACHE_H
+#define QGC_TILE_MEM_CACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+
+//-----------------------------------------------------------------------------
+class QGCTileMemCache
+{
+public:
+    QGCTileMemCache             (quint64 maxBytes = 0);
+
+    void        setMaxBytes     (quint64 maxBytes);
+    quint64     maxBytes        () { return _maxBytes; }
+
+    //-- Returns true and fills in image/format if the tile is in memory. Marks the tile as most recently used.
+    bool        find            (quint64 key, QByteArray& image, QString& format);
+    void        insert          (quint64 key, const QByteArray& image, const QString& format);
+    void        remove          (quint64 key);
+    void        clear           ();
+
+    //-- Statistics (summed across all shards)
+    quint64     hits            ();
+    quint64     misses          ();
+    quint64     evictions       ();
+    quint64     bytes           ();
+    quint32     count           ();
+
+private:
+    class Tile
+    {
+    public:
+        QByteArray  image;
+        QString     format;
+    };
+
+    class Shard
+    {
+    public:
+        Shard() : hits(0), misses(0), evictions(0) {}
+        QMutex              mutex;
+        QCache<quint64,Tile> cache;     ///< Cost is the image size in bytes
+        quint64             hits;
+        quint64             misses;
+        quint64             evictions;
+    };
+
+    Shard&      _shard          (quint64 key);
+
+    enum { kShardCount = 8 };
+
+    Shard       _shards[kShardCount];
+    quint64     _maxBytes;
+};
+
+#endif // QGC_TILE_MEM_CACHE_H
@@ -57,6 +57,7 @@ QGeoTiledMapReplyQGC::QGeoTiledMapReplyQGC(QNetworkAccessManager *networkManager
     , _reply(NULL)
     , _request(request)
     , _networkManager(networkManager)
+    , _key(QGCMapEngine::getTileKey((UrlFactory::MapType)spec.mapId(), spec.x(), spec.y(), spec.zoom()))
 {
     if(_request.url().isEmpty()) {
         if(!_badMapBox.size()) {
@@ -69,7 +70,17 @@ QGeoTiledMapReplyQGC::QGeoTiledMapReplyQGC(QNetworkAccessManager *networkManager
         setFinished(true);
         setCached(false);
     } else {
-        QGCFetchTileTask* task = getQGCMapEngine()->createFetchTileTask((UrlFactory::MapType)spec.mapId(), spec.x(), spec.y(), spec.zoom());
+        //-- Recently used tiles are answered straight from memory
+        QByteArray image;
+        QString format;
+        if(getQGCMapEngine()->fetchMemTile(_key, image, format)) {
+            setMapImageData(image);
+            setMapImageFormat(format);
+            setFinished(true);
+            setCached(true);
+            return;
+        }
+        QGCFetchTileTask* task = getQGCMapEngine()->createFetchTileTask(_key);
         connect(task, &QGCFetchTileTask::tileFetched, this, &QGeoTiledMapReplyQGC::cacheReply);
         connect(task, &QGCMapTask::error, this, &QGeoTiledMapReplyQGC::cacheError);
         getQGCMapEngine()->addTask(task);
@@ -114,7 +125,8 @@ QGeoTiledMapReplyQGC::networkReplyFinished()
     QString format = getQGCMapEngine()->urlFactory()->getImageFormat((UrlFactory::MapType)tileSpec().mapId(), a);
     if(!format.isEmpty()) {
         setMapImageFormat(format);
-        getQGCMapEngine()->cacheTile((UrlFactory::MapType)tileSpec().mapId(), tileSpec().x(), tileSpec().y(), tileSpec().zoom(), a, format);
+        getQGCMapEngine()->cacheTile((UrlFactory::MapType)tileSpec().mapId(), _key, a, format);
+        getQGCMapEngine()->cacheMemTile(_key, a, format);
     }
     setFinished(true);
     _reply->deleteLater();
@@ -165,6 +177,7 @@ QGeoTiledMapReplyQGC::cacheReply(QGCCacheTile* tile)
 {
     setMapImageData(tile->img());
     setMapImageFormat(tile->format());
+    getQGCMapEngine()->cacheMemTile(_key, tile->img(), tile->format());
     setFinished(true);
     setCached(true);
     tile->deleteLater();
@@ -71,6 +71,7 @@ private:
     QNetworkReply*          _reply;
     QNetworkRequest         _request;
     QNetworkAccessManager*  _networkManager;
+    quint64                 _key;
     QByteArray              _badMapBox;
     QByteArray              _badTile;
 };
@@ -232,8 +232,8 @@ QGeoTiledMappingManagerEngineQGC::_setCache(const QVariantMap &parameters)
     }
     if(!memLimit)
     {
-        //-- Value saved in MB
-        memLimit = getQGCMapEngine()->getMaxMemCache() * (1024 * 1024);
+        //-- Value saved in MB. Part of it goes to the hot tile cache in QGCMapEngine.
+        memLimit = (uint32_t)QGCMapEngine::qtMemCacheBytes(getQGCMapEngine()->getMaxMemCache());
     }
     //-- It won't work with less than 1M of memory cache
     if(memLimit < 1024 * 1024)
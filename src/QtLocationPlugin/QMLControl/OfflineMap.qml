@@ -415,6 +415,13 @@ QGCView {
                         QGCLabel {  text: qsTr("Error Count:"); width: infoView._labelWidth; }
                         QGCLabel {  text: offlineMapView._currentSelection ? offlineMapView._currentSelection.errorCountStr : ""; horizontalAlignment: Text.AlignRight; width: infoView._valueWidth; }
                     }
+                    Row {
+                        spacing:    ScreenTools.defaultFontPixelWidth
+                        anchors.horizontalCenter: parent.horizontalCenter
+                        visible:    offlineMapView && offlineMapView._currentSelection && !_defaultSet && offlineMapView._currentSelection.downloading
+                        QGCLabel {  text: qsTr("Rate:"); width: infoView._labelWidth; }
+                        QGCLabel {  text: offlineMapView._currentSelection ? offlineMapView._currentSelection.downloadRateStr : ""; horizontalAlignment: Text.AlignRight; width: infoView._valueWidth; }
+                    }
                     //-- Default Tile Set
                     Row {
                         spacing:    ScreenTools.defaultFontPixelWidth
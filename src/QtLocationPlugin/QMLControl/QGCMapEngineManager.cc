@@ -17,6 +17,7 @@
 #include "QGCMapUrlEngine.h"
 
 #include <QSettings>
+#include <QFileInfo>
 #include <QStorageInfo>
 #include <stdio.h>
 
@@ -61,17 +62,49 @@ QGCMapEngineManager::setToolbox(QGCToolbox *toolbox)
 void
 QGCMapEngineManager::updateForCurrentView(double lon0, double lat0, double lon1, double lat1, int minZoom, int maxZoom, const QString& mapName)
 {
-    UrlFactory::MapType mapType = QGCMapEngine::getTypeFromName(mapName);
-
     _topleftLat     = lat0;
     _topleftLon     = lon0;
     _bottomRightLat = lat1;
     _bottomRightLon = lon1;
     _minZoom        = minZoom;
     _maxZoom        = maxZoom;
+    _polygon.clear();
+    _updateTileCount(mapName);
+
+    qCDebug(QGCMapEngineManagerLog) << "updateForCurrentView" << lat0 << lon0 << lat1 << lon1 << minZoom << maxZoom;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::updateForPolygon(const QVariantList& path, int minZoom, int maxZoom, const QString& mapName)
+{
+    //-- The bounds still describe the set, only tiles the polygon reaches are counted (and downloaded)
+    _polygon.clear();
+    for(int i = 0; i < path.count(); i++) {
+        QGeoCoordinate coord = path[i].value<QGeoCoordinate>();
+        if(!i || coord.latitude()  > _topleftLat)     _topleftLat     = coord.latitude();
+        if(!i || coord.longitude() < _topleftLon)     _topleftLon     = coord.longitude();
+        if(!i || coord.latitude()  < _bottomRightLat) _bottomRightLat = coord.latitude();
+        if(!i || coord.longitude() > _bottomRightLon) _bottomRightLon = coord.longitude();
+        _polygon.append(coord);
+    }
+    _minZoom = minZoom;
+    _maxZoom = maxZoom;
+    _updateTileCount(mapName);
+
+    qCDebug(QGCMapEngineManagerLog) << "updateForPolygon" << _polygon.count() << "vertices" << minZoom << maxZoom << "tiles" << _totalSet.tileCount;
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::_updateTileCount(const QString& mapName)
+{
+    UrlFactory::MapType mapType = QGCMapEngine::getTypeFromName(mapName);
     _totalSet.clear();
-    for(int z = minZoom; z <= maxZoom; z++) {
-        QGCTileSet set = QGCMapEngine::getTileCount(z, lon0, lat0, lon1, lat1, mapType);
+    for(int z = _minZoom; z <= _maxZoom; z++) {
+        QGCTileSet set = _polygon.isEmpty() ?
+            QGCMapEngine::getTileCount(z, _topleftLon, _topleftLat, _bottomRightLon, _bottomRightLat, mapType) :
+            QGCMapEngine::getTileCount(z, _polygon, mapType);
         _totalSet += set;
     }
     emit tileX0Changed();
@@ -80,8 +113,6 @@ QGCMapEngineManager::updateForCurrentView(double lon0, double lat0, double lon1,
     emit tileY1Changed();
     emit tileCountChanged();
     emit tileSizeChanged();
-
-    qCDebug(QGCMapEngineManagerLog) << "updateForCurrentView" << lat0 << lon0 << lat1 << lon1 << minZoom << maxZoom;
 }
 
 //-----------------------------------------------------------------------------
@@ -136,6 +167,7 @@ QGCMapEngineManager::startDownload(const QString& name, const QString& mapType)
         set->setTopleftLon(_topleftLon);
         set->setBottomRightLat(_bottomRightLat);
         set->setBottomRightLon(_bottomRightLon);
+        set->setPolygon(_polygon);
         set->setMinZoom(_minZoom);
         set->setMaxZoom(_maxZoom);
         set->setTotalTileSize(_totalSet.tileSize);
@@ -254,6 +286,61 @@ QGCMapEngineManager::deleteTileSet(QGCCachedTileSet* tileSet)
     }
 }
 
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::exportTileSet(QGCCachedTileSet* tileSet, const QString& path)
+{
+    _exportTiles(tileSet->setID(), tileSet->type(), tileSet->name(), path);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::exportCache(const QString& mapType, const QString& path)
+{
+    _exportTiles(UINT64_MAX, QGCMapEngine::getTypeFromName(mapType), mapType, path);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::_exportTiles(qulonglong setID, UrlFactory::MapType mapType, const QString& name, const QString& path)
+{
+    qCDebug(QGCMapEngineManagerLog) << "Exporting" << name << "to" << path;
+    QGCExportTileTask* task = new QGCExportTileTask(setID, mapType, name, path);
+    connect(task, &QGCExportTileTask::exported, this, &QGCMapEngineManager::exportCompleted);
+    connect(task, &QGCMapTask::error, this, &QGCMapEngineManager::taskError);
+    getQGCMapEngine()->addTask(task);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::importTileSet(const QString& path, const QString& mapType)
+{
+    //-- The set is named after the file
+    QString base = QFileInfo(path).completeBaseName();
+    QString name = base;
+    for(int count = 2; findName(name); count++) {
+        name = QString("%1 %2").arg(base).arg(count);
+    }
+    qCDebug(QGCMapEngineManagerLog) << "Importing" << path << "as" << name;
+    QGCCachedTileSet* set = new QGCCachedTileSet(name);
+    set->setMapTypeStr(mapType);
+    set->setType(QGCMapEngine::getTypeFromName(mapType));
+    QGCImportTileTask* task = new QGCImportTileTask(set, path);
+    connect(task, &QGCImportTileTask::tileSetImported, this, &QGCMapEngineManager::_tileSetImported);
+    connect(task, &QGCMapTask::error, this, &QGCMapEngineManager::taskError);
+    getQGCMapEngine()->addTask(task);
+}
+
+//-----------------------------------------------------------------------------
+void
+QGCMapEngineManager::_tileSetImported(QGCCachedTileSet* set)
+{
+    qCDebug(QGCMapEngineManagerLog) << "Tile set imported (" << set->name() << ")" << set->savedTileCount() << "tiles";
+    _tileSets.append(set);
+    set->setManager(this);
+    emit tileSetsChanged();
+}
+
 //-----------------------------------------------------------------------------
 void
 QGCMapEngineManager::_resetCompleted()
@@ -308,6 +395,12 @@ QGCMapEngineManager::taskError(QGCMapTask::TaskType type, QString error)
     case QGCMapTask::taskReset:
         task = "Reset Tile Sets";
         break;
+    case QGCMapTask::taskExportTileSet:
+        task = "Export Tile Set";
+        break;
+    case QGCMapTask::taskImportTileSet:
+        task = "Import Tile Set";
+        break;
     default:
         task = "Database Error";
         break;
@@ -323,6 +416,8 @@ QGCMapEngineManager::taskError(QGCMapTask::TaskType type, QString error)
 void
 QGCMapEngineManager::_updateTotals(quint32 totaltiles, quint64 totalsize, quint32 defaulttiles, quint64 defaultsize)
 {
+    //-- Piggyback on the cache worker's update cadence for the memory cache stats
+    emit memCacheStatsChanged();
     for(int i = 0; i < _tileSets.count(); i++ ) {
         QGCCachedTileSet* set = qobject_cast<QGCCachedTileSet*>(_tileSets.get(i));
         Q_ASSERT(set);
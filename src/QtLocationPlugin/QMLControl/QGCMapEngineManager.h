@@ -46,13 +46,24 @@ public:
     //-- Disk Space in MB
     Q_PROPERTY(quint32              freeDiskSpace   READ    freeDiskSpace   NOTIFY  freeDiskSpaceChanged)
     Q_PROPERTY(quint32              diskSpace       READ    diskSpace       CONSTANT)
+    //-- In memory (hot) tile cache statistics
+    Q_PROPERTY(quint64              memCacheHits        READ    memCacheHits        NOTIFY  memCacheStatsChanged)
+    Q_PROPERTY(quint64              memCacheMisses      READ    memCacheMisses      NOTIFY  memCacheStatsChanged)
+    Q_PROPERTY(quint64              memCacheEvictions   READ    memCacheEvictions   NOTIFY  memCacheStatsChanged)
+    Q_PROPERTY(quint64              memCacheSize        READ    memCacheSize        NOTIFY  memCacheStatsChanged)
+    Q_PROPERTY(quint32              memCacheCount       READ    memCacheCount       NOTIFY  memCacheStatsChanged)
 
     Q_INVOKABLE void                loadTileSets            ();
     Q_INVOKABLE void                updateForCurrentView    (double lon0, double lat0, double lon1, double lat1, int minZoom, int maxZoom, const QString& mapName);
+    Q_INVOKABLE void                updateForPolygon        (const QVariantList& path, int minZoom, int maxZoom, const QString& mapName);
     Q_INVOKABLE void                startDownload           (const QString& name, const QString& mapType);
     Q_INVOKABLE void                saveSetting             (const QString& key,  const QString& value);
     Q_INVOKABLE QString             loadSetting             (const QString& key,  const QString& defaultValue);
     Q_INVOKABLE void                deleteTileSet           (QGCCachedTileSet* tileSet);
+    //-- MBTiles files hold a single map type. The default set mixes them, so the whole cache is exported one type at a time.
+    Q_INVOKABLE void                exportTileSet           (QGCCachedTileSet* tileSet, const QString& path);
+    Q_INVOKABLE void                exportCache             (const QString& mapType, const QString& path);
+    Q_INVOKABLE void                importTileSet           (const QString& path, const QString& mapType);
     Q_INVOKABLE QString             getUniqueName           ();
     Q_INVOKABLE bool                findName                (const QString& name);
 
@@ -72,6 +83,11 @@ public:
     QString                         errorMessage            () { return _errorMessage; }
     quint64                         freeDiskSpace           () { return _freeDiskSpace; }
     quint64                         diskSpace               () { return _diskSpace; }
+    quint64                         memCacheHits            () { return getQGCMapEngine()->memCache()->hits(); }
+    quint64                         memCacheMisses          () { return getQGCMapEngine()->memCache()->misses(); }
+    quint64                         memCacheEvictions       () { return getQGCMapEngine()->memCache()->evictions(); }
+    quint64                         memCacheSize            () { return getQGCMapEngine()->memCache()->bytes(); }
+    quint32                         memCacheCount           () { return getQGCMapEngine()->memCache()->count(); }
 
     void                            setMapboxToken          (QString token);
     void                            setMaxMemCache          (quint32 size);
@@ -95,6 +111,8 @@ signals:
     void maxDiskCacheChanged    ();
     void errorMessageChanged    ();
     void freeDiskSpaceChanged   ();
+    void memCacheStatsChanged   ();
+    void exportCompleted        (quint32 count);
 
 public slots:
     void taskError              (QGCMapTask::TaskType type, QString error);
@@ -103,11 +121,14 @@ private slots:
     void _tileSetSaved          (QGCCachedTileSet* set);
     void _tileSetFetched        (QGCCachedTileSet* tileSets);
     void _tileSetDeleted        (quint64 setID);
+    void _tileSetImported       (QGCCachedTileSet* set);
     void _updateTotals          (quint32 totaltiles, quint64 totalsize, quint32 defaulttiles, quint64 defaultsize);
     void _resetCompleted        ();
 
 private:
     void _updateDiskFreeSpace   ();
+    void _updateTileCount       (const QString& mapName);
+    void _exportTiles           (qulonglong setID, UrlFactory::MapType mapType, const QString& name, const QString& path);
 
 private:
     QGCTileSet  _totalSet;
@@ -115,6 +136,7 @@ private:
     double      _topleftLon;
     double      _bottomRightLat;
     double      _bottomRightLon;
+    QList<QGeoCoordinate> _polygon;
     int         _minZoom;
     int         _maxZoom;
     quint64     _setID;
@@ -18,6 +18,7 @@
 #include <QNetworkReply>
 #include <QFile>
 #include <QFileInfo>
+#include <QThread>
 
 #define kTimeOutMilliseconds 1000
 
@@ -108,13 +109,18 @@ MAVLinkLogFiles::setUploaded(bool uploaded)
 //-----------------------------------------------------------------------------
 MAVLinkLogProcessor::MAVLinkLogProcessor()
     : _fd(NULL)
+    , _head(0)
+    , _committed(0)
+    , _flushed(0)
     , _written(0)
     , _sequence(-1)
     , _numDrops(0)
     , _gotHeader(false)
+    , _synced(true)
     , _error(false)
     , _record(NULL)
 {
+    _buffer.resize(bufferSize);
 }
 
 //-----------------------------------------------------------------------------
@@ -128,8 +134,10 @@ void
 MAVLinkLogProcessor::close()
 {
     if(_fd) {
+        _flush();
         fclose(_fd);
         _fd = NULL;
+        qCDebug(MAVLinkLogManagerLog) << "Closed" << _fileName << "bytes:" << _written << "drops:" << _numDrops << "bytes/sec:" << _bytesPerSecond();
     }
 }
 
@@ -154,6 +162,7 @@ MAVLinkLogProcessor::create(MAVLinkLogManager* manager, const QString path, uint
         _record = new MAVLinkLogFiles(manager, _fileName, true);
         _record->setWriting(true);
         _sequence = -1;
+        _elapsed.start();
         return true;
     }
     return false;
@@ -195,96 +204,120 @@ MAVLinkLogProcessor::_checkSequence(uint16_t seq, int& num_drops)
 
 //-----------------------------------------------------------------------------
 void
-MAVLinkLogProcessor::_writeData(void* data, int len)
+MAVLinkLogProcessor::_append(const char* data, int len)
 {
-    if(!_error) {
-        _error = fwrite(data, 1, len, _fd) != (size_t)len;
-        if(!_error) {
-            _written += len;
-            if(_record) {
-                _record->setSize(_written);
-            }
-        } else {
-            qCDebug(MAVLinkLogManagerLog) << "File IO error:" << len << "bytes into" << _fileName;
-        }
+    if(_head + len - _flushed > (quint64)bufferSize) {
+        //-- Make room. What is left after this is at most one partial message, which always fits.
+        _flush();
     }
+    int pos   = _head & (bufferSize - 1);
+    int first = qMin(len, bufferSize - pos);
+    memcpy(_buffer.data() + pos, data, first);
+    memcpy(_buffer.data(), data + first, len - first);
+    _head += len;
 }
 
 //-----------------------------------------------------------------------------
-QByteArray
-MAVLinkLogProcessor::_writeUlogMessage(QByteArray& data)
+void
+MAVLinkLogProcessor::_commitMessages()
 {
-    //-- Write ulog data w/o integrity checking, assuming data starts with a
-    //   valid ulog message. returns the remaining data at the end.
-    while(data.length() > 2) {
-        uint8_t* ptr = (uint8_t*)data.data();
-        int message_length = ptr[0] + (ptr[1] * 256) + 3; // 3 = ULog msg header
-        if(message_length > data.length())
+    //-- Walk the ULog message headers, without any integrity checking
+    while(_head - _committed > 2) {
+        quint64 message_length = _byteAt(_committed) + (_byteAt(_committed + 1) * 256) + 3; // 3 = ULog msg header
+        if(message_length > _head - _committed) {
             break;
-        _writeData(data.data(), message_length);
-        data.remove(0, message_length);
-        return data;
+        }
+        _committed += message_length;
     }
-    return data;
+}
+
+//-----------------------------------------------------------------------------
+void
+MAVLinkLogProcessor::_flush()
+{
+    if(_flushed == _committed) {
+        return;
+    }
+    //-- At most two writes, one when the committed data wraps around the end of the buffer
+    while(!_error && _flushed < _committed) {
+        int pos = _flushed & (bufferSize - 1);
+        int len = (int)qMin(_committed - _flushed, (quint64)(bufferSize - pos));
+        _error = fwrite(_buffer.constData() + pos, 1, len, _fd) != (size_t)len;
+        if(_error) {
+            qCDebug(MAVLinkLogManagerLog) << "File IO error:" << len << "bytes into" << _fileName;
+            emit writeError();
+            return;
+        }
+        _flushed += len;
+        _written += len;
+    }
+    emit bytesWritten(_written, _numDrops, _bytesPerSecond());
+}
+
+//-----------------------------------------------------------------------------
+qreal
+MAVLinkLogProcessor::_bytesPerSecond() const
+{
+    qint64 msecs = _elapsed.elapsed();
+    return msecs ? _written / (msecs / 1000.0) : 0;
 }
 
 //-----------------------------------------------------------------------------
 bool
-MAVLinkLogProcessor::processStreamData(uint16_t sequence, uint8_t first_message, QByteArray data)
+MAVLinkLogProcessor::processStreamData(quint16 sequence, quint8 first_message, QByteArray data)
 {
     int num_drops = 0;
-    _error = false;
-    while(_checkSequence(sequence, num_drops)) {
-        //-- The first 16 bytes need special treatment (this sounds awfully brittle)
-        if(!_gotHeader) {
-            if(data.size() < 16) {
-                //-- Shouldn't happen but if it does, we might as well close shop.
-                qCCritical(MAVLinkLogManagerLog) << "Corrupt log header. Canceling log download.";
-                return false;
-            }
-            //-- Write header
-            _writeData(data.data(), 16);
-            data.remove(0, 16);
-            _gotHeader = true;
-            // What about data start offset now that we removed 16 bytes off the start?
-        }
-        if(_gotHeader && num_drops > 0) {
-            if(num_drops > 25) num_drops = 25;
-            //-- Hocus Pocus
-            //   Write a dropout message. We don't really know the actual duration,
-            //   so just use the number of drops * 10 ms
-            uint8_t bogus[] = {2, 0, 79, 0, 0};
-            bogus[3] = num_drops * 10;
-            _writeData(bogus, sizeof(bogus));
-        }
-        if(num_drops > 0) {
-            _writeUlogMessage(_ulogMessage);
-            _ulogMessage.clear();
-            //-- If no usefull information in this message. Drop it.
-            if(first_message == 255) {
-                break;
-            }
-            if(first_message > 0) {
-                data.remove(0, first_message);
-                first_message = 0;
-            }
-        }
-        if(first_message == 255 && _ulogMessage.length() > 0) {
-            _ulogMessage.append(data);
-            break;
-        }
-        if(_ulogMessage.length()) {
-            _writeData(_ulogMessage.data(), _ulogMessage.length());
-            if(first_message) {
-                _writeData(data.left(first_message).data(), first_message);
-            }
-            _ulogMessage.clear();
+    if(!_fd || _error) {
+        return !_error;
+    }
+    if(!_checkSequence(sequence, num_drops)) {
+        return true;
+    }
+    const char* ptr = data.constData();
+    int len = data.length();
+    //-- The first 16 bytes need special treatment (this sounds awfully brittle)
+    if(!_gotHeader) {
+        if(len < 16) {
+            //-- Shouldn't happen but if it does, we might as well close shop.
+            qCCritical(MAVLinkLogManagerLog) << "Corrupt log header. Canceling log download.";
+            _error = true;
+            emit writeError();
+            return false;
         }
-        if(first_message) {
-            data.remove(0, first_message);
+        //-- Write header
+        _append(ptr, 16);
+        _committed = _head;
+        ptr += 16;
+        len -= 16;
+        _gotHeader = true;
+        num_drops = 0;
+    }
+    if(num_drops > 0) {
+        //-- Throw away the message which was cut short
+        _head = _committed;
+        if(num_drops > 25) num_drops = 25;
+        //-- Hocus Pocus
+        //   Write a dropout message. We don't really know the actual duration,
+        //   so just use the number of drops * 10 ms
+        uint8_t bogus[] = {2, 0, 79, 0, 0};
+        bogus[3] = num_drops * 10;
+        _append((const char*)bogus, sizeof(bogus));
+        _committed = _head;
+        _synced = false;
+    }
+    if(!_synced) {
+        //-- If no usefull information in this message. Drop it.
+        if(first_message == 255 || first_message > len) {
+            return true;
         }
-        _ulogMessage = _writeUlogMessage(data);
-        break;
+        ptr += first_message;
+        len -= first_message;
+        _synced = true;
+    }
+    _append(ptr, len);
+    _commitMessages();
+    if(_committed - _flushed >= (quint64)flushSize) {
+        _flush();
     }
     return !_error;
 }
@@ -301,6 +334,7 @@ MAVLinkLogManager::MAVLinkLogManager(QGCApplication* app)
     , _logRunning(false)
     , _loggingDisabled(false)
     , _logProcessor(NULL)
+    , _logProcessorThread(NULL)
     , _deleteAfterUpload(false)
     , _loggingCmdTryCount(0)
 {
@@ -336,6 +370,14 @@ MAVLinkLogManager::MAVLinkLogManager(QGCApplication* app)
 //-----------------------------------------------------------------------------
 MAVLinkLogManager::~MAVLinkLogManager()
 {
+    if(_logProcessor) {
+        _closeLogProcessor();
+        _deleteLogProcessor();
+    }
+    if(_logProcessorThread) {
+        _logProcessorThread->quit();
+        _logProcessorThread->wait();
+    }
     _logFiles.clear();
 }
 
@@ -557,8 +599,9 @@ MAVLinkLogManager::stopLogging()
         _vehicle->stopMavlinkLog();
     }
     if(_logProcessor) {
-        _logProcessor->close();
+        _closeLogProcessor();
         if(_logProcessor->record()) {
+            _logProcessor->record()->setSize(_logProcessor->written());
             _logProcessor->record()->setWriting(false);
             if(_enableAutoUpload) {
                 //-- Queue log for auto upload (set selected flag)
@@ -568,8 +611,7 @@ MAVLinkLogManager::stopLogging()
                 }
             }
         }
-        delete _logProcessor;
-        _logProcessor = NULL;
+        _deleteLogProcessor();
         _logRunning = false;
         if(_vehicle) {
             //-- Setup a timer to make sure vehicle received the command
@@ -800,14 +842,8 @@ MAVLinkLogManager::_mavlinkLogData(Vehicle* /*vehicle*/, uint8_t /*target_system
         _ackTimer.stop();
     }
     if(_logProcessor && _logProcessor->valid()) {
-        if(!_logProcessor->processStreamData(sequence, first_message, data)) {
-            qCCritical(MAVLinkLogManagerLog) << "Error writing MAVLink log file:" << _logProcessor->fileName();
-            delete _logProcessor;
-            _logProcessor = NULL;
-            _logRunning = false;
-            _vehicle->stopMavlinkLog();
-            emit logRunningChanged();
-        }
+        //-- Reassembly and file IO happen on the log processor thread
+        emit _writeLogData(sequence, first_message, data);
     } else {
         qCWarning(MAVLinkLogManagerLog) << "MAVLink log data received when not expected.";
     }
@@ -839,29 +875,84 @@ MAVLinkLogManager::_discardLog()
 {
     //-- Delete (empty) log file (and record)
     if(_logProcessor) {
-        _logProcessor->close();
+        _closeLogProcessor();
         if(_logProcessor->record()) {
             _deleteLog(_logProcessor->record());
         }
-        delete _logProcessor;
-        _logProcessor = NULL;
+        _deleteLogProcessor();
     }
     _logRunning = false;
     emit logRunningChanged();
 }
 
+//-----------------------------------------------------------------------------
+void
+MAVLinkLogManager::_closeLogProcessor()
+{
+    //-- Wait for the processor to get through the data queued up for it so the file is complete once this returns
+    if(_logProcessor->thread() != thread()) {
+        QMetaObject::invokeMethod(_logProcessor, "close", Qt::BlockingQueuedConnection);
+    } else {
+        _logProcessor->close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void
+MAVLinkLogManager::_deleteLogProcessor()
+{
+    disconnect(this, &MAVLinkLogManager::_writeLogData, _logProcessor, &MAVLinkLogProcessor::processStreamData);
+    disconnect(_logProcessor, 0, this, 0);
+    _logProcessor->deleteLater();
+    _logProcessor = NULL;
+}
+
+//-----------------------------------------------------------------------------
+void
+MAVLinkLogManager::_logBytesWritten(quint32 written, int numDrops, qreal bytesPerSecond)
+{
+    if(_logProcessor && _logProcessor->record()) {
+        _logProcessor->record()->setSize(written);
+    }
+    qCDebug(MAVLinkLogManagerLog) << "MAVLink log bytes:" << written << "drops:" << numDrops << "bytes/sec:" << bytesPerSecond;
+}
+
+//-----------------------------------------------------------------------------
+void
+MAVLinkLogManager::_logWriteError()
+{
+    if(_logProcessor) {
+        qCCritical(MAVLinkLogManagerLog) << "Error writing MAVLink log file:" << _logProcessor->fileName();
+        _closeLogProcessor();
+        _deleteLogProcessor();
+        _logRunning = false;
+        if(_vehicle) {
+            _vehicle->stopMavlinkLog();
+        }
+        emit logRunningChanged();
+    }
+}
+
 //-----------------------------------------------------------------------------
 bool
 MAVLinkLogManager::_createNewLog()
 {
     if(_logProcessor) {
-        delete _logProcessor;
-        _logProcessor = NULL;
+        _closeLogProcessor();
+        _deleteLogProcessor();
     }
     _logProcessor = new MAVLinkLogProcessor;
     if(_logProcessor->create(this, _logPath, _vehicle->id())) {
         _insertNewLog(_logProcessor->record());
         emit logFilesChanged();
+        if(!_logProcessorThread) {
+            _logProcessorThread = new QThread(this);
+            _logProcessorThread->start();
+        }
+        _logProcessor->moveToThread(_logProcessorThread);
+        connect(this,          &MAVLinkLogManager::_writeLogData,       _logProcessor, &MAVLinkLogProcessor::processStreamData);
+        connect(_logProcessor, &MAVLinkLogProcessor::bytesWritten,      this,          &MAVLinkLogManager::_logBytesWritten);
+        connect(_logProcessor, &MAVLinkLogProcessor::writeError,        this,          &MAVLinkLogManager::_logWriteError);
     } else {
         qCCritical(MAVLinkLogManagerLog) << "Could not create MAVLink log file:" << _logProcessor->fileName();
         delete _logProcessor;
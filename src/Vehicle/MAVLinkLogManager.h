@@ -12,6 +12,7 @@
 #define MAVLinkLogManager_H
 
 #include <QObject>
+#include <QElapsedTimer>
 
 #include "QmlObjectListModel.h"
 #include "QGCLoggingCategory.h"
@@ -21,6 +22,7 @@
 Q_DECLARE_LOGGING_CATEGORY(MAVLinkLogManagerLog)
 
 class QNetworkAccessManager;
+class QThread;
 class MAVLinkLogManager;
 
 //-----------------------------------------------------------------------------
@@ -73,29 +75,61 @@ private:
 };
 
 //-----------------------------------------------------------------------------
-class MAVLinkLogProcessor
+/// Reassembles the ULog stream carried by LOGGING_DATA messages and writes it to a file.
+///
+/// Incoming data is copied into a ring buffer and from then on only offsets move. Bytes which make up complete ULog
+/// messages are committed, the partial message left by a dropped LOGGING_DATA message is thrown away by moving the
+/// write offset back to the last commit. Committed data goes to the file in large blocks. MAVLinkLogManager runs the
+/// processor on a worker thread.
+class MAVLinkLogProcessor : public QObject
 {
+    Q_OBJECT
 public:
     MAVLinkLogProcessor();
     ~MAVLinkLogProcessor();
-    void                close       ();
     bool                valid       ();
     bool                create      (MAVLinkLogManager *manager, const QString path, uint8_t id);
     MAVLinkLogFiles*    record      () { return _record; }
     QString             fileName    () { return _fileName; }
-    bool                processStreamData(uint16_t _sequence, uint8_t first_message, QByteArray data);
+    quint32             written     () { return _written; }
+    int                 numDrops    () { return _numDrops; }
+
+    static const int    bufferSize  = 256 * 1024;   ///< Ring buffer size, must be a power of two larger than a ULog message
+    static const int    flushSize   = 64 * 1024;    ///< Amount of committed data which triggers a write to the file
+
+public slots:
+    /// Processes the payload of a LOGGING_DATA message
+    ///     @return false: error writing the file, writeError is also signalled
+    bool                processStreamData(quint16 sequence, quint8 first_message, QByteArray data);
+
+    /// Writes out all complete messages and closes the file
+    void                close       ();
+
+signals:
+    /// Signalled each time a block is written to the file
+    void                bytesWritten(quint32 written, int numDrops, qreal bytesPerSecond);
+    void                writeError  ();
+
 private:
-    bool                _checkSequence(uint16_t seq, int &num_drops);
-    QByteArray          _writeUlogMessage(QByteArray &data);
-    void                _writeData(void* data, int len);
+    bool                _checkSequence  (uint16_t seq, int &num_drops);
+    void                _append         (const char* data, int len);
+    void                _commitMessages ();
+    void                _flush          ();
+    quint8              _byteAt         (quint64 offset) const { return (quint8)_buffer.constData()[offset & (bufferSize - 1)]; }
+    qreal               _bytesPerSecond () const;
 private:
     FILE*               _fd;
+    QByteArray          _buffer;
+    quint64             _head;          ///< Stream offset of the end of the data in the ring buffer
+    quint64             _committed;     ///< Stream offset of the end of the last complete message
+    quint64             _flushed;       ///< Stream offset of the end of the data written to the file
     quint32             _written;
     int                 _sequence;
     int                 _numDrops;
     bool                _gotHeader;
+    bool                _synced;        ///< false: waiting for the start of a message after a drop
     bool                _error;
-    QByteArray          _ulogMessage;
+    QElapsedTimer       _elapsed;
     QString             _fileName;
     MAVLinkLogFiles*    _record;
 };
@@ -164,6 +198,8 @@ signals:
     void logRunningChanged          ();
     void canStartLogChanged         ();
     void deleteAfterUploadChanged   ();
+    // Internal signal which passes log data to the log processor thread
+    void _writeLogData              (quint16 sequence, quint8 first_message, QByteArray data);
 
 private slots:
     void _uploadFinished            ();
@@ -174,11 +210,15 @@ private slots:
     void _armedChanged              (bool armed);
     void _commandLongAck            (uint8_t compID, uint16_t command, uint8_t result);
     void _processCmdAck             ();
+    void _logBytesWritten           (quint32 written, int numDrops, qreal bytesPerSecond);
+    void _logWriteError             ();
 
 private:
     bool _sendLog                   (const QString& logFile);
     bool _processUploadResponse     (int http_code, QByteArray &data);
     bool _createNewLog              ();
+    void _closeLogProcessor         ();
+    void _deleteLogProcessor        ();
     int  _getFirstSelected          ();
     void _insertNewLog              (MAVLinkLogFiles* newLog);
     void _deleteLog                 (MAVLinkLogFiles* log);
@@ -199,6 +239,7 @@ private:
     bool                    _logRunning;
     bool                    _loggingDisabled;
     MAVLinkLogProcessor*    _logProcessor;
+    QThread*                _logProcessorThread;
     bool                    _deleteAfterUpload;
     int                     _loggingCmdTryCount;
     QTimer                  _ackTimer;
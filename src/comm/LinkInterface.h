@@ -35,6 +35,9 @@ class LinkInterface : public QThread
     // Only LinkManager is allowed to create/delete or _connect/_disconnect a link
     friend class LinkManager;
 
+    // MockLink hands its mavlink channel to the vehicles which share it
+    friend class MockLink;
+
 public:
     Q_PROPERTY(bool active      READ active         WRITE setActive         NOTIFY activeChanged)
 
@@ -210,9 +210,10 @@ void LinkManager::_addLink(LinkInterface* link)
     }
 
     connect(link, &LinkInterface::communicationError,   _app,               &QGCApplication::criticalMessageBoxOnMainThread);
-    connect(link, &LinkInterface::bytesReceived,        _mavlinkProtocol,   &MAVLinkProtocol::receiveBytes);
 
+    // Incoming bytes are decoded off the main thread, decoded messages come back through MAVLinkProtocol signals
     _mavlinkProtocol->resetMetadataForLink(link);
+    _mavlinkProtocol->addLink(link);
 
     connect(link, &LinkInterface::connected,            this, &LinkManager::_linkConnected);
     connect(link, &LinkInterface::disconnected,         this, &LinkManager::_linkDisconnected);
@@ -276,6 +277,8 @@ void LinkManager::_deleteLink(LinkInterface* link)
     // Free up the mavlink channel associated with this link
     _mavlinkChannelsUsedBitMask &= ~(1 << link->mavlinkChannel());
 
+    _mavlinkProtocol->removeLink(link);
+
     _links.removeOne(link);
     delete link;
 
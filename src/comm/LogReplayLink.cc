@@ -11,10 +11,13 @@
 #include "LogReplayLink.h"
 #include "LinkManager.h"
 #include "QGCApplication.h"
+#include "QGCLoggingCategory.h"
 
 #include <QFileInfo>
 #include <QtEndian>
 
+QGC_LOGGING_CATEGORY(LogReplayLinkLog, "LogReplayLinkLog")
+
 const char*  LogReplayLinkConfiguration::_logFilenameKey = "logFilename";
 
 const char* LogReplayLink::_errorTitle = "Log Replay Error";
@@ -66,7 +69,10 @@ QString LogReplayLinkConfiguration::logFilenameShort(void)
 
 LogReplayLink::LogReplayLink(LogReplayLinkConfiguration* config) :
     _connected(false),
-    _replayAccelerationFactor(1.0f)
+    _replayAccelerationFactor(1.0f),
+    _unthrottled(false),
+    _logPos(0),
+    _rateMessageCount(0)
 {
     Q_ASSERT(config);
     _config = config;
@@ -77,6 +83,7 @@ LogReplayLink::LogReplayLink(LogReplayLinkConfiguration* config) :
     QObject::connect(this, &LogReplayLink::_playOnThread, this, &LogReplayLink::_play);
     QObject::connect(this, &LogReplayLink::_pauseOnThread, this, &LogReplayLink::_pause);
     QObject::connect(this, &LogReplayLink::_setAccelerationFactorOnThread, this, &LogReplayLink::_setAccelerationFactor);
+    QObject::connect(this, &LogReplayLink::_setUnthrottledOnThread, this, &LogReplayLink::_setUnthrottled);
     
     moveToThread(this);
 }
@@ -147,16 +154,7 @@ void LogReplayLink::_writeBytes(const QByteArray bytes)
 /// @return A Unix timestamp in microseconds UTC for found message or 0 if parsing failed
 quint64 LogReplayLink::_parseTimestamp(const QByteArray& bytes)
 {
-    quint64 timestamp = qFromBigEndian(*((quint64*)(bytes.constData())));
-    quint64 currentTimestamp = ((quint64)QDateTime::currentMSecsSinceEpoch()) * 1000;
-    
-    // Now if the parsed timestamp is in the future, it must be an old file where the timestamp was stored as
-    // little endian, so switch it.
-    if (timestamp > currentTimestamp) {
-        timestamp = qbswap(timestamp);
-    }
-    
-    return timestamp;
+    return MAVLinkTlogIndex::parseTimestamp((const uint8_t*)bytes.constData());
 }
 
 /// Seeks to the beginning of the next successfully parsed mavlink message in the log file.
@@ -204,39 +202,28 @@ bool LogReplayLink::_loadLogFile(void)
     _logTimestamped = logFilename.endsWith(".mavlink");
     
     if (_logTimestamped) {
-        // Get the first timestamp from the log
-        // This should be a big-endian uint64.
-        QByteArray timestamp = _logFile.read(cbTimestamp);
-        quint64 startTimeUSecs = _parseTimestamp(timestamp);
-        
-        // Now find the last timestamp by scanning for the last MAVLink packet and
-        // find the timestamp before it. To do this we start searchin a little before
-        // the end of the file, specifically the maximum MAVLink packet size + the
-        // timestamp size. This guarantees that we will hit a MAVLink packet before
-        // the end of the file. Unfortunately, it basically guarantees that we will
-        // hit more than one. This is why we have to search for a bit.
-        qint64 fileLoc = _logFile.size() - MAVLINK_MAX_PACKET_LEN - cbTimestamp;
-        _logFile.seek(fileLoc);
-        quint64 endTimeUSecs = startTimeUSecs; // Set a sane default for the endtime
-        mavlink_message_t msg;
-        quint64 messageTimeUSecs;
-        while ((messageTimeUSecs = _seekToNextMavlinkMessage(&msg)) > endTimeUSecs) {
-            endTimeUSecs = messageTimeUSecs;
+        // Messages are read straight out of the mapped file, which saves a read call per message. Only a window is
+        // mapped at a time so large logs still fit in the address space of 32 bit and mobile builds.
+        if (!_logView.open(logFilename)) {
+            errorMsg = QString("Unable to open log file: '%1', error: %2").arg(logFilename).arg(_logView.errorString());
+            goto Error;
         }
-        
-        if (endTimeUSecs == startTimeUSecs) {
-            errorMsg = QString("The log file '%1' is corrupt. No valid timestamps were found at the end of the file.").arg(logFilename);
+
+        _loadLogIndex();
+
+        if (_logIndex.durationUSecs() == 0) {
+            errorMsg = QString("The log file '%1' is corrupt. No valid timestamps were found in the file.").arg(logFilename);
             goto Error;
         }
-        
+
         // Remember the start and end time so we can move around this _logFile with the slider.
-        _logEndTimeUSecs = endTimeUSecs;
-        _logStartTimeUSecs = startTimeUSecs;
-        _logDurationUSecs = endTimeUSecs - startTimeUSecs;
-        _logCurrentTimeUSecs = startTimeUSecs;
+        _logStartTimeUSecs = _logIndex.startTimeUSecs();
+        _logEndTimeUSecs = _logIndex.endTimeUSecs();
+        _logDurationUSecs = _logIndex.durationUSecs();
+        _logCurrentTimeUSecs = _logStartTimeUSecs;
         
-        // Reset our log file so when we go to read it for the first time, we start at the beginning.
-        _logFile.reset();
+        // Start reading from the beginning of the log
+        _logPos = 0;
         
         logDurationSecondsTotal = (_logDurationUSecs) / 1000000;
     } else {
@@ -271,11 +258,37 @@ Error:
     if (_logFile.isOpen()) {
         _logFile.close();
     }
+    _logView.close();
     _replayError(errorMsg);
     return false;
 }
 
-/// This function will read the next available log entry. It will then start
+/// Loads the time index from the sidecar file, building and saving it if it is missing or out of date
+void LogReplayLink::_loadLogIndex(void)
+{
+    QString logFilename = _config->logFilename();
+
+    if (_logIndex.load(logFilename)) {
+        qCDebug(MAVLinkTlogIndexLog) << "Loaded log index" << logFilename;
+    } else {
+        // This runs on the replay link thread so a long scan doesn't block the ui
+        _logIndex.build(_logView);
+
+        // Failing to save (read only location for example) only means the index is rebuilt next time
+        QString errorString;
+        if (!_logIndex.save(logFilename, errorString)) {
+            qCDebug(MAVLinkTlogIndexLog) << "Unable to save log index" << logFilename << errorString;
+        }
+    }
+
+    qCDebug(MAVLinkTlogIndexLog) << "Log messages:duration(secs)" << _logIndex.messageCount() << _logIndex.durationUSecs() / 1000000;
+    QMap<uint32_t, quint32> messageCounts = _logIndex.messageCounts();
+    foreach (uint32_t msgid, messageCounts.keys()) {
+        qCDebug(MAVLinkTlogIndexLog) << "    msgid:count" << msgid << messageCounts[msgid];
+    }
+}
+
+/// This function will read the next available log entries. It will then start
 /// the _readTickTimer timer to read the new log entry at the appropriate time.
 /// It might not perfectly match the timing of the log file, but it will never
 /// induce a static drift into the log file replay.
@@ -284,44 +297,58 @@ void LogReplayLink::_readNextLogEntry(void)
     // If we have a file with timestamps, try and pace this out following the time differences
     // between the timestamps and the current playback speed.
     if (_logTimestamped) {
-        // Now parse MAVLink messages, grabbing their timestamps as we go. We stop once we
-        // have at least 3ms until the next one.
-        
-        // We track what the next execution time should be in milliseconds, which we use to set
-        // the next timer interrupt.
-        int timeToNextExecutionMSecs = 0;
-        
-        // We use the `_seekToNextMavlinkMessage()` function to scan ahead for MAVLink messages. This
-        // is necessary because we don't know how big each MAVLink message is until we finish parsing
-        // one, and since we only output arrays of bytes, we need to know the size of that array.
-        mavlink_message_t msg;
-        _seekToNextMavlinkMessage(&msg);
-        
-        while (timeToNextExecutionMSecs < 3) {
-            
-            // Now we're sitting at the start of a MAVLink message, so read it all into a byte array for feeding to our parser.
-            QByteArray message = _logFile.read(msg.len + MAVLINK_NUM_NON_PAYLOAD_BYTES);
-            
-            emit bytesReceived(this, message);            
-            emit playbackPercentCompleteChanged(((float)(_logCurrentTimeUSecs - _logStartTimeUSecs) / (float)_logDurationUSecs) * 100);
-            
-            // If we've reached the end of the of the file, make sure we handle that well
-            if (_logFile.atEnd()) {
-                _finishPlayback();
-                return;
+        if (_unthrottled) {
+            _readUnthrottled();
+            return;
+        }
+
+        // Gather up all messages which are due now, or within the next 3ms, and send them as a single block.
+        QByteArray  block;
+        bool        atEnd = false;
+        qint64      timeToNextExecutionMSecs = 0;
+        int         messageCount = 0;
+
+        while (true) {
+            quint64     messageTimeUSecs;
+            uint32_t    msgid;
+            int         recordBytes;
+
+            qint64 offset = MAVLinkTlogIndex::nextRecord(_logView, _logPos, messageTimeUSecs, msgid, recordBytes);
+            if (offset == -1) {
+                atEnd = true;
+                break;
             }
-            
-            // Run our parser to find the next timestamp and leave us at the start of the next MAVLink message.
-            _logCurrentTimeUSecs = _seekToNextMavlinkMessage(&msg);
-            
-            // Calculate how long we should wait in real time until parsing this message.
+            _logCurrentTimeUSecs = messageTimeUSecs;
+
+            // Calculate how long we should wait in real time until sending this message.
             // We pace ourselves relative to the start time of playback to fix any drift (initially set in play())
             qint64 timeDiffMSecs = ((_logCurrentTimeUSecs - _logStartTimeUSecs) / 1000) / _replayAccelerationFactor;
             quint64 desiredPacedTimeMSecs = _playbackStartTimeMSecs + timeDiffMSecs;
             quint64 currentTimeMSecs = (quint64)QDateTime::currentMSecsSinceEpoch();
             timeToNextExecutionMSecs = desiredPacedTimeMSecs - currentTimeMSecs;
+            if (timeToNextExecutionMSecs >= 3) {
+                break;
+            }
+
+            int messageBytes = recordBytes - MAVLinkTlogIndex::timestampLength;
+            block.append((const char*)_logView.data(offset + MAVLinkTlogIndex::timestampLength, messageBytes), messageBytes);
+            _logPos = offset + recordBytes;
+            messageCount++;
         }
-        
+
+        if (!block.isEmpty()) {
+            emit bytesReceived(this, block);
+            emit playbackPercentCompleteChanged(((float)(_logCurrentTimeUSecs - _logStartTimeUSecs) / (float)_logDurationUSecs) * 100);
+        }
+        _updateMessageRate(messageCount);
+
+        // If we've reached the end of the of the file, make sure we handle that well
+        if (atEnd) {
+            _logPos = _logFileSize;
+            _finishPlayback();
+            return;
+        }
+
         // And schedule the next execution of this function.
         _readTickTimer.start(timeToNextExecutionMSecs);
     }
@@ -344,6 +371,72 @@ void LogReplayLink::_readNextLogEntry(void)
     
 }
 
+/// Sends the log as fast as the decoder threads and the main thread can take it. Instead of following the log timestamps
+/// we hold off while too much data is still waiting to be decoded or processed.
+void LogReplayLink::_readUnthrottled(void)
+{
+    MAVLinkDecoderPool* decoderPool = qgcApp()->toolbox()->mavlinkProtocol()->decoderPool();
+
+    if (decoderPool->pendingByteCount() > _maxPendingBytes || decoderPool->queueDepth() > _maxQueuedMessages) {
+        _readTickTimer.start(1);
+        return;
+    }
+
+    QByteArray  block;
+    bool        atEnd = false;
+    int         messageCount = 0;
+
+    block.reserve(_unthrottledBlockSize + MAVLINK_MAX_PACKET_LEN);
+    while (block.length() < _unthrottledBlockSize) {
+        quint64     messageTimeUSecs;
+        uint32_t    msgid;
+        int         recordBytes;
+
+        qint64 offset = MAVLinkTlogIndex::nextRecord(_logView, _logPos, messageTimeUSecs, msgid, recordBytes);
+        if (offset == -1) {
+            atEnd = true;
+            break;
+        }
+
+        int messageBytes = recordBytes - MAVLinkTlogIndex::timestampLength;
+        block.append((const char*)_logView.data(offset + MAVLinkTlogIndex::timestampLength, messageBytes), messageBytes);
+        _logPos = offset + recordBytes;
+        _logCurrentTimeUSecs = messageTimeUSecs;
+        messageCount++;
+    }
+
+    if (!block.isEmpty()) {
+        emit bytesReceived(this, block);
+        emit playbackPercentCompleteChanged(((float)(_logCurrentTimeUSecs - _logStartTimeUSecs) / (float)_logDurationUSecs) * 100);
+    }
+    _updateMessageRate(messageCount);
+
+    if (atEnd) {
+        _logPos = _logFileSize;
+        _finishPlayback();
+        return;
+    }
+
+    // Go again as soon as the event loop is idle
+    _readTickTimer.start(0);
+}
+
+/// Signals the playback rate once a second
+void LogReplayLink::_updateMessageRate(int messageCount)
+{
+    _rateMessageCount += messageCount;
+
+    qint64 elapsedMSecs = _rateTimer.elapsed();
+    if (elapsedMSecs >= 1000) {
+        int messagesPerSecond = (int)((_rateMessageCount * 1000) / elapsedMSecs);
+        qCDebug(LogReplayLinkLog) << "Playback messages/sec" << messagesPerSecond;
+        emit playbackMessageRate(messagesPerSecond);
+
+        _rateMessageCount = 0;
+        _rateTimer.restart();
+    }
+}
+
 void LogReplayLink::_play(void)
 {
     qgcApp()->toolbox()->linkManager()->setConnectionsSuspended(tr("Connect not allowed during Flight Data replay."));
@@ -352,7 +445,7 @@ void LogReplayLink::_play(void)
 #endif
     
     // Make sure we aren't at the end of the file, if we are, reset to the beginning and play from there.
-    if (_logFile.atEnd()) {
+    if (_logTimestamped ? _logPos >= (qint64)_logFileSize : _logFile.atEnd()) {
         _resetPlaybackToBeginning();
     }
     
@@ -360,6 +453,9 @@ void LogReplayLink::_play(void)
     // We do this by subtracting the current file playback offset  from now()
     _playbackStartTimeMSecs = (quint64)QDateTime::currentMSecsSinceEpoch() - ((_logCurrentTimeUSecs - _logStartTimeUSecs) / 1000);
     
+    _rateMessageCount = 0;
+    _rateTimer.start();
+
     // Start timer
     if (_logTimestamped) {
         _readTickTimer.start(1);
@@ -393,6 +489,7 @@ void LogReplayLink::_resetPlaybackToBeginning(void)
     if (_logFile.isOpen()) {
         _logFile.reset();
     }
+    _logPos = 0;
     
     // And since we haven't starting playback, clear the time of initial playback and the current timestamp.
     _playbackStartTimeMSecs = 0;
@@ -414,42 +511,26 @@ void LogReplayLink::movePlayhead(int percentComplete)
     float floatPercentComplete = (float)percentComplete / 100.0f;
     
     if (_logTimestamped) {
-        // But if we have a timestamped MAVLink log, then actually aim to hit that percentage in terms of
-        // time through the file.
-        qint64 newFilePos = (qint64)(floatPercentComplete * (float)_logFile.size());
-        
-        // Now seek to the appropriate position, failing gracefully if we can't.
-        if (!_logFile.seek(newFilePos)) {
-            _replayError("Unable to seek to new position");
-            return;
-        }
-        
-        // But we do align to the next MAVLink message for consistency.
-        mavlink_message_t dummy;
-        _logCurrentTimeUSecs = _seekToNextMavlinkMessage(&dummy);
-        
-        // Now calculate the current file location based on time.
-        float newRelativeTimeUSecs = (float)(_logCurrentTimeUSecs - _logStartTimeUSecs);
-        
-        // Calculate the effective baud rate of the file in bytes/s.
-        float baudRate = _logFile.size() / (float)_logDurationUSecs / 1e6;
-        
-        // And the desired time is:
-        float desiredTimeUSecs = floatPercentComplete * _logDurationUSecs;
-        
-        // And now jump the necessary number of bytes in the proper direction
-        qint64 offset = (newRelativeTimeUSecs - desiredTimeUSecs) * baudRate;
-        if (!_logFile.seek(_logFile.pos() + offset)) {
-            _replayError("Unable to seek to new position");
-            return;
+        // Timestamped MAVLink logs aim to hit that percentage in terms of time through the file. The index takes us
+        // straight to the first message at or past the desired time.
+        quint64 desiredTimeUSecs = _logStartTimeUSecs + (quint64)(floatPercentComplete * _logDurationUSecs);
+        quint64 messageTimeUSecs;
+
+        qint64 offset = _logIndex.seek(_logView, desiredTimeUSecs, messageTimeUSecs);
+        if (offset == -1) {
+            if (desiredTimeUSecs < _logEndTimeUSecs) {
+                _replayError("Unable to seek to new position");
+                return;
+            }
+            // Nothing past the end of the log
+            offset = _logFileSize;
+            messageTimeUSecs = _logEndTimeUSecs;
         }
-        
-        // And scan until we reach the start of a MAVLink message. We make sure to record this timestamp for
-        // smooth jumping around the file.
-        _logCurrentTimeUSecs = _seekToNextMavlinkMessage(&dummy);
-        
+        _logPos = offset;
+        _logCurrentTimeUSecs = messageTimeUSecs;
+
         // Now update the UI with our actual final position.
-        newRelativeTimeUSecs = (float)(_logCurrentTimeUSecs - _logStartTimeUSecs);
+        float newRelativeTimeUSecs = (float)(_logCurrentTimeUSecs - _logStartTimeUSecs);
         percentComplete = (newRelativeTimeUSecs / _logDurationUSecs) * 100;
         emit playbackPercentCompleteChanged(percentComplete);
     } else {
@@ -498,6 +579,19 @@ void LogReplayLink::_setAccelerationFactor(int factor)
     }
 }
 
+void LogReplayLink::_setUnthrottled(bool unthrottled)
+{
+    if (unthrottled == _unthrottled) {
+        return;
+    }
+    _unthrottled = unthrottled;
+
+    if (!_unthrottled) {
+        // Pick up paced playback from wherever the unthrottled replay got to
+        _playbackStartTimeMSecs = (quint64)QDateTime::currentMSecsSinceEpoch() - ((_logCurrentTimeUSecs - _logStartTimeUSecs) / 1000);
+    }
+}
+
 /// @brief Called when playback is complete
 void LogReplayLink::_finishPlayback(void)
 {
@@ -511,5 +605,6 @@ void LogReplayLink::_playbackError(void)
 {
     _pause();
     _logFile.close();
+    _logView.close();
     emit playbackError();
 }
@@ -14,9 +14,12 @@
 #include "LinkInterface.h"
 #include "LinkConfiguration.h"
 #include "MAVLinkProtocol.h"
+#include "MAVLinkTlogIndex.h"
+#include "LogFileView.h"
 
 #include <QTimer>
 #include <QFile>
+#include <QElapsedTimer>
 
 class LogReplayLinkConfiguration : public LinkConfiguration
 {
@@ -74,6 +77,13 @@ public:
     /// Sets the acceleration factor: -100: 0.01X, 0: 1.0X, 100: 100.0X
     void setAccelerationFactor(int factor) { emit _setAccelerationFactorOnThread(factor); }
 
+    /// Unthrottled replay ignores log timing and sends messages as fast as the decoder threads and the main thread
+    /// can process them. Only supported for timestamped logs.
+    void setUnthrottled(bool unthrottled) { emit _setUnthrottledOnThread(unthrottled); }
+
+    /// @return Time index for a timestamped log, which includes the per message id counts. Only valid once connected.
+    const MAVLinkTlogIndex& logIndex(void) const { return _logIndex; }
+
     // Virtuals from LinkInterface
     virtual QString getName(void) const { return _config->name(); }
     virtual void requestReset(void){ }
@@ -97,17 +107,20 @@ signals:
     void playbackAtEnd(void);
     void playbackError(void);
     void playbackPercentCompleteChanged(int percentComplete);
+    void playbackMessageRate(int messagesPerSecond);
 
     // Internal signals
     void _playOnThread(void);
     void _pauseOnThread(void);
     void _setAccelerationFactorOnThread(int factor);
+    void _setUnthrottledOnThread(bool unthrottled);
 
 private slots:
     void _readNextLogEntry(void);
     void _play(void);
     void _pause(void);
     void _setAccelerationFactor(int factor);
+    void _setUnthrottled(bool unthrottled);
 
 private:
     // Links are only created/destroyed by LinkManager so constructor/destructor is not public
@@ -118,6 +131,9 @@ private:
     quint64 _parseTimestamp(const QByteArray& bytes);
     quint64 _seekToNextMavlinkMessage(mavlink_message_t* nextMsg);
     bool _loadLogFile(void);
+    void _loadLogIndex(void);
+    void _readUnthrottled(void);
+    void _updateMessageRate(int messageCount);
     void _finishPlayback(void);
     void _playbackError(void);
     void _resetPlaybackToBeginning(void);
@@ -145,12 +161,23 @@ private:
     int                 _binaryBaudRate;        ///< Playback rate for binary log format
 
     float   _replayAccelerationFactor;  ///< Factor to apply to playback rate
+    bool    _unthrottled;               ///< true: Replay as fast as possible, ignoring log timing
     quint64 _playbackStartTimeMSecs;    ///< The time when the logfile was first played back. This is used to pace out replaying the messages to fix long-term drift/skew. 0 indicates that the player hasn't initiated playback of this log file.
 
     MAVLinkProtocol*    _mavlink;
     QFile               _logFile;
     quint64             _logFileSize;
     bool                _logTimestamped;    ///< true: Timestamped log format, false: no timestamps
+    MAVLinkTlogIndex    _logIndex;          ///< Time index used for seeking in timestamped logs
+    LogFileView         _logView;           ///< Timestamped log, mapped a window at a time
+    qint64              _logPos;            ///< Offset of the next record to read from _logView
+
+    QElapsedTimer       _rateTimer;
+    quint64             _rateMessageCount;  ///< Messages sent since _rateTimer was last restarted
+
+    static const int    _unthrottledBlockSize = 64 * 1024;  ///< Bytes sent per pass when unthrottled
+    static const int    _maxPendingBytes =      256 * 1024; ///< Unthrottled backpressure: bytes waiting for the decoder threads
+    static const int    _maxQueuedMessages =    5000;       ///< Unthrottled backpressure: messages waiting for the main thread
 
     static const int cbTimestamp = sizeof(quint64);
 };
@@ -0,0 +1,246 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkDecoderPool.h"
+#include "LinkInterface.h"
+#include "QGCLoggingCategory.h"
+
+#include <QMutexLocker>
+
+QGC_LOGGING_CATEGORY(MAVLinkDecoderPoolLog, "MAVLinkDecoderPoolLog")
+
+const double MAVLinkDecoderPool::_latencyWarningMSecs = 250.0;
+
+MAVLinkDecoderWorker::MAVLinkDecoderWorker(MAVLinkDecoderPool* pool)
+    : QObject(NULL)
+    , _pool(pool)
+{
+
+}
+
+MAVLinkDecoderWorker::~MAVLinkDecoderWorker()
+{
+    qDeleteAll(_decoders);
+}
+
+void MAVLinkDecoderWorker::addLink(LinkInterface* link, quint32 linkId)
+{
+    _linkIds[link] = linkId;
+
+    if (_decoders.contains(link)) {
+        _decoders[link]->reset();
+        return;
+    }
+
+    // Channel status is updated from the batch on the main thread
+    MAVLinkFrameDecoder* decoder = new MAVLinkFrameDecoder();
+    decoder->setUpdateChannelStatus(false);
+    _decoders[link] = decoder;
+}
+
+void MAVLinkDecoderWorker::removeLink(LinkInterface* link)
+{
+    // The link may already be deleted at this point, it is only used as a key
+    delete _decoders.take(link);
+    _linkIds.remove(link);
+}
+
+void MAVLinkDecoderWorker::receiveBytes(LinkInterface* link, QByteArray bytes)
+{
+    _pool->_bytesTaken(bytes.length());
+
+    MAVLinkFrameDecoder* decoder = _decoders.value(link, NULL);
+    if (!decoder) {
+        // Bytes still in the queue for a link which has been removed
+        return;
+    }
+
+    MAVLinkDecodedBatch batch;
+    batch.link = link;
+    batch.linkId = _linkIds.value(link, 0);
+    batch.byteCount = bytes.length();
+    batch.mavlink09Count = bytes.count((char)0x55);
+    batch.channelStatusUpdated = false;
+    quint32 parseErrorCount = decoder->parseErrorCount();
+    decoder->decode(bytes, batch.messages);
+    batch.parseErrorCount = decoder->parseErrorCount() - parseErrorCount;
+    batch.decodedNSecs = _pool->_nsecsElapsed();
+
+    _pool->_queueBatch(batch);
+}
+
+MAVLinkDecoderPool::MAVLinkDecoderPool(int threadCount, QObject* parent)
+    : QObject(parent)
+    , _nextLinkId(1)
+    , _queuedMessageCount(0)
+    , _batchesSignalled(false)
+    , _maxQueueDepth(0)
+    , _pendingByteCount(0)
+    , _latencyMSecs(0)
+    , _maxLatencyMSecs(0)
+    , _decodedMessageCount(0)
+{
+    _timer.start();
+
+    if (threadCount <= 0) {
+        // Leave a core for the main thread
+        threadCount = qBound(1, QThread::idealThreadCount() - 1, _maxThreadCount);
+    }
+
+    for (int i=0; i<threadCount; i++) {
+        QThread* thread = new QThread(this);
+        Q_CHECK_PTR(thread);
+        thread->setObjectName(QString("MAVLinkDecoder%1").arg(i));
+
+        MAVLinkDecoderWorker* worker = new MAVLinkDecoderWorker(this);
+        Q_CHECK_PTR(worker);
+        worker->moveToThread(thread);
+
+        _threads.append(thread);
+        _workers.append(worker);
+
+        thread->start();
+    }
+
+    qCDebug(MAVLinkDecoderPoolLog) << "Decoder threads" << threadCount;
+}
+
+MAVLinkDecoderPool::~MAVLinkDecoderPool()
+{
+    for (int i=0; i<_threads.count(); i++) {
+        _threads[i]->quit();
+        _threads[i]->wait();
+    }
+
+    // Threads are stopped so it is safe to delete the workers from here
+    qDeleteAll(_workers);
+    qDeleteAll(_threads);
+}
+
+void MAVLinkDecoderPool::addLink(LinkInterface* link)
+{
+    if (_linkToWorker.contains(link)) {
+        return;
+    }
+
+    // Pick the worker with the fewest links
+    MAVLinkDecoderWorker* worker = _workers[0];
+    int linkCount = _linkToWorker.keys(worker).count();
+    for (int i=1; i<_workers.count(); i++) {
+        int count = _linkToWorker.keys(_workers[i]).count();
+        if (count < linkCount) {
+            worker = _workers[i];
+            linkCount = count;
+        }
+    }
+    _linkToWorker[link] = worker;
+
+    // A new id each time, a link allocated at the address of a removed one must not pick up the old link's batches
+    quint32 linkId = _nextLinkId++;
+    if (_nextLinkId == 0) {
+        _nextLinkId = 1;
+    }
+    _linkIds[link] = linkId;
+
+    // The decoder must be set up before the first bytes arrive. Both calls are queued to the worker thread
+    // so ordering is preserved.
+    QMetaObject::invokeMethod(worker, "addLink", Qt::QueuedConnection, Q_ARG(LinkInterface*, link), Q_ARG(quint32, linkId));
+    connect(link, &LinkInterface::bytesReceived, worker, &MAVLinkDecoderWorker::receiveBytes, Qt::QueuedConnection);
+
+    // Count bytes on the link thread as they are signalled so producers such as log replay can apply backpressure
+    connect(link, &LinkInterface::bytesReceived, this, [this](LinkInterface*, QByteArray bytes) {
+        _pendingByteCount.fetchAndAddRelaxed(bytes.length());
+    }, Qt::DirectConnection);
+}
+
+void MAVLinkDecoderPool::removeLink(LinkInterface* link)
+{
+    MAVLinkDecoderWorker* worker = _linkToWorker.take(link);
+    if (!worker) {
+        return;
+    }
+    _linkIds.remove(link);
+
+    disconnect(link, &LinkInterface::bytesReceived, worker, &MAVLinkDecoderWorker::receiveBytes);
+    disconnect(link, &LinkInterface::bytesReceived, this, 0);
+    QMetaObject::invokeMethod(worker, "removeLink", Qt::QueuedConnection, Q_ARG(LinkInterface*, link));
+}
+
+void MAVLinkDecoderPool::_queueBatch(const MAVLinkDecodedBatch& batch)
+{
+    bool signalBatches = false;
+
+    {
+        QMutexLocker locker(&_queueMutex);
+
+        _queuedBatches.append(batch);
+        _queuedMessageCount += batch.messages.count();
+        if (_queuedMessageCount > _maxQueueDepth) {
+            _maxQueueDepth = _queuedMessageCount;
+        }
+
+        // Only signal once until the main thread takes the queue. This coalesces all the blocks which arrive
+        // in the meantime into a single pass on the main thread.
+        if (!_batchesSignalled) {
+            _batchesSignalled = true;
+            signalBatches = true;
+        }
+    }
+
+    if (signalBatches) {
+        emit batchesAvailable();
+    }
+}
+
+QList<MAVLinkDecodedBatch> MAVLinkDecoderPool::takeBatches(void)
+{
+    QList<MAVLinkDecodedBatch> batches;
+
+    {
+        QMutexLocker locker(&_queueMutex);
+
+        batches.swap(_queuedBatches);
+        _queuedMessageCount = 0;
+        _batchesSignalled = false;
+    }
+
+    if (!batches.isEmpty()) {
+        // The oldest batch is the worst case latency for this pass
+        double latencyMSecs = (double)(_nsecsElapsed() - batches.first().decodedNSecs) / 1.0e6;
+
+        _latencyMSecs = (_latencyMSecs * 0.9) + (latencyMSecs * 0.1);
+        if (latencyMSecs > _maxLatencyMSecs) {
+            _maxLatencyMSecs = latencyMSecs;
+        }
+        if (latencyMSecs > _latencyWarningMSecs) {
+            qCWarning(MAVLinkDecoderPoolLog) << "Main thread is falling behind decoded telemetry latency(msecs):queued batches" << latencyMSecs << batches.count();
+        }
+
+        for (int i=0; i<batches.count(); i++) {
+            _decodedMessageCount += batches[i].messages.count();
+        }
+    }
+
+    return batches;
+}
+
+int MAVLinkDecoderPool::queueDepth(void)
+{
+    QMutexLocker locker(&_queueMutex);
+
+    return _queuedMessageCount;
+}
+
+int MAVLinkDecoderPool::maxQueueDepth(void)
+{
+    QMutexLocker locker(&_queueMutex);
+
+    return _maxQueueDepth;
+}
@@ -0,0 +1,134 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkDecoderPool_H
+#define MAVLinkDecoderPool_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QMap>
+#include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QLoggingCategory>
+
+#include "QGCMAVLink.h"
+#include "MAVLinkFrameDecoder.h"
+
+class LinkInterface;
+class MAVLinkDecoderPool;
+
+Q_DECLARE_LOGGING_CATEGORY(MAVLinkDecoderPoolLog)
+
+/// Messages decoded from a single bytesReceived block on a link
+typedef struct {
+    LinkInterface*              link;               ///< Only valid on the main thread once isCurrentLink passes
+    quint32                     linkId;             ///< Pool id of the link, tells a removed link apart from a new link at the same address
+    QVector<mavlink_message_t>  messages;
+    int                         byteCount;          ///< Number of raw bytes in the block
+    int                         mavlink09Count;     ///< Number of Mavlink 0.9 start bytes in the block
+    quint32                     parseErrorCount;    ///< Number of frames in the block which failed CRC
+    bool                        channelStatusUpdated; ///< false: batch still needs to be applied to the mavlink channel status
+    qint64                      decodedNSecs;       ///< Time the block was decoded, relative to the pool timer
+} MAVLinkDecodedBatch;
+
+/// Decodes bytes for a set of links on a worker thread. Each link has its own frame decoder.
+class MAVLinkDecoderWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    MAVLinkDecoderWorker(MAVLinkDecoderPool* pool);
+    ~MAVLinkDecoderWorker();
+
+public slots:
+    void addLink    (LinkInterface* link, quint32 linkId);
+    void removeLink (LinkInterface* link);
+    void receiveBytes(LinkInterface* link, QByteArray bytes);
+
+private:
+    MAVLinkDecoderPool*                         _pool;
+    QMap<LinkInterface*, MAVLinkFrameDecoder*>  _decoders;
+    QMap<LinkInterface*, quint32>               _linkIds;
+};
+
+/// Pool of worker threads which decode incoming link traffic off the main thread. Decoded batches are queued up
+/// and handed to the main thread in one go, so no matter how many blocks arrive the main thread only sees a single
+/// batchesAvailable signal per event loop pass.
+class MAVLinkDecoderPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// @param threadCount Number of worker threads, 0 to pick based on the number of cores
+    MAVLinkDecoderPool(int threadCount = 0, QObject* parent = NULL);
+    ~MAVLinkDecoderPool();
+
+    /// Assigns the link to the least loaded worker and routes its bytesReceived signal there
+    void addLink(LinkInterface* link);
+
+    /// Stops decoding for the link. Must be called before the link is deleted.
+    void removeLink(LinkInterface* link);
+
+    /// Removes and returns all decoded batches which are waiting for the main thread
+    QList<MAVLinkDecodedBatch> takeBatches(void);
+
+    /// Main thread only
+    ///     @return true: the link the batch was decoded for has not been removed since
+    bool isCurrentLink(const MAVLinkDecodedBatch& batch) const { return batch.linkId != 0 && _linkIds.value(batch.link, 0) == batch.linkId; }
+
+    int     threadCount         (void) const { return _threads.count(); }
+    int     queueDepth          (void);                                         ///< Messages waiting for the main thread
+    int     pendingByteCount    (void) const { return _pendingByteCount.load(); } ///< Received bytes waiting to be decoded
+    int     maxQueueDepth       (void);                                         ///< High water mark of queueDepth
+    double  latencyMSecs        (void) const { return _latencyMSecs; }         ///< Smoothed decode to main thread latency
+    double  maxLatencyMSecs     (void) const { return _maxLatencyMSecs; }      ///< Worst decode to main thread latency
+    quint64 decodedMessageCount (void) const { return _decodedMessageCount; }
+
+    /// Called by workers to queue a decoded batch for the main thread. Thread safe.
+    void _queueBatch(const MAVLinkDecodedBatch& batch);
+
+    /// Called by workers as they pick up a block of bytes. Thread safe.
+    void _bytesTaken(int byteCount) { _pendingByteCount.fetchAndAddRelaxed(-byteCount); }
+
+    /// Time base shared by the workers and the main thread
+    qint64 _nsecsElapsed(void) const { return _timer.nsecsElapsed(); }
+
+signals:
+    /// Signalled once when decoded batches become available and the previous ones have been taken
+    void batchesAvailable(void);
+
+private:
+    QList<QThread*>                         _threads;
+    QList<MAVLinkDecoderWorker*>            _workers;
+    QMap<LinkInterface*, MAVLinkDecoderWorker*> _linkToWorker;
+    QMap<LinkInterface*, quint32>           _linkIds;
+    quint32                                 _nextLinkId;
+
+    QMutex                      _queueMutex;        ///< Protects all queue variables below
+    QList<MAVLinkDecodedBatch>  _queuedBatches;
+    int                         _queuedMessageCount;
+    bool                        _batchesSignalled;  ///< true: batchesAvailable signalled, waiting for takeBatches
+
+    int                         _maxQueueDepth;
+
+    QAtomicInt      _pendingByteCount;      ///< Bytes signalled by links which the workers have not picked up yet
+    QElapsedTimer   _timer;
+    double          _latencyMSecs;
+    double          _maxLatencyMSecs;
+    quint64         _decodedMessageCount;
+
+    static const int    _maxThreadCount = 4;
+    static const double _latencyWarningMSecs;       ///< Latency above which we warn that the main thread is behind
+};
+
+#endif
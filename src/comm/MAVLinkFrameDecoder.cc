@@ -0,0 +1,302 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkFrameDecoder.h"
+
+#include <string.h>
+
+MAVLinkFrameDecoder::MAVLinkFrameDecoder(void)
+    : _mavlinkChannel(0)
+    , _updateChannelStatus(true)
+    , _parseErrorCount(0)
+    , _discardedByteCount(0)
+{
+
+}
+
+void MAVLinkFrameDecoder::reset(void)
+{
+    _pendingFrame.clear();
+    _parseErrorCount = 0;
+    _discardedByteCount = 0;
+}
+
+int MAVLinkFrameDecoder::decode(const uint8_t* bytes, int length, QVector<mavlink_message_t>& messages)
+{
+    int startCount = messages.count();
+    int offset = 0;
+
+    // First finish off any partial frame left over from the previous call. Only the bytes needed to complete
+    // the frame are copied, the remainder of the buffer is decoded in place below.
+    while (!_pendingFrame.isEmpty() && offset < length) {
+        int frameLength = MAVLinkFrameDecoder::frameLength((const uint8_t*)_pendingFrame.constData(), _pendingFrame.length());
+
+        if (frameLength < 0) {
+            // Not enough header bytes yet to know the frame length
+            _pendingFrame.append((const char*)&bytes[offset++], 1);
+            continue;
+        }
+
+        if (frameLength > 0) {
+            int copyCount = qMin(frameLength - _pendingFrame.length(), length - offset);
+            _pendingFrame.append((const char*)&bytes[offset], copyCount);
+            offset += copyCount;
+            if (_pendingFrame.length() < frameLength) {
+                // Ran out of input, wait for more
+                break;
+            }
+
+            mavlink_message_t message;
+            if (_decodeFrame((const uint8_t*)_pendingFrame.constData(), frameLength, message)) {
+                messages.append(message);
+                _pendingFrame.clear();
+                continue;
+            }
+        }
+
+        // The pending bytes were not a valid frame. Rescan them past the bad start byte, which will leave any new
+        // partial frame in _pendingFrame.
+        QByteArray rescan = _pendingFrame.mid(1);
+        _discardedByteCount++;
+        _pendingFrame.clear();
+        int consumed = _scan((const uint8_t*)rescan.constData(), rescan.length(), messages);
+        _pendingFrame = rescan.mid(consumed);
+    }
+
+    if (offset < length) {
+        int consumed = _scan(&bytes[offset], length - offset, messages);
+        offset += consumed;
+        if (offset < length) {
+            _pendingFrame = QByteArray((const char*)&bytes[offset], length - offset);
+        }
+    }
+
+    return messages.count() - startCount;
+}
+
+/// Decodes all complete frames from the buffer.
+/// @return Number of bytes consumed. Any bytes past this point are the start of a partial frame.
+int MAVLinkFrameDecoder::_scan(const uint8_t* bytes, int length, QVector<mavlink_message_t>& messages)
+{
+    int index = 0;
+
+    while (index < length) {
+        uint8_t c = bytes[index];
+        if (c != MAVLINK_STX && c != MAVLINK_STX_MAVLINK1) {
+            index++;
+            _discardedByteCount++;
+            continue;
+        }
+
+        int frameLength = MAVLinkFrameDecoder::frameLength(&bytes[index], length - index);
+        if (frameLength < 0 || index + frameLength > length) {
+            // Partial frame at end of buffer
+            break;
+        }
+
+        if (frameLength > 0) {
+            // Decode directly into the batch to prevent an additional copy of the message
+            messages.resize(messages.count() + 1);
+            if (_decodeFrame(&bytes[index], frameLength, messages.last())) {
+                index += frameLength;
+                continue;
+            }
+            messages.resize(messages.count() - 1);
+        }
+
+        // Not a valid frame, resync on the next start byte
+        index++;
+        _discardedByteCount++;
+    }
+
+    return index;
+}
+
+int MAVLinkFrameDecoder::frameLength(const uint8_t* bytes, int length)
+{
+    if (length < 2) {
+        return -1;
+    }
+
+    int payloadLength = bytes[1];
+
+    if (bytes[0] == MAVLINK_STX_MAVLINK1) {
+        return _headerLengthV1 + payloadLength + _checksumLength;
+    }
+
+    if (length < 3) {
+        return -1;
+    }
+
+    uint8_t incompatFlags = bytes[2];
+    if (incompatFlags & ~MAVLINK_IFLAG_MASK) {
+        // Unknown incompatible flags, mavlink_parse_char rejects these as well
+        return 0;
+    }
+
+    int frameLength = _headerLengthV2 + payloadLength + _checksumLength;
+    if (incompatFlags & MAVLINK_IFLAG_SIGNED) {
+        frameLength += MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+    return frameLength;
+}
+
+/// Validates the checksum of a complete frame and unpacks it into message
+bool MAVLinkFrameDecoder::_decodeFrame(const uint8_t* frame, int frameLength, mavlink_message_t& message)
+{
+    bool mavlink1 = frame[0] == MAVLINK_STX_MAVLINK1;
+    int headerLength = mavlink1 ? _headerLengthV1 : _headerLengthV2;
+
+    Q_ASSERT(frameLength >= headerLength + frame[1] + _checksumLength);
+    Q_UNUSED(frameLength);
+
+    message.magic = frame[0];
+    message.len = frame[1];
+    if (mavlink1) {
+        message.incompat_flags = 0;
+        message.compat_flags = 0;
+        message.seq = frame[2];
+        message.sysid = frame[3];
+        message.compid = frame[4];
+        message.msgid = frame[5];
+    } else {
+        message.incompat_flags = frame[2];
+        message.compat_flags = frame[3];
+        message.seq = frame[4];
+        message.sysid = frame[5];
+        message.compid = frame[6];
+        message.msgid = frame[7] | (frame[8] << 8) | (frame[9] << 16);
+    }
+
+    const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message.msgid);
+    uint16_t checksum = _frameChecksum(frame, headerLength, message.len, message.msgid);
+
+    const uint8_t* ck = &frame[headerLength + message.len];
+    if (ck[0] != (checksum & 0xFF) || ck[1] != (checksum >> 8)) {
+        _parseErrorCount++;
+        if (_updateChannelStatus) {
+            _channelStatusParseError(_mavlinkChannel);
+        }
+        return false;
+    }
+
+    message.checksum = checksum;
+    message.ck[0] = ck[0];
+    message.ck[1] = ck[1];
+
+    char* payload = _MAV_PAYLOAD_NON_CONST(&message);
+    memcpy(payload, &frame[headerLength], message.len);
+    if (entry && message.len < entry->max_msg_len) {
+        // Mavlink 2.0 truncates trailing zero bytes from the payload, put them back
+        memset(&payload[message.len], 0, entry->max_msg_len - message.len);
+    }
+
+    if (message.incompat_flags & MAVLINK_IFLAG_SIGNED) {
+        memcpy(message.signature, &ck[_checksumLength], MAVLINK_SIGNATURE_BLOCK_LEN);
+    }
+
+    // Keep channel status in sync with what mavlink_parse_char would have done
+    if (_updateChannelStatus) {
+        _channelStatusMessage(_mavlinkChannel, message);
+    }
+
+    return true;
+}
+
+void MAVLinkFrameDecoder::_channelStatusParseError(uint8_t mavlinkChannel)
+{
+    mavlink_status_t* status = mavlink_get_channel_status(mavlinkChannel);
+    status->parse_error++;
+    status->packet_rx_drop_count++;
+}
+
+void MAVLinkFrameDecoder::_channelStatusMessage(uint8_t mavlinkChannel, const mavlink_message_t& message)
+{
+    mavlink_status_t* status = mavlink_get_channel_status(mavlinkChannel);
+    if (message.magic == MAVLINK_STX_MAVLINK1) {
+        status->flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    } else {
+        status->flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    }
+    status->current_rx_seq = message.seq;
+    if (status->packet_rx_success_count == 0) {
+        status->packet_rx_drop_count = 0;
+    }
+    status->packet_rx_success_count++;
+}
+
+void MAVLinkFrameDecoder::updateChannelStatus(uint8_t mavlinkChannel, const QVector<mavlink_message_t>& messages, quint32 parseErrorCount)
+{
+    // Which frames in the batch failed is not known, so errors are counted ahead of the good frames
+    for (quint32 i=0; i<parseErrorCount; i++) {
+        _channelStatusParseError(mavlinkChannel);
+    }
+    for (int i=0; i<messages.count(); i++) {
+        _channelStatusMessage(mavlinkChannel, messages[i]);
+    }
+}
+
+bool MAVLinkFrameDecoder::checkFrame(const uint8_t* frame, uint32_t& msgid)
+{
+    int headerLength;
+
+    if (frame[0] == MAVLINK_STX_MAVLINK1) {
+        headerLength = _headerLengthV1;
+        msgid = frame[5];
+    } else {
+        headerLength = _headerLengthV2;
+        msgid = frame[7] | (frame[8] << 8) | (frame[9] << 16);
+    }
+
+    uint16_t checksum = _frameChecksum(frame, headerLength, frame[1], msgid);
+    const uint8_t* ck = &frame[headerLength + frame[1]];
+
+    return ck[0] == (checksum & 0xFF) && ck[1] == (checksum >> 8);
+}
+
+bool MAVLinkFrameDecoder::setFrameSequence(uint8_t* frame, uint8_t seq)
+{
+    int         headerLength;
+    uint32_t    msgid;
+
+    if (frame[0] == MAVLINK_STX_MAVLINK1) {
+        headerLength = _headerLengthV1;
+        msgid = frame[5];
+        frame[2] = seq;
+    } else {
+        if (frame[2] & MAVLINK_IFLAG_SIGNED) {
+            // The signature covers the sequence number
+            return false;
+        }
+        headerLength = _headerLengthV2;
+        msgid = frame[7] | (frame[8] << 8) | (frame[9] << 16);
+        frame[4] = seq;
+    }
+
+    uint16_t checksum = _frameChecksum(frame, headerLength, frame[1], msgid);
+    uint8_t* ck = &frame[headerLength + frame[1]];
+    ck[0] = checksum & 0xFF;
+    ck[1] = checksum >> 8;
+
+    return true;
+}
+
+/// Calculates the checksum over the header (minus STX) and payload, including the crc extra byte for the message
+uint16_t MAVLinkFrameDecoder::_frameChecksum(const uint8_t* frame, int headerLength, uint8_t payloadLength, uint32_t msgid)
+{
+    const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msgid);
+
+    uint16_t checksum;
+    crc_init(&checksum);
+    crc_accumulate_buffer(&checksum, (const char*)&frame[1], headerLength - 1 + payloadLength);
+    crc_accumulate(entry ? entry->crc_extra : 0, &checksum);
+
+    return checksum;
+}
@@ -0,0 +1,94 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkFrameDecoder_H
+#define MAVLinkFrameDecoder_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "QGCMAVLink.h"
+
+/// Block oriented MAVLink 1.0/2.0 frame decoder.
+///
+/// Unlike mavlink_parse_char, which runs the parser state machine once per byte, this decoder scans a whole
+/// buffer for start bytes, validates length and CRC over each complete frame in a single pass and appends the
+/// decoded messages to a caller supplied batch. Frames are decoded straight out of the incoming buffer. Only
+/// a partial frame at the end of a buffer is copied and held until the next call completes it.
+///
+/// The decoder keeps the per channel mavlink_status_t up to date in the same way mavlink_parse_char does so code
+/// which inspects channel status flags continues to work.
+class MAVLinkFrameDecoder
+{
+public:
+    MAVLinkFrameDecoder(void);
+
+    /// Sets the mavlink channel whose status is updated by this decoder
+    void setMavlinkChannel(uint8_t mavlinkChannel) { _mavlinkChannel = mavlinkChannel; }
+
+    /// Decoders running off the main thread must not touch the shared channel status, since the main thread
+    /// modifies the outgoing protocol flags in that same structure. Their batches are applied to the channel
+    /// status later on the main thread with updateChannelStatus.
+    void setUpdateChannelStatus(bool updateChannelStatus) { _updateChannelStatus = updateChannelStatus; }
+
+    /// Decodes all complete frames in the specified bytes
+    ///     @param bytes Incoming bytes
+    ///     @param length Number of bytes
+    ///     @param[out] messages Decoded messages are appended to this batch
+    /// @return Number of messages decoded
+    int decode(const uint8_t* bytes, int length, QVector<mavlink_message_t>& messages);
+
+    int decode(const QByteArray& bytes, QVector<mavlink_message_t>& messages) { return decode((const uint8_t*)bytes.constData(), bytes.length(), messages); }
+
+    /// Throws away any partial frame and resets counters
+    void reset(void);
+
+    quint32 parseErrorCount(void) const { return _parseErrorCount; }    ///< Frames which failed CRC or had bad flags
+    quint64 discardedByteCount(void) const { return _discardedByteCount; }  ///< Bytes skipped while hunting for a start byte
+
+    /// @return Full frame length for the frame starting at bytes, 0 if this is not a valid frame start,
+    ///         -1 if there are not enough bytes to determine the length yet.
+    static int frameLength(const uint8_t* bytes, int length);
+
+    /// Validates the checksum of a complete frame without unpacking it
+    ///     @param[out] msgid Message id of the frame
+    /// @return true: checksum is valid
+    static bool checkFrame(const uint8_t* frame, uint32_t& msgid);
+
+    /// Updates the channel status for a batch decoded without channel status updates, the same way decoding
+    /// the batch with channel status updates would have
+    ///     @param parseErrorCount Number of frames in the batch which failed CRC
+    static void updateChannelStatus(uint8_t mavlinkChannel, const QVector<mavlink_message_t>& messages, quint32 parseErrorCount);
+
+    /// Rewrites the sequence number of a complete unsigned frame and updates its checksum to match
+    ///     @return false: frame is signed and can't be resequenced
+    static bool setFrameSequence(uint8_t* frame, uint8_t seq);
+
+private:
+    int  _scan              (const uint8_t* bytes, int length, QVector<mavlink_message_t>& messages);
+    bool _decodeFrame       (const uint8_t* frame, int frameLength, mavlink_message_t& message);
+
+    static void _channelStatusParseError(uint8_t mavlinkChannel);
+    static void _channelStatusMessage   (uint8_t mavlinkChannel, const mavlink_message_t& message);
+
+    static uint16_t _frameChecksum(const uint8_t* frame, int headerLength, uint8_t payloadLength, uint32_t msgid);
+
+    uint8_t     _mavlinkChannel;
+    bool        _updateChannelStatus;
+    QByteArray  _pendingFrame;          ///< Partial frame carried over from the previous call
+    quint32     _parseErrorCount;
+    quint64     _discardedByteCount;
+
+    static const int _headerLengthV1 = 6;       ///< Header length including STX for MAVLink 1.0
+    static const int _headerLengthV2 = 10;      ///< Header length including STX for MAVLink 2.0
+    static const int _checksumLength = 2;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include <QApplication>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QFileInfo>
 #include <QtEndian>
 #include <QMetaType>
 
@@ -59,15 +60,24 @@ MAVLinkProtocol::MAVLinkProtocol(QGCApplication* app)
     , _logSuspendReplay(false)
     , _logPromptForSave(false)
     , _tempLogFile(QString("%2.%3").arg(_tempLogFileTemplate).arg(_logFileExtension))
+    , _tlogWriter(this)
 #endif
     , _linkMgr(NULL)
     , _multiVehicleManager(NULL)
+    , _decoderPool(NULL)
 {
     memset(&totalReceiveCounter, 0, sizeof(totalReceiveCounter));
     memset(&totalLossCounter, 0, sizeof(totalLossCounter));
     memset(&totalErrorCounter, 0, sizeof(totalErrorCounter));
     memset(&currReceiveCounter, 0, sizeof(currReceiveCounter));
     memset(&currLossCounter, 0, sizeof(currLossCounter));
+
+    for (int i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        _frameDecoders[i].setMavlinkChannel(i);
+    }
+
+    _decoderPool = new MAVLinkDecoderPool(0, this);
+    connect(_decoderPool, &MAVLinkDecoderPool::batchesAvailable, this, &MAVLinkProtocol::_decodedBatchesAvailable, Qt::QueuedConnection);
 }
 
 MAVLinkProtocol::~MAVLinkProtocol()
@@ -87,6 +97,7 @@ void MAVLinkProtocol::setToolbox(QGCToolbox *toolbox)
    _multiVehicleManager =   _toolbox->multiVehicleManager();
 
    qRegisterMetaType<mavlink_message_t>("mavlink_message_t");
+   qRegisterMetaType<QVector<mavlink_message_t> >("QVector<mavlink_message_t>");
 
    loadSettings();
 
@@ -105,6 +116,7 @@ void MAVLinkProtocol::setToolbox(QGCToolbox *toolbox)
    connect(this, &MAVLinkProtocol::protocolStatusMessage, _app, &QGCApplication::criticalMessageBoxOnMainThread);
 #ifndef __mobile__
    connect(this, &MAVLinkProtocol::saveTempFlightDataLog, _app, &QGCApplication::saveTempFlightDataLogOnMainThread);
+   connect(&_tlogWriter, &MAVLinkTlogWriter::writeError, this, &MAVLinkProtocol::_tlogWriteError);
 #endif
 
    connect(_multiVehicleManager->vehicles(), &QmlObjectListModel::countChanged, this, &MAVLinkProtocol::_vehicleCountChanged);
@@ -145,6 +157,7 @@ void MAVLinkProtocol::resetMetadataForLink(const LinkInterface *link)
     totalErrorCounter[channel] = 0;
     currReceiveCounter[channel] = 0;
     currLossCounter[channel] = 0;
+    _frameDecoders[channel].reset();
 }
 
 /**
@@ -163,12 +176,56 @@ void MAVLinkProtocol::receiveBytes(LinkInterface* link, QByteArray b)
         return;
     }
 
-//    receiveMutex.lock();
-    mavlink_message_t message;
-    mavlink_status_t status;
+    // Decode all complete frames in the block at once
+    MAVLinkDecodedBatch batch;
+    batch.link = link;
+    batch.linkId = 0;
+    batch.byteCount = b.size();
+    batch.mavlink09Count = b.count((char)0x55);
+    batch.parseErrorCount = 0;
+    batch.channelStatusUpdated = true;
+    batch.decodedNSecs = 0;
+    _frameDecoders[link->mavlinkChannel()].decode(b, batch.messages);
+
+    _processBatch(batch);
+}
 
+/// Links added through addLink are decoded on the decoder pool threads. This picks up everything which has been
+/// decoded since the last pass of the event loop.
+void MAVLinkProtocol::_decodedBatchesAvailable(void)
+{
+    QList<MAVLinkDecodedBatch> batches = _decoderPool->takeBatches();
+
+    for (int i=0; i<batches.count(); i++) {
+        // Links may have gone away while their batches were in the queue, and a new link may have been
+        // allocated at the same address since
+        if (_decoderPool->isCurrentLink(batches[i])) {
+            _processBatch(batches[i]);
+        }
+    }
+}
+
+void MAVLinkProtocol::addLink(LinkInterface* link)
+{
+    _decoderPool->addLink(link);
+}
+
+void MAVLinkProtocol::removeLink(LinkInterface* link)
+{
+    _decoderPool->removeLink(link);
+}
+
+/// Handles the messages decoded from a single block of bytes
+void MAVLinkProtocol::_processBatch(const MAVLinkDecodedBatch& batch)
+{
+    LinkInterface* link = batch.link;
     int mavlinkChannel = link->mavlinkChannel();
 
+    if (!batch.channelStatusUpdated) {
+        // Decoded off the main thread, bring the channel status up to date here where the outgoing flags are owned
+        MAVLinkFrameDecoder::updateChannelStatus(mavlinkChannel, batch.messages, batch.parseErrorCount);
+    }
+
     static int mavlink09Count = 0;
     static int nonmavlinkCount = 0;
     static bool decodedFirstPacket = false;
@@ -176,11 +233,9 @@ void MAVLinkProtocol::receiveBytes(LinkInterface* link, QByteArray b)
     static bool checkedUserNonMavlink = false;
     static bool warnedUserNonMavlink = false;
 
-    for (int position = 0; position < b.size(); position++) {
-        unsigned int decodeState = mavlink_parse_char(mavlinkChannel, (uint8_t)(b[position]), &message, &status);
-
-        if ((uint8_t)b[position] == 0x55) mavlink09Count++;
-        if ((mavlink09Count > 100) && !decodedFirstPacket && !warnedUser)
+    if (!decodedFirstPacket) {
+        mavlink09Count += batch.mavlink09Count;
+        if ((mavlink09Count > 100) && !warnedUser)
         {
             warnedUser = true;
             // Obviously the user tries to use a 0.9 autopilot
@@ -191,9 +246,9 @@ void MAVLinkProtocol::receiveBytes(LinkInterface* link, QByteArray b)
                                                                   "If your autopilot is using version 1.0, check if the baud rates of QGroundControl and your autopilot are the same."));
         }
 
-        if (decodeState == 0 && !decodedFirstPacket)
+        if (batch.messages.isEmpty())
         {
-            nonmavlinkCount++;
+            nonmavlinkCount += batch.byteCount;
             if (nonmavlinkCount > 2000 && !warnedUserNonMavlink)
             {
                 //2000 bytes with no mavlink message. Are we connected to a mavlink capable device?
@@ -210,149 +265,145 @@ void MAVLinkProtocol::receiveBytes(LinkInterface* link, QByteArray b)
                 }
             }
         }
-        if (decodeState == 1)
+        else
         {
-            if(!decodedFirstPacket) {
-                mavlink_status_t* mavlinkStatus = mavlink_get_channel_status(mavlinkChannel);
-                if (!(mavlinkStatus->flags & MAVLINK_STATUS_FLAG_IN_MAVLINK1) && (mavlinkStatus->flags & MAVLINK_STATUS_FLAG_OUT_MAVLINK1)) {
-                    qDebug() << "switch to mavlink 2.0" << mavlinkStatus << mavlinkChannel << mavlinkStatus->flags;
-                    mavlinkStatus->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
-                } else if ((mavlinkStatus->flags & MAVLINK_STATUS_FLAG_IN_MAVLINK1) && !(mavlinkStatus->flags & MAVLINK_STATUS_FLAG_OUT_MAVLINK1)) {
-                    qDebug() << "switch to mavlink 1.0" << mavlinkStatus << mavlinkChannel << mavlinkStatus->flags;
-                    mavlinkStatus->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
-                }
-                decodedFirstPacket = true;
-            }
-
-            if(message.msgid == MAVLINK_MSG_ID_RADIO_STATUS)
-            {
-                // process telemetry status message
-                mavlink_radio_status_t rstatus;
-                mavlink_msg_radio_status_decode(&message, &rstatus);
-                int rssi = rstatus.rssi,
-                    remrssi = rstatus.remrssi;
-                // 3DR Si1k radio needs rssi fields to be converted to dBm
-                if (message.sysid == '3' && message.compid == 'D') {
-                    /* Per the Si1K datasheet figure 23.25 and SI AN474 code
-                     * samples the relationship between the RSSI register
-                     * and received power is as follows:
-                     *
-                     *                       10
-                     * inputPower = rssi * ------ 127
-                     *                       19
-                     *
-                     * Additionally limit to the only realistic range [-120,0] dBm
-                     */
-                    rssi    = qMin(qMax(qRound(static_cast<qreal>(rssi)    / 1.9 - 127.0), - 120), 0);
-                    remrssi = qMin(qMax(qRound(static_cast<qreal>(remrssi) / 1.9 - 127.0), - 120), 0);
-                } else {
-                    rssi = (int8_t) rstatus.rssi;
-                    remrssi = (int8_t) rstatus.remrssi;
-                }
-
-                emit radioStatusChanged(link, rstatus.rxerrors, rstatus.fixed, rssi, remrssi,
-                    rstatus.txbuf, rstatus.noise, rstatus.remnoise);
+            mavlink_status_t* mavlinkStatus = mavlink_get_channel_status(mavlinkChannel);
+            bool inMavlink1 = batch.messages.first().magic == MAVLINK_STX_MAVLINK1;
+            if (!inMavlink1 && (mavlinkStatus->flags & MAVLINK_STATUS_FLAG_OUT_MAVLINK1)) {
+                qDebug() << "switch to mavlink 2.0" << mavlinkStatus << mavlinkChannel << mavlinkStatus->flags;
+                mavlinkStatus->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+            } else if (inMavlink1 && !(mavlinkStatus->flags & MAVLINK_STATUS_FLAG_OUT_MAVLINK1)) {
+                qDebug() << "switch to mavlink 1.0" << mavlinkStatus << mavlinkChannel << mavlinkStatus->flags;
+                mavlinkStatus->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
             }
+            decodedFirstPacket = true;
+        }
+    }
 
-#ifndef __mobile__
-            // Log data
+    if (batch.messages.isEmpty()) {
+        return;
+    }
 
-            if (!_logSuspendError && !_logSuspendReplay && _tempLogFile.isOpen()) {
-                uint8_t buf[MAVLINK_MAX_PACKET_LEN+sizeof(quint64)];
+    // Hold a shallow copy so a re-entrant call from a message handler can't free the batch we are iterating over
+    QVector<mavlink_message_t> messages = batch.messages;
+    for (int i=0; i<messages.count(); i++) {
+        _processMessage(link, messages.at(i));
+    }
 
-                // Write the uint64 time in microseconds in big endian format before the message.
-                // This timestamp is saved in UTC time. We are only saving in ms precision because
-                // getting more than this isn't possible with Qt without a ton of extra code.
-                quint64 time = (quint64)QDateTime::currentMSecsSinceEpoch() * 1000;
-                qToBigEndian(time, buf);
+    emit messagesReceived(link, messages);
+}
 
-                // Then write the message to the buffer
-                int len = mavlink_msg_to_send_buffer(buf + sizeof(quint64), &message);
+/// Handles protocol level processing of a single decoded message: radio status, logging, heartbeat and
+/// loss accounting. Then signals the message to per message consumers.
+void MAVLinkProtocol::_processMessage(LinkInterface* link, const mavlink_message_t& message)
+{
+    int mavlinkChannel = link->mavlinkChannel();
 
-                // Determine how many bytes were written by adding the timestamp size to the message size
-                len += sizeof(quint64);
+    if(message.msgid == MAVLINK_MSG_ID_RADIO_STATUS)
+    {
+        // process telemetry status message
+        mavlink_radio_status_t rstatus;
+        mavlink_msg_radio_status_decode(&message, &rstatus);
+        int rssi = rstatus.rssi,
+            remrssi = rstatus.remrssi;
+        // 3DR Si1k radio needs rssi fields to be converted to dBm
+        if (message.sysid == '3' && message.compid == 'D') {
+            /* Per the Si1K datasheet figure 23.25 and SI AN474 code
+             * samples the relationship between the RSSI register
+             * and received power is as follows:
+             *
+             *                       10
+             * inputPower = rssi * ------ 127
+             *                       19
+             *
+             * Additionally limit to the only realistic range [-120,0] dBm
+             */
+            rssi    = qMin(qMax(qRound(static_cast<qreal>(rssi)    / 1.9 - 127.0), - 120), 0);
+            remrssi = qMin(qMax(qRound(static_cast<qreal>(remrssi) / 1.9 - 127.0), - 120), 0);
+        } else {
+            rssi = (int8_t) rstatus.rssi;
+            remrssi = (int8_t) rstatus.remrssi;
+        }
 
-                // Now write this timestamp/message pair to the log.
-                QByteArray b((const char*)buf, len);
-                if(_tempLogFile.write(b) != len)
-                {
-                    // If there's an error logging data, raise an alert and stop logging.
-                    emit protocolStatusMessage(tr("MAVLink Protocol"), tr("MAVLink Logging failed. Could not write to file %1, logging disabled.").arg(_tempLogFile.fileName()));
-                    _stopLogging();
-                    _logSuspendError = true;
-                }
+        emit radioStatusChanged(link, rstatus.rxerrors, rstatus.fixed, rssi, remrssi,
+            rstatus.txbuf, rstatus.noise, rstatus.remnoise);
+    }
 
-                // Check for the vehicle arming going by. This is used to trigger log save.
-                if (!_logPromptForSave && message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
-                    mavlink_heartbeat_t state;
-                    mavlink_msg_heartbeat_decode(&message, &state);
-                    if (state.base_mode & MAV_MODE_FLAG_DECODE_POSITION_SAFETY) {
-                        _logPromptForSave = true;
-                    }
-                }
+#ifndef __mobile__
+    // Log data
+
+    if (!_logSuspendError && !_logSuspendReplay && _tlogWriter.isOpen()) {
+        // The writer timestamps and serializes the message into its ring buffer, the disk write happens on the
+        // writer thread. If the ring is full the message is dropped and counted instead of stalling here.
+        _tlogWriter.logMessage(message);
+
+        // Check for the vehicle arming going by. This is used to trigger log save.
+        if (!_logPromptForSave && message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+            mavlink_heartbeat_t state;
+            mavlink_msg_heartbeat_decode(&message, &state);
+            if (state.base_mode & MAV_MODE_FLAG_DECODE_POSITION_SAFETY) {
+                _logPromptForSave = true;
             }
+        }
+    }
 #endif
 
-            if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+    if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
 #ifndef __mobile__
-                // Start loggin on first heartbeat
-                _startLogging();
+        // Start loggin on first heartbeat
+        _startLogging();
 #endif
 
-                mavlink_heartbeat_t heartbeat;
-                mavlink_msg_heartbeat_decode(&message, &heartbeat);
-                emit vehicleHeartbeatInfo(link, message.sysid, heartbeat.mavlink_version, heartbeat.autopilot, heartbeat.type);
-            }
+        mavlink_heartbeat_t heartbeat;
+        mavlink_msg_heartbeat_decode(&message, &heartbeat);
+        emit vehicleHeartbeatInfo(link, message.sysid, heartbeat.mavlink_version, heartbeat.autopilot, heartbeat.type);
+    }
 
-            // Increase receive counter
-            totalReceiveCounter[mavlinkChannel]++;
-            currReceiveCounter[mavlinkChannel]++;
+    // Increase receive counter
+    totalReceiveCounter[mavlinkChannel]++;
+    currReceiveCounter[mavlinkChannel]++;
 
-            // Determine what the next expected sequence number is, accounting for
-            // never having seen a message for this system/component pair.
-            int lastSeq = lastIndex[message.sysid][message.compid];
-            int expectedSeq = (lastSeq == -1) ? message.seq : (lastSeq + 1);
+    // Determine what the next expected sequence number is, accounting for
+    // never having seen a message for this system/component pair.
+    int lastSeq = lastIndex[message.sysid][message.compid];
+    int expectedSeq = (lastSeq == -1) ? message.seq : (lastSeq + 1);
 
-            // And if we didn't encounter that sequence number, record the error
-            if (message.seq != expectedSeq)
-            {
+    // And if we didn't encounter that sequence number, record the error
+    if (message.seq != expectedSeq)
+    {
 
-                // Determine how many messages were skipped
-                int lostMessages = message.seq - expectedSeq;
+        // Determine how many messages were skipped
+        int lostMessages = message.seq - expectedSeq;
 
-                // Out of order messages or wraparound can cause this, but we just ignore these conditions for simplicity
-                if (lostMessages < 0)
-                {
-                    lostMessages = 0;
-                }
-
-                // And log how many were lost for all time and just this timestep
-                totalLossCounter[mavlinkChannel] += lostMessages;
-                currLossCounter[mavlinkChannel] += lostMessages;
-            }
+        // Out of order messages or wraparound can cause this, but we just ignore these conditions for simplicity
+        if (lostMessages < 0)
+        {
+            lostMessages = 0;
+        }
 
-            // And update the last sequence number for this system/component pair
-            lastIndex[message.sysid][message.compid] = expectedSeq;
+        // And log how many were lost for all time and just this timestep
+        totalLossCounter[mavlinkChannel] += lostMessages;
+        currLossCounter[mavlinkChannel] += lostMessages;
+    }
 
-            // Update on every 32th packet
-            if ((totalReceiveCounter[mavlinkChannel] & 0x1F) == 0)
-            {
-                // Calculate new loss ratio
-                // Receive loss
-                float receiveLossPercent = (double)currLossCounter[mavlinkChannel]/(double)(currReceiveCounter[mavlinkChannel]+currLossCounter[mavlinkChannel]);
-                receiveLossPercent *= 100.0f;
-                currLossCounter[mavlinkChannel] = 0;
-                currReceiveCounter[mavlinkChannel] = 0;
-                emit receiveLossPercentChanged(message.sysid, receiveLossPercent);
-                emit receiveLossTotalChanged(message.sysid, totalLossCounter[mavlinkChannel]);
-            }
+    // And update the last sequence number for this system/component pair
+    lastIndex[message.sysid][message.compid] = expectedSeq;
 
-            // The packet is emitted as a whole, as it is only 255 - 261 bytes short
-            // kind of inefficient, but no issue for a groundstation pc.
-            // It buys as reentrancy for the whole code over all threads
-            emit messageReceived(link, message);
-        }
+    // Update on every 32th packet
+    if ((totalReceiveCounter[mavlinkChannel] & 0x1F) == 0)
+    {
+        // Calculate new loss ratio
+        // Receive loss
+        float receiveLossPercent = (double)currLossCounter[mavlinkChannel]/(double)(currReceiveCounter[mavlinkChannel]+currLossCounter[mavlinkChannel]);
+        receiveLossPercent *= 100.0f;
+        currLossCounter[mavlinkChannel] = 0;
+        currReceiveCounter[mavlinkChannel] = 0;
+        emit receiveLossPercentChanged(message.sysid, receiveLossPercent);
+        emit receiveLossTotalChanged(message.sysid, totalLossCounter[mavlinkChannel]);
     }
+
+    // Per message signal for existing consumers. The full batch is signalled afterwards through messagesReceived.
+    emit messageReceived(link, message);
 }
 
 /**
@@ -402,14 +453,15 @@ void MAVLinkProtocol::_vehicleCountChanged(int count)
 /// @brief Closes the log file if it is open
 bool MAVLinkProtocol::_closeLogFile(void)
 {
-    if (_tempLogFile.isOpen()) {
-        if (_tempLogFile.size() == 0) {
+    if (_tlogWriter.isOpen()) {
+        // Closing the writer flushes everything still in the ring buffer
+        _tlogWriter.close();
+        if (QFileInfo(_tempLogFile.fileName()).size() == 0) {
             // Don't save zero byte files
             _tempLogFile.remove();
+            QFile::remove(MAVLinkTlogIndex::indexFileName(_tempLogFile.fileName()));
             return false;
         } else {
-            _tempLogFile.flush();
-            _tempLogFile.close();
             return true;
         }
     }
@@ -419,9 +471,12 @@ bool MAVLinkProtocol::_closeLogFile(void)
 
 void MAVLinkProtocol::_startLogging(void)
 {
-    if (!_tempLogFile.isOpen()) {
+    if (!_tlogWriter.isOpen()) {
         if (!_logSuspendReplay) {
-            if (!_tempLogFile.open()) {
+            // The temp file is only used to pick a unique file name, the writer opens its own handle
+            bool opened = _tempLogFile.open();
+            _tempLogFile.close();
+            if (!opened || !_tlogWriter.open(_tempLogFile.fileName())) {
                 emit protocolStatusMessage(tr("MAVLink Protocol"), tr("Opening Flight Data file for writing failed. "
                                                                       "Unable to write to %1. Please choose a different file location.").arg(_tempLogFile.fileName()));
                 _closeLogFile();
@@ -448,6 +503,7 @@ void MAVLinkProtocol::_stopLogging(void)
             emit saveTempFlightDataLog(_tempLogFile.fileName());
         } else {
             QFile::remove(_tempLogFile.fileName());
+            QFile::remove(MAVLinkTlogIndex::indexFileName(_tempLogFile.fileName()));
         }
     }
     _logPromptForSave = false;
@@ -481,6 +537,14 @@ void MAVLinkProtocol::checkForLostLogFiles(void)
     }
 }
 
+void MAVLinkProtocol::_tlogWriteError(const QString& errorString)
+{
+    // If there's an error logging data, raise an alert and stop logging.
+    emit protocolStatusMessage(tr("MAVLink Protocol"), tr("MAVLink Logging failed. Could not write to file %1, logging disabled. %2").arg(_tempLogFile.fileName()).arg(errorString));
+    _stopLogging();
+    _logSuspendError = true;
+}
+
 void MAVLinkProtocol::suspendLogForReplay(bool suspend)
 {
     _logSuspendReplay = suspend;
@@ -495,6 +559,7 @@ void MAVLinkProtocol::deleteTempLogFiles(void)
 
     foreach(const QFileInfo fileInfo, fileInfoList) {
         QFile::remove(fileInfo.filePath());
+        QFile::remove(MAVLinkTlogIndex::indexFileName(fileInfo.filePath()));
     }
 }
 #endif
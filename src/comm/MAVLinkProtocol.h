@@ -24,10 +24,14 @@
 #include <QFile>
 #include <QMap>
 #include <QByteArray>
+#include <QVector>
 #include <QLoggingCategory>
 
 #include "LinkInterface.h"
 #include "QGCMAVLink.h"
+#include "MAVLinkFrameDecoder.h"
+#include "MAVLinkDecoderPool.h"
+#include "MAVLinkTlogWriter.h"
 #include "QGC.h"
 #include "QGCTemporaryFile.h"
 #include "QGCToolbox.h"
@@ -94,6 +98,21 @@ public:
      */
     virtual void resetMetadataForLink(const LinkInterface *link);
     
+    /// Starts decoding the link's incoming bytes on the decoder thread pool. Decoded messages are delivered
+    /// on the main thread through the normal signals.
+    void addLink(LinkInterface* link);
+
+    /// Stops decoding for the link. Must be called before the link is deleted.
+    void removeLink(LinkInterface* link);
+
+    /// @return Decoder pool statistics used to check whether the main thread is keeping up with telemetry
+    MAVLinkDecoderPool* decoderPool(void) { return _decoderPool; }
+
+#ifndef __mobile__
+    /// @return Background writer for the telemetry log
+    MAVLinkTlogWriter* tlogWriter(void) { return &_tlogWriter; }
+#endif
+
     /// Suspend/Restart logging during replay.
     void suspendLogForReplay(bool suspend);
 
@@ -141,6 +160,10 @@ signals:
 
     /** @brief Message received and directly copied via signal */
     void messageReceived(LinkInterface* link, mavlink_message_t message);
+
+    /// All messages decoded from a single block of bytes received on a link. This is signalled once per receiveBytes
+    /// call after messageReceived has been signalled for each individual message in the batch.
+    void messagesReceived(LinkInterface* link, QVector<mavlink_message_t> messages);
     /** @brief Emitted if version check is enabled / disabled */
     void versionCheckChanged(bool enabled);
     /** @brief Emitted if a message from the protocol should reach the user */
@@ -170,6 +193,10 @@ signals:
 
 private slots:
     void _vehicleCountChanged(int count);
+    void _decodedBatchesAvailable(void);
+#ifndef __mobile__
+    void _tlogWriteError(const QString& errorString);
+#endif
     
 private:
 #ifndef __mobile__
@@ -181,13 +208,20 @@ private:
     bool _logSuspendReplay;     ///< true: Logging suspended due to replay
     bool _logPromptForSave;     ///< true: Prompt for log save when appropriate
 
-    QGCTemporaryFile    _tempLogFile;            ///< File to log to
+    QGCTemporaryFile    _tempLogFile;            ///< Provides the unique name of the file to log to
+    MAVLinkTlogWriter   _tlogWriter;             ///< Writes the log file on a background thread
     static const char*  _tempLogFileTemplate;    ///< Template for temporary log file
     static const char*  _logFileExtension;       ///< Extension for log files
 #endif
 
+    void _processBatch(const MAVLinkDecodedBatch& batch);
+    void _processMessage(LinkInterface* link, const mavlink_message_t& message);
+
     LinkManager*            _linkMgr;
     MultiVehicleManager*    _multiVehicleManager;
+
+    MAVLinkFrameDecoder     _frameDecoders[MAVLINK_COMM_NUM_BUFFERS];   ///< Per channel block decoders used by receiveBytes
+    MAVLinkDecoderPool*     _decoderPool;                               ///< Off main thread decoding for links added through addLink
 };
 
 #endif // MAVLINKPROTOCOL_H_
@@ -0,0 +1,70 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkRequestWindow.h"
+
+#include <QtGlobal>
+
+MAVLinkRequestWindow::MAVLinkRequestWindow(int maxSize)
+    : _maxSize(qMax(1, maxSize))
+{
+    reset();
+}
+
+void MAVLinkRequestWindow::reset(void)
+{
+    _size = qMin(initialSize, _maxSize);
+    _timeoutCount = 0;
+    _smoothedRttMSecs = -1;
+    _rttVariationMSecs = 0;
+}
+
+void MAVLinkRequestWindow::setMaxSize(int maxSize)
+{
+    _maxSize = qMax(1, maxSize);
+    _size = qMin(_size, (double)_maxSize);
+}
+
+void MAVLinkRequestWindow::replyReceived(double rttMSecs)
+{
+    if (rttMSecs >= 0) {
+        if (_smoothedRttMSecs < 0) {
+            _smoothedRttMSecs = rttMSecs;
+            _rttVariationMSecs = rttMSecs / 2;
+        } else {
+            _rttVariationMSecs = (0.75 * _rttVariationMSecs) + (0.25 * qAbs(_smoothedRttMSecs - rttMSecs));
+            _smoothedRttMSecs = (0.875 * _smoothedRttMSecs) + (0.125 * rttMSecs);
+        }
+    }
+
+    if (_timeoutCount == 0) {
+        _size += 1;
+    } else {
+        _size += 1.0 / _size;
+    }
+    _size = qMin(_size, (double)_maxSize);
+}
+
+void MAVLinkRequestWindow::requestsTimedOut(int count)
+{
+    if (count > 0) {
+        _timeoutCount += count;
+        _size = qMax(1.0, _size / 2);
+    }
+}
+
+int MAVLinkRequestWindow::timeoutMSecs(void) const
+{
+    if (_smoothedRttMSecs < 0) {
+        return initialTimeoutMSecs;
+    }
+    int timeoutMSecs = (int)(_smoothedRttMSecs + (4 * _rttVariationMSecs));
+    return qBound((int)minTimeoutMSecs, timeoutMSecs, (int)maxTimeoutMSecs);
+}
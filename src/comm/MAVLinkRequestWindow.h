@@ -0,0 +1,63 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkRequestWindow_H
+#define MAVLinkRequestWindow_H
+
+/// Flow control for requests which are pipelined to the vehicle over a lossy link.
+///
+/// The window is the number of requests allowed in flight. It grows by one per reply until the first loss (slow start),
+/// after that by one per window full of replies, and halves whenever requests time out. The timeout tracks the measured
+/// round trip time as smoothed rtt + 4 * rtt variation, the same way TCP does.
+class MAVLinkRequestWindow
+{
+public:
+    MAVLinkRequestWindow(int maxSize);
+
+    /// Back to the initial window and timeout, for a new transfer
+    void reset(void);
+
+    void setMaxSize(int maxSize);
+
+    /// Called for each reply to a request which is in flight
+    ///     @param rttMSecs Round trip time of the request, -1 if it can't be measured. A reply to a request which was
+    ///                     sent more than once can't be matched to the send which caused it.
+    void replyReceived(double rttMSecs);
+
+    /// Called once per timeout check which found requests which timed out. Loss means the link is congested, so the
+    /// window backs off once per check, not once per request.
+    ///     @param count Number of requests which timed out
+    void requestsTimedOut(int count);
+
+    /// @return true: another request may be sent
+    bool canSend(int inFlightCount) const { return inFlightCount < (int)_size; }
+
+    double  size            (void) const { return _size; }
+    int     maxSize         (void) const { return _maxSize; }
+    int     timeoutCount    (void) const { return _timeoutCount; }      ///< Requests which timed out since the last reset
+    double  smoothedRttMSecs(void) const { return _smoothedRttMSecs; }  ///< -1 until the first round trip is measured
+
+    /// @return Time to wait for the reply to a request
+    int timeoutMSecs(void) const;
+
+    static const int initialSize =          4;
+    static const int initialTimeoutMSecs =  1000;   ///< Used until a round trip has been measured
+    static const int minTimeoutMSecs =      100;
+    static const int maxTimeoutMSecs =      3000;
+
+private:
+    double  _size;
+    int     _maxSize;
+    int     _timeoutCount;
+    double  _smoothedRttMSecs;
+    double  _rttVariationMSecs;
+};
+
+#endif
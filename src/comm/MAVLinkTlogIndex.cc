@@ -0,0 +1,252 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkTlogIndex.h"
+#include "MAVLinkFrameDecoder.h"
+#include "LogFileView.h"
+#include "QGCLoggingCategory.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+QGC_LOGGING_CATEGORY(MAVLinkTlogIndexLog, "MAVLinkTlogIndexLog")
+
+MAVLinkTlogIndex::MAVLinkTlogIndex(quint64 intervalUSecs)
+    : _intervalUSecs(intervalUSecs)
+{
+    clear();
+}
+
+void MAVLinkTlogIndex::clear(void)
+{
+    _entries.clear();
+    _messageCounts.clear();
+    _messageCount = 0;
+    _startTimeUSecs = 0;
+    _endTimeUSecs = 0;
+    _fileSize = 0;
+}
+
+void MAVLinkTlogIndex::addMessage(quint64 timeUSecs, qint64 offset, uint32_t msgid)
+{
+    if (_messageCount == 0) {
+        _startTimeUSecs = timeUSecs;
+        _endTimeUSecs = timeUSecs;
+    }
+
+    // Entries must stay sorted by time for the binary search, so messages which go back in time never start an entry
+    if (_entries.isEmpty() || timeUSecs >= _entries.last().timeUSecs + _intervalUSecs) {
+        Entry entry = { timeUSecs, offset };
+        _entries.append(entry);
+    }
+
+    if (timeUSecs > _endTimeUSecs) {
+        _endTimeUSecs = timeUSecs;
+    }
+
+    _messageCounts[msgid]++;
+    _messageCount++;
+}
+
+bool MAVLinkTlogIndex::build(const QString& logFileName, QString& errorString)
+{
+    clear();
+
+    LogFileView log;
+    if (!log.open(logFileName)) {
+        errorString = log.errorString();
+        return false;
+    }
+
+    build(log);
+
+    qCDebug(MAVLinkTlogIndexLog) << "Built index" << logFileName << "messages:entries" << _messageCount << _entries.count();
+
+    return true;
+}
+
+void MAVLinkTlogIndex::build(LogFileView& log)
+{
+    clear();
+
+    qint64      offset = 0;
+    quint64     timeUSecs;
+    uint32_t    msgid;
+    int         recordBytes;
+    while ((offset = nextRecord(log, offset, timeUSecs, msgid, recordBytes)) != -1) {
+        addMessage(timeUSecs, offset, msgid);
+        offset += recordBytes;
+    }
+    _fileSize = log.size();
+}
+
+bool MAVLinkTlogIndex::load(const QString& logFileName)
+{
+    clear();
+
+    QFile file(indexFileName(logFileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic, version, entryCount;
+    stream >> magic >> version;
+    if (magic != _indexFileMagic || version != _indexFileVersion) {
+        qCDebug(MAVLinkTlogIndexLog) << "Index file wrong format" << file.fileName();
+        return false;
+    }
+
+    stream >> _fileSize >> _intervalUSecs >> _messageCount >> _startTimeUSecs >> _endTimeUSecs >> _messageCounts >> entryCount;
+    if (stream.status() != QDataStream::Ok || _fileSize != QFileInfo(logFileName).size()) {
+        // The log was modified or truncated after the index was written
+        qCDebug(MAVLinkTlogIndexLog) << "Index file out of date" << file.fileName();
+        clear();
+        return false;
+    }
+
+    _entries.resize(entryCount);
+    for (quint32 i=0; i<entryCount; i++) {
+        stream >> _entries[i].timeUSecs >> _entries[i].offset;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool MAVLinkTlogIndex::save(const QString& logFileName, QString& errorString) const
+{
+    QFile file(indexFileName(logFileName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << _indexFileMagic << _indexFileVersion;
+    stream << _fileSize << _intervalUSecs << _messageCount << _startTimeUSecs << _endTimeUSecs << _messageCounts;
+    stream << (quint32)_entries.count();
+    for (int i=0; i<_entries.count(); i++) {
+        stream << _entries[i].timeUSecs << _entries[i].offset;
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+qint64 MAVLinkTlogIndex::seek(LogFileView& log, quint64 timeUSecs, quint64& messageTimeUSecs) const
+{
+    if (_entries.isEmpty()) {
+        return -1;
+    }
+
+    // Binary search for the last entry at or before the requested time
+    int low = 0;
+    int high = _entries.count();
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (_entries[mid].timeUSecs <= timeUSecs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // Scan the rest of the interval for the exact message
+    qint64      offset = _entries[qMax(0, low - 1)].offset;
+    quint64     recordTimeUSecs;
+    uint32_t    msgid;
+    int         recordBytes;
+    while ((offset = nextRecord(log, offset, recordTimeUSecs, msgid, recordBytes)) != -1) {
+        if (recordTimeUSecs >= timeUSecs) {
+            messageTimeUSecs = recordTimeUSecs;
+            return offset;
+        }
+        offset += recordBytes;
+    }
+
+    return -1;
+}
+
+quint64 MAVLinkTlogIndex::parseTimestamp(const uint8_t* bytes)
+{
+    quint64 timestamp = qFromBigEndian<quint64>(bytes);
+    quint64 currentTimestamp = ((quint64)QDateTime::currentMSecsSinceEpoch()) * 1000;
+
+    // Now if the parsed timestamp is in the future, it must be an old file where the timestamp was stored as
+    // little endian, so switch it.
+    if (timestamp > currentTimestamp) {
+        timestamp = qbswap(timestamp);
+    }
+
+    return timestamp;
+}
+
+int MAVLinkTlogIndex::recordLength(const uint8_t* bytes, int length, quint64& timeUSecs, uint32_t& msgid)
+{
+    if (length <= timestampLength) {
+        return -1;
+    }
+
+    const uint8_t* frame = &bytes[timestampLength];
+    if (frame[0] != MAVLINK_STX && frame[0] != MAVLINK_STX_MAVLINK1) {
+        return 0;
+    }
+
+    int frameLength = MAVLinkFrameDecoder::frameLength(frame, length - timestampLength);
+    if (frameLength <= 0) {
+        return frameLength;
+    }
+    if (timestampLength + frameLength > length) {
+        return -1;
+    }
+    if (!MAVLinkFrameDecoder::checkFrame(frame, msgid)) {
+        return 0;
+    }
+
+    timeUSecs = parseTimestamp(bytes);
+
+    return timestampLength + frameLength;
+}
+
+qint64 MAVLinkTlogIndex::nextRecord(LogFileView& log, qint64 offset, quint64& timeUSecs, uint32_t& msgid, int& recordBytes)
+{
+    while (offset < log.size()) {
+        int length = (int)qMin(log.size() - offset, (qint64)maxRecordLength);
+
+        // Fetching the longest possible record keeps it inside the mapped window for the caller
+        const uint8_t* bytes = log.data(offset, length);
+        if (!bytes) {
+            qWarning() << "Unable to map log" << offset << log.errorString();
+            return -1;
+        }
+
+        recordBytes = recordLength(bytes, length, timeUSecs, msgid);
+        if (recordBytes > 0) {
+            return offset;
+        }
+
+        // Either garbage, or a record cut off at the end of the log. A stray start byte near the end can look like a
+        // cut off record, so keep scanning rather than giving up on the remaining bytes.
+        offset++;
+    }
+
+    return -1;
+}
@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkTlogIndex_H
+#define MAVLinkTlogIndex_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QLoggingCategory>
+
+#include "QGCMAVLink.h"
+
+class LogFileView;
+
+Q_DECLARE_LOGGING_CATEGORY(MAVLinkTlogIndexLog)
+
+/// Time index for a telemetry (.tlog) file.
+///
+/// The index holds the file offset of the first message at or after each interval boundary, along with the start/end
+/// time and per message id counts for the whole log. It is saved in a sidecar file next to the log (<log>.idx). The index
+/// can either be built by scanning an existing log, or built up message by message while the log is being written.
+class MAVLinkTlogIndex
+{
+public:
+    MAVLinkTlogIndex(quint64 intervalUSecs = _defaultIntervalUSecs);
+
+    typedef struct {
+        quint64 timeUSecs;
+        qint64  offset;     ///< File offset of the timestamp which precedes the message
+    } Entry;
+
+    /// Clears the index so it can be reused for a new log
+    void clear(void);
+
+    /// Adds a message to the index. Messages must be added in file order.
+    ///     @param timeUSecs Log timestamp for the message
+    ///     @param offset File offset of the timestamp which precedes the message
+    ///     @param msgid Message id
+    void addMessage(quint64 timeUSecs, qint64 offset, uint32_t msgid);
+
+    /// Sets the size of the log file this index covers. Used to detect stale sidecar files.
+    void setFileSize(qint64 fileSize) { _fileSize = fileSize; }
+
+    /// Builds the index by scanning the whole log
+    ///     @return false: log could not be read, see errorString
+    bool build(const QString& logFileName, QString& errorString);
+
+    /// Builds the index by scanning an open log
+    void build(LogFileView& log);
+
+    /// Loads the sidecar index for the specified log
+    ///     @return false: No index, or the index is out of date with respect to the log
+    bool load(const QString& logFileName);
+
+    /// Saves the index to the sidecar file for the specified log
+    bool save(const QString& logFileName, QString& errorString) const;
+
+    /// Finds the first message whose timestamp is at or after timeUSecs in an open log. The index
+    /// is used to find the nearest preceding entry, the remainder of the interval is scanned to find the exact message.
+    ///     @param[out] messageTimeUSecs Timestamp of the message which was found
+    ///     @return Offset of the record for the message, -1 if there are no messages past the specified time
+    qint64 seek(LogFileView& log, quint64 timeUSecs, quint64& messageTimeUSecs) const;
+
+    bool                    isEmpty         (void) const { return _messageCount == 0; }
+    quint64                 startTimeUSecs  (void) const { return _startTimeUSecs; }
+    quint64                 endTimeUSecs    (void) const { return _endTimeUSecs; }
+    quint64                 durationUSecs   (void) const { return _endTimeUSecs - _startTimeUSecs; }
+    quint64                 messageCount    (void) const { return _messageCount; }
+    QMap<uint32_t, quint32> messageCounts   (void) const { return _messageCounts; }    ///< Message id to count histogram
+    const QVector<Entry>&   entries         (void) const { return _entries; }
+
+    /// @return Name of the sidecar index file for the specified log
+    static QString indexFileName(const QString& logFileName) { return logFileName + QStringLiteral(".idx"); }
+
+    /// Parses a big endian log timestamp. Old logs stored little endian timestamps, these are detected and swapped.
+    ///     @return Unix timestamp in microseconds UTC
+    static quint64 parseTimestamp(const uint8_t* bytes);
+
+    /// Determines the length of the timestamp/message record at the start of bytes
+    ///     @param[out] timeUSecs Timestamp for the record
+    ///     @param[out] msgid Message id for the record
+    ///     @return Record length, 0 if this is not a valid record, -1 if more bytes are needed
+    static int recordLength(const uint8_t* bytes, int length, quint64& timeUSecs, uint32_t& msgid);
+
+    /// Finds the next valid record at or after offset in an open log. Bytes which are not part of a valid record are
+    /// skipped. The record bytes stay available from log.data until the next call on log.
+    ///     @param[out] recordBytes Length of the record
+    ///     @return Offset of the record, -1 if there are no more complete records
+    static qint64 nextRecord(LogFileView& log, qint64 offset, quint64& timeUSecs, uint32_t& msgid, int& recordBytes);
+
+    static const int timestampLength = sizeof(quint64);
+    static const int maxRecordLength = timestampLength + MAVLINK_MAX_PACKET_LEN;
+
+private:
+    quint64                 _intervalUSecs;     ///< Time between index entries
+    QVector<Entry>          _entries;           ///< Sorted by time
+    QMap<uint32_t, quint32> _messageCounts;
+    quint64                 _messageCount;
+    quint64                 _startTimeUSecs;
+    quint64                 _endTimeUSecs;
+    qint64                  _fileSize;
+
+    static const quint64    _defaultIntervalUSecs = 100000;
+    static const quint32    _indexFileMagic =       0x51474349;     ///< "QGCI"
+    static const quint32    _indexFileVersion =     1;
+};
+
+#endif
@@ -0,0 +1,298 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkTlogWriter.h"
+#include "QGCLoggingCategory.h"
+
+#include <QDateTime>
+#include <QSettings>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+QGC_LOGGING_CATEGORY(MAVLinkTlogWriterLog, "MAVLinkTlogWriterLog")
+
+const char* MAVLinkTlogWriter::_settingsGroup = "QGC_MAVLINK_PROTOCOL";
+const char* MAVLinkTlogWriter::_syncToDiskKey = "TLOG_SYNC_TO_DISK";
+
+MAVLinkTlogWriter::MAVLinkTlogWriter(QObject* parent)
+    : QThread(parent)
+    , _open(false)
+    , _syncToDisk(false)
+    , _ring(new char[_ringSize])
+    , _head(0)
+    , _tail(0)
+    , _stopRequested(0)
+    , _aboveHighWater(false)
+    , _writeFailed(false)
+    , _fileOffset(0)
+    , _bytesWritten(0)
+    , _messagesLogged(0)
+    , _messagesDropped(0)
+    , _backpressureCount(0)
+{
+    QSettings settings;
+    settings.beginGroup(_settingsGroup);
+    _syncToDisk.store(settings.value(_syncToDiskKey, false).toBool());
+
+    _statsTimer.setInterval(1000);
+    connect(&_statsTimer, &QTimer::timeout, this, &MAVLinkTlogWriter::statsChanged);
+}
+
+MAVLinkTlogWriter::~MAVLinkTlogWriter()
+{
+    close();
+    delete[] _ring;
+}
+
+void MAVLinkTlogWriter::setSyncToDisk(bool syncToDisk)
+{
+    if (syncToDisk != this->syncToDisk()) {
+        _syncToDisk.storeRelease(syncToDisk);
+
+        QSettings settings;
+        settings.beginGroup(_settingsGroup);
+        settings.setValue(_syncToDiskKey, syncToDisk);
+
+        emit syncToDiskChanged(syncToDisk);
+    }
+}
+
+bool MAVLinkTlogWriter::open(const QString& fileName)
+{
+    if (_open) {
+        close();
+    }
+
+    _file.setFileName(fileName);
+    // Unbuffered since we already hand QFile large blocks
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        _errorString = _file.errorString();
+        qCWarning(MAVLinkTlogWriterLog) << "Open failed" << fileName << _errorString;
+        return false;
+    }
+
+    _head.store(0);
+    _tail.store(0);
+    _stopRequested.store(0);
+    _aboveHighWater = false;
+    _writeFailed = false;
+    _errorString.clear();
+    _index.clear();
+    _fileOffset = _file.size();
+    {
+        QMutexLocker locker(&_statsMutex);
+        _bytesWritten = 0;
+    }
+    _messagesLogged = 0;
+    _messagesDropped = 0;
+    _backpressureCount = 0;
+
+    _open = true;
+    start();
+    _statsTimer.start();
+
+    emit loggingChanged(true);
+    emit statsChanged();
+
+    return true;
+}
+
+void MAVLinkTlogWriter::close(void)
+{
+    if (!_open) {
+        return;
+    }
+
+    {
+        // Hold the mutex so the wake can't slip in between the writer checking for stop and going to sleep
+        QMutexLocker locker(&_waitMutex);
+        _stopRequested.storeRelease(1);
+        _waitCondition.wakeOne();
+    }
+    wait();
+
+    _open = false;
+    _statsTimer.stop();
+
+    // Only save the index if everything it points at made it to disk
+    if (!_writeFailed && !_index.isEmpty()) {
+        QString errorString;
+        _index.setFileSize(_fileOffset);
+        if (!_index.save(_file.fileName(), errorString)) {
+            qCWarning(MAVLinkTlogWriterLog) << "Unable to save log index" << errorString;
+        }
+    }
+
+    qCDebug(MAVLinkTlogWriterLog) << "Closed" << _file.fileName() << "bytes:logged:dropped:backpressure" << bytesWritten() << _messagesLogged << _messagesDropped << _backpressureCount;
+
+    emit loggingChanged(false);
+    emit statsChanged();
+}
+
+bool MAVLinkTlogWriter::logMessage(const mavlink_message_t& message)
+{
+    if (!_open) {
+        return false;
+    }
+
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN+sizeof(quint64)];
+
+    // Write the uint64 time in microseconds in big endian format before the message.
+    // This timestamp is saved in UTC time. We are only saving in ms precision because
+    // getting more than this isn't possible with Qt without a ton of extra code.
+    quint64 time = (quint64)QDateTime::currentMSecsSinceEpoch() * 1000;
+    qToBigEndian(time, buf);
+
+    // Then write the message to the buffer
+    quint32 len = mavlink_msg_to_send_buffer(buf + sizeof(quint64), &message) + sizeof(quint64);
+
+    quint32 head = _head.load();
+    quint32 used = head - _tail.loadAcquire();
+
+    if (_ringSize - used < len) {
+        // Writer is behind, drop rather than stall the caller
+        _messagesDropped++;
+        _wakeWriter();
+        return false;
+    }
+
+    if (used + len > _highWaterMark) {
+        if (!_aboveHighWater) {
+            _aboveHighWater = true;
+            _backpressureCount++;
+            qCDebug(MAVLinkTlogWriterLog) << "Ring buffer above high water mark" << used + len;
+        }
+    } else {
+        _aboveHighWater = false;
+    }
+
+    quint32 offset = head & (_ringSize - 1);
+    quint32 firstCount = qMin(len, _ringSize - offset);
+    memcpy(&_ring[offset], buf, firstCount);
+    if (firstCount < len) {
+        memcpy(_ring, &buf[firstCount], len - firstCount);
+    }
+    _head.storeRelease(head + len);
+    _messagesLogged++;
+
+    _index.addMessage(time, _fileOffset, message.msgid);
+    _fileOffset += len;
+
+    // Wake the writer as soon as there is a full block to write
+    if ((used % _flushBlockSize) + len >= _flushBlockSize) {
+        _wakeWriter();
+    }
+
+    return true;
+}
+
+/// Wakes the writer thread. The mutex is held so the wake can't be lost between the writer checking for data and
+/// going to sleep.
+void MAVLinkTlogWriter::_wakeWriter(void)
+{
+    QMutexLocker locker(&_waitMutex);
+    _waitCondition.wakeOne();
+}
+
+quint64 MAVLinkTlogWriter::bytesWritten(void)
+{
+    QMutexLocker locker(&_statsMutex);
+
+    return _bytesWritten;
+}
+
+int MAVLinkTlogWriter::bufferPercentFull(void) const
+{
+    quint32 used = _head.loadAcquire() - _tail.loadAcquire();
+
+    return (int)(((quint64)used * 100) / _ringSize);
+}
+
+void MAVLinkTlogWriter::run(void)
+{
+    while (true) {
+        {
+            QMutexLocker locker(&_waitMutex);
+            if (!_stopRequested.loadAcquire() && (_head.loadAcquire() - _tail.load()) < _flushBlockSize) {
+                _waitCondition.wait(&_waitMutex, _flushIntervalMSecs);
+            }
+        }
+
+        bool    stopping = _stopRequested.loadAcquire();
+        quint32 tail = _tail.load();
+        quint32 used = _head.loadAcquire() - tail;
+
+        // Write whole blocks while data is streaming in. Whatever is left over goes out when the flush interval
+        // expires with less than a block pending, or when we are closing.
+        quint32 count = used;
+        if (!stopping && used >= _flushBlockSize) {
+            count = used - (used % _flushBlockSize);
+        }
+
+        if (count) {
+            if (!_writeFailed) {
+                _writeFailed = !_writeBlock(tail, count);
+                if (_writeFailed) {
+                    emit writeError(_file.errorString());
+                } else if (_syncToDisk.loadAcquire()) {
+                    _syncFile();
+                }
+            }
+            // On write failure the data is discarded so the producer never blocks
+            _tail.storeRelease(tail + count);
+        }
+
+        if (stopping && _head.loadAcquire() == _tail.load()) {
+            break;
+        }
+    }
+
+    _file.flush();
+    _syncFile();
+    _file.close();
+}
+
+/// Writes count bytes from the ring starting at tail, handling wrap around
+bool MAVLinkTlogWriter::_writeBlock(quint32 tail, quint32 count)
+{
+    quint32 offset = tail & (_ringSize - 1);
+    quint32 firstCount = qMin(count, _ringSize - offset);
+
+    if (_file.write(&_ring[offset], firstCount) != (qint64)firstCount) {
+        return false;
+    }
+    if (firstCount < count && _file.write(_ring, count - firstCount) != (qint64)(count - firstCount)) {
+        return false;
+    }
+
+    QMutexLocker locker(&_statsMutex);
+    _bytesWritten += count;
+
+    return true;
+}
+
+void MAVLinkTlogWriter::_syncFile(void)
+{
+    int handle = _file.handle();
+    if (handle == -1) {
+        return;
+    }
+#ifdef Q_OS_WIN
+    _commit(handle);
+#else
+    fsync(handle);
+#endif
+}
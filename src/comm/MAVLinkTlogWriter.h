@@ -0,0 +1,122 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkTlogWriter_H
+#define MAVLinkTlogWriter_H
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QTimer>
+#include <QLoggingCategory>
+
+#include "QGCMAVLink.h"
+#include "MAVLinkTlogIndex.h"
+
+Q_DECLARE_LOGGING_CATEGORY(MAVLinkTlogWriterLog)
+
+/// Writes telemetry (.tlog) files on a background thread.
+///
+/// The main thread serializes each message as a big endian microsecond timestamp followed by the raw mavlink frame,
+/// which is the format LogReplayLink reads, into a lock free single producer/single consumer ring buffer. The writer
+/// thread drains the ring in large blocks and optionally syncs the file to disk after each flush. If the disk can't
+/// keep up the ring fills and further messages are dropped instead of stalling the main thread. The time index for the log
+/// is built as messages are queued and saved next to the log when it is closed.
+class MAVLinkTlogWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    MAVLinkTlogWriter(QObject* parent = NULL);
+    ~MAVLinkTlogWriter();
+
+    Q_PROPERTY(bool     logging             READ isOpen                                 NOTIFY loggingChanged)
+    Q_PROPERTY(bool     syncToDisk          READ syncToDisk     WRITE setSyncToDisk     NOTIFY syncToDiskChanged)
+    Q_PROPERTY(quint64  bytesWritten        READ bytesWritten                           NOTIFY statsChanged)
+    Q_PROPERTY(quint64  messagesLogged      READ messagesLogged                         NOTIFY statsChanged)
+    Q_PROPERTY(quint64  messagesDropped     READ messagesDropped                        NOTIFY statsChanged)
+    Q_PROPERTY(quint32  backpressureCount   READ backpressureCount                      NOTIFY statsChanged)
+    Q_PROPERTY(int      bufferPercentFull   READ bufferPercentFull                      NOTIFY statsChanged)
+
+    /// Opens the file for appending and starts the writer thread
+    ///     @return false: open failed, see errorString
+    bool open(const QString& fileName);
+
+    /// Writes all buffered data, closes the file and stops the writer thread
+    void close(void);
+
+    bool    isOpen              (void) const { return _open; }
+    QString errorString         (void) const { return _errorString; }
+    bool    syncToDisk          (void) const { return _syncToDisk.load() != 0; }
+    quint64 bytesWritten        (void);
+    quint64 messagesLogged      (void) const { return _messagesLogged; }
+    quint64 messagesDropped     (void) const { return _messagesDropped; }
+    quint32 backpressureCount   (void) const { return _backpressureCount; }
+    int     bufferPercentFull   (void) const;
+
+    void setSyncToDisk(bool syncToDisk);
+
+    /// Queues a message for writing. Must only be called from a single thread.
+    ///     @return false: ring buffer full, message dropped
+    bool logMessage(const mavlink_message_t& message);
+
+signals:
+    void loggingChanged     (bool logging);
+    void syncToDiskChanged  (bool syncToDisk);
+    void statsChanged       (void);
+
+    /// Signalled from the writer thread if the file could not be written. Nothing further is written.
+    void writeError         (const QString& errorString);
+
+protected:
+    // Override from QThread
+    void run(void);
+
+private:
+    bool _writeBlock    (quint32 tail, quint32 count);
+    void _syncFile      (void);
+    void _wakeWriter    (void);
+
+    QFile       _file;
+    bool        _open;
+    QString     _errorString;
+    QAtomicInteger<int> _syncToDisk;    ///< true: fsync the file after each flush, read by the writer thread
+    QTimer      _statsTimer;
+
+    char*                   _ring;
+    QAtomicInteger<quint32> _head;              ///< Total bytes queued, only written by the producer
+    QAtomicInteger<quint32> _tail;              ///< Total bytes written, only written by the writer thread
+    QAtomicInteger<int>     _stopRequested;
+    bool                    _aboveHighWater;    ///< true: ring is above the high water mark, producer side only
+    bool                    _writeFailed;       ///< Writer thread only
+
+    QMutex                  _waitMutex;
+    QWaitCondition          _waitCondition;
+
+    MAVLinkTlogIndex        _index;             ///< Producer side only
+    quint64                 _fileOffset;        ///< File offset of the next queued message, producer side only
+
+    QMutex                  _statsMutex;
+    quint64                 _bytesWritten;      ///< Protected by _statsMutex
+    quint64                 _messagesLogged;
+    quint64                 _messagesDropped;
+    quint32                 _backpressureCount;
+
+    static const quint32    _ringSize =             4 * 1024 * 1024;    ///< Must be a power of two
+    static const quint32    _flushBlockSize =       64 * 1024;          ///< Writes are done in multiples of this
+    static const quint32    _highWaterMark =        _ringSize / 4 * 3;
+    static const unsigned long _flushIntervalMSecs = 500;               ///< Max time data sits in the ring
+    static const char*      _settingsGroup;
+    static const char*      _syncToDiskKey;
+};
+
+#endif
@@ -9,6 +9,7 @@
 
 
 #include "MockLink.h"
+#include "MAVLinkFrameDecoder.h"
 #include "QGCLoggingCategory.h"
 #include "QGCApplication.h"
 #ifndef __mobile__
@@ -18,6 +19,7 @@
 #include <QTimer>
 #include <QDebug>
 #include <QFile>
+#include <QtMath>
 
 #include <string.h>
 
@@ -36,13 +38,18 @@ float           MockLink::_vehicleLongitude =       -122.08794f;
 float           MockLink::_vehicleAltitude =        3.5f;
 int             MockLink::_nextVehicleSystemId =    128;
 const char*     MockLink::_failParam =              "COM_FLTMODE6";
+QElapsedTimer   MockLink::_bootTimer;
 
 const char* MockConfiguration::_firmwareTypeKey =   "FirmwareType";
 const char* MockConfiguration::_vehicleTypeKey =    "VehicleType";
 const char* MockConfiguration::_sendStatusTextKey = "SendStatusText";
 const char* MockConfiguration::_failureModeKey =    "FailureMode";
+const char* MockConfiguration::_streamRatesKey =    "StreamRates";
+const char* MockConfiguration::_packetLossPercentKey =  "PacketLossPercent";
+const char* MockConfiguration::_jitterMSecsKey =        "JitterMSecs";
+const char* MockConfiguration::_sharedVehicleCountKey = "SharedVehicleCount";
 
-MockLink::MockLink(MockConfiguration* config)
+MockLink::MockLink(MockConfiguration* config, MockLink* sharedLink)
     : _missionItemHandler(this, qgcApp()->toolbox()->mavlinkProtocol())
     , _name("MockLink")
     , _connected(false)
@@ -64,14 +71,32 @@ MockLink::MockLink(MockConfiguration* config)
     , _currentParamRequestListParamIndex(-1)
     , _logDownloadCurrentOffset(0)
     , _logDownloadBytesRemaining(0)
+    , _logDownloadBytesSent(0)
+    , _logDownloadLossPercent(0)
+    , _packetLossPercent(0)
+    , _jitterMSecs(0)
+    , _sharedLink(sharedLink)
+    , _txSequence(0)
 {
+    if (!_bootTimer.isValid()) {
+        _bootTimer.start();
+    }
+
     _config = config;
     if (_config) {
         _firmwareType = config->firmwareType();
         _vehicleType = config->vehicleType();
         _sendStatusText = config->sendStatusText();
         _failureMode = config->failureMode();
+        _packetLossPercent = config->packetLossPercent();
+        _jitterMSecs = config->jitterMSecs();
         _config->setLink(this);
+
+        QMap<uint32_t, int> streamRates = config->streamRates();
+        foreach (uint32_t msgId, streamRates.keys()) {
+            Stream_t stream = { qMax(1, 1000 / streamRates[msgId]), 0 };
+            _streams[msgId] = stream;
+        }
     }
 
     union px4_custom_mode   px4_cm;
@@ -83,14 +108,36 @@ MockLink::MockLink(MockConfiguration* config)
     _fileServer = new MockLinkFileServer(_vehicleSystemId, _vehicleComponentId, this);
     Q_CHECK_PTR(_fileServer);
 
-    moveToThread(this);
+    if (_sharedLink) {
+        // A shared vehicle's own thread is never started, it runs from the thread of the link which carries its traffic
+        moveToThread(_sharedLink);
+    } else {
+        moveToThread(this);
+    }
 
     _loadParams();
+
+    if (_config) {
+        for (int i=0; i<_config->sharedVehicleCount(); i++) {
+            // Shared vehicles are set up the same as this one, but are never connected through LinkManager. They run
+            // from this link's thread and all their traffic goes through this link.
+            MockConfiguration sharedConfig(_config);
+            sharedConfig.setSharedVehicleCount(0);
+            sharedConfig.setPacketLossPercent(0);
+            sharedConfig.setJitterMSecs(0);
+
+            MockLink* vehicle = new MockLink(&sharedConfig, this);
+            Q_CHECK_PTR(vehicle);
+            vehicle->_config = NULL;
+            _sharedVehicles.append(vehicle);
+        }
+    }
 }
 
 MockLink::~MockLink(void)
 {
     _disconnect();
+    qDeleteAll(_sharedVehicles);
     if (!_logDownloadFilename.isEmpty()) {
         QFile::remove(_logDownloadFilename);
     }
@@ -100,6 +147,11 @@ bool MockLink::_connect(void)
 {
     if (!_connected) {
         _connected = true;
+        foreach (MockLink* vehicle, _sharedVehicles) {
+            vehicle->_mavlinkChannelSet = true;
+            vehicle->_mavlinkChannel = mavlinkChannel();
+            vehicle->_connected = true;
+        }
         start();
         emit connected();
     }
@@ -113,6 +165,9 @@ void MockLink::_disconnect(void)
         _connected = false;
         quit();
         wait();
+        foreach (MockLink* vehicle, _sharedVehicles) {
+            vehicle->_connected = false;
+        }
         emit disconnected();
     }
 }
@@ -138,6 +193,9 @@ void MockLink::run(void)
     QObject::disconnect(&timer500HzTasks, &QTimer::timeout, this, &MockLink::_run500HzTasks);
 
     _missionItemHandler.shutdown();
+    foreach (MockLink* vehicle, _sharedVehicles) {
+        vehicle->_missionItemHandler.shutdown();
+    }
 }
 
 void MockLink::_run1HzTasks(void)
@@ -159,6 +217,10 @@ void MockLink::_run1HzTasks(void)
             _sendStatusTextMessages();
         }
     }
+
+    foreach (MockLink* vehicle, _sharedVehicles) {
+        vehicle->_run1HzTasks();
+    }
 }
 
 void MockLink::_run10HzTasks(void)
@@ -172,6 +234,10 @@ void MockLink::_run10HzTasks(void)
             _sendGpsRawInt();
         }
     }
+
+    foreach (MockLink* vehicle, _sharedVehicles) {
+        vehicle->_run10HzTasks();
+    }
 }
 
 void MockLink::_run500HzTasks(void)
@@ -179,6 +245,15 @@ void MockLink::_run500HzTasks(void)
     if (_mavlinkStarted && _connected) {
         _paramRequestListWorker();
         _logDownloadWorker();
+        _streamWorker();
+    }
+
+    foreach (MockLink* vehicle, _sharedVehicles) {
+        vehicle->_run500HzTasks();
+    }
+
+    if (!_delayedBytes.isEmpty()) {
+        _sendDelayedBytes();
     }
 }
 
@@ -297,10 +372,47 @@ void MockLink::respondWithMavlinkMessage(const mavlink_message_t& msg)
     uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
 
     int cBuffer = mavlink_msg_to_send_buffer(buffer, &msg);
-    QByteArray bytes((char *)buffer, cBuffer);
+
+    if (_sharedLink) {
+        // The message was packed using the shared link's channel. Each vehicle needs its own sequence numbers, otherwise
+        // QGC sees the gaps as packet loss.
+        MAVLinkFrameDecoder::setFrameSequence(buffer, _txSequence++);
+        _sharedLink->_sendBytes(QByteArray((char *)buffer, cBuffer));
+    } else {
+        _sendBytes(QByteArray((char *)buffer, cBuffer));
+    }
+}
+
+/// Sends bytes to QGC, applying simulated packet loss and jitter
+void MockLink::_sendBytes(const QByteArray& bytes)
+{
+    if (_packetLossPercent > 0 && (qrand() % 10000) < _packetLossPercent * 100) {
+        return;
+    }
+
+    if (_jitterMSecs > 0) {
+        // Never send ahead of the previous packet so order is preserved
+        qint64 sendMSecs = bootMSecs() + (qrand() % (_jitterMSecs + 1));
+        if (!_delayedBytes.isEmpty()) {
+            sendMSecs = qMax(sendMSecs, _delayedBytes.last().sendMSecs);
+        }
+        DelayedBytes_t delayedBytes = { sendMSecs, bytes };
+        _delayedBytes.enqueue(delayedBytes);
+        return;
+    }
+
     emit bytesReceived(this, bytes);
 }
 
+void MockLink::_sendDelayedBytes(void)
+{
+    qint64 nowMSecs = bootMSecs();
+
+    while (!_delayedBytes.isEmpty() && _delayedBytes.head().sendMSecs <= nowMSecs) {
+        emit bytesReceived(this, _delayedBytes.dequeue().bytes);
+    }
+}
+
 /// @brief Called when QGC wants to write bytes to the MAV
 void MockLink::_writeBytes(const QByteArray bytes)
 {
@@ -352,54 +464,85 @@ void MockLink::_handleIncomingMavlinkBytes(const uint8_t* bytes, int cBytes)
             continue;
         }
 
-        if (_missionItemHandler.handleMessage(msg)) {
-            continue;
+        if (_sharedVehicles.isEmpty()) {
+            _handleIncomingMavlinkMessage(msg);
+        } else {
+            // Route by target system, messages without a target go to all vehicles on the link
+            int targetSystem = _targetSystem(msg);
+            if (targetSystem == 0 || targetSystem == _vehicleSystemId) {
+                _handleIncomingMavlinkMessage(msg);
+            }
+            foreach (MockLink* vehicle, _sharedVehicles) {
+                if (targetSystem == 0 || targetSystem == vehicle->vehicleId()) {
+                    vehicle->_handleIncomingMavlinkMessage(msg);
+                }
+            }
         }
+    }
+}
 
-        switch (msg.msgid) {
-        case MAVLINK_MSG_ID_HEARTBEAT:
-            _handleHeartBeat(msg);
-            break;
+/// @return Target system for the message, 0 if the message is not targeted
+int MockLink::_targetSystem(const mavlink_message_t& msg)
+{
+    const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msg.msgid);
 
-        case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
-            _handleParamRequestList(msg);
-            break;
+    // Trailing zeros are truncated from MAVLink 2.0 payloads so a target past the end of the payload is 0
+    if (!entry || !(entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) || entry->target_system_ofs >= msg.len) {
+        return 0;
+    }
 
-        case MAVLINK_MSG_ID_SET_MODE:
-            _handleSetMode(msg);
-            break;
+    return (uint8_t)_MAV_PAYLOAD(&msg)[entry->target_system_ofs];
+}
 
-        case MAVLINK_MSG_ID_PARAM_SET:
-            _handleParamSet(msg);
-            break;
+void MockLink::_handleIncomingMavlinkMessage(const mavlink_message_t& msg)
+{
+    if (_missionItemHandler.handleMessage(msg)) {
+        return;
+    }
 
-        case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
-            _handleParamRequestRead(msg);
-            break;
+    switch (msg.msgid) {
+    case MAVLINK_MSG_ID_HEARTBEAT:
+        _handleHeartBeat(msg);
+        break;
 
-        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
-            _handleFTP(msg);
-            break;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+        _handleParamRequestList(msg);
+        break;
 
-        case MAVLINK_MSG_ID_COMMAND_LONG:
-            _handleCommandLong(msg);
-            break;
+    case MAVLINK_MSG_ID_SET_MODE:
+        _handleSetMode(msg);
+        break;
 
-        case MAVLINK_MSG_ID_MANUAL_CONTROL:
-            _handleManualControl(msg);
-            break;
+    case MAVLINK_MSG_ID_PARAM_SET:
+        _handleParamSet(msg);
+        break;
 
-        case MAVLINK_MSG_ID_LOG_REQUEST_LIST:
-            _handleLogRequestList(msg);
-            break;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+        _handleParamRequestRead(msg);
+        break;
 
-        case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
-            _handleLogRequestData(msg);
-            break;
+    case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+        _handleFTP(msg);
+        break;
 
-        default:
-            break;
-        }
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+        _handleCommandLong(msg);
+        break;
+
+    case MAVLINK_MSG_ID_MANUAL_CONTROL:
+        _handleManualControl(msg);
+        break;
+
+    case MAVLINK_MSG_ID_LOG_REQUEST_LIST:
+        _handleLogRequestList(msg);
+        break;
+
+    case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
+        _handleLogRequestData(msg);
+        break;
+
+    default:
+        break;
     }
 }
 
@@ -428,6 +571,17 @@ void MockLink::_handleManualControl(const mavlink_message_t& msg)
     qDebug() << "MANUAL_CONTROL" << manualControl.x << manualControl.y << manualControl.z << manualControl.r;
 }
 
+void MockLink::setParamValue(int componentId, const QString& paramName, const QVariant& value)
+{
+    Q_ASSERT(_mapParamName2Value.contains(componentId));
+    Q_ASSERT(_mapParamName2Value[componentId].contains(paramName));
+
+    // Keep the type the parameter was loaded with
+    QVariant paramValue = value;
+    paramValue.convert(_mapParamName2Value[componentId][paramName].type());
+    _mapParamName2Value[componentId][paramName] = paramValue;
+}
+
 void MockLink::_setParamFloatUnionIntoMap(int componentId, const QString& paramName, float paramFloat)
 {
     mavlink_param_union_t   valueUnion;
@@ -902,6 +1056,132 @@ void MockLink::_sendGpsRawInt(void)
     respondWithMavlinkMessage(msg);
 }
 
+/// Sends telemetry streams which are due
+void MockLink::_streamWorker(void)
+{
+    qint64 nowMSecs = bootMSecs();
+
+    QMutableMapIterator<uint32_t, Stream_t> iter(_streams);
+    while (iter.hasNext()) {
+        Stream_t& stream = iter.next().value();
+
+        if (nowMSecs < stream.nextSendMSecs) {
+            continue;
+        }
+
+        // Stay on schedule unless we have fallen a whole interval behind
+        stream.nextSendMSecs += stream.intervalMSecs;
+        if (stream.nextSendMSecs <= nowMSecs) {
+            stream.nextSendMSecs = nowMSecs + stream.intervalMSecs;
+        }
+
+        switch (iter.key()) {
+        case MAVLINK_MSG_ID_ATTITUDE:
+            _sendAttitude();
+            break;
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+            _sendGlobalPositionInt();
+            break;
+        case MAVLINK_MSG_ID_VFR_HUD:
+            _sendVfrHud();
+            break;
+        case MAVLINK_MSG_ID_SYS_STATUS:
+            _sendSysStatus();
+            break;
+        default:
+            qWarning() << "MockLink stream not supported" << iter.key();
+            iter.remove();
+            break;
+        }
+    }
+}
+
+void MockLink::_sendAttitude(void)
+{
+    mavlink_message_t msg;
+
+    // Keep the attitude moving so every message changes the vehicle's Facts. Each vehicle is out of phase with the others.
+    uint32_t    timeBootMSecs = (uint32_t)bootMSecs();
+    float       t = (timeBootMSecs / 1000.0f) + _vehicleSystemId;
+
+    mavlink_msg_attitude_pack_chan(_vehicleSystemId,
+                                   _vehicleComponentId,
+                                   mavlinkChannel(),
+                                   &msg,
+                                   timeBootMSecs,                               // time_boot_ms
+                                   0.2f * qSin(t),                              // roll
+                                   0.1f * qCos(t),                              // pitch
+                                   fmodf(t * 0.5f, 2.0f * (float)M_PI) - (float)M_PI,  // yaw
+                                   0.2f * qCos(t),                              // rollspeed
+                                   -0.1f * qSin(t),                             // pitchspeed
+                                   0.5f);                                       // yawspeed
+    respondWithMavlinkMessage(msg);
+}
+
+void MockLink::_sendGlobalPositionInt(void)
+{
+    mavlink_message_t msg;
+
+    // Fly a small circle around the mock vehicle position
+    uint32_t    timeBootMSecs = (uint32_t)bootMSecs();
+    float       t = ((timeBootMSecs / 1000.0f) * 0.1f) + _vehicleSystemId;
+
+    mavlink_msg_global_position_int_pack_chan(_vehicleSystemId,
+                                              _vehicleComponentId,
+                                              mavlinkChannel(),
+                                              &msg,
+                                              timeBootMSecs,                                            // time_boot_ms
+                                              (int32_t)((_vehicleLatitude  + (0.0005f * qSin(t))) * 1E7),
+                                              (int32_t)((_vehicleLongitude + (0.0005f * qCos(t))) * 1E7),
+                                              (int32_t)((_vehicleAltitude + 20.0f) * 1000),             // alt (mm)
+                                              20000,                                                    // relative_alt (mm)
+                                              (int16_t)(500 * qCos(t)),                                 // vx (cm/s)
+                                              (int16_t)(-500 * qSin(t)),                                // vy (cm/s)
+                                              0,                                                        // vz (cm/s)
+                                              UINT16_MAX);                                              // heading not known
+    respondWithMavlinkMessage(msg);
+}
+
+void MockLink::_sendVfrHud(void)
+{
+    mavlink_message_t msg;
+
+    float t = (bootMSecs() / 1000.0f) + _vehicleSystemId;
+
+    mavlink_msg_vfr_hud_pack_chan(_vehicleSystemId,
+                                  _vehicleComponentId,
+                                  mavlinkChannel(),
+                                  &msg,
+                                  5.0f + qSin(t),               // airspeed
+                                  5.0f + qCos(t),               // groundspeed
+                                  (int16_t)(t * 10) % 360,      // heading
+                                  50,                           // throttle
+                                  _vehicleAltitude + 20.0f,     // alt
+                                  0.5f * qSin(t));              // climb
+    respondWithMavlinkMessage(msg);
+}
+
+void MockLink::_sendSysStatus(void)
+{
+    mavlink_message_t msg;
+
+    mavlink_msg_sys_status_pack_chan(_vehicleSystemId,
+                                     _vehicleComponentId,
+                                     mavlinkChannel(),
+                                     &msg,
+                                     0,         // onboard_control_sensors_present
+                                     0,         // onboard_control_sensors_enabled
+                                     0,         // onboard_control_sensors_health
+                                     250,       // load
+                                     12600,     // voltage_battery (mV)
+                                     -1,        // current_battery not known
+                                     75,        // battery_remaining
+                                     0,         // drop_rate_comm
+                                     0,         // errors_comm
+                                     0, 0, 0, 0);
+    respondWithMavlinkMessage(msg);
+}
+
 void MockLink::_sendStatusTextMessages(void)
 {
     struct StatusMessage {
@@ -941,6 +1221,9 @@ MockConfiguration::MockConfiguration(const QString& name)
     , _vehicleType(MAV_TYPE_QUADROTOR)
     , _sendStatusText(false)
     , _failureMode(FailNone)
+    , _packetLossPercent(0)
+    , _jitterMSecs(0)
+    , _sharedVehicleCount(0)
 {
 
 }
@@ -948,10 +1231,23 @@ MockConfiguration::MockConfiguration(const QString& name)
 MockConfiguration::MockConfiguration(MockConfiguration* source)
     : LinkConfiguration(source)
 {
-    _firmwareType =     source->_firmwareType;
-    _vehicleType =      source->_vehicleType;
-    _sendStatusText =   source->_sendStatusText;
-    _failureMode =      source->_failureMode;
+    _firmwareType =         source->_firmwareType;
+    _vehicleType =          source->_vehicleType;
+    _sendStatusText =       source->_sendStatusText;
+    _failureMode =          source->_failureMode;
+    _streamRates =          source->_streamRates;
+    _packetLossPercent =    source->_packetLossPercent;
+    _jitterMSecs =          source->_jitterMSecs;
+    _sharedVehicleCount =   source->_sharedVehicleCount;
+}
+
+void MockConfiguration::setStreamRate(uint32_t msgId, int rateHz)
+{
+    if (rateHz > 0) {
+        _streamRates[msgId] = rateHz;
+    } else {
+        _streamRates.remove(msgId);
+    }
 }
 
 void MockConfiguration::copyFrom(LinkConfiguration *source)
@@ -968,6 +1264,10 @@ void MockConfiguration::copyFrom(LinkConfiguration *source)
     _vehicleType =      usource->_vehicleType;
     _sendStatusText =   usource->_sendStatusText;
     _failureMode =      usource->_failureMode;
+    _streamRates =          usource->_streamRates;
+    _packetLossPercent =    usource->_packetLossPercent;
+    _jitterMSecs =          usource->_jitterMSecs;
+    _sharedVehicleCount =   usource->_sharedVehicleCount;
 }
 
 void MockConfiguration::saveSettings(QSettings& settings, const QString& root)
@@ -977,6 +1277,14 @@ void MockConfiguration::saveSettings(QSettings& settings, const QString& root)
     settings.setValue(_vehicleTypeKey, (int)_vehicleType);
     settings.setValue(_sendStatusTextKey, _sendStatusText);
     settings.setValue(_failureModeKey, (int)_failureMode);
+    settings.setValue(_packetLossPercentKey, _packetLossPercent);
+    settings.setValue(_jitterMSecsKey, _jitterMSecs);
+    settings.setValue(_sharedVehicleCountKey, _sharedVehicleCount);
+    QVariantMap streamRates;
+    foreach (uint32_t msgId, _streamRates.keys()) {
+        streamRates[QString::number(msgId)] = _streamRates[msgId];
+    }
+    settings.setValue(_streamRatesKey, streamRates);
     settings.sync();
     settings.endGroup();
 }
@@ -988,6 +1296,14 @@ void MockConfiguration::loadSettings(QSettings& settings, const QString& root)
     _vehicleType = (MAV_TYPE)settings.value(_vehicleTypeKey, (int)MAV_TYPE_QUADROTOR).toInt();
     _sendStatusText = settings.value(_sendStatusTextKey, false).toBool();
     _failureMode = (FailureMode_t)settings.value(_failureModeKey, (int)FailNone).toInt();
+    _packetLossPercent = settings.value(_packetLossPercentKey, 0).toDouble();
+    _jitterMSecs = settings.value(_jitterMSecsKey, 0).toInt();
+    _sharedVehicleCount = settings.value(_sharedVehicleCountKey, 0).toInt();
+    _streamRates.clear();
+    QVariantMap streamRates = settings.value(_streamRatesKey).toMap();
+    foreach (const QString& msgId, streamRates.keys()) {
+        setStreamRate(msgId.toUInt(), streamRates[msgId].toInt());
+    }
     settings.endGroup();
 }
 
@@ -1025,6 +1341,18 @@ MockLink*  MockLink::startPX4MockLink(bool sendStatusText, MockConfiguration::Fa
     return _startMockLink(mockConfig);
 }
 
+MockLink*  MockLink::startLossyPX4MockLink(double packetLossPercent, int jitterMSecs)
+{
+    MockConfiguration* mockConfig = new MockConfiguration("Lossy PX4 MockLink");
+
+    mockConfig->setFirmwareType(MAV_AUTOPILOT_PX4);
+    mockConfig->setVehicleType(MAV_TYPE_QUADROTOR);
+    mockConfig->setPacketLossPercent(packetLossPercent);
+    mockConfig->setJitterMSecs(jitterMSecs);
+
+    return _startMockLink(mockConfig);
+}
+
 MockLink*  MockLink::startGenericMockLink(bool sendStatusText, MockConfiguration::FailureMode_t failureMode)
 {
     MockConfiguration* mockConfig = new MockConfiguration("Generic MockLink");
@@ -1073,6 +1401,32 @@ MockLink*  MockLink::startAPMArduSubMockLink(bool sendStatusText, MockConfigurat
     return _startMockLink(mockConfig);
 }
 
+QList<MockLink*> MockLink::startSwarmMockLinks(MockConfiguration* swarmConfig, int vehicleCount, bool sharedLink)
+{
+    QList<MockLink*> links;
+
+    if (sharedLink) {
+        MockConfiguration* mockConfig = new MockConfiguration(swarmConfig);
+
+        mockConfig->setName(QStringLiteral("Swarm MockLink"));
+        mockConfig->setSharedVehicleCount(vehicleCount - 1);
+
+        links.append(_startMockLink(mockConfig));
+    } else {
+        // Each link uses up a mavlink channel, so the swarm size is limited by the number of channels
+        for (int i=0; i<vehicleCount; i++) {
+            MockConfiguration* mockConfig = new MockConfiguration(swarmConfig);
+
+            mockConfig->setName(QString("Swarm MockLink %1").arg(i + 1));
+            mockConfig->setSharedVehicleCount(0);
+
+            links.append(_startMockLink(mockConfig));
+        }
+    }
+
+    return links;
+}
+
 void MockLink::_sendRCChannels(void)
 {
     mavlink_message_t   msg;
@@ -1193,19 +1547,22 @@ void MockLink::_logDownloadWorker(void)
             Q_ASSERT(file.seek(_logDownloadCurrentOffset));
             Q_ASSERT(file.read((char *)buffer, bytesToRead) == bytesToRead);
 
-            qDebug() << "MockLink::_logDownloadWorker" << _logDownloadCurrentOffset << _logDownloadBytesRemaining;
-
-            mavlink_message_t responseMsg;
-            mavlink_msg_log_data_pack_chan(_vehicleSystemId,
-                                           _vehicleComponentId,
-                                           mavlinkChannel(),
-                                           &responseMsg,
-                                           _logDownloadLogId,
-                                           _logDownloadCurrentOffset,
-                                           bytesToRead,
-                                           &buffer[0]);
-            respondWithMavlinkMessage(responseMsg);
-
+            qCDebug(MockLinkVerboseLog) << "MockLink::_logDownloadWorker" << _logDownloadCurrentOffset << _logDownloadBytesRemaining;
+
+            if (_logDownloadLossPercent == 0 || (qrand() % 100) >= _logDownloadLossPercent) {
+                mavlink_message_t responseMsg;
+                mavlink_msg_log_data_pack_chan(_vehicleSystemId,
+                                               _vehicleComponentId,
+                                               mavlinkChannel(),
+                                               &responseMsg,
+                                               _logDownloadLogId,
+                                               _logDownloadCurrentOffset,
+                                               bytesToRead,
+                                               &buffer[0]);
+                respondWithMavlinkMessage(responseMsg);
+            }
+
+            _logDownloadBytesSent += bytesToRead;
             _logDownloadCurrentOffset += bytesToRead;
             _logDownloadBytesRemaining -= bytesToRead;
 
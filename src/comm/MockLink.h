@@ -12,6 +12,8 @@
 #define MOCKLINK_H
 
 #include <QMap>
+#include <QQueue>
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 
 #include "MockLinkMissionItemHandler.h"
@@ -60,6 +62,23 @@ public:
     FailureMode_t failureMode(void) { return _failureMode; }
     void setFailureMode(FailureMode_t failureMode) { _failureMode = failureMode; }
 
+    /// Telemetry stream rates in Hz keyed by message id. Streams are only sent once a rate is set. Supported messages
+    /// are ATTITUDE, GLOBAL_POSITION_INT, VFR_HUD and SYS_STATUS.
+    QMap<uint32_t, int> streamRates(void) { return _streamRates; }
+    void setStreamRate(uint32_t msgId, int rateHz);
+
+    /// Percentage of packets sent by the vehicle which are dropped
+    double packetLossPercent(void) { return _packetLossPercent; }
+    void setPacketLossPercent(double packetLossPercent) { _packetLossPercent = packetLossPercent; }
+
+    /// Packets sent by the vehicle are delayed by a random amount up to this value. Packet order is preserved.
+    int jitterMSecs(void) { return _jitterMSecs; }
+    void setJitterMSecs(int jitterMSecs) { _jitterMSecs = jitterMSecs; }
+
+    /// Number of additional vehicles, each with its own system id, which share the link
+    int sharedVehicleCount(void) { return _sharedVehicleCount; }
+    void setSharedVehicleCount(int sharedVehicleCount) { _sharedVehicleCount = sharedVehicleCount; }
+
     // Overrides from LinkConfiguration
     LinkType    type            (void) { return LinkConfiguration::TypeMock; }
     void        copyFrom        (LinkConfiguration* source);
@@ -78,11 +97,19 @@ private:
     MAV_TYPE        _vehicleType;
     bool            _sendStatusText;
     FailureMode_t   _failureMode;
+    QMap<uint32_t, int> _streamRates;
+    double          _packetLossPercent;
+    int             _jitterMSecs;
+    int             _sharedVehicleCount;
 
     static const char* _firmwareTypeKey;
     static const char* _vehicleTypeKey;
     static const char* _sendStatusTextKey;
     static const char* _failureModeKey;
+    static const char* _streamRatesKey;
+    static const char* _packetLossPercentKey;
+    static const char* _jitterMSecsKey;
+    static const char* _sharedVehicleCountKey;
 };
 
 class MockLink : public LinkInterface
@@ -91,7 +118,8 @@ class MockLink : public LinkInterface
 
 public:
     // LinkConfiguration is optional for MockLink
-    MockLink(MockConfiguration* config = NULL);
+    ///     @param sharedLink Link which carries this vehicle's traffic, NULL for a vehicle with its own link
+    MockLink(MockConfiguration* config = NULL, MockLink* sharedLink = NULL);
     ~MockLink(void);
 
     // MockLink methods
@@ -114,6 +142,13 @@ public:
 
     MockLinkFileServer* getFileServer(void) { return _fileServer; }
 
+    /// @return Vehicles which share this link, not including the vehicle for the link itself
+    QList<MockLink*> sharedVehicles(void) { return _sharedVehicles; }
+
+    /// @return Time since the first MockLink was created. This is sent as time_boot_ms in streamed telemetry so all
+    /// mock vehicles run off the same clock.
+    static qint64 bootMSecs(void) { return _bootTimer.elapsed(); }
+
     // Virtuals from LinkInterface
     virtual QString getName(void) const { return _name; }
     virtual void requestReset(void){ }
@@ -144,15 +179,36 @@ public:
     /// Reset the state of the MissionItemHandler to no items, no transactions in progress.
     void resetMissionItemHandler(void) { _missionItemHandler.reset(); }
 
+    /// Changes a parameter value as if it was set on the vehicle. Must be called before the vehicle requests parameters.
+    void setParamValue(int componentId, const QString& paramName, const QVariant& value);
+
     /// Returns the filename for the simulated log file. Onyl available after a download is requested.
     QString logDownloadFile(void) { return _logDownloadFilename; }
 
+    uint32_t logDownloadFileSize(void) const { return _logDownloadFileSize; }
+
+    /// Drops the specified percentage of LOG_DATA messages
+    void setLogDownloadLossPercent(int lossPercent) { _logDownloadLossPercent = lossPercent; }
+
+    /// Returns the number of log data bytes sent so far, including the ones which were dropped
+    uint32_t logDownloadBytesSent(void) const { return _logDownloadBytesSent; }
+
     static MockLink* startPX4MockLink            (bool sendStatusText, MockConfiguration::FailureMode_t failureMode = MockConfiguration::FailNone);
     static MockLink* startGenericMockLink        (bool sendStatusText, MockConfiguration::FailureMode_t failureMode = MockConfiguration::FailNone);
     static MockLink* startAPMArduCopterMockLink  (bool sendStatusText, MockConfiguration::FailureMode_t failureMode = MockConfiguration::FailNone);
     static MockLink* startAPMArduPlaneMockLink   (bool sendStatusText, MockConfiguration::FailureMode_t failureMode = MockConfiguration::FailNone);
     static MockLink* startAPMArduSubMockLink     (bool sendStatusText, MockConfiguration::FailureMode_t failureMode = MockConfiguration::FailNone);
 
+    /// Starts a PX4 vehicle on a link which drops and delays the messages sent by the vehicle
+    static MockLink* startLossyPX4MockLink(double packetLossPercent, int jitterMSecs);
+
+    /// Starts a swarm of vehicles, each with its own system id
+    ///     @param swarmConfig Settings for each vehicle, copied for each link which is started
+    ///     @param vehicleCount Number of vehicles in the swarm
+    ///     @param sharedLink true: all vehicles share a single link, false: each vehicle has its own link
+    /// @return Links which were started
+    static QList<MockLink*> startSwarmMockLinks(MockConfiguration* swarmConfig, int vehicleCount, bool sharedLink);
+
 private slots:
     virtual void _writeBytes(const QByteArray bytes);
 
@@ -173,6 +229,7 @@ private:
     void _sendHeartBeat(void);
     void _handleIncomingNSHBytes(const char* bytes, int cBytes);
     void _handleIncomingMavlinkBytes(const uint8_t* bytes, int cBytes);
+    void _handleIncomingMavlinkMessage(const mavlink_message_t& msg);
     void _loadParams(void);
     void _handleHeartBeat(const mavlink_message_t& msg);
     void _handleSetMode(const mavlink_message_t& msg);
@@ -195,7 +252,15 @@ private:
     void _sendRCChannels(void);
     void _paramRequestListWorker(void);
     void _logDownloadWorker(void);
-
+    void _streamWorker(void);
+    void _sendAttitude(void);
+    void _sendGlobalPositionInt(void);
+    void _sendVfrHud(void);
+    void _sendSysStatus(void);
+    void _sendBytes(const QByteArray& bytes);
+    void _sendDelayedBytes(void);
+
+    static int _targetSystem(const mavlink_message_t& msg);
     static MockLink* _startMockLink(MockConfiguration* mockConfig);
 
     MockLinkMissionItemHandler  _missionItemHandler;
@@ -233,12 +298,33 @@ private:
     int _currentParamRequestListParamIndex;     // Current parameter index for param request list workflow
 
     static const uint16_t _logDownloadLogId = 0;        ///< Id of siumulated log file
-    static const uint32_t _logDownloadFileSize = 1000;  ///< Size of simulated log file
+    static const uint32_t _logDownloadFileSize = 50000; ///< Size of simulated log file, several requests worth
 
     QString _logDownloadFilename;           ///< Filename for log download which is in progress
     uint32_t    _logDownloadCurrentOffset;  ///< Current offset we are sending from
     uint32_t    _logDownloadBytesRemaining; ///< Number of bytes still to send, 0 = send inactive
-
+    uint32_t    _logDownloadBytesSent;      ///< Total number of log data bytes sent
+    int         _logDownloadLossPercent;    ///< Percentage of LOG_DATA messages to drop
+
+    typedef struct {
+        int     intervalMSecs;
+        qint64  nextSendMSecs;
+    } Stream_t;
+
+    typedef struct {
+        qint64      sendMSecs;
+        QByteArray  bytes;
+    } DelayedBytes_t;
+
+    QMap<uint32_t, Stream_t>    _streams;               ///< Telemetry streams keyed by message id
+    double                      _packetLossPercent;
+    int                         _jitterMSecs;
+    QQueue<DelayedBytes_t>      _delayedBytes;          ///< Packets held back to simulate jitter, in send order
+    MockLink*                   _sharedLink;            ///< Link which carries this vehicle's traffic, NULL if it has its own link
+    QList<MockLink*>            _sharedVehicles;        ///< Vehicles which share this link
+    uint8_t                     _txSequence;            ///< Outgoing sequence number for a vehicle on a shared link
+
+    static QElapsedTimer    _bootTimer;
     static float        _vehicleLatitude;
     static float        _vehicleLongitude;
     static float        _vehicleAltitude;
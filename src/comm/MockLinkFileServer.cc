@@ -27,13 +27,23 @@ const MockLinkFileServer::FileTestCase MockLinkFileServer::rgFileTestCases[MockL
     { "exact.qgc",      sizeof(((FileManager::Request*)0)->data),         1,    true },
     // File is larger than a single Read Ack packets, requires multiple Reads
     { "multi.qgc",      sizeof(((FileManager::Request*)0)->data) + 1,     2,    false },
+    // File is large enough to fill the read window many times over
+    { "large.qgc",      (sizeof(((FileManager::Request*)0)->data) * 400) + 17,  401,  false },
 };
 
 // We only support a single fixed session
 const uint8_t MockLinkFileServer::_sessionId = 1;
 
 MockLinkFileServer::MockLinkFileServer(uint8_t systemIdServer, uint8_t componentIdServer, MockLink* mockLink) :
+    _readFileLength(0),
     _errMode(errModeNone),
+    _readLossPercent(0),
+    _readReorder(false),
+    _readCommandCount(0),
+    _readResponseHeld(false),
+    _heldReadSeqNumber(0),
+    _heldReadSystemId(0),
+    _heldReadComponentId(0),
     _systemIdServer(systemIdServer),
     _componentIdServer(componentIdServer),
     _mockLink(mockLink)
@@ -139,6 +149,8 @@ void MockLinkFileServer::_readCommand(uint8_t senderSystemId, uint8_t senderComp
     FileManager::Request	response;
     uint16_t				outgoingSeqNumber = _nextSeqNumber(seqNumber);
 
+    _readCommandCount++;
+
     if (request->hdr.session != _sessionId) {
 		_sendNak(senderSystemId, senderComponentId, FileManager::kErrFail, outgoingSeqNumber, FileManager::kCmdReadFile);
         return;
@@ -178,7 +190,32 @@ void MockLinkFileServer::_readCommand(uint8_t senderSystemId, uint8_t senderComp
     response.hdr.opcode = FileManager::kRspAck;
 	response.hdr.req_opcode = FileManager::kCmdReadFile;
 
-    _sendResponse(senderSystemId, senderComponentId, &response, outgoingSeqNumber);
+    _sendReadResponse(senderSystemId, senderComponentId, &response, outgoingSeqNumber);
+}
+
+/// @brief Sends a Read command response, applying simulated loss and reordering
+void MockLinkFileServer::_sendReadResponse(uint8_t targetSystemId, uint8_t targetComponentId, FileManager::Request* request, uint16_t seqNumber)
+{
+    if (_readLossPercent > 0 && (qrand() % 100) < _readLossPercent) {
+        return;
+    }
+
+    if (_readReorder && !_readResponseHeld) {
+        // Hold this one back until after the next response
+        _heldReadResponse = *request;
+        _heldReadSeqNumber = seqNumber;
+        _heldReadSystemId = targetSystemId;
+        _heldReadComponentId = targetComponentId;
+        _readResponseHeld = true;
+        return;
+    }
+
+    _sendResponse(targetSystemId, targetComponentId, request, seqNumber);
+
+    if (_readResponseHeld) {
+        _readResponseHeld = false;
+        _sendResponse(_heldReadSystemId, _heldReadComponentId, &_heldReadResponse, _heldReadSeqNumber);
+    }
 }
 
 void MockLinkFileServer::_streamCommand(uint8_t senderSystemId, uint8_t senderComponentId, FileManager::Request* request, uint16_t seqNumber)
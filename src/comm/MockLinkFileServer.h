@@ -44,6 +44,16 @@ public:
     
     /// @brief Sets the error mode for command responses. This allows you to simulate various server errors.
     void setErrorMode(ErrorMode_t errMode) { _errMode = errMode; };
+
+    /// @brief Sets the percentage of Read command responses which are dropped
+    void setReadLossPercent(int readLossPercent) { _readLossPercent = readLossPercent; }
+
+    /// @brief When set every other Read command response is held back and sent after the next one
+    void setReadReorder(bool readReorder) { _readReorder = readReorder; }
+
+    /// @brief Number of Read commands received since the last reset of the count
+    int readCommandCount(void) const { return _readCommandCount; }
+    void clearReadCommandCount(void) { _readCommandCount = 0; }
     
     /// @brief Array of failure modes you can cycle through for testing. By looping through this array you can avoid
     /// hardcoding the specific error modes in your unit test. This way when new error modes are added your unit test
@@ -59,13 +69,13 @@ public:
     /// @brief Used to represent a single test case for download testing.
     struct FileTestCase {
         const char* filename;               ///< Filename to download
-        uint8_t     length;                 ///< Length of file in bytes
+        uint32_t    length;                 ///< Length of file in bytes
 		int			packetCount;			///< Number of packets required for data
         bool        exactFit;				///< true: last packet is exact fit, false: last packet is partially filled
     };
     
     /// @brief The numbers of test cases in the rgFileTestCases array.
-    static const size_t cFileTestCases = 3;
+    static const size_t cFileTestCases = 4;
     
     /// @brief The set of files supported by the mock server for testing purposes. Each one represents a different edge case for testing.
     static const FileTestCase rgFileTestCases[cFileTestCases];
@@ -87,13 +97,22 @@ private:
 	void _streamCommand(uint8_t senderSystemId, uint8_t senderComponentId, FileManager::Request* request, uint16_t seqNumber);
     void _terminateCommand(uint8_t senderSystemId, uint8_t senderComponentId, FileManager::Request* request, uint16_t seqNumber);
     void _resetCommand(uint8_t senderSystemId, uint8_t senderComponentId, uint16_t seqNumber);
+    void _sendReadResponse(uint8_t targetSystemId, uint8_t targetComponentId, FileManager::Request* request, uint16_t seqNumber);
     uint16_t _nextSeqNumber(uint16_t seqNumber);
     
     QStringList _fileList;  ///< List of files returned by List command
     
     static const uint8_t    _sessionId;
-    uint8_t                 _readFileLength;    ///< Length of active file being read
+    uint32_t                _readFileLength;    ///< Length of active file being read
     ErrorMode_t             _errMode;           ///< Currently set error mode, as specified by setErrorMode
+    int                     _readLossPercent;
+    bool                    _readReorder;
+    int                     _readCommandCount;
+    bool                    _readResponseHeld;  ///< true: _heldReadResponse is waiting to be sent
+    FileManager::Request    _heldReadResponse;
+    uint16_t                _heldReadSeqNumber;
+    uint8_t                 _heldReadSystemId;
+    uint8_t                 _heldReadComponentId;
     const uint8_t           _systemIdServer;    ///< System ID for server
     const uint8_t           _componentIdServer; ///< Component ID for server
     MockLink*               _mockLink;          ///< MockLink to communicate through
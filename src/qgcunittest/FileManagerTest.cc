@@ -16,6 +16,8 @@
 #include "UAS.h"
 #include "QGCApplication.h"
 
+#include <QTemporaryDir>
+
 FileManagerTest::FileManagerTest(void)
     : _fileServer(NULL)
     , _fileManager(NULL)
@@ -36,6 +38,7 @@ void FileManagerTest::init(void)
     
     _fileManager = qgcApp()->toolbox()->multiVehicleManager()->activeVehicle()->uas()->getFileManager();
     QVERIFY(_fileManager != NULL);
+    _fileManager->setAckTimeoutMsecs(_fileManagerAckTimeoutMsecs);
     
     Q_ASSERT(_multiSpy == NULL);
     
@@ -60,8 +63,7 @@ void FileManagerTest::cleanup(void)
     Q_ASSERT(_multiSpy);
     Q_ASSERT(_fileManager);
     
-    // Disconnecting the link will prompt for log file save
-    setExpectedFileDialog(getSaveFileName, QStringList());
+    // The vehicle is never armed so disconnecting the link does not prompt for log file save
     _disconnectMockLink();
 
     _fileServer = NULL;
@@ -194,6 +196,109 @@ void FileManagerTest::_listTest(void)
     }
 }
 
+/// Downloads a file which takes many reads, with responses lost and reordered along the way
+void FileManagerTest::_windowedDownloadTest(void)
+{
+    Q_ASSERT(_fileManager);
+    Q_ASSERT(_multiSpy);
+    Q_ASSERT(_multiSpy->checkNoSignals() == true);
+
+    const MockLinkFileServer::FileTestCase* testCase = &MockLinkFileServer::rgFileTestCases[MockLinkFileServer::cFileTestCases - 1];
+
+    QTemporaryDir downloadDir;
+    QVERIFY(downloadDir.isValid());
+
+    QSignalSpy rateSpy(_fileManager, SIGNAL(downloadRate(double)));
+
+    _fileServer->setReadLossPercent(10);
+    _fileServer->setReadReorder(true);
+    _fileServer->clearReadCommandCount();
+
+    _fileManager->downloadPath(testCase->filename, QDir(downloadDir.path()));
+    _multiSpy->waitForSignalByIndex(commandCompleteSignalIndex, _ackTimerTimeoutMsecs * 3);
+    QCOMPARE(_multiSpy->checkOnlySignalByMask(commandCompleteSignalMask), true);
+    _multiSpy->clearAllSignals();
+
+    QString filePath = QDir(downloadDir.path()).absoluteFilePath(testCase->filename);
+    _validateFileContents(filePath, testCase->length);
+
+    // Partial download files are cleaned up on success
+    QCOMPARE(QFile::exists(filePath + FileManager::partialFileExtension), false);
+    QCOMPARE(QFile::exists(filePath + FileManager::partialFileExtension + FileManager::resumeBitmapExtension), false);
+
+    // Lost responses are re-requested a chunk at a time, the whole file is not started over
+    QVERIFY(_fileServer->readCommandCount() >= testCase->packetCount);
+    QVERIFY(_fileServer->readCommandCount() < testCase->packetCount * 2);
+
+    QCOMPARE(rateSpy.count(), 1);
+    qCDebug(UnitTestBenchmarkLog) << "Lossy download bytes/sec:read commands" << rateSpy.at(0).at(0).toDouble() << _fileServer->readCommandCount();
+
+    _fileServer->setReadLossPercent(0);
+    _fileServer->setReadReorder(false);
+}
+
+/// A download which fails part way through should pick up where it left off the next time
+void FileManagerTest::_resumeDownloadTest(void)
+{
+    Q_ASSERT(_fileManager);
+    Q_ASSERT(_multiSpy);
+    Q_ASSERT(_multiSpy->checkNoSignals() == true);
+
+    const MockLinkFileServer::FileTestCase* testCase = &MockLinkFileServer::rgFileTestCases[MockLinkFileServer::cFileTestCases - 1];
+
+    QTemporaryDir downloadDir;
+    QVERIFY(downloadDir.isValid());
+    QString filePath = QDir(downloadDir.path()).absoluteFilePath(testCase->filename);
+
+    // Cut the link half way through the download
+    MockLinkFileServer* fileServer = _fileServer;
+    QMetaObject::Connection progressConnection = connect(_fileManager, &FileManager::commandProgress, this, [fileServer](int value) {
+        if (value >= 50) {
+            fileServer->setReadLossPercent(100);
+        }
+    });
+
+    _fileManager->downloadPath(testCase->filename, QDir(downloadDir.path()));
+    _multiSpy->waitForSignalByIndex(commandErrorSignalIndex, _ackTimerTimeoutMsecs * 3);
+    QCOMPARE(_multiSpy->checkOnlySignalByMask(commandErrorSignalMask), true);
+    _multiSpy->clearAllSignals();
+    disconnect(progressConnection);
+
+    QCOMPARE(QFile::exists(filePath), false);
+    QVERIFY(QFile::exists(filePath + FileManager::partialFileExtension + FileManager::resumeBitmapExtension));
+
+    // Only the missing half should be read the second time around
+    _fileServer->setReadLossPercent(0);
+    _fileServer->clearReadCommandCount();
+
+    _fileManager->downloadPath(testCase->filename, QDir(downloadDir.path()));
+    _multiSpy->waitForSignalByIndex(commandCompleteSignalIndex, _ackTimerTimeoutMsecs * 3);
+    QCOMPARE(_multiSpy->checkOnlySignalByMask(commandCompleteSignalMask), true);
+    _multiSpy->clearAllSignals();
+
+    _validateFileContents(filePath, testCase->length);
+    QVERIFY(_fileServer->readCommandCount() <= (testCase->packetCount / 2) + FileManager::maxReadWindowSize);
+}
+
+void FileManagerTest::_validateFileContents(const QString& filePath, uint32_t length)
+{
+	QFile file(filePath);
+	
+	// Make sure file size is correct
+	QCOMPARE(file.size(), (qint64)length);
+	
+	// Read data
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	QByteArray bytes = file.readAll();
+	file.close();
+	
+	// Validate file contents:
+	//      Repeating 0x00, 0x01 .. 0xFF until file is full
+	for (int i=0; i<bytes.length(); i++) {
+		QCOMPARE((uint8_t)bytes[i], (uint8_t)(i & 0xFF));
+	}
+}
+
 #if 0
 // Trying to write test code for read and burst mode download as well as implement support in MockLineFileServer reached a point
 // of diminishing returns where the test code and mock server were generating more bugs in themselves than finding problems.
@@ -369,22 +474,4 @@ void FileManagerTest::_streamDownloadTest(void)
     }
 }
 
-void FileManagerTest::_validateFileContents(const QString& filePath, uint8_t length)
-{
-	QFile file(filePath);
-	
-	// Make sure file size is correct
-	QCOMPARE(file.size(), (qint64)length);
-	
-	// Read data
-	QVERIFY(file.open(QIODevice::ReadOnly));
-	QByteArray bytes = file.readAll();
-	file.close();
-	
-	// Validate file contents:
-	//      Repeating 0x00, 0x01 .. 0xFF until file is full
-	for (uint8_t i=0; i<bytes.length(); i++) {
-		QCOMPARE((uint8_t)bytes[i], (uint8_t)(i & 0xFF));
-	}
-}
 #endif
@@ -40,12 +40,14 @@ private slots:
     void _ackTest(void);
     void _noAckTest(void);
     void _listTest(void);
+    void _windowedDownloadTest(void);
+    void _resumeDownloadTest(void);
 	
     // Connected to FileManager listEntry signal
     void listEntry(const QString& entry);
     
 private:
-    void _validateFileContents(const QString& filePath, uint8_t length);
+    void _validateFileContents(const QString& filePath, uint32_t length);
 
     enum {
         listEntrySignalIndex = 0,
@@ -70,9 +72,12 @@ private:
     static const size_t _cSignals = maxSignalIndex;
     const char*         _rgSignals[_cSignals];
     
+    /// Ack timeout used by the FileManager under test, the default is long enough that the failure cases would take minutes
+    static const int _fileManagerAckTimeoutMsecs = 1000;
+
     /// @brief This is the amount of time to wait to allow the FileManager enough time to timeout waiting for an Ack.
     /// As such it must be larger than the Ack Timeout used by the FileManager.
-    static const int _ackTimerTimeoutMsecs = FileManager::ackTimerTimeoutMsecs * 2;
+    static const int _ackTimerTimeoutMsecs = _fileManagerAckTimeoutMsecs * 2;
     
     QStringList _fileListReceived;
 };
@@ -0,0 +1,254 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkFrameDecoderTest.h"
+#include "MAVLinkFrameDecoder.h"
+
+#include <QElapsedTimer>
+
+MAVLinkFrameDecoderTest::MAVLinkFrameDecoderTest(void)
+{
+
+}
+
+/// Builds a stream of mixed Mavlink 1.0 and 2.0 messages. If requested non-mavlink noise and frames with bad
+/// checksums are mixed in as well.
+QByteArray MAVLinkFrameDecoderTest::_buildStream(int messageCount, bool addNoise)
+{
+    QByteArray          stream;
+    mavlink_message_t   message;
+    uint8_t             buffer[MAVLINK_MAX_PACKET_LEN];
+
+    mavlink_status_t* mavlinkStatus = mavlink_get_channel_status(_mavlinkChannel);
+    uint8_t savedFlags = mavlinkStatus->flags;
+
+    for (int i=0; i<messageCount; i++) {
+        if (i % 10 == 0) {
+            mavlinkStatus->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+        } else {
+            mavlinkStatus->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+        }
+
+        switch (i % 4) {
+        case 0:
+            mavlink_msg_heartbeat_pack_chan(1, 1, _mavlinkChannel, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, MAV_STATE_ACTIVE);
+            break;
+        case 1:
+            mavlink_msg_attitude_pack_chan(1, 1, _mavlinkChannel, &message, i, 0.1f * i, -0.2f * i, 0.3f, 0.0f, 0.0f, 0.0f);
+            break;
+        case 2:
+            mavlink_msg_global_position_int_pack_chan(2, 1, _mavlinkChannel, &message, i, 473977420, 85455940, 488000 + i, 1000, 0, 0, 0, 0);
+            break;
+        case 3:
+            mavlink_msg_statustext_pack_chan(2, 1, _mavlinkChannel, &message, MAV_SEVERITY_INFO, "Frame decoder test");
+            break;
+        }
+
+        int length = mavlink_msg_to_send_buffer(buffer, &message);
+
+        if (addNoise && i % 7 == 3) {
+            // Corrupt a payload byte, both decoders should drop this frame
+            buffer[length - 3] ^= 0xFF;
+        }
+        stream.append((const char*)buffer, length);
+
+        if (addNoise && i % 5 == 0) {
+            // Noise bytes never contain a start byte so the parse_char state machine stays in sync as well
+            for (int j=0; j<i % 13; j++) {
+                stream.append((char)(qrand() & 0x7F));
+            }
+        }
+    }
+
+    mavlinkStatus->flags = savedFlags;
+
+    return stream;
+}
+
+QList<mavlink_message_t> MAVLinkFrameDecoderTest::_parseCharDecode(const QByteArray& bytes)
+{
+    QList<mavlink_message_t>    messages;
+    mavlink_message_t           message;
+    mavlink_status_t            status;
+
+    for (int i=0; i<bytes.length(); i++) {
+        if (mavlink_parse_char(_mavlinkChannel, (uint8_t)bytes[i], &message, &status)) {
+            messages.append(message);
+        }
+    }
+
+    return messages;
+}
+
+void MAVLinkFrameDecoderTest::_compareMessages(const QList<mavlink_message_t>& expected, const QVector<mavlink_message_t>& actual)
+{
+    QCOMPARE(actual.count(), expected.count());
+
+    for (int i=0; i<expected.count(); i++) {
+        const mavlink_message_t& expectedMessage = expected[i];
+        const mavlink_message_t& actualMessage = actual[i];
+
+        QCOMPARE(actualMessage.magic, expectedMessage.magic);
+        QCOMPARE(actualMessage.msgid, expectedMessage.msgid);
+        QCOMPARE(actualMessage.sysid, expectedMessage.sysid);
+        QCOMPARE(actualMessage.compid, expectedMessage.compid);
+        QCOMPARE(actualMessage.seq, expectedMessage.seq);
+        QCOMPARE(actualMessage.len, expectedMessage.len);
+        QCOMPARE(actualMessage.checksum, expectedMessage.checksum);
+        QCOMPARE(memcmp(_MAV_PAYLOAD(&actualMessage), _MAV_PAYLOAD(&expectedMessage), expectedMessage.len), 0);
+    }
+}
+
+void MAVLinkFrameDecoderTest::_decodeMatchesParseChar_test(void)
+{
+    QByteArray stream = _buildStream(1000, true /* addNoise */);
+    QList<mavlink_message_t> expected = _parseCharDecode(stream);
+
+    MAVLinkFrameDecoder decoder;
+    decoder.setMavlinkChannel(_mavlinkChannel);
+
+    QVector<mavlink_message_t> actual;
+    decoder.decode(stream, actual);
+
+    _compareMessages(expected, actual);
+    QVERIFY(decoder.parseErrorCount() > 0);
+}
+
+void MAVLinkFrameDecoderTest::_splitFrames_test(void)
+{
+    QByteArray stream = _buildStream(1000, true /* addNoise */);
+    QList<mavlink_message_t> expected = _parseCharDecode(stream);
+
+    MAVLinkFrameDecoder decoder;
+    decoder.setMavlinkChannel(_mavlinkChannel);
+
+    // Feed the stream in random sized blocks so frames are split at every possible position
+    QVector<mavlink_message_t> actual;
+    int offset = 0;
+    while (offset < stream.length()) {
+        int blockSize = qMin((qrand() % 64) + 1, stream.length() - offset);
+        decoder.decode((const uint8_t*)stream.constData() + offset, blockSize, actual);
+        offset += blockSize;
+    }
+
+    _compareMessages(expected, actual);
+}
+
+void MAVLinkFrameDecoderTest::_setFrameSequence_test(void)
+{
+    QByteArray stream = _buildStream(100, false /* addNoise */);
+
+    // Resequence every frame in place, the frames must still pass the checksum and carry the new sequence numbers
+    uint8_t*    bytes = (uint8_t*)stream.data();
+    int         offset = 0;
+    uint8_t     seq = 200;
+    while (offset < stream.length()) {
+        int frameLength = MAVLinkFrameDecoder::frameLength(&bytes[offset], stream.length() - offset);
+        QVERIFY(frameLength > 0);
+        QVERIFY(MAVLinkFrameDecoder::setFrameSequence(&bytes[offset], seq++));
+        offset += frameLength;
+    }
+
+    MAVLinkFrameDecoder decoder;
+    decoder.setMavlinkChannel(_mavlinkChannel);
+
+    QVector<mavlink_message_t> messages;
+    QCOMPARE(decoder.decode(stream, messages), 100);
+    QCOMPARE(decoder.parseErrorCount(), (quint32)0);
+
+    seq = 200;
+    for (int i=0; i<messages.count(); i++) {
+        QCOMPARE(messages[i].seq, seq++);
+    }
+}
+
+/// Decoding without channel status updates and applying the batch afterwards, as the decoder pool does, must leave
+/// the channel status the same as decoding with updates
+void MAVLinkFrameDecoderTest::_deferredChannelStatus_test(void)
+{
+    // Last message is Mavlink 1.0, so the incoming protocol flag is set at the end
+    QByteArray stream = _buildStream(991, true /* addNoise */);
+
+    mavlink_status_t* mavlinkStatus = mavlink_get_channel_status(_mavlinkChannel);
+    mavlink_status_t savedStatus = *mavlinkStatus;
+
+    mavlinkStatus->flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    mavlink_status_t startStatus = *mavlinkStatus;
+
+    MAVLinkFrameDecoder decoder;
+    decoder.setMavlinkChannel(_mavlinkChannel);
+    QVector<mavlink_message_t> messages;
+    decoder.decode(stream, messages);
+    mavlink_status_t expectedStatus = *mavlinkStatus;
+    QVERIFY(expectedStatus.flags & MAVLINK_STATUS_FLAG_IN_MAVLINK1);
+
+    *mavlinkStatus = startStatus;
+    MAVLinkFrameDecoder deferredDecoder;
+    deferredDecoder.setMavlinkChannel(_mavlinkChannel);
+    deferredDecoder.setUpdateChannelStatus(false);
+    QVector<mavlink_message_t> deferredMessages;
+    deferredDecoder.decode(stream, deferredMessages);
+    QCOMPARE(mavlinkStatus->packet_rx_success_count, startStatus.packet_rx_success_count);
+    QCOMPARE(mavlinkStatus->flags, startStatus.flags);
+
+    MAVLinkFrameDecoder::updateChannelStatus(_mavlinkChannel, deferredMessages, deferredDecoder.parseErrorCount());
+    QCOMPARE(mavlinkStatus->flags, expectedStatus.flags);
+    QCOMPARE(mavlinkStatus->current_rx_seq, expectedStatus.current_rx_seq);
+    QCOMPARE(mavlinkStatus->packet_rx_success_count, expectedStatus.packet_rx_success_count);
+    QCOMPARE(mavlinkStatus->parse_error, expectedStatus.parse_error);
+
+    *mavlinkStatus = savedStatus;
+}
+
+void MAVLinkFrameDecoderTest::_benchmark_test(void)
+{
+    const int   blockSize = 512;    ///< Similar to a single serial port read at high baud rates
+    const int   passes = 20;
+
+    QByteArray stream = _buildStream(10000, false /* addNoise */);
+    qint64 totalBytes = (qint64)stream.length() * passes;
+
+    QElapsedTimer timer;
+    int parseCharCount = 0;
+
+    timer.start();
+    for (int pass=0; pass<passes; pass++) {
+        mavlink_message_t   message;
+        mavlink_status_t    status;
+
+        for (int i=0; i<stream.length(); i++) {
+            if (mavlink_parse_char(_mavlinkChannel, (uint8_t)stream[i], &message, &status)) {
+                parseCharCount++;
+            }
+        }
+    }
+    qint64 parseCharNSecs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    MAVLinkFrameDecoder decoder;
+    decoder.setMavlinkChannel(_mavlinkChannel);
+    QVector<mavlink_message_t> batch;
+    int decoderCount = 0;
+
+    timer.restart();
+    for (int pass=0; pass<passes; pass++) {
+        for (int offset=0; offset<stream.length(); offset+=blockSize) {
+            batch.resize(0);
+            decoderCount += decoder.decode((const uint8_t*)stream.constData() + offset, qMin(blockSize, stream.length() - offset), batch);
+        }
+    }
+    qint64 decoderNSecs = qMax(timer.nsecsElapsed(), (qint64)1);
+
+    QCOMPARE(decoderCount, parseCharCount);
+
+    double parseCharRate = (double)totalBytes / ((double)parseCharNSecs / 1.0e9);
+    double decoderRate = (double)totalBytes / ((double)decoderNSecs / 1.0e9);
+    qCDebug(UnitTestBenchmarkLog) << "mavlink_parse_char bytes/sec" << (qint64)parseCharRate;
+    qCDebug(UnitTestBenchmarkLog) << "MAVLinkFrameDecoder bytes/sec" << (qint64)decoderRate << "speedup" << decoderRate / parseCharRate;
+}
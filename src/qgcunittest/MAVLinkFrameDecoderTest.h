@@ -0,0 +1,39 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkFrameDecoderTest_H
+#define MAVLinkFrameDecoderTest_H
+
+#include "UnitTest.h"
+
+/// Unit test and throughput benchmark for MAVLinkFrameDecoder
+class MAVLinkFrameDecoderTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    MAVLinkFrameDecoderTest(void);
+
+private slots:
+    void _decodeMatchesParseChar_test(void);
+    void _splitFrames_test(void);
+    void _setFrameSequence_test(void);
+    void _deferredChannelStatus_test(void);
+    void _benchmark_test(void);
+
+private:
+    QByteArray _buildStream(int messageCount, bool addNoise);
+    QList<mavlink_message_t> _parseCharDecode(const QByteArray& bytes);
+    void _compareMessages(const QList<mavlink_message_t>& expected, const QVector<mavlink_message_t>& actual);
+
+    static const uint8_t _mavlinkChannel = 0;   ///< Channel 0 is never used by LinkManager
+};
+
+#endif
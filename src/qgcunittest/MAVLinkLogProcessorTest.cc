@@ -0,0 +1,217 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkLogProcessorTest.h"
+#include "MAVLinkLogManager.h"
+#include "QGCApplication.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QSignalSpy>
+
+MAVLinkLogProcessorTest::MAVLinkLogProcessorTest(void)
+{
+
+}
+
+void MAVLinkLogProcessorTest::init(void)
+{
+    UnitTest::init();
+
+    QVERIFY(_logDir.isValid());
+    _recordingFileName = QDir(_logDir.path()).filePath("LOGGING_DATA.recording");
+
+    // Large enough to wrap around the processor ring buffer a few times
+    _buildStream(8000);
+    _recordPackets();
+}
+
+void MAVLinkLogProcessorTest::cleanup(void)
+{
+    QDir logDir(_logDir.path());
+    foreach (const QString& fileName, logDir.entryList(QDir::Files)) {
+        logDir.remove(fileName);
+    }
+
+    UnitTest::cleanup();
+}
+
+/// Builds a ULog header followed by messages of random size, with the odd message spanning many LOGGING_DATA messages
+void MAVLinkLogProcessorTest::_buildStream(int messageCount)
+{
+    const char header[16] = { 'U', 'L', 'o', 'g', 0x01, 0x12, 0x35, 0x01 };
+
+    _stream = QByteArray(header, sizeof(header));
+    _messageEnds.clear();
+
+    for (int i=0; i<messageCount; i++) {
+        int payloadLength = (i % 500) == 0 ? 2000 + (qrand() % 500) : qrand() % 120;
+        _stream.append((char)(payloadLength & 0xFF));
+        _stream.append((char)(payloadLength >> 8));
+        _stream.append((char)('A' + (qrand() % 26)));
+        for (int j=0; j<payloadLength; j++) {
+            _stream.append((char)qrand());
+        }
+        _messageEnds.append(_stream.length());
+    }
+}
+
+/// Splits the stream into LOGGING_DATA messages the way the vehicle sends them and records them to a file
+void MAVLinkLogProcessorTest::_recordPackets(void)
+{
+    QFile recording(_recordingFileName);
+    QVERIFY(recording.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QDataStream stream(&recording);
+
+    quint16 sequence = _firstSequence;
+    int     messageIndex = 0;
+    int     offset = 0;
+    while (offset < _stream.length()) {
+        int length = qMin((int)MAVLINK_MSG_LOGGING_DATA_FIELD_DATA_LEN, _stream.length() - offset);
+
+        // The first message always starts right after the header
+        quint8 firstMessage = 255;
+        if (offset == 0) {
+            firstMessage = 16;
+        } else {
+            while (messageIndex < _messageEnds.count() && _messageEnds[messageIndex] < offset) {
+                messageIndex++;
+            }
+            if (messageIndex < _messageEnds.count() - 1 && _messageEnds[messageIndex] < offset + length) {
+                firstMessage = _messageEnds[messageIndex] - offset;
+            }
+        }
+
+        stream << sequence++ << firstMessage << _stream.mid(offset, length) << (qint32)offset;
+        offset += length;
+    }
+}
+
+QList<MAVLinkLogProcessorTest::Packet_t> MAVLinkLogProcessorTest::_loadRecording(void)
+{
+    QList<Packet_t> packets;
+
+    QFile recording(_recordingFileName);
+    if (!recording.open(QIODevice::ReadOnly)) {
+        return packets;
+    }
+    QDataStream stream(&recording);
+    while (!stream.atEnd()) {
+        Packet_t    packet;
+        qint32      streamOffset;
+
+        stream >> packet.sequence >> packet.firstMessage >> packet.data >> streamOffset;
+        packet.streamOffset = streamOffset;
+        packets.append(packet);
+    }
+
+    return packets;
+}
+
+MAVLinkLogProcessor* MAVLinkLogProcessorTest::_createProcessor(void)
+{
+    MAVLinkLogProcessor* processor = new MAVLinkLogProcessor;
+    if (!processor->create(qgcApp()->toolbox()->mavlinkLogManager(), _logDir.path(), 1)) {
+        delete processor;
+        return NULL;
+    }
+    return processor;
+}
+
+QByteArray MAVLinkLogProcessorTest::_readLog(MAVLinkLogProcessor* processor)
+{
+    QFile log(processor->fileName());
+    if (!log.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return log.readAll();
+}
+
+/// Replaying a clean stream must reproduce it byte for byte
+void MAVLinkLogProcessorTest::_replay_test(void)
+{
+    QList<Packet_t> packets = _loadRecording();
+    QVERIFY(packets.count() > 0);
+
+    MAVLinkLogProcessor* processor = _createProcessor();
+    QVERIFY(processor);
+    QSignalSpy spyBytesWritten(processor, SIGNAL(bytesWritten(quint32, int, qreal)));
+
+    foreach (const Packet_t& packet, packets) {
+        QVERIFY(processor->processStreamData(packet.sequence, packet.firstMessage, packet.data));
+    }
+    processor->close();
+
+    // Written in large blocks, not per message
+    QVERIFY(spyBytesWritten.count() > 1);
+    QVERIFY(spyBytesWritten.count() < _stream.length() / MAVLinkLogProcessor::flushSize + 2);
+
+    QCOMPARE(processor->numDrops(), 0);
+    QCOMPARE((int)processor->written(), _stream.length());
+    QVERIFY(_readLog(processor) == _stream);
+
+    delete processor->record();
+    delete processor;
+}
+
+/// Messages cut short by a drop must be replaced by a dropout message, with the stream picking up again at the start
+/// of the next message
+void MAVLinkLogProcessorTest::_drops_test(void)
+{
+    QList<Packet_t> packets = _loadRecording();
+    QVERIFY(packets.count() > 400);
+
+    MAVLinkLogProcessor* processor = _createProcessor();
+    QVERIFY(processor);
+
+    QByteArray  expected;
+    int         expectedDrops = 0;
+    int         copyFrom = 0;       // Stream offset the expected output continues from
+    bool        synced = true;
+    for (int i=0; i<packets.count(); i++) {
+        const Packet_t& packet = packets[i];
+
+        // Drop one or two messages every so often, but never the header
+        int dropCount = (i > 0 && (i % 97) == 0) ? 1 + ((i / 97) % 2) : 0;
+        if (dropCount) {
+            // Everything up to the last message completed before the drop is kept
+            int lastEnd = 16;
+            foreach (int messageEnd, _messageEnds) {
+                if (messageEnd > packet.streamOffset) {
+                    break;
+                }
+                lastEnd = messageEnd;
+            }
+            if (synced && lastEnd > copyFrom) {
+                expected.append(_stream.mid(copyFrom, lastEnd - copyFrom));
+            }
+            const char dropout[] = { 2, 0, 79, (char)(dropCount * 10), 0 };
+            expected.append(dropout, sizeof(dropout));
+            expectedDrops += dropCount;
+            synced = false;
+            i += dropCount - 1;
+            continue;
+        }
+
+        if (!synced && packet.firstMessage != 255) {
+            copyFrom = packet.streamOffset + packet.firstMessage;
+            synced = true;
+        }
+        QVERIFY(processor->processStreamData(packet.sequence, packet.firstMessage, packet.data));
+    }
+    processor->close();
+    expected.append(_stream.mid(copyFrom));
+
+    QCOMPARE(processor->numDrops(), expectedDrops);
+    QVERIFY(_readLog(processor) == expected);
+
+    delete processor->record();
+    delete processor;
+}
@@ -0,0 +1,58 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkLogProcessorTest_H
+#define MAVLinkLogProcessorTest_H
+
+#include "UnitTest.h"
+
+#include <QTemporaryDir>
+
+class MAVLinkLogProcessor;
+
+/// Unit test for MAVLinkLogProcessor. Replays a LOGGING_DATA stream through the processor and checks the ULog file
+/// which comes out of it.
+class MAVLinkLogProcessorTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    MAVLinkLogProcessorTest(void);
+
+private slots:
+    void init(void);
+    void cleanup(void);
+
+    void _replay_test(void);
+    void _drops_test(void);
+
+private:
+    typedef struct {
+        quint16     sequence;
+        quint8      firstMessage;   ///< Offset of the first message start in data, 255 for none
+        QByteArray  data;
+        int         streamOffset;   ///< Offset of data within the ULog stream
+    } Packet_t;
+
+    void                _buildStream        (int messageCount);
+    void                _recordPackets      (void);
+    QList<Packet_t>     _loadRecording      (void);
+    MAVLinkLogProcessor* _createProcessor   (void);
+    QByteArray          _readLog            (MAVLinkLogProcessor* processor);
+
+    QTemporaryDir       _logDir;
+    QString             _recordingFileName;
+    QByteArray          _stream;            ///< ULog stream sent by the vehicle
+    QList<int>          _messageEnds;       ///< Stream offset of the end of each message
+
+    static const quint16 _firstSequence = 65500;    ///< Close to the end so the sequence wraps
+};
+
+#endif
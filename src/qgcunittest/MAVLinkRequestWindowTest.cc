@@ -0,0 +1,96 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkRequestWindowTest.h"
+#include "MAVLinkRequestWindow.h"
+
+MAVLinkRequestWindowTest::MAVLinkRequestWindowTest(void)
+{
+
+}
+
+/// Slow start up to the maximum, halve on loss, slower growth after the first loss
+void MAVLinkRequestWindowTest::_window_test(void)
+{
+    MAVLinkRequestWindow window(_maxSize);
+
+    QCOMPARE(window.size(), (double)MAVLinkRequestWindow::initialSize);
+    QVERIFY(window.canSend(MAVLinkRequestWindow::initialSize - 1));
+    QVERIFY(!window.canSend(MAVLinkRequestWindow::initialSize));
+
+    // One more per reply until the first loss, never past the maximum
+    window.replyReceived(-1);
+    QCOMPARE(window.size(), (double)(MAVLinkRequestWindow::initialSize + 1));
+    for (int i=0; i<_maxSize; i++) {
+        window.replyReceived(-1);
+    }
+    QCOMPARE(window.size(), (double)_maxSize);
+
+    // Halves once per timeout check regardless of how many requests were lost
+    window.requestsTimedOut(3);
+    QCOMPARE(window.size(), (double)(_maxSize / 2));
+    QCOMPARE(window.timeoutCount(), 3);
+    window.requestsTimedOut(0);
+    QCOMPARE(window.size(), (double)(_maxSize / 2));
+
+    // One more per window full of replies after a loss
+    for (int i=0; i<_maxSize / 2; i++) {
+        window.replyReceived(-1);
+    }
+    QVERIFY(window.size() > _maxSize / 2 && window.size() < (_maxSize / 2) + 1.1);
+
+    // Never below one request in flight
+    for (int i=0; i<10; i++) {
+        window.requestsTimedOut(1);
+    }
+    QCOMPARE(window.size(), 1.0);
+    QVERIFY(window.canSend(0));
+
+    // Lowering the maximum shrinks the current window
+    window.reset();
+    window.setMaxSize(2);
+    QCOMPARE(window.size(), 2.0);
+    QCOMPARE(window.timeoutCount(), 0);
+}
+
+/// Timeout follows smoothed rtt + 4 * rtt variation within the limits
+void MAVLinkRequestWindowTest::_timeout_test(void)
+{
+    MAVLinkRequestWindow window(_maxSize);
+
+    QCOMPARE(window.timeoutMSecs(), (int)MAVLinkRequestWindow::initialTimeoutMSecs);
+
+    // Replies which can't be timed don't change the estimate
+    window.replyReceived(-1);
+    QCOMPARE(window.smoothedRttMSecs(), -1.0);
+    QCOMPARE(window.timeoutMSecs(), (int)MAVLinkRequestWindow::initialTimeoutMSecs);
+
+    // First sample: rtt 200, variation 100
+    window.replyReceived(200);
+    QCOMPARE(window.smoothedRttMSecs(), 200.0);
+    QCOMPARE(window.timeoutMSecs(), 600);
+
+    // Steady round trips shrink the variation
+    for (int i=0; i<50; i++) {
+        window.replyReceived(200);
+    }
+    QCOMPARE(window.smoothedRttMSecs(), 200.0);
+    QVERIFY(window.timeoutMSecs() >= 200 && window.timeoutMSecs() < 210);
+
+    // Fast link hits the lower limit
+    window.reset();
+    window.replyReceived(10);
+    QCOMPARE(window.timeoutMSecs(), (int)MAVLinkRequestWindow::minTimeoutMSecs);
+
+    // Slow link hits the upper limit
+    window.reset();
+    window.replyReceived(2000);
+    QCOMPARE(window.timeoutMSecs(), (int)MAVLinkRequestWindow::maxTimeoutMSecs);
+}
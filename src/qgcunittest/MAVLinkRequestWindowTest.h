@@ -0,0 +1,32 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkRequestWindowTest_H
+#define MAVLinkRequestWindowTest_H
+
+#include "UnitTest.h"
+
+/// Unit test for MAVLinkRequestWindow
+class MAVLinkRequestWindowTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    MAVLinkRequestWindowTest(void);
+
+private slots:
+    void _window_test(void);
+    void _timeout_test(void);
+
+private:
+    static const int _maxSize = 8;
+};
+
+#endif
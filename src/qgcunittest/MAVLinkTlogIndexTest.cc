@@ -0,0 +1,174 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MAVLinkTlogIndexTest.h"
+#include "MAVLinkTlogIndex.h"
+#include "LogFileView.h"
+#include "QGCTemporaryFile.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+MAVLinkTlogIndexTest::MAVLinkTlogIndexTest(void)
+{
+
+}
+
+void MAVLinkTlogIndexTest::init(void)
+{
+    UnitTest::init();
+
+    QGCTemporaryFile tempFile(QStringLiteral("MAVLinkTlogIndexTest.XXXXXX.mavlink"));
+    QVERIFY(tempFile.open());
+    _logFileName = tempFile.fileName();
+    tempFile.close();
+
+    _recordTimes.clear();
+    _recordOffsets.clear();
+    _recordCounts.clear();
+}
+
+void MAVLinkTlogIndexTest::cleanup(void)
+{
+    QFile::remove(_logFileName);
+    QFile::remove(MAVLinkTlogIndex::indexFileName(_logFileName));
+
+    UnitTest::cleanup();
+}
+
+/// Writes a log with a mix of messages and some garbage between records
+void MAVLinkTlogIndexTest::_writeLog(int messageCount)
+{
+    QFile logFile(_logFileName);
+    QVERIFY(logFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+
+    // Timestamps must be in the past, otherwise they are treated as little endian
+    quint64 timeUSecs = ((quint64)QDateTime::currentMSecsSinceEpoch() - 24 * 60 * 60 * 1000) * 1000;
+
+    for (int i=0; i<messageCount; i++) {
+        mavlink_message_t   message;
+        uint8_t             buffer[MAVLINK_MAX_PACKET_LEN + sizeof(quint64)];
+
+        switch (i % 3) {
+        case 0:
+            mavlink_msg_heartbeat_pack_chan(1, 1, _mavlinkChannel, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, MAV_STATE_ACTIVE);
+            break;
+        case 1:
+            mavlink_msg_attitude_pack_chan(1, 1, _mavlinkChannel, &message, i, 0.1f * i, -0.2f * i, 0.3f, 0.0f, 0.0f, 0.0f);
+            break;
+        case 2:
+            mavlink_msg_system_time_pack_chan(1, 1, _mavlinkChannel, &message, timeUSecs, i);
+            break;
+        }
+
+        qToBigEndian<quint64>(timeUSecs, buffer);
+        int length = mavlink_msg_to_send_buffer(&buffer[sizeof(quint64)], &message) + sizeof(quint64);
+
+        _recordTimes.append(timeUSecs);
+        _recordOffsets.append(logFile.pos());
+        _recordCounts[message.msgid]++;
+        QCOMPARE(logFile.write((const char*)buffer, length), (qint64)length);
+
+        if (i % 11 == 5) {
+            // Garbage which the index must skip over
+            QByteArray garbage(i % 17, (char)0x42);
+            logFile.write(garbage);
+        }
+
+        timeUSecs += _recordIntervalUSecs;
+    }
+}
+
+void MAVLinkTlogIndexTest::_build_test(void)
+{
+    _writeLog(5000);
+
+    MAVLinkTlogIndex index;
+    QString errorString;
+    QVERIFY(index.build(_logFileName, errorString));
+
+    QCOMPARE(index.messageCount(), (quint64)_recordTimes.count());
+    QCOMPARE(index.startTimeUSecs(), _recordTimes.first());
+    QCOMPARE(index.endTimeUSecs(), _recordTimes.last());
+
+    QMap<uint32_t, quint32> messageCounts = index.messageCounts();
+    QCOMPARE(messageCounts.count(), _recordCounts.count());
+    foreach (uint32_t msgid, _recordCounts.keys()) {
+        QCOMPARE((int)messageCounts[msgid], _recordCounts[msgid]);
+    }
+
+    // Every entry must point exactly at a record with the same timestamp
+    const QVector<MAVLinkTlogIndex::Entry>& entries = index.entries();
+    QVERIFY(entries.count() > 1);
+    foreach (const MAVLinkTlogIndex::Entry& entry, entries) {
+        int recordIndex = _recordOffsets.indexOf(entry.offset);
+        QVERIFY(recordIndex != -1);
+        QCOMPARE(entry.timeUSecs, _recordTimes[recordIndex]);
+    }
+}
+
+void MAVLinkTlogIndexTest::_seek_test(void)
+{
+    _writeLog(5000);
+
+    MAVLinkTlogIndex index;
+    QString errorString;
+    QVERIFY(index.build(_logFileName, errorString));
+
+    // A window much smaller than the log makes records straddle window boundaries
+    LogFileView log;
+    QVERIFY(log.open(_logFileName));
+    log.setWindowSize(1000);
+
+    // Building through the small window must match building from the whole file
+    MAVLinkTlogIndex windowedIndex;
+    windowedIndex.build(log);
+    QCOMPARE(windowedIndex.messageCount(), index.messageCount());
+    QCOMPARE(windowedIndex.entries().count(), index.entries().count());
+
+    // Seek to times both on and in between record timestamps
+    for (int i=0; i<_recordTimes.count(); i+=37) {
+        quint64 seekTimeUSecs = _recordTimes[i] - (i % 2 ? _recordIntervalUSecs / 2 : 0);
+        quint64 messageTimeUSecs;
+
+        QCOMPARE(index.seek(log, seekTimeUSecs, messageTimeUSecs), _recordOffsets[i]);
+        QCOMPARE(messageTimeUSecs, _recordTimes[i]);
+    }
+
+    // Seeking past the end of the log fails
+    quint64 messageTimeUSecs;
+    QCOMPARE(index.seek(log, _recordTimes.last() + 1, messageTimeUSecs), (qint64)-1);
+}
+
+void MAVLinkTlogIndexTest::_saveLoad_test(void)
+{
+    _writeLog(1000);
+
+    MAVLinkTlogIndex index;
+    QString errorString;
+    QVERIFY(index.build(_logFileName, errorString));
+    QVERIFY(index.save(_logFileName, errorString));
+
+    MAVLinkTlogIndex loadedIndex;
+    QVERIFY(loadedIndex.load(_logFileName));
+    QCOMPARE(loadedIndex.messageCount(), index.messageCount());
+    QCOMPARE(loadedIndex.startTimeUSecs(), index.startTimeUSecs());
+    QCOMPARE(loadedIndex.endTimeUSecs(), index.endTimeUSecs());
+    QCOMPARE(loadedIndex.messageCounts(), index.messageCounts());
+    QCOMPARE(loadedIndex.entries().count(), index.entries().count());
+
+    // Once the log changes size the index is stale
+    QFile logFile(_logFileName);
+    QVERIFY(logFile.open(QIODevice::Append));
+    logFile.write(QByteArray(10, 0));
+    logFile.close();
+    QVERIFY(!loadedIndex.load(_logFileName));
+    QVERIFY(loadedIndex.isEmpty());
+}
@@ -0,0 +1,44 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MAVLinkTlogIndexTest_H
+#define MAVLinkTlogIndexTest_H
+
+#include "UnitTest.h"
+
+/// Unit test for MAVLinkTlogIndex
+class MAVLinkTlogIndexTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    MAVLinkTlogIndexTest(void);
+
+private slots:
+    void init(void);
+    void cleanup(void);
+
+    void _build_test(void);
+    void _seek_test(void);
+    void _saveLoad_test(void);
+
+private:
+    void _writeLog(int messageCount);
+
+    QString             _logFileName;
+    QList<quint64>      _recordTimes;       ///< Timestamp of each record written to the log
+    QList<qint64>       _recordOffsets;     ///< File offset of each record written to the log
+    QMap<uint32_t, int> _recordCounts;      ///< Number of records for each message id
+
+    static const uint8_t _mavlinkChannel = 0;   ///< Channel 0 is never used by LinkManager
+    static const quint64 _recordIntervalUSecs = 7000;
+};
+
+#endif
@@ -0,0 +1,247 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MockLinkSwarmTest.h"
+#include "MockLink.h"
+#include "MultiVehicleManager.h"
+#include "Vehicle.h"
+#include "ParameterManager.h"
+#include "QGCApplication.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtAlgorithms>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+MockLinkSwarmTest::MockLinkSwarmTest(void)
+{
+
+}
+
+void MockLinkSwarmTest::cleanup(void)
+{
+    _stopSwarm();
+
+    UnitTest::cleanup();
+}
+
+/// Starts the swarm and waits for all the vehicles to finish loading parameters
+void MockLinkSwarmTest::_startSwarm(int vehicleCount, bool sharedLink)
+{
+    MultiVehicleManager* multiVehicleManager = qgcApp()->toolbox()->multiVehicleManager();
+
+    connect(qgcApp()->toolbox()->mavlinkProtocol(), &MAVLinkProtocol::messageReceived, this, &MockLinkSwarmTest::_messageReceived, Qt::UniqueConnection);
+    _attitudeBootMSecs.clear();
+    _rollUpdateCounts.clear();
+    _latencies.clear();
+
+    MockConfiguration swarmConfig("Swarm");
+    swarmConfig.setFirmwareType(MAV_AUTOPILOT_PX4);
+    swarmConfig.setVehicleType(MAV_TYPE_QUADROTOR);
+    swarmConfig.setStreamRate(MAVLINK_MSG_ID_ATTITUDE,              _attitudeRateHz);
+    swarmConfig.setStreamRate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT,   _positionRateHz);
+    swarmConfig.setStreamRate(MAVLINK_MSG_ID_VFR_HUD,               _hudRateHz);
+    swarmConfig.setStreamRate(MAVLINK_MSG_ID_SYS_STATUS,            _statusRateHz);
+
+    _swarmLinks = MockLink::startSwarmMockLinks(&swarmConfig, vehicleCount, sharedLink);
+
+    // Parameter loads for the whole swarm compete for the main thread, so allow plenty of time
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 10000 + (vehicleCount * 2000)) {
+        int readyCount = 0;
+        for (int i=0; i<multiVehicleManager->vehicles()->count(); i++) {
+            Vehicle* vehicle = qobject_cast<Vehicle*>(multiVehicleManager->vehicles()->get(i));
+            if (vehicle->parameterManager()->parametersReady()) {
+                readyCount++;
+            }
+        }
+        if (readyCount == vehicleCount) {
+            break;
+        }
+        QTest::qWait(100);
+    }
+    QCOMPARE(multiVehicleManager->vehicles()->count(), vehicleCount);
+
+    for (int i=0; i<multiVehicleManager->vehicles()->count(); i++) {
+        Vehicle*    vehicle = qobject_cast<Vehicle*>(multiVehicleManager->vehicles()->get(i));
+        int         vehicleId = vehicle->id();
+
+        QVERIFY(vehicle->parameterManager()->parametersReady());
+
+        connect(vehicle->roll(), &Fact::rawValueChanged, this, [this, vehicleId](QVariant) {
+            _rollUpdateCounts[vehicleId]++;
+            if (_attitudeBootMSecs.contains(vehicleId)) {
+                _latencies.append(MockLink::bootMSecs() - _attitudeBootMSecs[vehicleId]);
+            }
+        });
+    }
+}
+
+void MockLinkSwarmTest::_stopSwarm(void)
+{
+    if (_swarmLinks.isEmpty()) {
+        return;
+    }
+
+    MultiVehicleManager* multiVehicleManager = qgcApp()->toolbox()->multiVehicleManager();
+
+    foreach (MockLink* link, _swarmLinks) {
+        _linkManager->disconnectLink(link);
+    }
+    _swarmLinks.clear();
+
+    // Vehicles go away once their links are deleted
+    QElapsedTimer timer;
+    timer.start();
+    while (multiVehicleManager->vehicles()->count() && timer.elapsed() < 10000) {
+        QTest::qWait(100);
+    }
+    QCOMPARE(multiVehicleManager->vehicles()->count(), 0);
+
+    disconnect(qgcApp()->toolbox()->mavlinkProtocol(), &MAVLinkProtocol::messageReceived, this, &MockLinkSwarmTest::_messageReceived);
+}
+
+void MockLinkSwarmTest::_messageReceived(LinkInterface* link, mavlink_message_t message)
+{
+    Q_UNUSED(link);
+
+    // This is connected ahead of the Vehicles so it sees each message before the Vehicle updates its Facts
+    if (message.msgid == MAVLINK_MSG_ID_ATTITUDE) {
+        _attitudeBootMSecs[message.sysid] = mavlink_msg_attitude_get_time_boot_ms(&message);
+    }
+}
+
+/// Checks that every vehicle in the swarm has a distinct id and is receiving streamed telemetry
+void MockLinkSwarmTest::_verifySwarm(int vehicleCount, bool sharedLink)
+{
+    _startSwarm(vehicleCount, sharedLink);
+
+    QCOMPARE(_swarmLinks.count(), sharedLink ? 1 : vehicleCount);
+    if (sharedLink) {
+        QCOMPARE(_swarmLinks[0]->sharedVehicles().count(), vehicleCount - 1);
+    }
+
+    QTest::qWait(1000);
+
+    QCOMPARE(_rollUpdateCounts.count(), vehicleCount);
+    foreach (int vehicleId, _rollUpdateCounts.keys()) {
+        // Allow for the main thread falling behind the stream rate
+        QVERIFY(_rollUpdateCounts[vehicleId] > _attitudeRateHz / 2);
+    }
+
+    _stopSwarm();
+}
+
+void MockLinkSwarmTest::_sharedLink_test(void)
+{
+    _verifySwarm(_functionalSwarmSize, true /* sharedLink */);
+}
+
+void MockLinkSwarmTest::_ownLinks_test(void)
+{
+    _verifySwarm(_functionalSwarmSize, false /* sharedLink */);
+}
+
+/// Measures Fact latency and main thread load for a steady state swarm
+void MockLinkSwarmTest::_measure(int vehicleCount, bool sharedLink)
+{
+    _startSwarm(vehicleCount, sharedLink);
+
+    // The probe timer fires late by however long the main thread was busy with something else
+    QList<double>   probeLags;
+    qint64          lastProbeMSecs = MockLink::bootMSecs();
+    QTimer          probeTimer;
+    connect(&probeTimer, &QTimer::timeout, this, [&probeLags, &lastProbeMSecs]() {
+        qint64 nowMSecs = MockLink::bootMSecs();
+        probeLags.append(qMax((qint64)0, nowMSecs - lastProbeMSecs - _probeIntervalMSecs));
+        lastProbeMSecs = nowMSecs;
+    });
+
+    _latencies.clear();
+    probeTimer.start(_probeIntervalMSecs);
+
+    QElapsedTimer   wallTimer;
+    qint64          cpuStartNSecs = _threadCpuNSecs();
+    wallTimer.start();
+
+    QTest::qWait(_measureMSecs);
+
+    double busyPercent = ((double)(_threadCpuNSecs() - cpuStartNSecs) * 100.0) / (double)wallTimer.nsecsElapsed();
+    probeTimer.stop();
+
+    QVERIFY(!_latencies.isEmpty());
+    qSort(_latencies);
+    qSort(probeLags);
+
+    double lagTotal = 0;
+    foreach (double lag, probeLags) {
+        lagTotal += lag;
+    }
+
+    qCDebug(UnitTestBenchmarkLog) << "Swarm vehicles:link" << vehicleCount << (sharedLink ? "shared" : "own")
+             << "roll latency (msecs) p50:p95:p99" << _latencies[_latencies.count() / 2] << _latencies[(_latencies.count() * 95) / 100] << _latencies[(_latencies.count() * 99) / 100]
+             << "main thread busy %" << busyPercent
+             << "event loop lag (msecs) mean:max" << (probeLags.isEmpty() ? 0 : lagTotal / probeLags.count()) << (probeLags.isEmpty() ? 0 : probeLags.last());
+
+    _stopSwarm();
+}
+
+void MockLinkSwarmTest::_swarmBenchmark_test(void)
+{
+    UT_BENCHMARK_OPT_IN();
+
+    QList<int> swarmSizes;
+
+    QString sizes = QString::fromLocal8Bit(qgetenv("QGC_SWARM_SIZES"));
+    foreach (const QString& size, sizes.split(',', QString::SkipEmptyParts)) {
+        swarmSizes.append(size.toInt());
+    }
+    if (swarmSizes.isEmpty()) {
+        swarmSizes << 1 << 5 << 10;
+    }
+
+    foreach (int vehicleCount, swarmSizes) {
+        _measure(vehicleCount, true /* sharedLink */);
+    }
+
+    // Only the smaller swarms can be run with a link per vehicle
+    foreach (int vehicleCount, swarmSizes) {
+        if (vehicleCount <= _maxOwnLinkSwarmSize) {
+            _measure(vehicleCount, false /* sharedLink */);
+        }
+    }
+}
+
+/// @return CPU time used by the calling thread
+qint64 MockLinkSwarmTest::_threadCpuNSecs(void)
+{
+#ifdef Q_OS_WIN
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    // FILETIME is in 100 nanosecond units
+    quint64 kernel = ((quint64)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+    quint64 user = ((quint64)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+    return (qint64)((kernel + user) * 100);
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return ((qint64)ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+#endif
+}
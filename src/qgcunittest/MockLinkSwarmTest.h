@@ -0,0 +1,68 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MockLinkSwarmTest_H
+#define MockLinkSwarmTest_H
+
+#include "UnitTest.h"
+#include "QGCMAVLink.h"
+
+#include <QMap>
+#include <QList>
+
+class MockLink;
+class LinkInterface;
+
+/// Unit test and load benchmark for MockLink swarms.
+///
+/// The benchmark reports the latency from a streamed ATTITUDE message leaving a mock vehicle to the Vehicle roll Fact
+/// being updated, along with how busy the main thread is, as the swarm grows. It only runs when benchmarks are enabled,
+/// see UnitTest::benchmarksEnabled. The swarm sizes can be set with the QGC_SWARM_SIZES environment variable, for
+/// example QGC_SWARM_SIZES=10,20,50.
+class MockLinkSwarmTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    MockLinkSwarmTest(void);
+
+private slots:
+    void cleanup(void);
+
+    void _sharedLink_test(void);
+    void _ownLinks_test(void);
+    void _swarmBenchmark_test(void);
+
+    void _messageReceived(LinkInterface* link, mavlink_message_t message);
+
+private:
+    void    _startSwarm         (int vehicleCount, bool sharedLink);
+    void    _stopSwarm          (void);
+    void    _verifySwarm        (int vehicleCount, bool sharedLink);
+    void    _measure            (int vehicleCount, bool sharedLink);
+
+    static qint64 _threadCpuNSecs(void);
+
+    QList<MockLink*>    _swarmLinks;
+    QMap<int, qint64>   _attitudeBootMSecs;     ///< Last ATTITUDE time_boot_ms by system id
+    QMap<int, int>      _rollUpdateCounts;      ///< Roll Fact updates by system id
+    QList<double>       _latencies;             ///< ATTITUDE to roll Fact latency (msecs)
+
+    static const int _attitudeRateHz =      50;
+    static const int _positionRateHz =      10;
+    static const int _hudRateHz =           10;
+    static const int _statusRateHz =        2;
+    static const int _functionalSwarmSize = 3;
+    static const int _maxOwnLinkSwarmSize = 20;     ///< Each link uses one of the limited mavlink channels
+    static const int _measureMSecs =        3000;
+    static const int _probeIntervalMSecs =  10;
+};
+
+#endif
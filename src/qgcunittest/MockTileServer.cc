@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "MockTileServer.h"
+
+#include <QPointer>
+#include <QTimer>
+#include <QUrl>
+
+MockTileServer::MockTileServer(void)
+    : _latency(0)
+    , _failFirst(0)
+    , _missingZoom(-1)
+    , _overloadAbove(0)
+    , _overloadCount(0)
+    , _open(0)
+    , _maxOpen(0)
+{
+    connect(&_tcpServer, &QTcpServer::newConnection, this, &MockTileServer::_newConnection);
+    bool listening = _tcpServer.listen(QHostAddress::LocalHost);
+    Q_ASSERT(listening);
+    Q_UNUSED(listening);
+}
+
+QNetworkRequest MockTileServer::request(int x, int y, int z) const
+{
+    return QNetworkRequest(QUrl(QString("http://127.0.0.1:%1/%2/%3/%4.png").arg(_tcpServer.serverPort()).arg(z).arg(x).arg(y)));
+}
+
+void MockTileServer::_newConnection(void)
+{
+    while (_tcpServer.hasPendingConnections()) {
+        QTcpSocket* socket = _tcpServer.nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, &MockTileServer::_readRequests);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            _buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockTileServer::_readRequests(void)
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    // Requests are GETs without a body, each ends with an empty line
+    QByteArray& buffer = _buffers[socket];
+    buffer.append(socket->readAll());
+    int end;
+    while ((end = buffer.indexOf("\r\n\r\n")) != -1) {
+        QByteArray requestLine = buffer.left(buffer.indexOf("\r\n"));
+        buffer.remove(0, end + 4);
+        _handleRequest(socket, requestLine);
+    }
+}
+
+void MockTileServer::_handleRequest(QTcpSocket* socket, const QByteArray& requestLine)
+{
+    // "GET /z/x/y.png HTTP/1.1"
+    QString path = QString::fromLatin1(requestLine.split(' ').value(1));
+    int zoom = path.section('/', 1, 1).toInt();
+    _requestedZooms.append(zoom);
+    _maxOpen = qMax(_maxOpen, ++_open);
+
+    int status = 200;
+    if (_overloadAbove && _open > _overloadAbove) {
+        status = 503;
+        _overloadCount++;
+    } else if (zoom == _missingZoom) {
+        status = 404;
+    } else if (_attempts[path]++ < _failFirst) {
+        status = 503;
+    }
+
+    QByteArray body;
+    if (status == 200) {
+        body.fill('t', tileSize);
+        body.replace(0, 4, "\x89PNG");
+    }
+    QByteArray response = QString("HTTP/1.1 %1 %2\r\n"
+                                  "Content-Type: image/png\r\n"
+                                  "Content-Length: %3\r\n"
+                                  "Connection: keep-alive\r\n\r\n")
+            .arg(status).arg(status == 200 ? "OK" : (status == 404 ? "Not Found" : "Service Unavailable")).arg(body.length()).toLatin1() + body;
+
+    // Every response waits the same time, so pipelined requests are still answered in order
+    QPointer<QTcpSocket> target(socket);
+    QTimer::singleShot(_latency, this, [this, target, response]() {
+        _open--;
+        if (target) {
+            target->write(response);
+        }
+    });
+}
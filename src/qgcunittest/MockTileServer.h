@@ -0,0 +1,72 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef MockTileServer_H
+#define MockTileServer_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkRequest>
+#include <QHash>
+#include <QList>
+
+/// @file
+///     @brief Minimal HTTP/1.1 map tile server for unit tests
+///
+///     Serves GET /z/x/y.png on the loop back interface with a fixed size body. Connections are kept alive and
+///     pipelined requests are answered in order. It can be set up to be slow, to fail, or to throttle.
+
+class MockTileServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    MockTileServer(void);
+
+    /// @return Request for the specified tile from this server
+    QNetworkRequest request(int x, int y, int z) const;
+
+    /// @return Host name as the downloader keys it ("host:port")
+    QString host(void) const { return QString("127.0.0.1:%1").arg(_tcpServer.serverPort()); }
+
+    void setLatency         (int msecs)     { _latency = msecs; }           ///< Delay before every response
+    void setFailFirst       (int count)     { _failFirst = count; }         ///< Each tile gets a 503 this many times before it is served
+    void setMissingZoom     (int zoom)      { _missingZoom = zoom; }        ///< Tiles at this zoom level get a 404
+    void setOverloadAbove   (int count)     { _overloadAbove = count; }     ///< 503 while more than this many requests are open, 0 for never
+
+    QList<int>  requestedZooms  (void) const { return _requestedZooms; }    ///< Zoom level of each request, in arrival order
+    int         requestCount    (void) const { return _requestedZooms.count(); }
+    int         overloadCount   (void) const { return _overloadCount; }     ///< Number of requests turned away by setOverloadAbove
+    int         maxOpen         (void) const { return _maxOpen; }           ///< Most requests open at once
+
+    static const int tileSize = 1000;
+
+private slots:
+    void _newConnection (void);
+    void _readRequests  (void);
+
+private:
+    void _handleRequest (QTcpSocket* socket, const QByteArray& requestLine);
+
+    QTcpServer                      _tcpServer;
+    QHash<QTcpSocket*, QByteArray>  _buffers;
+    QHash<QString, int>             _attempts;
+    QList<int>                      _requestedZooms;
+    int                             _latency;
+    int                             _failFirst;
+    int                             _missingZoom;
+    int                             _overloadAbove;
+    int                             _overloadCount;
+    int                             _open;
+    int                             _maxOpen;
+};
+
+#endif
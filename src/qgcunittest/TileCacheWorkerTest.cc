@@ -0,0 +1,907 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "TileCacheWorkerTest.h"
+#include "QGCMapEngine.h"
+#include "QGCMapTileSet.h"
+#include "QGCTemporaryFile.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QtAlgorithms>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+
+#include <math.h>
+
+TileCacheWorkerTest::TileCacheWorkerTest(void)
+    : _tileBase(0)
+{
+
+}
+
+void TileCacheWorkerTest::init(void)
+{
+    UnitTest::init();
+
+    QGCTemporaryFile tempFile(QStringLiteral("TileCacheWorkerTest.XXXXXX.db"));
+    QVERIFY(tempFile.open());
+    _databaseFileName = tempFile.fileName();
+    tempFile.close();
+    // The worker creates the database from scratch
+    QFile::remove(_databaseFileName);
+
+    _tileBase = 0;
+}
+
+void TileCacheWorkerTest::cleanup(void)
+{
+    QFile::remove(_databaseFileName);
+    QFile::remove(_databaseFileName + QStringLiteral("-wal"));
+    QFile::remove(_databaseFileName + QStringLiteral("-shm"));
+    QFile::remove(_databaseFileName + QStringLiteral("-journal"));
+
+    UnitTest::cleanup();
+}
+
+/// Creates a worker and waits for it to initialize the database
+QGCCacheWorker* TileCacheWorkerTest::_startWorker(int synchronous, bool walMode, int saveBatchSize, int readerCount)
+{
+    QGCCacheWorker* worker = new QGCCacheWorker();
+    worker->setDatabaseFile(_databaseFileName);
+    worker->setReaderCount(readerCount);
+    worker->setSynchronous(synchronous);
+    worker->setWalMode(walMode);
+    worker->setSaveBatchSize(saveBatchSize);
+
+    // Totals are signalled once the init task has been processed
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+    worker->enqueueTask(new QGCMapTask(QGCMapTask::taskInit));
+    if (!spyTotals.count()) {
+        spyTotals.wait(10000);
+    }
+    return worker;
+}
+
+void TileCacheWorkerTest::_stopWorker(QGCCacheWorker* worker)
+{
+    worker->quit();
+    worker->wait();
+    delete worker;
+}
+
+/// Queues tileCount tiles for saving and waits for all of them to be written
+///     @return Tiles saved per second
+double TileCacheWorkerTest::_saveTiles(QGCCacheWorker* worker, int tileCount, int tileSize)
+{
+    QByteArray  image(tileSize, (char)0x5a);
+
+    // Fetches don't go through the worker queue so they can't be used to tell when the saves are done. Wait
+    // for the totals instead, which the worker reports once its queue drains.
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i=0; i<tileCount; i++) {
+        quint64 key = QGCMapEngine::getTileKey(UrlFactory::GoogleMap, _tileBase++, i % 1024, 19);
+        QGCCacheTile* tile = new QGCCacheTile(key, image, QStringLiteral("png"), UrlFactory::GoogleMap);
+        worker->enqueueTask(new QGCSaveTileTask(tile));
+    }
+
+    while (spyTotals.count() == 0 || spyTotals.last()[0].toUInt() < (quint32)_tileBase) {
+        if (!spyTotals.wait(600000)) {
+            return 0;
+        }
+    }
+
+    qint64 elapsedMSecs = qMax(timer.elapsed(), (qint64)1);
+    return (double)tileCount * 1000.0 / (double)elapsedMSecs;
+}
+
+void TileCacheWorkerTest::_saveTiles_test(void)
+{
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+
+    QVERIFY(_saveTiles(worker, 1050, 64) > 0);
+
+    // Tiles from every batch must be readable
+    for (int x=0; x<_tileBase; x+=99) {
+        QGCFetchTileTask* fetchTask = new QGCFetchTileTask(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, x % 1024, 19));
+        QSignalSpy spyFetched(fetchTask, &QGCFetchTileTask::tileFetched);
+        worker->enqueueTask(fetchTask);
+        if (!spyFetched.count()) {
+            QVERIFY(spyFetched.wait(10000));
+        }
+        QGCCacheTile* tile = spyFetched[0][0].value<QGCCacheTile*>();
+        QCOMPARE(tile->img().size(), 64);
+        delete tile;
+    }
+
+    _stopWorker(worker);
+}
+
+void TileCacheWorkerTest::_totals_test(void)
+{
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+    QVERIFY(_saveTiles(worker, 500, 64) > 0);
+
+    // Every tile is in the default set only
+    QList<QVariant> totals = spyTotals.last();
+    QCOMPARE(totals[0].toUInt(), (quint32)500);
+    QCOMPARE(totals[1].toULongLong(), (quint64)500 * 64);
+    QCOMPARE(totals[2].toUInt(), (quint32)500);
+    QCOMPARE(totals[3].toULongLong(), (quint64)500 * 64);
+
+    // Prune takes tiles out of both the cache and the default set totals
+    QGCPruneCacheTask* pruneTask = new QGCPruneCacheTask(64 * 10);
+    QSignalSpy spyPruned(pruneTask, &QGCPruneCacheTask::pruned);
+    spyTotals.clear();
+    worker->enqueueTask(pruneTask);
+    if (!spyPruned.count()) {
+        QVERIFY(spyPruned.wait(10000));
+    }
+    if (!spyTotals.count()) {
+        QVERIFY(spyTotals.wait(10000));
+    }
+    totals = spyTotals.last();
+    quint32 remaining = totals[0].toUInt();
+    QVERIFY(remaining < 500);
+    QCOMPARE(totals[1].toULongLong(), (quint64)remaining * 64);
+    QCOMPARE(totals[2].toUInt(), remaining);
+    QCOMPARE(totals[3].toULongLong(), (quint64)remaining * 64);
+
+    _stopWorker(worker);
+}
+
+void TileCacheWorkerTest::_pruneOrder_test(void)
+{
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+    QVERIFY(_saveTiles(worker, _pruneTileCount, 64) > 0);
+    _stopWorker(worker);
+
+    // Every tile was saved in the same second. Spread the access times out so tile x was used before tile x+1, and put
+    // the oldest few tiles after tile 0 into an offline set as well.
+    const QString connection(QStringLiteral("TileCacheWorkerTestPrune"));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(_databaseFileName);
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec(QString("INSERT INTO TileSets(name, type) VALUES('Offline Set', %1)").arg((int)UrlFactory::GoogleMap)));
+        quint64 setID = query.lastInsertId().toULongLong();
+        QVERIFY(db.transaction());
+        for (int x=0; x<_pruneTileCount; x++) {
+            qint64 key = (qint64)QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, x % 1024, 19);
+            QVERIFY(query.exec(QString("UPDATE Tiles SET date = %1 WHERE tileID = %2").arg(_pruneBaseDate + x).arg(key)));
+            if (x >= 1 && x <= _pruneOfflineCount) {
+                QVERIFY(query.exec(QString("INSERT INTO SetTiles(tileID, setID) VALUES(%1, %2)").arg(key).arg(setID)));
+            }
+        }
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+
+    worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+
+    // Using the oldest tile makes it the most recently used
+    QGCFetchTileTask* fetchTask = new QGCFetchTileTask(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 0, 0, 19));
+    QSignalSpy spyFetched(fetchTask, &QGCFetchTileTask::tileFetched);
+    worker->enqueueTask(fetchTask);
+    if (!spyFetched.count()) {
+        QVERIFY(spyFetched.wait(10000));
+    }
+    delete spyFetched[0][0].value<QGCCacheTile*>();
+
+    QGCPruneCacheTask* pruneTask = new QGCPruneCacheTask(64 * _prunedCount);
+    QSignalSpy spyPruned(pruneTask, &QGCPruneCacheTask::pruned);
+    worker->enqueueTask(pruneTask);
+    if (!spyPruned.count()) {
+        QVERIFY(spyPruned.wait(10000));
+    }
+    _stopWorker(worker);
+
+    // The touched tile and the offline set tiles survive, the oldest untouched default set tiles go first
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(_databaseFileName);
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        for (int x=0; x<_pruneTileCount; x++) {
+            qint64 key = (qint64)QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, x % 1024, 19);
+            QVERIFY(query.exec(QString("SELECT COUNT(*) FROM Tiles WHERE tileID = %1").arg(key)));
+            QVERIFY(query.next());
+            bool pruned = x > _pruneOfflineCount && x <= _pruneOfflineCount + _prunedCount;
+            QCOMPARE(query.value(0).toInt(), pruned ? 0 : 1);
+        }
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+}
+
+void TileCacheWorkerTest::_saveBenchmark_test(void)
+{
+    UT_BENCHMARK_OPT_IN();
+
+    // Settings prior to batching: a transaction per insert with a rollback journal and full sync
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncFull, false /* walMode */, 1, 0);
+    double legacyRate = _saveTiles(worker, _legacyBenchmarkTileCount, _benchmarkTileSize);
+    _stopWorker(worker);
+    QVERIFY(legacyRate > 0);
+    cleanup();
+    init();
+
+    worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 1000, 2);
+    double batchedRate = _saveTiles(worker, _benchmarkTileCount, _benchmarkTileSize);
+    _stopWorker(worker);
+    QVERIFY(batchedRate > 0);
+
+    qCDebug(UnitTestBenchmarkLog) << "Tile save tiles/sec unbatched:batched" << legacyRate << batchedRate;
+}
+
+/// Floods the cache with tile fetches while a prune is running on the worker
+///     @param[out] latencies Time in msecs from queuing each fetch until it returned a tile, sorted
+void TileCacheWorkerTest::_fetchDuringPrune(QGCCacheWorker* worker, QList<double>& latencies)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Prune most of the cache in the background
+    QGCPruneCacheTask* pruneTask = new QGCPruneCacheTask((quint64)_tileBase * _benchmarkTileSize / 2);
+    QSignalSpy spyPruned(pruneTask, &QGCPruneCacheTask::pruned);
+    worker->enqueueTask(pruneTask);
+
+    QList<QGCFetchTileTask*> fetchTasks;
+    QVector<qint64> queuedNSecs(_latencyFetchCount);
+    QVector<qint64> fetchedNSecs(_latencyFetchCount, 0);
+    for (int i=0; i<_latencyFetchCount; i++) {
+        // Walk the cache backwards, the prune starts with the oldest tiles
+        int x = _tileBase - 1 - (i % (_tileBase / 4));
+        QGCFetchTileTask* fetchTask = new QGCFetchTileTask(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, x % 1024, 19));
+        // Runs on the reader thread as soon as the tile is found
+        connect(fetchTask, &QGCFetchTileTask::tileFetched, this, [&timer, &fetchedNSecs, i](QGCCacheTile* tile) {
+            fetchedNSecs[i] = timer.nsecsElapsed();
+            delete tile;
+        }, Qt::DirectConnection);
+        queuedNSecs[i] = timer.nsecsElapsed();
+        worker->enqueueTask(fetchTask);
+    }
+
+    if (!spyPruned.count()) {
+        QVERIFY(spyPruned.wait(60000));
+    }
+    // Give stragglers time to finish
+    for (int wait=0; wait<100 && fetchedNSecs.contains(0); wait++) {
+        QTest::qWait(100);
+    }
+
+    latencies.clear();
+    for (int i=0; i<_latencyFetchCount; i++) {
+        QVERIFY(fetchedNSecs[i] != 0);
+        latencies.append((double)(fetchedNSecs[i] - queuedNSecs[i]) / 1.0e6);
+    }
+    qSort(latencies);
+}
+
+void TileCacheWorkerTest::_fetchLatency_test(void)
+{
+    UT_BENCHMARK_OPT_IN();
+
+    const int seedTileCount = 20000;
+
+    QList<double> latencies;
+    double p50[2], p95[2], p99[2];
+
+    // Fetches on the worker queue, then on the reader pool
+    for (int readers=0; readers<2; readers++) {
+        QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 1000, readers * 2);
+        QVERIFY(_saveTiles(worker, seedTileCount, _benchmarkTileSize) > 0);
+        _fetchDuringPrune(worker, latencies);
+        _stopWorker(worker);
+        if (latencies.isEmpty()) {
+            return;
+        }
+        p50[readers] = latencies[latencies.count() / 2];
+        p95[readers] = latencies[latencies.count() * 95 / 100];
+        p99[readers] = latencies[latencies.count() * 99 / 100];
+        cleanup();
+        init();
+    }
+
+    qCDebug(UnitTestBenchmarkLog) << "Tile fetch latency during prune (msecs) p50:p95:p99 worker" << p50[0] << p95[0] << p99[0];
+    qCDebug(UnitTestBenchmarkLog) << "Tile fetch latency during prune (msecs) p50:p95:p99 readers" << p50[1] << p95[1] << p99[1];
+}
+
+/// Builds a cache the way it was written before tiles were keyed by integer: every tile in the default set, the first
+/// _migrateSharedCount also in a second set, which has _migratePendingCount tiles left to download
+void TileCacheWorkerTest::_createTextKeyCache(void)
+{
+    const QString connection(QStringLiteral("TileCacheWorkerTestTextKeys"));
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(_databaseFileName);
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE Tiles (tileID INTEGER PRIMARY KEY NOT NULL, hash TEXT NOT NULL UNIQUE, format TEXT NOT NULL, tile BLOB NULL, size INTEGER, type INTEGER, date INTEGER DEFAULT 0)"));
+        QVERIFY(query.exec("CREATE TABLE TileSets (setID INTEGER PRIMARY KEY NOT NULL, name TEXT NOT NULL UNIQUE, typeStr TEXT, topleftLat REAL DEFAULT 0.0, topleftLon REAL DEFAULT 0.0, bottomRightLat REAL DEFAULT 0.0, bottomRightLon REAL DEFAULT 0.0, minZoom INTEGER DEFAULT 3, maxZoom INTEGER DEFAULT 3, type INTEGER DEFAULT -1, numTiles INTEGER DEFAULT 0, defaultSet INTEGER DEFAULT 0, date INTEGER DEFAULT 0)"));
+        QVERIFY(query.exec("CREATE TABLE SetTiles (setID INTEGER, tileID INTEGER)"));
+        QVERIFY(query.exec("CREATE TABLE TilesDownload (setID INTEGER, hash TEXT NOT NULL UNIQUE, type INTEGER, x INTEGER, y INTEGER, z INTEGER, state INTEGER DEFAULT 0)"));
+        QVERIFY(query.exec("INSERT INTO TileSets(setID, name, defaultSet) VALUES(1, 'Default Tile Set', 1)"));
+        QVERIFY(query.exec(QString("INSERT INTO TileSets(setID, name, type, numTiles) VALUES(2, 'Offline Set', %1, %2)").arg((int)UrlFactory::GoogleMap).arg(_migrateSharedCount + _migratePendingCount)));
+
+        QVERIFY(db.transaction());
+        QByteArray image(64, (char)0x5a);
+        for (int i=0; i<_migrateTileCount; i++) {
+            // Old tile ids have nothing to do with the tile
+            int tileID = _migrateTileCount - i;
+            query.prepare("INSERT INTO Tiles(tileID, hash, format, tile, size, type) VALUES(?, ?, ?, ?, ?, ?)");
+            query.addBindValue(tileID);
+            query.addBindValue(QString().sprintf("%04d%08d%08d%03d", (int)UrlFactory::GoogleMap, i, i % 1024, 19));
+            query.addBindValue(QStringLiteral("png"));
+            query.addBindValue(image);
+            query.addBindValue(image.size());
+            query.addBindValue((int)UrlFactory::GoogleMap);
+            QVERIFY(query.exec());
+            QVERIFY(query.exec(QString("INSERT INTO SetTiles(tileID, setID) VALUES(%1, 1)").arg(tileID)));
+            if (i < _migrateSharedCount) {
+                QVERIFY(query.exec(QString("INSERT INTO SetTiles(tileID, setID) VALUES(%1, 2)").arg(tileID)));
+            }
+        }
+        for (int i=0; i<_migratePendingCount; i++) {
+            int x = _migrateTileCount + i;
+            query.prepare("INSERT INTO TilesDownload(setID, hash, type, x, y, z, state) VALUES(2, ?, ?, ?, ?, 19, 0)");
+            query.addBindValue(QString().sprintf("%04d%08d%08d%03d", (int)UrlFactory::GoogleMap, x, i, 19));
+            query.addBindValue((int)UrlFactory::GoogleMap);
+            query.addBindValue(x);
+            query.addBindValue(i);
+            QVERIFY(query.exec());
+        }
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+}
+
+void TileCacheWorkerTest::_migrateTileKeys_test(void)
+{
+    _createTextKeyCache();
+    qint64 textKeySize = QFileInfo(_databaseFileName).size();
+
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+
+    // Tiles are found by their new key
+    for (int x=0; x<_migrateTileCount; x+=97) {
+        QGCFetchTileTask* fetchTask = new QGCFetchTileTask(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, x % 1024, 19));
+        QSignalSpy spyFetched(fetchTask, &QGCFetchTileTask::tileFetched);
+        worker->enqueueTask(fetchTask);
+        if (!spyFetched.count()) {
+            QVERIFY(spyFetched.wait(10000));
+        }
+        QGCCacheTile* tile = spyFetched[0][0].value<QGCCacheTile*>();
+        QCOMPARE(tile->img().size(), 64);
+        QCOMPARE(tile->type(), UrlFactory::GoogleMap);
+        delete tile;
+    }
+
+    // Set membership and totals survive the migration
+    QList<QGCCachedTileSet*> tileSets;
+    QGCFetchTileSetTask* setTask = new QGCFetchTileSetTask();
+    connect(setTask, &QGCFetchTileSetTask::tileSetFetched, this, [&tileSets](QGCCachedTileSet* tileSet) {
+        tileSets.append(tileSet);
+    }, Qt::DirectConnection);
+    worker->enqueueTask(setTask);
+    for (int wait=0; wait<100 && tileSets.count() < 2; wait++) {
+        QTest::qWait(100);
+    }
+    QCOMPARE(tileSets.count(), 2);
+    QCOMPARE(tileSets[0]->savedTileCount(), (quint32)_migrateTileCount);
+    QCOMPARE(tileSets[1]->savedTileCount(), (quint32)_migrateSharedCount);
+    QCOMPARE(tileSets[1]->savedTileSize(), (quint64)_migrateSharedCount * 64);
+    qDeleteAll(tileSets);
+
+    // Pending downloads come back with their coordinates
+    QList<QGCTile*> tiles;
+    bool listFetched = false;
+    QGCGetTileDownloadListTask* listTask = new QGCGetTileDownloadListTask(2, _migratePendingCount * 2);
+    connect(listTask, &QGCGetTileDownloadListTask::tileListFetched, this, [&tiles, &listFetched](QList<QGCTile*> fetched) {
+        tiles = fetched;
+        listFetched = true;
+    }, Qt::DirectConnection);
+    worker->enqueueTask(listTask);
+    for (int wait=0; wait<100 && !listFetched; wait++) {
+        QTest::qWait(100);
+    }
+    QCOMPARE(tiles.count(), (int)_migratePendingCount);
+    foreach (QGCTile* tile, tiles) {
+        QCOMPARE(tile->type(), UrlFactory::GoogleMap);
+        QCOMPARE(tile->z(), 19);
+        QCOMPARE(tile->x(), _migrateTileCount + tile->y());
+        QCOMPARE(tile->key(), QGCMapEngine::getTileKey(UrlFactory::GoogleMap, tile->x(), tile->y(), tile->z()));
+    }
+    qDeleteAll(tiles);
+
+    _stopWorker(worker);
+
+    qint64 intKeySize = QFileInfo(_databaseFileName).size();
+    qCDebug(UnitTestBenchmarkLog) << "Tile cache size bytes text keys:integer keys" << textKeySize << intKeySize;
+    QVERIFY(intKeySize < textKeySize);
+}
+
+/// A migration which fails part way through must leave the old cache, and the offline sets in it, as they were
+void TileCacheWorkerTest::_migrateTileKeysFailure_test(void)
+{
+    _createTextKeyCache();
+
+    const QString connection(QStringLiteral("TileCacheWorkerTestMigrateFailure"));
+    {
+        // Blocks the rename of the pending download table, which comes after the tiles have been moved over
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(_databaseFileName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE TilesDownloadV1 (setID INTEGER)"));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+
+    QGCCacheWorker* worker = new QGCCacheWorker();
+    worker->setDatabaseFile(_databaseFileName);
+    worker->setReaderCount(0);
+    QGCMapTask* initTask = new QGCMapTask(QGCMapTask::taskInit);
+    QSignalSpy spyError(initTask, &QGCMapTask::error);
+    worker->enqueueTask(initTask);
+    if (!spyError.count()) {
+        QVERIFY(spyError.wait(10000));
+    }
+    _stopWorker(worker);
+
+    QVERIFY(QFile::exists(_databaseFileName));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(_databaseFileName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+
+        // Still in the old form, with nothing lost
+        QVERIFY(query.exec("SELECT COUNT(hash) FROM Tiles"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), (int)_migrateTileCount);
+        QVERIFY(query.exec("SELECT name FROM TileSets ORDER BY setID"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QStringLiteral("Default Tile Set"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QStringLiteral("Offline Set"));
+        QVERIFY(query.exec("SELECT COUNT(*) FROM SetTiles WHERE setID = 2 AND tileID IN (SELECT tileID FROM Tiles)"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), (int)_migrateSharedCount);
+        QVERIFY(query.exec("SELECT COUNT(hash) FROM TilesDownload"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), (int)_migratePendingCount);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+}
+
+/// @return Coordinate of a point in tile space, tile (x, y) spans x..x+1, y..y+1
+QGeoCoordinate TileCacheWorkerTest::_tileCoordinate(double x, double y, int z)
+{
+    double n = pow(2.0, z);
+    return QGeoCoordinate(atan(sinh(M_PI * (1.0 - 2.0 * y / n))) * 180.0 / M_PI, x / n * 360.0 - 180.0);
+}
+
+/// Creates a tile set covering tiles x0..x1, y0..y1 at zoom levels minZoom..maxZoom of zoom level z
+///     @param polygon Clips the set when not empty
+///     @return Set ID, 0 if the set could not be created
+quint64 TileCacheWorkerTest::_createTileSet(QGCCacheWorker* worker, int x0, int y0, int x1, int y1, int z, int minZoom, int maxZoom, const QList<QGeoCoordinate>& polygon)
+{
+    // Tile centers, so the bounds don't land on a tile edge
+    QGeoCoordinate topLeft = _tileCoordinate(x0 + 0.5, y0 + 0.5, z);
+    QGeoCoordinate bottomRight = _tileCoordinate(x1 + 0.5, y1 + 0.5, z);
+    QGCCachedTileSet* tileSet = new QGCCachedTileSet(QStringLiteral("Set %1 %2 %3").arg(x0).arg(y0).arg(minZoom));
+    tileSet->setType(UrlFactory::GoogleMap);
+    tileSet->setTopleftLon(topLeft.longitude());
+    tileSet->setTopleftLat(topLeft.latitude());
+    tileSet->setBottomRightLon(bottomRight.longitude());
+    tileSet->setBottomRightLat(bottomRight.latitude());
+    tileSet->setPolygon(polygon);
+    tileSet->setMinZoom(minZoom);
+    tileSet->setMaxZoom(maxZoom);
+
+    QGCCreateTileSetTask* createTask = new QGCCreateTileSetTask(tileSet);
+    QSignalSpy spySaved(createTask, &QGCCreateTileSetTask::tileSetSaved);
+    worker->enqueueTask(createTask);
+    if (!spySaved.count() && !spySaved.wait(10000)) {
+        return 0;
+    }
+    quint64 setID = tileSet->id();
+    delete tileSet;
+    return setID;
+}
+
+/// Fetches the next batch of tiles to download for a set
+///     @param[out] cachedCount Number of tiles which joined the set because they were already cached
+void TileCacheWorkerTest::_getTileDownloadList(QGCCacheWorker* worker, quint64 setID, int count, QList<QGCTile*>& tiles, quint32& cachedCount)
+{
+    bool listFetched = false;
+    QGCGetTileDownloadListTask* listTask = new QGCGetTileDownloadListTask(setID, count);
+    connect(listTask, &QGCGetTileDownloadListTask::tileListFetched, this, [&tiles, &cachedCount, &listFetched](QList<QGCTile*> fetched, quint32 cached, quint64) {
+        tiles = fetched;
+        cachedCount = cached;
+        listFetched = true;
+    }, Qt::DirectConnection);
+    worker->enqueueTask(listTask);
+    for (int wait=0; wait<100 && !listFetched; wait++) {
+        QTest::qWait(100);
+    }
+    QVERIFY(listFetched);
+}
+
+void TileCacheWorkerTest::_enumerateTileSet_test(void)
+{
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+
+    // Half of a 16x16 block is already cached, in a checkerboard
+    const int z = 12;
+    const int x0 = 1000;
+    const int y0 = 1500;
+    QByteArray image(64, (char)0x5a);
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+    for (int x=x0; x<x0+16; x++) {
+        for (int y=y0; y<y0+16; y++) {
+            if ((x + y) % 2 == 0) {
+                worker->enqueueTask(new QGCSaveTileTask(new QGCCacheTile(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, y, z), image, QStringLiteral("png"), UrlFactory::GoogleMap)));
+            }
+        }
+    }
+    while (spyTotals.count() == 0 || spyTotals.last()[0].toUInt() < 128) {
+        QVERIFY(spyTotals.wait(10000));
+    }
+
+    // The missing half comes back in batches, the cached half joins the set
+    quint64 setID = _createTileSet(worker, x0, y0, x0 + 15, y0 + 15, z, z, z);
+    QVERIFY(setID != 0);
+    QList<QGCTile*> tiles;
+    QSet<quint64> keys;
+    quint32 cachedCount = 0;
+    quint32 totalCachedCount = 0;
+    do {
+        _getTileDownloadList(worker, setID, 50, tiles, cachedCount);
+        totalCachedCount += cachedCount;
+        foreach (QGCTile* tile, tiles) {
+            QCOMPARE(tile->z(), z);
+            QVERIFY(tile->x() >= x0 && tile->x() < x0 + 16);
+            QVERIFY(tile->y() >= y0 && tile->y() < y0 + 16);
+            QVERIFY((tile->x() + tile->y()) % 2 == 1);
+            keys.insert(tile->key());
+        }
+        qDeleteAll(tiles);
+    } while (tiles.count() == 50);
+    QCOMPARE(keys.count(), 128);
+    QCOMPARE(totalCachedCount, (quint32)128);
+
+    // A large set is created without enumerating any of it: z10 to z19 over two by two z10 tiles
+    QElapsedTimer timer;
+    timer.start();
+    setID = _createTileSet(worker, 600, 380, 601, 381, 10, 10, 19);
+    qint64 createMSecs = timer.elapsed();
+    QVERIFY(setID != 0);
+    // Downloads start with the lowest zoom level
+    _getTileDownloadList(worker, setID, 256, tiles, cachedCount);
+    QCOMPARE(tiles.count(), 256);
+    QCOMPARE(tiles[0]->z(), 10);
+    for (int i=1; i<tiles.count(); i++) {
+        QVERIFY(tiles[i]->z() >= tiles[i - 1]->z());
+    }
+    qDeleteAll(tiles);
+    qCDebug(UnitTestBenchmarkLog) << "Tile set creation z10-z19 msecs" << createMSecs;
+
+    _stopWorker(worker);
+}
+
+void TileCacheWorkerTest::_polygonTileSet_test(void)
+{
+    // Right triangle in tile space with its legs along the top and left of a 16x16 block and a diagonal
+    // x + y = 15.4 (block relative). None of its edges run along a tile edge or through a tile corner,
+    // at this zoom level or the two below it.
+    const int z = 12;
+    const int x0 = 2000;
+    const int y0 = 1200;
+    QList<QGeoCoordinate> polygon;
+    polygon << _tileCoordinate(x0 + 0.3, y0 + 0.3, z) << _tileCoordinate(x0 + 15.1, y0 + 0.3, z) << _tileCoordinate(x0 + 0.3, y0 + 15.1, z);
+
+    // Exactly the tiles with x + y <= 15, one run per column, against 256 for the bounding box
+    QVector<QGCTileRun> runs = QGCMapEngine::getTileRuns(z, polygon);
+    QCOMPARE(runs.count(), 16);
+    for (int i=0; i<runs.count(); i++) {
+        QCOMPARE(runs[i].x, x0 + i);
+        QCOMPARE(runs[i].y0, y0);
+        QCOMPARE(runs[i].y1, y0 + 15 - i);
+    }
+    QGCTileSet set = QGCMapEngine::getTileCount(z, polygon, UrlFactory::GoogleMap);
+    QCOMPARE(set.tileCount, (quint64)136);
+    QCOMPARE(set.tileX0, x0);
+    QCOMPARE(set.tileX1, x0 + 15);
+    QCOMPARE(set.tileY0, y0);
+    QCOMPARE(set.tileY1, y0 + 15);
+
+    // A thin diagonal corridor needs far fewer tiles than its bounds
+    QList<QGeoCoordinate> corridor;
+    corridor << _tileCoordinate(x0 + 0.2, y0 + 0.1, z) << _tileCoordinate(x0 + 0.4, y0 + 0.1, z) << _tileCoordinate(x0 + 63.8, y0 + 63.9, z) << _tileCoordinate(x0 + 63.6, y0 + 63.9, z);
+    QGCTileSet corridorSet = QGCMapEngine::getTileCount(z, corridor, UrlFactory::GoogleMap);
+    QVERIFY(corridorSet.tileCount >= 64);
+    QVERIFY(corridorSet.tileCount <= 3 * 64);
+    QCOMPARE(QGCMapEngine::getTileCount(z, _tileCoordinate(x0 + 0.2, y0 + 0.1, z).longitude(), _tileCoordinate(x0 + 0.2, y0 + 0.1, z).latitude(),
+                                        _tileCoordinate(x0 + 63.8, y0 + 63.9, z).longitude(), _tileCoordinate(x0 + 63.8, y0 + 63.9, z).latitude(),
+                                        UrlFactory::GoogleMap).tileCount, (quint64)(64 * 64));
+
+    // A set clipped to the triangle downloads only the tiles it covers, at every zoom level
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+    quint64 setID = _createTileSet(worker, x0, y0, x0 + 15, y0 + 15, z, z, z + 2, polygon);
+    QVERIFY(setID != 0);
+    quint64 expectedCount = 0;
+    QSet<quint64> expectedKeys;
+    for (int zoom=z; zoom<=z+2; zoom++) {
+        runs = QGCMapEngine::getTileRuns(zoom, polygon);
+        foreach (const QGCTileRun& run, runs) {
+            for (int y=run.y0; y<=run.y1; y++) {
+                expectedKeys.insert(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, run.x, y, zoom));
+            }
+        }
+        expectedCount += QGCMapEngine::getTileCount(zoom, polygon, UrlFactory::GoogleMap).tileCount;
+    }
+    QCOMPARE((quint64)expectedKeys.count(), expectedCount);
+    QList<QGCTile*> tiles;
+    QSet<quint64> keys;
+    quint32 cachedCount = 0;
+    do {
+        _getTileDownloadList(worker, setID, 100, tiles, cachedCount);
+        foreach (QGCTile* tile, tiles) {
+            QVERIFY(expectedKeys.contains(tile->key()));
+            keys.insert(tile->key());
+        }
+        qDeleteAll(tiles);
+    } while (tiles.count() == 100);
+    QCOMPARE(keys, expectedKeys);
+
+    _stopWorker(worker);
+}
+
+/// Imports an MBTiles file as a new tile set, its map type comes from the file
+///     @return Imported set, NULL if the import failed
+QGCCachedTileSet* TileCacheWorkerTest::_importTileSet(QGCCacheWorker* worker, const QString& path, const QString& name)
+{
+    QGCCachedTileSet* tileSet = new QGCCachedTileSet(name);
+    QGCImportTileTask* importTask = new QGCImportTileTask(tileSet, path);
+    QSignalSpy spyImported(importTask, &QGCImportTileTask::tileSetImported);
+    QSignalSpy spyError(importTask, &QGCMapTask::error);
+    worker->enqueueTask(importTask);
+    for (int wait=0; wait<600 && !spyImported.count() && !spyError.count(); wait++) {
+        QTest::qWait(100);
+    }
+    return spyImported.count() ? tileSet : NULL;
+}
+
+void TileCacheWorkerTest::_mbtiles_test(void)
+{
+    // A block of z12 tiles, each holding its own key, plus tiles of another map type in the same place
+    const int z = 12;
+    const int x0 = 3000;
+    const int y0 = 1400;
+    const int tileCount = _mbtilesBlockSize * _mbtilesBlockSize;
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 1000, 2);
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+    for (int x=x0; x<x0+_mbtilesBlockSize; x++) {
+        for (int y=y0; y<y0+_mbtilesBlockSize; y++) {
+            quint64 key = QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, y, z);
+            worker->enqueueTask(new QGCSaveTileTask(new QGCCacheTile(key, QByteArray::number(key), QStringLiteral("png"), UrlFactory::GoogleMap)));
+        }
+    }
+    for (int x=x0; x<x0+8; x++) {
+        quint64 key = QGCMapEngine::getTileKey(UrlFactory::BingMap, x, y0, z);
+        worker->enqueueTask(new QGCSaveTileTask(new QGCCacheTile(key, QByteArray::number(key), QStringLiteral("png"), UrlFactory::BingMap)));
+    }
+    while (spyTotals.count() == 0 || spyTotals.last()[0].toUInt() < (quint32)tileCount + 8) {
+        QVERIFY(spyTotals.wait(10000));
+    }
+
+    // The whole cache of one map type goes out
+    QGCTemporaryFile tempFile(QStringLiteral("TileCacheWorkerTest.XXXXXX.mbtiles"));
+    QVERIFY(tempFile.open());
+    QString mbtilesFileName = tempFile.fileName();
+    tempFile.close();
+    QGCExportTileTask* exportTask = new QGCExportTileTask(UINT64_MAX, UrlFactory::GoogleMap, QStringLiteral("Export"), mbtilesFileName);
+    QSignalSpy spyExported(exportTask, &QGCExportTileTask::exported);
+    worker->enqueueTask(exportTask);
+    if (!spyExported.count()) {
+        QVERIFY(spyExported.wait(10000));
+    }
+    QCOMPARE(spyExported[0][0].toUInt(), (quint32)tileCount);
+    _stopWorker(worker);
+
+    // Rows are flipped (TMS) in the file
+    {
+        const QString connection(QStringLiteral("TileCacheWorkerTestMBTiles"));
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+        db.setDatabaseName(mbtilesFileName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec(QString("SELECT tile_data FROM tiles WHERE zoom_level = %1 AND tile_column = %2 AND tile_row = %3").arg(z).arg(x0).arg((1 << z) - 1 - y0)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toByteArray(), QByteArray::number(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x0, y0, z)));
+        QVERIFY(query.exec("SELECT value FROM metadata WHERE name = 'format'"));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toString(), QStringLiteral("png"));
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("TileCacheWorkerTestMBTiles"));
+
+    // Into an empty cache, as a complete set
+    cleanup();
+    init();
+    worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 1000, 2);
+    QElapsedTimer timer;
+    timer.start();
+    QGCCachedTileSet* tileSet = _importTileSet(worker, mbtilesFileName, QStringLiteral("Imported"));
+    qint64 importMSecs = timer.elapsed();
+    QVERIFY(tileSet);
+    QCOMPARE(tileSet->type(), UrlFactory::GoogleMap);
+    QCOMPARE(tileSet->minZoom(), z);
+    QCOMPARE(tileSet->maxZoom(), z);
+    QCOMPARE(tileSet->totalTileCount(), (quint32)tileCount);
+    QCOMPARE(tileSet->savedTileCount(), (quint32)tileCount);
+    QCOMPARE(tileSet->uniqueTileCount(), (quint32)tileCount);
+    QGeoCoordinate topLeft = _tileCoordinate(x0, y0, z);
+    QGeoCoordinate bottomRight = _tileCoordinate(x0 + _mbtilesBlockSize, y0 + _mbtilesBlockSize, z);
+    QVERIFY(qAbs(tileSet->topleftLat() - topLeft.latitude()) < 1e-9);
+    QVERIFY(qAbs(tileSet->topleftLon() - topLeft.longitude()) < 1e-9);
+    QVERIFY(qAbs(tileSet->bottomRightLat() - bottomRight.latitude()) < 1e-9);
+    QVERIFY(qAbs(tileSet->bottomRightLon() - bottomRight.longitude()) < 1e-9);
+    delete tileSet;
+
+    // Tiles are found under the key they were exported from
+    for (int i=0; i<tileCount; i+=37) {
+        quint64 key = QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x0 + i / _mbtilesBlockSize, y0 + i % _mbtilesBlockSize, z);
+        QGCFetchTileTask* fetchTask = new QGCFetchTileTask(key);
+        QSignalSpy spyFetched(fetchTask, &QGCFetchTileTask::tileFetched);
+        worker->enqueueTask(fetchTask);
+        if (!spyFetched.count()) {
+            QVERIFY(spyFetched.wait(10000));
+        }
+        QGCCacheTile* tile = spyFetched[0][0].value<QGCCacheTile*>();
+        QCOMPARE(tile->img(), QByteArray::number(key));
+        delete tile;
+    }
+
+    // Importing it again shares the tiles already there
+    tileSet = _importTileSet(worker, mbtilesFileName, QStringLiteral("Imported Again"));
+    QVERIFY(tileSet);
+    QCOMPARE(tileSet->savedTileCount(), (quint32)tileCount);
+    QCOMPARE(tileSet->uniqueTileCount(), (quint32)0);
+    delete tileSet;
+    QSignalSpy spyImportTotals(worker, &QGCCacheWorker::updateTotals);
+    worker->enqueueTask(new QGCMapTask(QGCMapTask::taskInit));
+    if (!spyImportTotals.count()) {
+        QVERIFY(spyImportTotals.wait(10000));
+    }
+    QCOMPARE(spyImportTotals.last()[0].toUInt(), (quint32)tileCount);
+
+    _stopWorker(worker);
+    QFile::remove(mbtilesFileName);
+    qCDebug(UnitTestBenchmarkLog) << "MBTiles import tiles:msecs" << tileCount << importMSecs;
+}
+
+/// The memory cache stays within its budget by dropping the least recently used tiles
+void TileCacheWorkerTest::_memCacheEviction_test(void)
+{
+    const int tileSize = 100;
+    const int tileCount = 500;
+
+    QGCTileMemCache memCache(_memCacheMaxBytes);
+    QByteArray image(tileSize, (char)0x5a);
+    QByteArray foundImage;
+    QString foundFormat;
+
+    // A tile which keeps being used survives the flood
+    quint64 hotKey = QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 0, 0, 19);
+    memCache.insert(hotKey, image, QStringLiteral("png"));
+    for (int i=1; i<=tileCount; i++) {
+        memCache.insert(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, i, i, 19), image, QStringLiteral("png"));
+        QVERIFY(memCache.find(hotKey, foundImage, foundFormat));
+    }
+    QCOMPARE(foundImage, image);
+    QCOMPARE(foundFormat, QStringLiteral("png"));
+
+    QVERIFY(memCache.bytes() <= (quint64)_memCacheMaxBytes);
+    QCOMPARE(memCache.bytes(), (quint64)memCache.count() * tileSize);
+    QCOMPARE(memCache.evictions(), (quint64)(tileCount + 1 - memCache.count()));
+    QVERIFY(!memCache.find(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 1, 1, 19), foundImage, foundFormat));
+
+    // Replacing a tile is not an eviction
+    quint64 evictions = memCache.evictions();
+    memCache.insert(hotKey, QByteArray(tileSize, (char)0xa5), QStringLiteral("jpg"));
+    QCOMPARE(memCache.evictions(), evictions);
+    QVERIFY(memCache.find(hotKey, foundImage, foundFormat));
+    QCOMPARE(foundFormat, QStringLiteral("jpg"));
+
+    // A tile larger than its share of the budget is never kept
+    quint64 bigKey = QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 1, 0, 19);
+    memCache.insert(bigKey, QByteArray(_memCacheMaxBytes, (char)0x5a), QStringLiteral("png"));
+    QVERIFY(!memCache.find(bigKey, foundImage, foundFormat));
+
+    // Shrinking the budget evicts down to the new size
+    quint32 count = memCache.count();
+    memCache.setMaxBytes(_memCacheMaxBytes / 4);
+    QVERIFY(memCache.bytes() <= (quint64)_memCacheMaxBytes / 4);
+    QCOMPARE(memCache.evictions(), evictions + count - memCache.count());
+}
+
+/// Tiles deleted from the database don't keep being served from the memory cache
+void TileCacheWorkerTest::_memCacheInvalidation_test(void)
+{
+    const int tileCount = 4;
+
+    QGCTileMemCache memCache(1024 * 1024);
+    QGCCacheWorker* worker = _startWorker(QGCCacheWorker::SyncNormal, true /* walMode */, 100, 2);
+    worker->setMemCache(&memCache);
+
+    // Tiles in a tile set and tiles in the default set, all of them also in memory
+    quint64 setID = _createTileSet(worker, 2000, 2000, 2001, 2001, 12, 12, 12);
+    QVERIFY(setID != 0);
+    QByteArray image(64, (char)0x5a);
+    QList<quint64> setKeys;
+    QList<quint64> defaultKeys;
+    QSignalSpy spyTotals(worker, &QGCCacheWorker::updateTotals);
+    for (int i=0; i<tileCount; i++) {
+        setKeys << QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 3000 + i, 3000, 19);
+        defaultKeys << QGCMapEngine::getTileKey(UrlFactory::GoogleMap, 4000 + i, 4000, 19);
+        worker->enqueueTask(new QGCSaveTileTask(new QGCCacheTile(setKeys.last(), image, QStringLiteral("png"), UrlFactory::GoogleMap, setID)));
+        worker->enqueueTask(new QGCSaveTileTask(new QGCCacheTile(defaultKeys.last(), image, QStringLiteral("png"), UrlFactory::GoogleMap)));
+        memCache.insert(setKeys.last(), image, QStringLiteral("png"));
+        memCache.insert(defaultKeys.last(), image, QStringLiteral("png"));
+    }
+    while (spyTotals.count() == 0 || spyTotals.last()[0].toUInt() < (quint32)tileCount * 2) {
+        QVERIFY(spyTotals.wait(10000));
+    }
+    QCOMPARE(memCache.count(), (quint32)tileCount * 2);
+
+    QByteArray foundImage;
+    QString foundFormat;
+
+    // Deleting the set drops its tiles from memory, the others stay
+    QGCDeleteTileSetTask* deleteTask = new QGCDeleteTileSetTask(setID);
+    QSignalSpy spyDeleted(deleteTask, &QGCDeleteTileSetTask::tileSetDeleted);
+    worker->enqueueTask(deleteTask);
+    QVERIFY(spyDeleted.count() || spyDeleted.wait(10000));
+    foreach (quint64 key, setKeys) {
+        QVERIFY(!memCache.find(key, foundImage, foundFormat));
+    }
+    foreach (quint64 key, defaultKeys) {
+        QVERIFY(memCache.find(key, foundImage, foundFormat));
+    }
+
+    // A reset empties it
+    QGCResetTask* resetTask = new QGCResetTask();
+    QSignalSpy spyReset(resetTask, &QGCResetTask::resetCompleted);
+    worker->enqueueTask(resetTask);
+    QVERIFY(spyReset.count() || spyReset.wait(10000));
+    QCOMPARE(memCache.count(), (quint32)0);
+
+    _stopWorker(worker);
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef TileCacheWorkerTest_H
+#define TileCacheWorkerTest_H
+
+#include "UnitTest.h"
+
+#include <QGeoCoordinate>
+
+class QGCCacheWorker;
+class QGCTile;
+class QGCCachedTileSet;
+
+/// Unit test and save benchmark for QGCCacheWorker
+class TileCacheWorkerTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    TileCacheWorkerTest(void);
+
+private slots:
+    void init(void);
+    void cleanup(void);
+
+    void _saveTiles_test(void);
+    void _totals_test(void);
+    void _pruneOrder_test(void);
+    void _saveBenchmark_test(void);
+    void _fetchLatency_test(void);
+    void _migrateTileKeys_test(void);
+    void _migrateTileKeysFailure_test(void);
+    void _enumerateTileSet_test(void);
+    void _polygonTileSet_test(void);
+    void _mbtiles_test(void);
+    void _memCacheEviction_test(void);
+    void _memCacheInvalidation_test(void);
+
+private:
+    QGCCacheWorker* _startWorker(int synchronous, bool walMode, int saveBatchSize, int readerCount);
+    void            _stopWorker(QGCCacheWorker* worker);
+    double          _saveTiles(QGCCacheWorker* worker, int tileCount, int tileSize);
+    void            _fetchDuringPrune(QGCCacheWorker* worker, QList<double>& latencies);
+    void            _createTextKeyCache(void);
+    quint64         _createTileSet(QGCCacheWorker* worker, int x0, int y0, int x1, int y1, int z, int minZoom, int maxZoom, const QList<QGeoCoordinate>& polygon = QList<QGeoCoordinate>());
+    static QGeoCoordinate _tileCoordinate(double x, double y, int z);
+    void            _getTileDownloadList(QGCCacheWorker* worker, quint64 setID, int count, QList<QGCTile*>& tiles, quint32& cachedCount);
+    QGCCachedTileSet* _importTileSet(QGCCacheWorker* worker, const QString& path, const QString& name);
+
+    QString _databaseFileName;
+    int     _tileBase;      ///< Tile x coordinate for the next save, keeps hashes unique across runs
+
+    static const int _benchmarkTileCount =          100000;
+    static const int _legacyBenchmarkTileCount =    1000;   ///< Unbatched saves are too slow for the full count
+    static const int _benchmarkTileSize =           1024;
+    static const int _latencyFetchCount =           2000;
+    static const int _migrateTileCount =            1000;
+    static const int _migrateSharedCount =          100;
+    static const int _migratePendingCount =         10;
+    static const int _mbtilesBlockSize =            64;     ///< Exported tiles are a block this many tiles on a side
+    static const int _memCacheMaxBytes =            8000;   ///< Memory cache budget for the eviction test
+    static const int _pruneTileCount =              20;
+    static const int _pruneOfflineCount =           3;      ///< Oldest tiles after tile 0 which are also in an offline set
+    static const int _prunedCount =                 5;
+    static const int _pruneBaseDate =               1000;   ///< Access time given to tile 0, long before the test runs
+};
+
+#endif
@@ -0,0 +1,151 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#include "TileDownloaderTest.h"
+#include "MockTileServer.h"
+#include "QGCTileDownloader.h"
+#include "QGCMapEngine.h"
+
+#include <QNetworkAccessManager>
+#include <QSignalSpy>
+
+TileDownloaderTest::TileDownloaderTest(void)
+{
+
+}
+
+/// Queues count tiles of the specified zoom level, one row from (0, 0)
+void TileDownloaderTest::_addTiles(QGCTileDownloader* downloader, MockTileServer* server, int z, int count)
+{
+    for (int x=0; x<count; x++) {
+        downloader->addTile(QGCMapEngine::getTileKey(UrlFactory::GoogleMap, x, 0, z), server->request(x, 0, z));
+    }
+}
+
+/// Waits until count tiles were either downloaded or given up on
+bool TileDownloaderTest::_waitForTiles(QSignalSpy& spyDownloaded, QSignalSpy& spyFailed, int count)
+{
+    for (int wait=0; wait<300 && spyDownloaded.count() + spyFailed.count() < count; wait++) {
+        QTest::qWait(100);
+    }
+    return spyDownloaded.count() + spyFailed.count() == count;
+}
+
+void TileDownloaderTest::_zoomOrder_test(void)
+{
+    MockTileServer server;
+    server.setLatency(5);
+    QNetworkAccessManager networkManager;
+    QGCTileDownloader downloader(&networkManager);
+    downloader.setInitialConcurrency(1);
+    downloader.setMaxConcurrency(1);
+    QSignalSpy spyDownloaded(&downloader, &QGCTileDownloader::tileDownloaded);
+    QSignalSpy spyFailed(&downloader, &QGCTileDownloader::tileFailed);
+
+    // Queued deepest zoom first, requested shallowest zoom first
+    _addTiles(&downloader, &server, 3, 8);
+    _addTiles(&downloader, &server, 1, 2);
+    _addTiles(&downloader, &server, 2, 4);
+    QCOMPARE(downloader.queuedCount(), 14);
+    QVERIFY(_waitForTiles(spyDownloaded, spyFailed, 14));
+    QCOMPARE(spyFailed.count(), 0);
+    QCOMPARE(server.maxOpen(), 1);
+    QList<int> zooms = server.requestedZooms();
+    QCOMPARE(zooms.count(), 14);
+    for (int i=1; i<zooms.count(); i++) {
+        QVERIFY(zooms[i] >= zooms[i - 1]);
+    }
+    foreach (const QList<QVariant>& args, spyDownloaded) {
+        QCOMPARE(args[1].toByteArray().length(), (int)MockTileServer::tileSize);
+    }
+    QCOMPARE(downloader.queuedCount(), 0);
+    QCOMPARE(downloader.inFlightCount(), 0);
+}
+
+void TileDownloaderTest::_retry_test(void)
+{
+    MockTileServer server;
+    QNetworkAccessManager networkManager;
+    QGCTileDownloader downloader(&networkManager);
+    downloader.setRetryDelay(10);
+    downloader.setMaxRetries(3);
+    QSignalSpy spyDownloaded(&downloader, &QGCTileDownloader::tileDownloaded);
+    QSignalSpy spyFailed(&downloader, &QGCTileDownloader::tileFailed);
+
+    // Two failures each are retried through, missing tiles fail right away
+    server.setFailFirst(2);
+    server.setMissingZoom(6);
+    _addTiles(&downloader, &server, 5, 20);
+    _addTiles(&downloader, &server, 6, 5);
+    QVERIFY(_waitForTiles(spyDownloaded, spyFailed, 25));
+    QCOMPARE(spyDownloaded.count(), 20);
+    QCOMPARE(spyFailed.count(), 5);
+    QCOMPARE(server.requestCount(), (20 * 3) + 5);
+
+    // Past the retry limit the tile is given up on
+    spyDownloaded.clear();
+    spyFailed.clear();
+    server.setFailFirst(100);
+    _addTiles(&downloader, &server, 7, 4);
+    QVERIFY(_waitForTiles(spyDownloaded, spyFailed, 4));
+    QCOMPARE(spyDownloaded.count(), 0);
+    QCOMPARE(spyFailed.count(), 4);
+    QCOMPARE(server.requestCount(), (20 * 3) + 5 + (4 * 4));
+}
+
+void TileDownloaderTest::_concurrency_test(void)
+{
+    // A healthy host gets more requests in flight
+    {
+        MockTileServer server;
+        server.setLatency(10);
+        QNetworkAccessManager networkManager;
+        QGCTileDownloader downloader(&networkManager);
+        downloader.setInitialConcurrency(2);
+        downloader.setMaxConcurrency(8);
+        QSignalSpy spyDownloaded(&downloader, &QGCTileDownloader::tileDownloaded);
+        QSignalSpy spyFailed(&downloader, &QGCTileDownloader::tileFailed);
+
+        _addTiles(&downloader, &server, 10, 200);
+        QVERIFY(_waitForTiles(spyDownloaded, spyFailed, 200));
+        QCOMPARE(spyFailed.count(), 0);
+        QVERIFY(downloader.concurrency(server.host()) > 2);
+        QVERIFY(server.maxOpen() <= 8);
+
+        // Every tile is the same size, so the two rates agree (up to the clock moving between the calls)
+        double tilesPerSecond = downloader.tilesPerSecond();
+        double bytesPerSecond = downloader.bytesPerSecond();
+        QVERIFY(tilesPerSecond > 0.0);
+        QVERIFY(qAbs(bytesPerSecond - (tilesPerSecond * MockTileServer::tileSize)) < bytesPerSecond * 0.01);
+        qCDebug(UnitTestBenchmarkLog) << "Healthy host concurrency" << downloader.concurrency(server.host()) << "Tiles/s" << tilesPerSecond;
+    }
+
+    // A throttling host gets fewer, and every tile still makes it through on retries
+    {
+        MockTileServer server;
+        server.setLatency(10);
+        server.setOverloadAbove(3);
+        QNetworkAccessManager networkManager;
+        QGCTileDownloader downloader(&networkManager);
+        downloader.setInitialConcurrency(8);
+        downloader.setMaxConcurrency(16);
+        downloader.setRetryDelay(5);
+        downloader.setMaxRetries(10);
+        QSignalSpy spyDownloaded(&downloader, &QGCTileDownloader::tileDownloaded);
+        QSignalSpy spyFailed(&downloader, &QGCTileDownloader::tileFailed);
+
+        _addTiles(&downloader, &server, 10, 100);
+        QVERIFY(_waitForTiles(spyDownloaded, spyFailed, 100));
+        QCOMPARE(spyFailed.count(), 0);
+        QVERIFY(server.overloadCount() > 0);
+        QVERIFY(downloader.concurrency(server.host()) < 8);
+        qCDebug(UnitTestBenchmarkLog) << "Throttling host concurrency" << downloader.concurrency(server.host()) << "Turned away" << server.overloadCount();
+    }
+}
@@ -0,0 +1,38 @@
+/****************************************************************************
+ *
+ *   (c) 2009-2016 QGROUNDCONTROL PROJECT <http://www.qgroundcontrol.org>
+ *
+ * QGroundControl is licensed according to the terms in the file
+ * COPYING.md in the root of the source code directory.
+ *
+ ****************************************************************************/
+
+
+#ifndef TileDownloaderTest_H
+#define TileDownloaderTest_H
+
+#include "UnitTest.h"
+
+class QSignalSpy;
+class QGCTileDownloader;
+class MockTileServer;
+
+/// Unit test for QGCTileDownloader, run against MockTileServer
+class TileDownloaderTest : public UnitTest
+{
+    Q_OBJECT
+
+public:
+    TileDownloaderTest(void);
+
+private slots:
+    void _zoomOrder_test(void);
+    void _retry_test(void);
+    void _concurrency_test(void);
+
+private:
+    void _addTiles(QGCTileDownloader* downloader, MockTileServer* server, int z, int count);
+    bool _waitForTiles(QSignalSpy& spyDownloaded, QSignalSpy& spyFailed, int count);
+};
+
+#endif
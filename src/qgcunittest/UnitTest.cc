@@ -22,6 +22,8 @@
 #include <QTemporaryFile>
 #include <QTime>
 
+QGC_LOGGING_CATEGORY(UnitTestBenchmarkLog, "UnitTestBenchmarkLog")
+
 bool UnitTest::_messageBoxRespondedTo = false;
 bool UnitTest::_badResponseButton = false;
 QMessageBox::StandardButton UnitTest::_messageBoxResponseButton = QMessageBox::NoButton;
@@ -504,3 +506,8 @@ bool UnitTest::fileCompare(const QString& file1, const QString& file2)
 
     return true;
 }
+
+bool UnitTest::benchmarksEnabled(void)
+{
+    return !qgetenv("QGC_UNITTEST_BENCHMARKS").isEmpty();
+}
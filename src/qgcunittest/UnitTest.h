@@ -24,9 +24,19 @@
 
 #include "QGCMAVLink.h"
 #include "LinkInterface.h"
+#include "QGCLoggingCategory.h"
 
 #define UT_REGISTER_TEST(className) static UnitTestWrapper<className> className(#className);
 
+/// Skips a heavy benchmark test case unless benchmarks were asked for, see UnitTest::benchmarksEnabled
+#define UT_BENCHMARK_OPT_IN() \
+    if (!UnitTest::benchmarksEnabled()) { \
+        QSKIP("Benchmark, set QGC_UNITTEST_BENCHMARKS=1 to run"); \
+    }
+
+/// Benchmark results. Turn on with --logging:UnitTestBenchmarkLog
+Q_DECLARE_LOGGING_CATEGORY(UnitTestBenchmarkLog)
+
 class QGCMessageBox;
 class QGCFileDialog;
 class LinkManager;
@@ -92,6 +102,11 @@ public:
     /// @return true: files are alike, false: files differ
     static bool fileCompare(const QString& file1, const QString& file2);
 
+    /// Heavy benchmarks are not part of the default run since they take minutes and their results need a person to read
+    /// them. Set the QGC_UNITTEST_BENCHMARKS environment variable to run them.
+    /// @return true: Run benchmark test cases
+    static bool benchmarksEnabled(void);
+
 protected slots:
     
     // These are all pure virtuals to force the derived class to implement each one and in turn
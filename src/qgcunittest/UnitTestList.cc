@@ -31,10 +31,21 @@
 #include "ParameterManagerTest.h"
 #include "MissionCommandTreeTest.h"
 #include "LogDownloadTest.h"
+#include "LogParserTest.h"
+#include "GeoTagControllerTest.h"
+#include "ExifParserTest.h"
+#include "MAVLinkFrameDecoderTest.h"
+#include "MAVLinkRequestWindowTest.h"
+#include "MAVLinkTlogIndexTest.h"
+#include "MAVLinkLogProcessorTest.h"
+#include "TileCacheWorkerTest.h"
+#include "TileDownloaderTest.h"
+#include "MockLinkSwarmTest.h"
 
 UT_REGISTER_TEST(FactSystemTestGeneric)
 UT_REGISTER_TEST(FactSystemTestPX4)
 UT_REGISTER_TEST(FileDialogTest)
+UT_REGISTER_TEST(FileManagerTest)
 UT_REGISTER_TEST(FlightGearUnitTest)
 UT_REGISTER_TEST(GeoTest)
 UT_REGISTER_TEST(LinkManagerTest)
@@ -50,6 +61,16 @@ UT_REGISTER_TEST(TCPLinkTest)
 UT_REGISTER_TEST(ParameterManagerTest)
 UT_REGISTER_TEST(MissionCommandTreeTest)
 UT_REGISTER_TEST(LogDownloadTest)
+UT_REGISTER_TEST(LogParserTest)
+UT_REGISTER_TEST(GeoTagControllerTest)
+UT_REGISTER_TEST(ExifParserTest)
+UT_REGISTER_TEST(MAVLinkFrameDecoderTest)
+UT_REGISTER_TEST(MAVLinkRequestWindowTest)
+UT_REGISTER_TEST(MAVLinkTlogIndexTest)
+UT_REGISTER_TEST(MAVLinkLogProcessorTest)
+UT_REGISTER_TEST(TileCacheWorkerTest)
+UT_REGISTER_TEST(TileDownloaderTest)
+UT_REGISTER_TEST(MockLinkSwarmTest)
 
 // List of unit test which are currently disabled.
 // If disabling a new test, include reason in comment.
@@ -57,6 +78,3 @@ UT_REGISTER_TEST(LogDownloadTest)
 // FIXME: Temporarily disabled until this can be stabilized
 //UT_REGISTER_TEST(MainWindowTest)
 
-// Onboard file support has been removed until it can be make to work correctly
-//UT_REGISTER_TEST(FileManagerTest)
-
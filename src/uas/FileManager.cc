@@ -17,20 +17,36 @@
 
 #include <QFile>
 #include <QDir>
+#include <QDataStream>
 #include <string>
 
 QGC_LOGGING_CATEGORY(FileManagerLog, "FileManagerLog")
 
+const char* FileManager::partialFileExtension =     ".part";
+const char* FileManager::resumeBitmapExtension =    ".chunks";
+
 FileManager::FileManager(QObject* parent, Vehicle* vehicle)
     : QObject(parent)
     , _currentOperation(kCOIdle)
+    , _ackTimeoutMsecs(ackTimerTimeoutMsecs)
     , _vehicle(vehicle)
     , _dedicatedLink(NULL)
     , _lastOutgoingSeqNumber(0)
     , _activeSession(0)
+    , _readChunkCount(0)
+    , _readChunksReceivedCount(0)
+    , _readFirstMissingChunk(0)
+    , _readChunksSinceSave(0)
+    , _readWindowFirstSeqNumber(0)
+    , _readWindow(maxReadWindowSize)
+    , _readBytesThisSession(0)
     , _systemIdQGC(0)
 {
     connect(&_ackTimer, &QTimer::timeout, this, &FileManager::_ackTimeout);
+
+    _readWindowTimer.setSingleShot(false);
+    _readWindowTimer.setInterval(_readWindowTimerMSecs);
+    connect(&_readWindowTimer, &QTimer::timeout, this, &FileManager::_readWindowTimeout);
     
     _systemIdServer = _vehicle->id();
     
@@ -50,6 +66,16 @@ void FileManager::_openAckResponse(Request* openAck)
     // File length comes back in data
     Q_ASSERT(openAck->hdr.size == sizeof(uint32_t));
     _downloadFileSize = openAck->openFileLength;
+
+    if (_currentOperation == kCORead) {
+        // Reads are pipelined through the read window
+        if (!_openReadWindow()) {
+            _currentOperation = kCOIdle;
+            _emitErrorMessage(tr("Unable to open local file for writing (%1)").arg(_partialFilePath()));
+            _sendResetCommand();
+        }
+        return;
+    }
     
     // Start the sequence of read commands
 
@@ -100,6 +126,316 @@ void FileManager::_closeDownloadSession(bool success)
     _sendResetCommand();
 }
 
+/// Sets up the read window for a pipelined download and sends the first set of read requests. If a partial download
+/// of the same file was left behind it is picked up where it left off.
+///     @return false: unable to open local file
+bool FileManager::_openReadWindow(void)
+{
+    int chunkSize = sizeof(((Request*)0)->data);
+
+    _readChunkCount = (_downloadFileSize + chunkSize - 1) / chunkSize;
+    _readChunksReceived.fill(false, _readChunkCount);
+    _readChunksReceivedCount = 0;
+    _readFirstMissingChunk = 0;
+    _readChunksSinceSave = 0;
+    _readChunksInFlight.clear();
+    _readChunkRetryCounts.clear();
+    _readWindowFirstSeqNumber = _lastOutgoingSeqNumber + 1;
+    _readWindow.reset();
+    _readBytesThisSession = 0;
+
+    bool resume = _loadResumeBitmap();
+
+    QIODevice::OpenMode openMode = QIODevice::ReadWrite;
+    if (!resume) {
+        openMode |= QIODevice::Truncate;
+    }
+    _readFile.setFileName(_partialFilePath());
+    if (!_readFile.open(openMode)) {
+        return false;
+    }
+    if (!_readFile.resize(_downloadFileSize)) {
+        _readFile.close();
+        return false;
+    }
+
+    while (_readFirstMissingChunk < _readChunkCount && _readChunksReceived.testBit(_readFirstMissingChunk)) {
+        _readFirstMissingChunk++;
+    }
+    if (resume) {
+        qCDebug(FileManagerLog) << "Resuming download chunks received:total" << _readChunksReceivedCount << _readChunkCount;
+    }
+
+    _readElapsedTimer.start();
+
+    if (_readChunksReceivedCount == _readChunkCount) {
+        // Empty file, or everything was already downloaded
+        _closeReadWindow(true /* success */);
+    } else {
+        _fillReadWindow();
+    }
+
+    return true;
+}
+
+/// Sends read requests for missing chunks until the read window is full
+void FileManager::_fillReadWindow(void)
+{
+    int chunkSize = sizeof(((Request*)0)->data);
+
+    for (int chunk=_readFirstMissingChunk; chunk<_readChunkCount && _readWindow.canSend(_readChunksInFlight.count()); chunk++) {
+        if (_readChunksReceived.testBit(chunk) || _readChunksInFlight.contains(chunk)) {
+            continue;
+        }
+
+        if (_readChunkRetryCounts.value(chunk, 0) >= maxReadChunkRetry) {
+            _closeReadWindow(false /* failure */);
+            _emitErrorMessage(tr("Download: No response for offset (%1) after %2 retries").arg(chunk * chunkSize).arg(maxReadChunkRetry));
+            return;
+        }
+        _readChunkRetryCounts[chunk]++;
+
+        Request request;
+        request.hdr.session = _activeSession;
+        request.hdr.opcode = kCmdReadFile;
+        request.hdr.offset = chunk * chunkSize;
+        request.hdr.size = sizeof(request.data);
+        _sendRequestNoAck(&request);
+
+        ReadInFlight_t& inFlight = _readChunksInFlight[chunk];
+        inFlight.seqNumber = request.hdr.seqNumber;
+        inFlight.sentMSecs = _readElapsedTimer.elapsed();
+    }
+
+    if (!_readChunksInFlight.isEmpty() && !_readWindowTimer.isActive()) {
+        _readWindowTimer.start();
+    }
+}
+
+/// Respond to the Ack or Nak associated with a pipelined read request. These arrive in any order.
+void FileManager::_readWindowResponse(Request* readAck)
+{
+    // Responses to requests from an earlier download are ignored
+    if ((uint16_t)(readAck->hdr.seqNumber - 1 - _readWindowFirstSeqNumber) > (uint16_t)(_lastOutgoingSeqNumber - _readWindowFirstSeqNumber)) {
+        qCDebug(FileManagerLog) << "Ignoring read response from earlier download seqNumber:" << readAck->hdr.seqNumber;
+        return;
+    }
+
+    if (readAck->hdr.opcode == kRspNak) {
+        _closeReadWindow(false /* failure */);
+        _emitErrorMessage(tr("Nak received, error: %1").arg(errorString(readAck->data[0])));
+        return;
+    }
+
+    if (readAck->hdr.session != _activeSession) {
+        _closeReadWindow(false /* failure */);
+        _emitErrorMessage(tr("Download: Incorrect session returned"));
+        return;
+    }
+
+    uint32_t    chunkSize = sizeof(readAck->data);
+    uint32_t    offset = readAck->hdr.offset;
+    int         chunk = offset / chunkSize;
+    if (offset % chunkSize != 0 || chunk >= _readChunkCount) {
+        _closeReadWindow(false /* failure */);
+        _emitErrorMessage(tr("Download: Offset returned (%1) was not requested").arg(offset));
+        return;
+    }
+
+    uint32_t expectedSize = qMin(chunkSize, _downloadFileSize - offset);
+    if (readAck->hdr.size != expectedSize) {
+        _closeReadWindow(false /* failure */);
+        _emitErrorMessage(tr("Download: Size returned (%1) differs from size expected (%2) at offset (%3)").arg(readAck->hdr.size).arg(expectedSize).arg(offset));
+        return;
+    }
+
+    qCDebug(FileManagerLog) << QString("_readWindowResponse: offset(%1) size(%2) seqNumber(%3)").arg(offset).arg(readAck->hdr.size).arg(readAck->hdr.seqNumber);
+
+    if (_readChunksReceived.testBit(chunk)) {
+        // Duplicate response to a resent request
+        return;
+    }
+
+    if (!_readFile.seek(offset) || _readFile.write((const char*)readAck->data, readAck->hdr.size) != readAck->hdr.size) {
+        _closeReadWindow(false /* failure */);
+        _emitErrorMessage(tr("Unable to write data to local file (%1)").arg(_readFile.fileName()));
+        return;
+    }
+
+    _readChunksReceived.setBit(chunk);
+    _readChunksReceivedCount++;
+    _readBytesThisSession += readAck->hdr.size;
+    _readChunkComplete(chunk, readAck->hdr.seqNumber);
+
+    while (_readFirstMissingChunk < _readChunkCount && _readChunksReceived.testBit(_readFirstMissingChunk)) {
+        _readFirstMissingChunk++;
+    }
+
+    emit commandProgress(100 * ((float)_readChunksReceivedCount / (float)_readChunkCount));
+
+    if (_readChunksReceivedCount == _readChunkCount) {
+        _closeReadWindow(true /* success */);
+        return;
+    }
+
+    if (++_readChunksSinceSave >= _resumeBitmapSaveInterval) {
+        _saveResumeBitmap();
+    }
+
+    _fillReadWindow();
+}
+
+/// Updates the round trip time and read window for a chunk which has been received
+void FileManager::_readChunkComplete(int chunk, uint16_t seqNumber)
+{
+    int retryCount = _readChunkRetryCounts.take(chunk);
+
+    if (!_readChunksInFlight.contains(chunk)) {
+        // Response to a request which already timed out
+        return;
+    }
+    ReadInFlight_t inFlight = _readChunksInFlight.take(chunk);
+
+    // Only sample the round trip time from chunks which were requested once. A response to a resent request can't be
+    // matched to the send which caused it.
+    double rttMSecs = -1;
+    if (retryCount == 1 && seqNumber == (uint16_t)(inFlight.seqNumber + 1)) {
+        rttMSecs = _readElapsedTimer.elapsed() - inFlight.sentMSecs;
+    }
+    _readWindow.replyReceived(rttMSecs);
+}
+
+void FileManager::_readWindowTimeout(void)
+{
+    if (_currentOperation != kCORead) {
+        _readWindowTimer.stop();
+        return;
+    }
+
+    qint64  nowMSecs = _readElapsedTimer.elapsed();
+    int     timeoutMSecs = _readWindow.timeoutMSecs();
+    int     timeoutCount = 0;
+
+    foreach(int chunk, _readChunksInFlight.keys()) {
+        if (nowMSecs - _readChunksInFlight[chunk].sentMSecs >= timeoutMSecs) {
+            // Request or response was lost. The chunk is still missing so it is resent as the window refills.
+            _readChunksInFlight.remove(chunk);
+            timeoutCount++;
+        }
+    }
+
+    if (timeoutCount) {
+        _readWindow.requestsTimedOut(timeoutCount);
+        qCDebug(FileManagerLog) << "Read window timeout window:rtt:timeout" << _readWindow.size() << _readWindow.smoothedRttMSecs() << timeoutMSecs;
+        _fillReadWindow();
+    }
+}
+
+/// Closes out a pipelined download. On success the partial file is moved into place, otherwise the partial file and
+/// chunk bitmap are kept so the download can be resumed.
+///     @param success true: all chunks received, false: error during download
+void FileManager::_closeReadWindow(bool success)
+{
+    qCDebug(FileManagerLog) << QString("_closeReadWindow: success(%1) timeouts(%2)").arg(success).arg(_readWindow.timeoutCount());
+
+    _currentOperation = kCOIdle;
+    _readWindowTimer.stop();
+    _readChunksInFlight.clear();
+    _readChunkRetryCounts.clear();
+
+    if (success) {
+        _readFile.close();
+
+        QString downloadFilePath = _readFileDownloadDir.absoluteFilePath(_readFileDownloadFilename);
+        QFile::remove(downloadFilePath);
+        if (QFile::rename(_partialFilePath(), downloadFilePath)) {
+            QFile::remove(_resumeBitmapFilePath());
+
+            qint64 elapsedMSecs = _readElapsedTimer.elapsed();
+            if (elapsedMSecs > 0) {
+                emit downloadRate(_readBytesThisSession * 1000.0 / elapsedMSecs);
+            }
+            emit commandComplete();
+        } else {
+            _emitErrorMessage(tr("Unable to write data to local file (%1)").arg(downloadFilePath));
+        }
+    } else if (_readFile.isOpen()) {
+        _readFile.close();
+        _saveResumeBitmap();
+    }
+
+    // Close the open session
+    _sendResetCommand();
+}
+
+/// Loads the chunk bitmap for a partial download of the current file, if there is one
+///     @return true: partial download can be resumed
+bool FileManager::_loadResumeBitmap(void)
+{
+    QFileInfo partialFileInfo(_partialFilePath());
+    if (!partialFileInfo.exists() || partialFileInfo.size() != _downloadFileSize) {
+        return false;
+    }
+
+    QFile bitmapFile(_resumeBitmapFilePath());
+    if (!bitmapFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    quint32     magic;
+    QString     path;
+    quint32     fileSize;
+    quint32     chunkSize;
+    QBitArray   chunksReceived;
+
+    QDataStream stream(&bitmapFile);
+    stream >> magic >> path >> fileSize >> chunkSize >> chunksReceived;
+    if (stream.status() != QDataStream::Ok ||
+            magic != _resumeBitmapMagic ||
+            path != _readFileDownloadPath ||
+            fileSize != _downloadFileSize ||
+            chunkSize != sizeof(((Request*)0)->data) ||
+            chunksReceived.count() != _readChunkCount) {
+        // Left over from a different file
+        return false;
+    }
+
+    _readChunksReceived = chunksReceived;
+    _readChunksReceivedCount = chunksReceived.count(true);
+
+    return true;
+}
+
+/// Saves the chunk bitmap for the current download so it can be resumed
+void FileManager::_saveResumeBitmap(void)
+{
+    _readChunksSinceSave = 0;
+
+    // The bitmap must never claim chunks which haven't made it to disk
+    if (_readFile.isOpen()) {
+        _readFile.flush();
+    }
+
+    QFile bitmapFile(_resumeBitmapFilePath());
+    if (!bitmapFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(FileManagerLog) << "Unable to save download resume bitmap" << bitmapFile.errorString();
+        return;
+    }
+
+    QDataStream stream(&bitmapFile);
+    stream << _resumeBitmapMagic << _readFileDownloadPath << _downloadFileSize << (quint32)sizeof(((Request*)0)->data) << _readChunksReceived;
+}
+
+QString FileManager::_partialFilePath(void)
+{
+    return _readFileDownloadDir.absoluteFilePath(_readFileDownloadFilename + partialFileExtension);
+}
+
+QString FileManager::_resumeBitmapFilePath(void)
+{
+    return _partialFilePath() + resumeBitmapExtension;
+}
+
 /// Closes out an upload session doing cleanup.
 ///     @param success true: successful upload completion, false: error during download
 void FileManager::_closeUploadSession(bool success)
@@ -313,6 +649,17 @@ void FileManager::receiveMessage(mavlink_message_t message)
     }
     
     Request* request = (Request*)&data.payload[0];
+
+    if (request->hdr.req_opcode == kCmdReadFile && (request->hdr.opcode == kRspAck || request->hdr.opcode == kRspNak)) {
+        // Pipelined read responses arrive in any order and have their own timeouts, so they skip the sequence number
+        // checks below.
+        if (_currentOperation == kCORead) {
+            _readWindowResponse(request);
+        } else {
+            qCDebug(FileManagerLog) << "Ignoring late read response seqNumber:" << request->hdr.seqNumber;
+        }
+        return;
+    }
     
     _clearAckTimeout();
     
@@ -365,10 +712,6 @@ void FileManager::receiveMessage(mavlink_message_t message)
 				_openAckResponse(request);
 				break;
 				
-			case kCmdReadFile:
-				_downloadAckResponse(request, true /* read file */);
-				break;
-				
 			case kCmdBurstReadFile:
 				_downloadAckResponse(request, false /* stream file */);
 				break;
@@ -519,6 +862,7 @@ void FileManager::_downloadWorker(const QString& from, const QDir& downloadDir,
 	}
 	i++; // move past slash
 	_readFileDownloadFilename = from.right(from.size() - i);
+	_readFileDownloadPath = from;
 	
 	_currentOperation = readFile ? kCOOpenRead : kCOOpenBurst;
 	
@@ -643,7 +987,7 @@ void FileManager::_setupAckTimeout(void)
     Q_ASSERT(!_ackTimer.isActive());
 
     _ackTimer.setSingleShot(true);
-    _ackTimer.start(ackTimerTimeoutMsecs);
+    _ackTimer.start(_ackTimeoutMsecs);
 }
 
 /// @brief Clears the ack timeout timer
@@ -717,11 +1061,16 @@ void FileManager::_emitListEntry(const QString& entry)
 /// @brief Sends the specified Request out to the UAS.
 void FileManager::_sendRequest(Request* request)
 {
+    _setupAckTimeout();
+    _sendRequestNoAck(request);
+}
 
+/// @brief Sends the specified Request out to the UAS without starting the ack timer. Pipelined reads track their own
+/// timeouts.
+void FileManager::_sendRequestNoAck(Request* request)
+{
     mavlink_message_t message;
 
-    _setupAckTimeout();
-    
     _lastOutgoingSeqNumber++;
 
     request->hdr.seqNumber = _lastOutgoingSeqNumber;
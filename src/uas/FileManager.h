@@ -14,9 +14,14 @@
 #include <QObject>
 #include <QDir>
 #include <QTimer>
+#include <QFile>
+#include <QBitArray>
+#include <QElapsedTimer>
+#include <QMap>
 
 #include "UASInterface.h"
 #include "QGCLoggingCategory.h"
+#include "MAVLinkRequestWindow.h"
 
 Q_DECLARE_LOGGING_CATEGORY(FileManagerLog)
 
@@ -37,7 +42,22 @@ public:
     /// for the FileManager to timeout.
     static const int ackTimerTimeoutMsecs = 10000;
 
-	/// Downloads the specified file.
+    /// Overrides ackTimerTimeoutMsecs. Unit tests use a short timeout so the failure cases don't take minutes to run.
+    void setAckTimeoutMsecs(int ackTimeoutMsecs) { _ackTimeoutMsecs = ackTimeoutMsecs; }
+
+    /// Maximum number of read requests in flight during a download
+    static const int maxReadWindowSize = 16;
+
+    /// Number of times a single chunk is requested before the download fails
+    static const int maxReadChunkRetry = 5;
+
+    /// Extension added to the local file name for a download which is in progress. The chunk bitmap is kept next to it
+    /// in a file with resumeBitmapExtension added, so a failed download picks up where it left off the next time.
+    static const char* partialFileExtension;
+    static const char* resumeBitmapExtension;
+
+	/// Downloads the specified file. Reads are pipelined with several chunks in flight at once. Chunks which are lost
+	/// are re-requested individually. A download which fails can be resumed by downloading the same file again.
 	///     @param from File to download from UAS, fully qualified path
 	///     @param downloadDir Local directory to download file to
 	void downloadPath(const QString& from, const QDir& downloadDir);
@@ -73,11 +93,16 @@ signals:
     ///     @param value Amount of progress: 0.0 = none, 1.0 = complete
     void commandProgress(int value);
 
+    /// Signalled when a download completes
+    ///     @param bytesPerSec Average rate for the bytes transferred during this download attempt
+    void downloadRate(double bytesPerSec);
+
 public slots:
     void receiveMessage(mavlink_message_t message);
 	
 private slots:
 	void _ackTimeout(void);
+    void _readWindowTimeout(void);
 
 private:
     /// @brief This is the fixed length portion of the protocol data. Trying to pack structures across differing compilers is
@@ -172,6 +197,7 @@ private:
     void _emitErrorMessage(const QString& msg);
     void _emitListEntry(const QString& entry);
     void _sendRequest(Request* request);
+    void _sendRequestNoAck(Request* request);
     void _fillRequestWithString(Request* request, const QString& str);
     void _openAckResponse(Request* openAck);
     void _downloadAckResponse(Request* readAck, bool readFile);
@@ -184,11 +210,21 @@ private:
     void _closeDownloadSession(bool success);
     void _closeUploadSession(bool success);
 	void _downloadWorker(const QString& from, const QDir& downloadDir, bool readFile);
+    bool _openReadWindow(void);
+    void _fillReadWindow(void);
+    void _readWindowResponse(Request* readAck);
+    void _readChunkComplete(int chunk, uint16_t seqNumber);
+    void _closeReadWindow(bool success);
+    bool _loadResumeBitmap(void);
+    void _saveResumeBitmap(void);
+    QString _partialFilePath(void);
+    QString _resumeBitmapFilePath(void);
     
     static QString errorString(uint8_t errorCode);
 
     OperationState  _currentOperation;              ///< Current operation of state machine
     QTimer          _ackTimer;                      ///< Used to signal a timeout waiting for an ack
+    int             _ackTimeoutMsecs;
     
     Vehicle*        _vehicle;
     LinkInterface*  _dedicatedLink; ///< Link to use for communication
@@ -211,8 +247,34 @@ private:
     QByteArray  _readFileAccumulator;       ///< Holds file being downloaded
     QDir        _readFileDownloadDir;       ///< Directory to download file to
     QString     _readFileDownloadFilename;  ///< Filename (no path) for download file
+    QString     _readFileDownloadPath;      ///< Fully qualified path of file being downloaded, on the vehicle
     uint32_t    _downloadFileSize;          ///< Size of file being downloaded
 
+    // Pipelined read downloads
+
+    typedef struct {
+        uint16_t    seqNumber;      ///< Sequence number of the last request sent for the chunk
+        qint64      sentMSecs;      ///< Time the last request was sent
+    } ReadInFlight_t;
+
+    QFile                       _readFile;                  ///< Partial download file, chunks are written in place
+    QBitArray                   _readChunksReceived;        ///< Chunks which have been written to the partial file
+    int                         _readChunkCount;            ///< Total number of chunks in the file
+    int                         _readChunksReceivedCount;
+    int                         _readFirstMissingChunk;     ///< All chunks before this one have been received
+    int                         _readChunksSinceSave;       ///< Chunks received since the resume bitmap was last saved
+    uint16_t                    _readWindowFirstSeqNumber;  ///< Sequence number of the first read request for this download
+    QMap<int, ReadInFlight_t>   _readChunksInFlight;        ///< Key: chunk
+    QMap<int, int>              _readChunkRetryCounts;      ///< Key: chunk, only for chunks which have been sent
+    MAVLinkRequestWindow        _readWindow;                ///< Number of requests allowed in flight and their timeout
+    QTimer                      _readWindowTimer;           ///< Checks for requests which timed out
+    QElapsedTimer               _readElapsedTimer;
+    qint64                      _readBytesThisSession;      ///< Bytes received during this download attempt
+
+    static const int _readWindowTimerMSecs =        20;
+    static const int _resumeBitmapSaveInterval =    64;     ///< Number of chunks between resume bitmap saves
+    static const quint32 _resumeBitmapMagic =       0x52505451; ///< "QTPR"
+
     uint8_t     _systemIdQGC;               ///< System ID for QGC
     uint8_t     _systemIdServer;            ///< System ID for server
     
@@ -26,6 +26,7 @@ QGCMAVLinkLogPlayer::QGCMAVLinkLogPlayer(QWidget *parent) :
     connect(_ui->playButton, &QPushButton::clicked, this, &QGCMAVLinkLogPlayer::_playPauseToggle);
     connect(_ui->positionSlider, &QSlider::valueChanged, this, &QGCMAVLinkLogPlayer::_setPlayheadFromSlider);
     connect(_ui->positionSlider, &QSlider::sliderPressed, this, &QGCMAVLinkLogPlayer::_pause);
+    connect(_ui->maxSpeedCheckBox, &QCheckBox::toggled, this, &QGCMAVLinkLogPlayer::_setMaxSpeed);
     
 #if 0
     // Speed slider is removed from 3.0 release. Too broken to fix.
@@ -91,7 +92,9 @@ void QGCMAVLinkLogPlayer::_selectLogFileForPlayback(void)
     connect(_replayLink, &LogReplayLink::playbackStarted, this, &QGCMAVLinkLogPlayer::_playbackStarted);
     connect(_replayLink, &LogReplayLink::playbackPaused, this, &QGCMAVLinkLogPlayer::_playbackPaused);
     connect(_replayLink, &LogReplayLink::playbackPercentCompleteChanged, this, &QGCMAVLinkLogPlayer::_playbackPercentCompleteChanged);
+    connect(_replayLink, &LogReplayLink::playbackMessageRate, this, &QGCMAVLinkLogPlayer::_playbackMessageRate);
     connect(_replayLink, &LogReplayLink::disconnected, this, &QGCMAVLinkLogPlayer::_replayLinkDisconnected);
+    _replayLink->setUnthrottled(_ui->maxSpeedCheckBox->isChecked());
     
     _ui->positionSlider->setValue(0);
 #if 0
@@ -151,6 +154,18 @@ void QGCMAVLinkLogPlayer::_playbackPercentCompleteChanged(int percentComplete)
     _ui->positionSlider->blockSignals(false);
 }
 
+void QGCMAVLinkLogPlayer::_playbackMessageRate(int messagesPerSecond)
+{
+    _ui->rateLabel->setText(tr("%1 msgs/sec").arg(messagesPerSecond));
+}
+
+void QGCMAVLinkLogPlayer::_setMaxSpeed(bool maxSpeed)
+{
+    if (_replayLink) {
+        _replayLink->setUnthrottled(maxSpeed);
+    }
+}
+
 void QGCMAVLinkLogPlayer::_setPlayheadFromSlider(int value)
 {
     if (_replayLink) {
@@ -165,6 +180,7 @@ void QGCMAVLinkLogPlayer::_enablePlaybackControls(bool enabled)
     _ui->speedSlider->setEnabled(enabled);
 #endif
     _ui->positionSlider->setEnabled(enabled);
+    _ui->maxSpeedCheckBox->setEnabled(enabled);
 }
 
 #if 0
@@ -197,5 +213,6 @@ void QGCMAVLinkLogPlayer::_setAccelerationFromSlider(int value)
 void QGCMAVLinkLogPlayer::_replayLinkDisconnected(void)
 {
     _enablePlaybackControls(false);
+    _ui->rateLabel->clear();
     _replayLink = NULL;
 }
@@ -40,6 +40,8 @@ private slots:
     void _playbackStarted(void);
     void _playbackPaused(void);
     void _playbackPercentCompleteChanged(int percentComplete);
+    void _playbackMessageRate(int messagesPerSecond);
+    void _setMaxSpeed(bool maxSpeed);
     void _playbackError(void);
     void _replayLinkDisconnected(void);
 
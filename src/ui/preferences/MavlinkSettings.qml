@@ -136,6 +136,65 @@ Rectangle {
                 }
             }
             //-----------------------------------------------------------------
+            //-- Telemetry Log
+            Item {
+                width:              __mavlinkRoot.width * 0.8
+                height:             tlogLabel.height
+                anchors.margins:    ScreenTools.defaultFontPixelWidth
+                anchors.horizontalCenter: parent.horizontalCenter
+                visible:            QGroundControl.tlogWriter
+                QGCLabel {
+                    id:             tlogLabel
+                    text:           qsTr("Telemetry Log")
+                    font.family:    ScreenTools.demiboldFontFamily
+                }
+            }
+            Rectangle {
+                height:         tlogColumn.height + (ScreenTools.defaultFontPixelHeight * 2)
+                width:          __mavlinkRoot.width * 0.8
+                color:          qgcPal.windowShade
+                anchors.margins: ScreenTools.defaultFontPixelWidth
+                anchors.horizontalCenter: parent.horizontalCenter
+                visible:        QGroundControl.tlogWriter
+                Column {
+                    id:         tlogColumn
+                    width:      gcsColumn.width
+                    spacing:    _columnSpacing
+                    anchors.centerIn: parent
+                    //-----------------------------------------------------------------
+                    //-- Sync to disk
+                    QGCCheckBox {
+                        text:       qsTr("Sync telemetry log to disk")
+                        checked:    QGroundControl.tlogWriter ? QGroundControl.tlogWriter.syncToDisk : false
+                        onClicked: {
+                            QGroundControl.tlogWriter.syncToDisk = checked
+                        }
+                    }
+                    //-----------------------------------------------------------------
+                    //-- Writer statistics
+                    Row {
+                        spacing:    ScreenTools.defaultFontPixelWidth
+                        QGCLabel { width: _labelWidth; text: qsTr("Bytes written:") }
+                        QGCLabel { text: QGroundControl.tlogWriter ? QGroundControl.tlogWriter.bytesWritten : "" }
+                    }
+                    Row {
+                        spacing:    ScreenTools.defaultFontPixelWidth
+                        QGCLabel { width: _labelWidth; text: qsTr("Messages logged/dropped:") }
+                        QGCLabel { text: QGroundControl.tlogWriter ? QGroundControl.tlogWriter.messagesLogged + "/" + QGroundControl.tlogWriter.messagesDropped : "" }
+                    }
+                    Row {
+                        spacing:    ScreenTools.defaultFontPixelWidth
+                        QGCLabel { width: _labelWidth; text: qsTr("Buffer usage:") }
+                        QGCLabel { text: QGroundControl.tlogWriter ? QGroundControl.tlogWriter.bufferPercentFull + "%" : "" }
+                    }
+                    Row {
+                        spacing:    ScreenTools.defaultFontPixelWidth
+                        QGCLabel { width: _labelWidth; text: qsTr("Backpressure events:") }
+                        QGCLabel { text: QGroundControl.tlogWriter ? QGroundControl.tlogWriter.backpressureCount : "" }
+                    }
+                }
+            }
+            //-----------------------------------------------------------------
             //-- Mavlink Logging
             Item {
                 width:              __mavlinkRoot.width * 0.8